@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "adc_deinterleave.h"
+
+size_t adc_deinterleave(const uint16_t *src, size_t n_frames, unsigned int n_channels, uint16_t *const dst[]) {
+    size_t errors = 0;
+    // Specialise the common cases, so the inner loop has no channel loop
+    switch (n_channels) {
+        case 1:
+            for (size_t i = 0; i < n_frames; ++i) {
+                uint16_t s = src[i];
+                errors += s >> 15;
+                dst[0][i] = s & ADC_SAMPLE_MASK;
+            }
+            break;
+        case 2:
+            for (size_t i = 0; i < n_frames; ++i, src += 2) {
+                errors += (src[0] >> 15) + (src[1] >> 15);
+                dst[0][i] = src[0] & ADC_SAMPLE_MASK;
+                dst[1][i] = src[1] & ADC_SAMPLE_MASK;
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < n_frames; ++i, src += 4) {
+                errors += (src[0] >> 15) + (src[1] >> 15) + (src[2] >> 15) + (src[3] >> 15);
+                dst[0][i] = src[0] & ADC_SAMPLE_MASK;
+                dst[1][i] = src[1] & ADC_SAMPLE_MASK;
+                dst[2][i] = src[2] & ADC_SAMPLE_MASK;
+                dst[3][i] = src[3] & ADC_SAMPLE_MASK;
+            }
+            break;
+        default:
+            for (size_t i = 0; i < n_frames; ++i) {
+                for (unsigned int ch = 0; ch < n_channels; ++ch) {
+                    uint16_t s = *src++;
+                    errors += s >> 15;
+                    dst[ch][i] = s & ADC_SAMPLE_MASK;
+                }
+            }
+            break;
+    }
+    return errors;
+}
+
+void adc_decimator_init(adc_decimator_t *dec, unsigned int n_channels, unsigned int factor) {
+    dec->n_channels = n_channels;
+    dec->factor = factor;
+    dec->count = 0;
+    for (unsigned int ch = 0; ch < ADC_DEINTERLEAVE_MAX_CHANNELS; ++ch)
+        dec->acc[ch] = 0;
+}
+
+size_t adc_decimate(adc_decimator_t *dec, const uint16_t *src, size_t n_frames, uint16_t *const dst[]) {
+    const unsigned int n_channels = dec->n_channels;
+    size_t n_out = 0;
+    size_t i = 0;
+    while (i < n_frames) {
+        // Accumulate as many frames as we can before the next output sample
+        size_t n = dec->factor - dec->count;
+        if (n > n_frames - i)
+            n = n_frames - i;
+        const uint16_t *s = src + i * n_channels;
+        for (unsigned int ch = 0; ch < n_channels; ++ch) {
+            uint32_t acc = dec->acc[ch];
+            for (size_t j = 0; j < n; ++j)
+                acc += s[j * n_channels + ch] & ADC_SAMPLE_MASK;
+            dec->acc[ch] = acc;
+        }
+        i += n;
+        dec->count += n;
+        if (dec->count == dec->factor) {
+            for (unsigned int ch = 0; ch < n_channels; ++ch) {
+                dst[ch][n_out] = (uint16_t) ((dec->acc[ch] << 4) / dec->factor);
+                dec->acc[ch] = 0;
+            }
+            dec->count = 0;
+            ++n_out;
+        }
+    }
+    return n_out;
+}
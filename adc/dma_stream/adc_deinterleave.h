@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _ADC_DEINTERLEAVE_H
+#define _ADC_DEINTERLEAVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Processing for blocks of round-robin ADC samples.
+//
+// With round-robin sampling, the ADC FIFO holds one sample from each selected
+// input in turn, lowest input first. A "frame" is one sample from every
+// input. Samples are 12 bits, with the ADC's error flag in bit 15.
+
+#define ADC_DEINTERLEAVE_MAX_CHANNELS 8
+#define ADC_SAMPLE_ERR_BIT 0x8000u
+#define ADC_SAMPLE_MASK 0x0fffu
+
+// Split n_frames frames from src into one buffer per channel, dropping the
+// error flags. Returns the number of samples which had the error flag set.
+size_t adc_deinterleave(const uint16_t *src, size_t n_frames, unsigned int n_channels, uint16_t *const dst[]);
+
+// Decimation by averaging `factor` consecutive samples of each channel. The
+// average is kept to 16 bits (i.e. with 4 fractional bits), so decimation
+// gains some resolution. State is carried across blocks, so the block size
+// needn't be a multiple of the factor.
+typedef struct {
+    unsigned int n_channels;
+    unsigned int factor;
+    unsigned int count;
+    uint32_t acc[ADC_DEINTERLEAVE_MAX_CHANNELS];
+} adc_decimator_t;
+
+void adc_decimator_init(adc_decimator_t *dec, unsigned int n_channels, unsigned int factor);
+
+// Deinterleave and decimate n_frames frames from src. Returns the number of
+// output samples written to each channel's buffer, which need room for
+// n_frames / factor + 1 samples.
+size_t adc_decimate(adc_decimator_t *dec, const uint16_t *src, size_t n_frames, uint16_t *const dst[]);
+
+#endif
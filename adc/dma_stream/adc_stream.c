@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "adc_stream.h"
+
+#define ADC_CYCLES_PER_SAMPLE 96
+
+// The control channel reads the table of block addresses through the DMA's
+// address ring, so it must be a power of two bytes and aligned to its size
+static_assert(!(ADC_STREAM_N_BLOCKS & (ADC_STREAM_N_BLOCKS - 1)), "ADC_STREAM_N_BLOCKS must be a power of two");
+#define BLOCK_ADDRS_RING_BITS __builtin_ctz(ADC_STREAM_N_BLOCKS * sizeof(uint16_t *))
+
+static uint16_t *ring;
+static uint16_t *block_addrs[ADC_STREAM_N_BLOCKS] __attribute__((aligned(ADC_STREAM_N_BLOCKS * sizeof(uint16_t *))));
+static uint block_samples;
+static uint n_channels;
+static uint input_mask;
+static adc_stream_block_cb_t block_cb;
+static void *block_cb_data;
+static uint data_chan;
+static uint ctrl_chan;
+
+// Blocks filled by the DMA, and blocks passed to the callback. Each has a
+// single writer, the DMA interrupt and adc_stream_task() respectively.
+static volatile uint32_t blocks_captured;
+static uint32_t blocks_consumed;
+static uint32_t blocks_dropped;
+
+static inline uint16_t *block_addr(uint32_t seq) {
+    return ring + (seq % ADC_STREAM_N_BLOCKS) * block_samples;
+}
+
+static void adc_stream_dma_handler(void) {
+    if (!dma_channel_get_irq0_status(data_chan))
+        return;
+    dma_channel_acknowledge_irq0(data_chan);
+    // The DMA has already moved on by itself, so there is nothing to re-arm.
+    // If this interrupt was held off for more than a block, several blocks
+    // have completed but only one interrupt is pending, so count up to the
+    // block the data channel is writing now. Its write address is the end of
+    // the block just finished until the control channel reloads it, which
+    // is the start of the next block either way.
+    uint32_t offset = (uint32_t) (dma_channel_hw_addr(data_chan)->write_addr - (uintptr_t) ring);
+    uint32_t writing = offset / (block_samples * sizeof(uint16_t)) % ADC_STREAM_N_BLOCKS;
+    uint32_t seq = blocks_captured;
+    blocks_captured = seq + (writing - seq) % ADC_STREAM_N_BLOCKS;
+}
+
+bool adc_stream_init(uint inputs, uint32_t sample_rate_hz, uint block_frames, adc_stream_block_cb_t callback,
+                     void *user_data) {
+    input_mask = inputs & ((1u << NUM_ADC_CHANNELS) - 1);
+    if (!input_mask || !sample_rate_hz || !block_frames)
+        return false;
+    n_channels = __builtin_popcount(input_mask);
+    uint32_t total_rate = sample_rate_hz * n_channels;
+    if (total_rate > ADC_STREAM_MAX_RATE_HZ)
+        return false;
+
+    block_samples = block_frames * n_channels;
+    ring = malloc(ADC_STREAM_N_BLOCKS * block_samples * sizeof(uint16_t));
+    if (!ring)
+        return false;
+    for (uint i = 0; i < ADC_STREAM_N_BLOCKS; ++i)
+        block_addrs[i] = block_addr(i);
+    block_cb = callback;
+    block_cb_data = user_data;
+
+    adc_init();
+    for (uint input = 0; input < ADC_TEMPERATURE_CHANNEL_NUM; ++input) {
+        if (input_mask & (1u << input))
+            adc_gpio_init(ADC_BASE_PIN + input);
+    }
+    if (input_mask & (1u << ADC_TEMPERATURE_CHANNEL_NUM))
+        adc_set_temp_sensor_enabled(true);
+    adc_fifo_setup(
+        true,    // Write each completed conversion to the sample FIFO
+        true,    // Enable DMA data request (DREQ)
+        1,       // DREQ (and IRQ) asserted when at least 1 sample present
+        true,    // Keep the ERR bit, so bad conversions can be counted
+        false    // Keep all 12 bits
+    );
+    // The divider is 1 + (int + frac / 256), and a conversion takes 96 clocks,
+    // so anything below 96 gives back-to-back conversions
+    float div = (float) clock_get_hz(clk_adc) / (float) total_rate - 1.f;
+    adc_set_clkdiv(div < ADC_CYCLES_PER_SAMPLE ? 0.f : div);
+
+    data_chan = dma_claim_unused_channel(true);
+    ctrl_chan = dma_claim_unused_channel(true);
+
+    // The data channel fills one block, then chains to the control channel,
+    // which writes the next block's address to the data channel's write
+    // address trigger register, starting it again with the same count
+    dma_channel_config c = dma_channel_get_default_config(data_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    channel_config_set_chain_to(&c, ctrl_chan);
+    dma_channel_configure(data_chan, &c, NULL, &adc_hw->fifo, block_samples, false);
+    dma_channel_set_irq0_enabled(data_chan, true);
+
+    c = dma_channel_get_default_config(ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, BLOCK_ADDRS_RING_BITS);
+    dma_channel_configure(ctrl_chan, &c, &dma_channel_hw_addr(data_chan)->al2_write_addr_trig, block_addrs, 1,
+                          false);
+
+    irq_add_shared_handler(DMA_IRQ_0, adc_stream_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    return true;
+}
+
+void adc_stream_start(void) {
+    blocks_captured = 0;
+    blocks_consumed = 0;
+    blocks_dropped = 0;
+
+    // Round robin always starts from the currently selected input, so select
+    // the lowest one to keep the channels in the same place in every block
+    adc_select_input(__builtin_ctz(input_mask));
+    adc_set_round_robin(n_channels > 1 ? input_mask : 0);
+    adc_fifo_drain();
+    // The control channel points the data channel at block 0 and starts it
+    dma_channel_set_read_addr(ctrl_chan, block_addrs, true);
+    adc_run(true);
+}
+
+void adc_stream_stop(void) {
+    adc_run(false);
+    // Break the chain before aborting, otherwise aborting the data channel
+    // can trigger the control channel, which restarts it (RP2040-E13)
+    dma_channel_config c = dma_get_channel_config(data_chan);
+    channel_config_set_chain_to(&c, data_chan);
+    dma_channel_set_config(data_chan, &c, false);
+    dma_channel_abort(ctrl_chan);
+    dma_channel_abort(data_chan);
+    dma_channel_acknowledge_irq0(data_chan);
+    channel_config_set_chain_to(&c, ctrl_chan);
+    dma_channel_set_config(data_chan, &c, false);
+    adc_fifo_drain();
+    adc_set_round_robin(0);
+}
+
+uint adc_stream_task(void) {
+    uint n = 0;
+    while (blocks_consumed != blocks_captured) {
+        // Block seq + N reuses the buffer of block seq, and the DMA starts
+        // writing it as soon as block seq + N - 1 is complete. Staying at
+        // most N - 2 blocks behind leaves a whole block's time to read it.
+        uint32_t lag = blocks_captured - blocks_consumed;
+        if (lag > ADC_STREAM_N_BLOCKS - 2) {
+            blocks_dropped += lag - (ADC_STREAM_N_BLOCKS - 2);
+            blocks_consumed = blocks_captured - (ADC_STREAM_N_BLOCKS - 2);
+        }
+        uint32_t seq = blocks_consumed;
+        block_cb(block_addr(seq), block_samples, block_cb_data);
+        __dmb();
+        // Check the block wasn't overwritten whilst we were processing it. The
+        // callback has had it either way, but it is counted as lost.
+        if (blocks_captured - seq > ADC_STREAM_N_BLOCKS - 2)
+            ++blocks_dropped;
+        blocks_consumed = seq + 1;
+        ++n;
+    }
+    return n;
+}
+
+uint adc_stream_n_channels(void) {
+    return n_channels;
+}
+
+float adc_stream_sample_rate_hz(void) {
+    float cycles = 1.f + (float) (adc_hw->div & (ADC_DIV_INT_BITS | ADC_DIV_FRAC_BITS)) / 256.f;
+    if (cycles < ADC_CYCLES_PER_SAMPLE)
+        cycles = ADC_CYCLES_PER_SAMPLE;
+    return (float) clock_get_hz(clk_adc) / cycles / (float) n_channels;
+}
+
+uint32_t adc_stream_dropped_blocks(void) {
+    return blocks_dropped;
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _ADC_STREAM_H
+#define _ADC_STREAM_H
+
+#include "pico/types.h"
+
+// Continuous ADC capture into a ring of blocks. One DMA channel fills a
+// block, then chains to a control channel which loads the address of the
+// next block from a table and restarts it, so no processor is needed to keep
+// the capture going, and there are no gaps between blocks however long the
+// interrupt takes to be serviced. The ADC FIFO covers the few cycles the
+// control channel takes. All the interrupt does is count the blocks, which
+// it works out from where the DMA is writing, so it only has to run once
+// every ADC_STREAM_N_BLOCKS - 1 blocks to keep count.
+//
+// Completed blocks are handed to a callback from adc_stream_task(), which
+// should be called regularly from the main loop. As long as each block is
+// processed within (ADC_STREAM_N_BLOCKS - 2) block periods, no samples are
+// lost. If the callback falls further behind than that, the oldest blocks are
+// skipped, and counted by adc_stream_dropped_blocks().
+//
+// Samples are 12 bits, with the ADC's error flag in bit 15. With more than one
+// input selected, the ADC samples them round-robin, lowest input first, and
+// every block starts with the lowest input (see adc_deinterleave.h).
+//
+// There is only one ADC, so there is only one stream.
+
+// Must be a power of two
+#ifndef ADC_STREAM_N_BLOCKS
+#define ADC_STREAM_N_BLOCKS 8
+#endif
+
+// The ADC takes 96 clocks per conversion, so 500 ksps total from a 48 MHz clock
+#define ADC_STREAM_MAX_RATE_HZ 500000u
+
+typedef void (*adc_stream_block_cb_t)(const uint16_t *samples, uint n_samples, void *user_data);
+
+// Set up the ADC and claim two DMA channels. inputs is a mask of ADC inputs
+// (bit 0 is ADC 0 on GPIO 26). sample_rate_hz is the rate for each input, so
+// the ADC runs at sample_rate_hz times the number of inputs. block_frames is
+// the number of samples of each input in a block. Returns false if the rate is
+// too high or the buffers can't be allocated.
+bool adc_stream_init(uint inputs, uint32_t sample_rate_hz, uint block_frames, adc_stream_block_cb_t callback,
+                     void *user_data);
+
+void adc_stream_start(void);
+
+void adc_stream_stop(void);
+
+// Call the callback for every block completed since the last call. Returns
+// the number of blocks processed.
+uint adc_stream_task(void);
+
+uint adc_stream_n_channels(void);
+
+// Actual rate for each input, after rounding the ADC clock divider
+float adc_stream_sample_rate_hz(void);
+
+uint32_t adc_stream_dropped_blocks(void);
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Continuous multi-channel ADC capture.
+//
+// dma_capture takes one buffer of samples and stops. Here the ADC runs flat
+// out (500 ksps) forever, sampling several inputs round-robin, and the samples
+// are streamed through a ring of buffers by DMA, with no processor in the
+// loop (see adc_stream.h). Each block is split into per-input samples and
+// decimated (see adc_deinterleave.h) from the main loop, whilst the DMA fills
+// the next.
+//
+// First we record a few blocks and time the processing on them, to show how
+// much headroom there is at the full sample rate. Then we stream, printing
+// the average voltage on each input, and how many blocks were dropped (which
+// should be none), once a second.
+//
+// Inputs 0 to 2 are GPIO 26 to 28. ADC 3 (GPIO 29) measures VSYS on a Pico,
+// but is used by the wireless chip on a Pico W, so it isn't sampled by default.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "adc_deinterleave.h"
+#include "adc_stream.h"
+
+#define INPUT_MASK 0x7u
+#define N_INPUTS 3
+#define BLOCK_FRAMES 512
+#define DECIMATION 64
+#define RECORD_BLOCKS 4
+#define BENCHMARK_PASSES 16
+
+// Stream statistics, only touched from the block callback and the main loop
+static adc_decimator_t decimator;
+static uint64_t channel_sum[N_INPUTS];
+static uint32_t channel_count;
+static uint32_t sample_errors;
+static uint32_t blocks_seen;
+
+static uint16_t decimated[N_INPUTS][BLOCK_FRAMES / DECIMATION + 1];
+static uint16_t *const decimated_out[N_INPUTS] = {decimated[0], decimated[1], decimated[2]};
+
+static uint16_t split[N_INPUTS][BLOCK_FRAMES];
+static uint16_t *const split_out[N_INPUTS] = {split[0], split[1], split[2]};
+
+static uint16_t recording[RECORD_BLOCKS][BLOCK_FRAMES * N_INPUTS];
+static volatile uint blocks_recorded;
+
+static void process_block(const uint16_t *samples, uint n_samples, __unused void *user_data) {
+    // Keep the first few blocks for the benchmark
+    if (blocks_recorded < RECORD_BLOCKS) {
+        memcpy(recording[blocks_recorded++], samples, n_samples * sizeof(uint16_t));
+        return;
+    }
+    uint n_frames = n_samples / N_INPUTS;
+    for (uint i = 0; i < n_samples; ++i)
+        sample_errors += samples[i] >> 15;
+    size_t n_out = adc_decimate(&decimator, samples, n_frames, decimated_out);
+    for (uint ch = 0; ch < N_INPUTS; ++ch)
+        for (size_t i = 0; i < n_out; ++i)
+            channel_sum[ch] += decimated[ch][i];
+    channel_count += n_out;
+    ++blocks_seen;
+}
+
+static void benchmark(void) {
+    uint32_t n_samples = BENCHMARK_PASSES * RECORD_BLOCKS * BLOCK_FRAMES * N_INPUTS;
+
+    uint64_t start = time_us_64();
+    size_t errors = 0;
+    for (uint pass = 0; pass < BENCHMARK_PASSES; ++pass)
+        for (uint b = 0; b < RECORD_BLOCKS; ++b)
+            errors += adc_deinterleave(recording[b], BLOCK_FRAMES, N_INPUTS, split_out);
+    uint64_t t = time_us_64() - start;
+    printf("Deinterleave: %u samples in %llu us, %.1f Msps (%u errors)\n", n_samples, t,
+           (float) n_samples / (float) t, (uint) (errors / BENCHMARK_PASSES));
+
+    adc_decimator_t dec;
+    adc_decimator_init(&dec, N_INPUTS, DECIMATION);
+    start = time_us_64();
+    for (uint pass = 0; pass < BENCHMARK_PASSES; ++pass)
+        for (uint b = 0; b < RECORD_BLOCKS; ++b)
+            adc_decimate(&dec, recording[b], BLOCK_FRAMES, decimated_out);
+    t = time_us_64() - start;
+    printf("Decimate by %d: %u samples in %llu us, %.1f Msps\n", DECIMATION, n_samples, t,
+           (float) n_samples / (float) t);
+    printf("ADC rate is %.3f Msps\n", adc_stream_sample_rate_hz() * N_INPUTS / 1e6f);
+}
+
+int main() {
+    stdio_init_all();
+    printf("ADC streaming example\n");
+
+    if (!adc_stream_init(INPUT_MASK, ADC_STREAM_MAX_RATE_HZ / N_INPUTS, BLOCK_FRAMES, process_block, NULL)) {
+        printf("Failed to set up ADC stream\n");
+        return 1;
+    }
+    adc_stream_start();
+    while (blocks_recorded < RECORD_BLOCKS)
+        adc_stream_task();
+    adc_stream_stop();
+    benchmark();
+
+    adc_decimator_init(&decimator, N_INPUTS, DECIMATION);
+    adc_stream_start();
+    absolute_time_t next_report = make_timeout_time_ms(1000);
+    while (true) {
+        adc_stream_task();
+        if (absolute_time_diff_us(get_absolute_time(), next_report) > 0)
+            continue;
+        next_report = delayed_by_ms(next_report, 1000);
+        printf("%u blocks, %u dropped, %u errors:", blocks_seen, adc_stream_dropped_blocks(), sample_errors);
+        for (uint ch = 0; ch < N_INPUTS; ++ch) {
+            // Decimated samples have 4 fractional bits
+            float mean = channel_count ? (float) channel_sum[ch] / (float) channel_count / 16.f : 0.f;
+            printf(" ADC%u %.3f V", ch, mean * 3.3f / (1 << 12));
+            channel_sum[ch] = 0;
+        }
+        printf("\n");
+        channel_count = 0;
+    }
+}
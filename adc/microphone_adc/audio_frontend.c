@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+
+#include "audio_frontend.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static inline int16_t saturate16(int32_t x) {
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : (int16_t) x;
+}
+
+void audio_fir_design_lowpass(int16_t *coeffs, unsigned int n_taps, float cutoff) {
+    float h[AUDIO_FIR_MAX_TAPS];
+    float sum = 0.f;
+    float centre = (float) (n_taps - 1) / 2.f;
+    for (unsigned int i = 0; i < n_taps; ++i) {
+        float t = (float) i - centre;
+        float sinc = t == 0.f ? 2.f * cutoff : sinf(2.f * (float) M_PI * cutoff * t) / ((float) M_PI * t);
+        float window = n_taps > 1 ? 0.54f - 0.46f * cosf(2.f * (float) M_PI * (float) i / (float) (n_taps - 1)) : 1.f;
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+    // Normalise for unity gain at DC, and make sure the rounded coefficients
+    // still add up to exactly 32768 by putting the error in the centre tap
+    int32_t total = 0;
+    for (unsigned int i = 0; i < n_taps; ++i) {
+        coeffs[i] = (int16_t) lroundf(h[i] / sum * 32768.f);
+        total += coeffs[i];
+    }
+    coeffs[n_taps / 2] = (int16_t) (coeffs[n_taps / 2] + 32768 - total);
+}
+
+bool audio_decimator_init(audio_decimator_t *dec, const int16_t *coeffs, unsigned int n_taps, unsigned int factor) {
+    if (!n_taps || n_taps > AUDIO_FIR_MAX_TAPS || !factor)
+        return false;
+    dec->coeffs = coeffs;
+    dec->n_taps = n_taps;
+    dec->factor = factor;
+    dec->phase = 0;
+    dec->pos = 0;
+    for (unsigned int i = 0; i < 2 * n_taps; ++i)
+        dec->history[i] = 0;
+    return true;
+}
+
+size_t audio_decimate(audio_decimator_t *dec, const uint16_t *adc, size_t n, int16_t *out) {
+    const unsigned int n_taps = dec->n_taps;
+    const int16_t *coeffs = dec->coeffs;
+    unsigned int pos = dec->pos;
+    unsigned int phase = dec->phase;
+    size_t n_out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        // Newest sample at the lowest address
+        pos = pos ? pos - 1 : n_taps - 1;
+        int16_t x = (int16_t) ((adc[i] & 0xfff) - 2048);
+        dec->history[pos] = x;
+        dec->history[pos + n_taps] = x;
+        if (++phase < dec->factor)
+            continue;
+        phase = 0;
+        // 12-bit samples and Q15 coefficients with a total gain of around 1
+        // can't overflow 32 bits
+        const int16_t *h = dec->history + pos;
+        int32_t acc = 0;
+        for (unsigned int k = 0; k < n_taps; ++k)
+            acc += (int32_t) h[k] * coeffs[k];
+        // Q15 * 12-bit, to Q15: shift right by 15, then left by 4, with rounding
+        out[n_out++] = saturate16((acc + (1 << 10)) >> 11);
+    }
+    dec->pos = pos;
+    dec->phase = phase;
+    return n_out;
+}
+
+// The running average has 12 fractional bits
+#define DC_FRAC_BITS 12
+
+void audio_dc_blocker_init(audio_dc_blocker_t *blocker, unsigned int shift) {
+    blocker->shift = shift;
+    blocker->dc = 0;
+}
+
+void audio_dc_block(audio_dc_blocker_t *blocker, int16_t *samples, size_t n) {
+    const unsigned int shift = blocker->shift;
+    int32_t dc = blocker->dc;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t x = samples[i];
+        dc += (x * (1 << DC_FRAC_BITS) - dc) >> shift;
+        samples[i] = saturate16(x - (dc >> DC_FRAC_BITS));
+    }
+    blocker->dc = dc;
+}
+
+static uint32_t isqrt64(uint64_t x) {
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= result + bit) {
+            x -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) result;
+}
+
+void audio_measure_level(const int16_t *samples, size_t n, audio_level_t *level) {
+    uint64_t sum_sq = 0;
+    uint32_t peak = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t x = samples[i];
+        uint32_t mag = (uint32_t) (x < 0 ? -x : x);
+        sum_sq += (uint32_t) (x * x);
+        if (mag > peak)
+            peak = mag;
+    }
+    uint32_t rms = n ? isqrt64(sum_sq / n) : 0;
+    level->rms = (uint16_t) (rms > UINT16_MAX ? UINT16_MAX : rms);
+    level->peak = (uint16_t) peak;
+}
+
+float audio_level_dbfs(uint16_t level) {
+    return level ? 20.f * log10f((float) level / 32768.f) : -100.f;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _AUDIO_FRONTEND_H
+#define _AUDIO_FRONTEND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-point processing for audio from the ADC:
+//
+// - A decimating FIR filter, which turns 12-bit ADC samples into 16-bit audio
+//   at a lower rate, with the anti-aliasing filter done in the same step.
+//
+// - A DC blocker, to remove the microphone amplifier's bias.
+//
+// - RMS and peak level metering over a block.
+//
+// Audio samples are signed Q15, i.e. full scale is +/-32768. FIR coefficients
+// are Q15 too, and should add up to 32768 for unity gain.
+
+#define AUDIO_FIR_MAX_TAPS 64
+
+typedef struct {
+    const int16_t *coeffs;
+    unsigned int n_taps;
+    unsigned int factor;
+    unsigned int phase;
+    unsigned int pos;
+    // Each sample is stored twice, n_taps apart, so the newest n_taps samples
+    // are always contiguous
+    int16_t history[2 * AUDIO_FIR_MAX_TAPS];
+} audio_decimator_t;
+
+// Windowed-sinc (Hamming) low pass filter. cutoff is a fraction of the input
+// sample rate, so must be less than 0.5.
+void audio_fir_design_lowpass(int16_t *coeffs, unsigned int n_taps, float cutoff);
+
+// coeffs must remain valid whilst the decimator is in use
+bool audio_decimator_init(audio_decimator_t *dec, const int16_t *coeffs, unsigned int n_taps, unsigned int factor);
+
+// Filter and decimate n 12-bit ADC samples (which are taken to be unsigned,
+// centred on 2048; the error flag is ignored). Only the output samples are
+// computed: this is the polyphase form, with each output summing one sample
+// from every phase. Returns the number of samples written to out, which is at
+// most n / factor + 1.
+size_t audio_decimate(audio_decimator_t *dec, const uint16_t *adc, size_t n, int16_t *out);
+
+// First order DC blocker: subtracts a running average, which follows the input
+// with a time constant of 2^shift samples.
+typedef struct {
+    unsigned int shift;
+    int32_t dc;
+} audio_dc_blocker_t;
+
+void audio_dc_blocker_init(audio_dc_blocker_t *blocker, unsigned int shift);
+
+void audio_dc_block(audio_dc_blocker_t *blocker, int16_t *samples, size_t n);
+
+typedef struct {
+    uint16_t rms;
+    uint16_t peak;
+} audio_level_t;
+
+void audio_measure_level(const int16_t *samples, size_t n, audio_level_t *level);
+
+// Level relative to full scale, in dB. Returns -100 for silence.
+float audio_level_dbfs(uint16_t level);
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/clocks.h"
+#include "adc_stream.h"
+#include "audio_frontend.h"
+
+/* Audio capture from an analog microphone, using the same wiring as
+   microphone_adc.
+
+   microphone_adc reads one sample every 10 ms, which is fine for plotting but
+   far too slow for audio. Here the ADC samples at 96 kHz, paced by its own
+   clock divider, and the samples are streamed to memory by DMA (see
+   adc/dma_stream). Each block of samples is then:
+
+   - low pass filtered and decimated by 4, to 16-bit samples at 24 kHz
+   - passed through a DC blocker, to remove the microphone amplifier's bias
+   - measured, giving the RMS and peak levels of each 256 sample block
+
+   The processing is all fixed point (see audio_frontend.h). Before starting,
+   it is checked against a floating point version of the same filter, and
+   timed.
+
+   GPIO 26/ADC0 (pin 31)-> AOUT or AUD on microphone board
+   3.3v (pin 36) -> VCC on microphone board
+   GND (pin 38)  -> GND on microphone board
+*/
+
+#define ADC_NUM 0
+#define ADC_PIN (26 + ADC_NUM)
+
+#define ADC_RATE_HZ 96000
+#define DECIMATION 4
+#define N_TAPS 48
+// Just below the Nyquist frequency of the output
+#define CUTOFF_HZ 10000
+#define BLOCK_SAMPLES 256
+// DC blocker time constant of 1024 samples, i.e. a corner of about 4 Hz
+#define DC_SHIFT 10
+// Print the levels every this many blocks
+#define REPORT_BLOCKS 16
+
+static int16_t coeffs[N_TAPS];
+static audio_decimator_t decimator;
+static audio_dc_blocker_t dc_blocker;
+static int16_t audio[BLOCK_SAMPLES];
+
+static uint32_t blocks;
+static uint64_t rms_sq_sum;
+static uint16_t peak_hold;
+
+static void audio_block(const uint16_t *samples, uint n_samples, __unused void *user_data) {
+    size_t n = audio_decimate(&decimator, samples, n_samples, audio);
+    audio_dc_block(&dc_blocker, audio, n);
+    audio_level_t level;
+    audio_measure_level(audio, n, &level);
+    rms_sq_sum += (uint32_t) level.rms * level.rms;
+    if (level.peak > peak_hold)
+        peak_hold = level.peak;
+    ++blocks;
+}
+
+// A 1 kHz tone with some content above the cutoff, as the ADC would see it
+static uint16_t test_signal(uint i) {
+    float t = (float) i / ADC_RATE_HZ;
+    return (uint16_t) (2048.f + 1200.f * sinf(2.f * (float) M_PI * 1000.f * t) +
+                       400.f * sinf(2.f * (float) M_PI * 30000.f * t));
+}
+
+// Check the fixed point decimator against a floating point one with the same
+// coefficients. The outputs should match to within rounding.
+static bool check_decimator(void) {
+    static uint16_t in[BLOCK_SAMPLES * DECIMATION];
+    static int16_t out[BLOCK_SAMPLES + 1];
+    for (uint i = 0; i < count_of(in); ++i)
+        in[i] = test_signal(i);
+    audio_decimator_t dec;
+    audio_decimator_init(&dec, coeffs, N_TAPS, DECIMATION);
+    size_t n = audio_decimate(&dec, in, count_of(in), out);
+    if (n != BLOCK_SAMPLES)
+        return false;
+    int max_err = 0;
+    for (uint j = 0; j < n; ++j) {
+        // Output j is produced by input sample (j + 1) * DECIMATION - 1
+        int newest = (int) ((j + 1) * DECIMATION - 1);
+        float acc = 0.f;
+        for (int k = 0; k < N_TAPS && newest - k >= 0; ++k)
+            acc += (float) coeffs[k] / 32768.f * (float) ((int) in[newest - k] - 2048);
+        int expected = (int) lroundf(acc * 16.f);
+        int err = abs(expected - out[j]);
+        if (err > max_err)
+            max_err = err;
+    }
+    printf("Decimator max error vs floating point: %d LSB\n", max_err);
+    return max_err <= 1;
+}
+
+static void benchmark(void) {
+    static uint16_t in[BLOCK_SAMPLES * DECIMATION];
+    for (uint i = 0; i < count_of(in); ++i)
+        in[i] = test_signal(i);
+    const uint passes = 32;
+    audio_decimator_t dec;
+    audio_decimator_init(&dec, coeffs, N_TAPS, DECIMATION);
+    audio_dc_blocker_t blocker;
+    audio_dc_blocker_init(&blocker, DC_SHIFT);
+    audio_level_t level;
+
+    uint64_t decimate_us = 0, post_us = 0;
+    for (uint pass = 0; pass < passes; ++pass) {
+        uint64_t start = time_us_64();
+        audio_decimate(&dec, in, count_of(in), audio);
+        uint64_t mid = time_us_64();
+        audio_dc_block(&blocker, audio, BLOCK_SAMPLES);
+        audio_measure_level(audio, BLOCK_SAMPLES, &level);
+        post_us += time_us_64() - mid;
+        decimate_us += mid - start;
+    }
+    float cycles_per_us = (float) clock_get_hz(clk_sys) / 1e6f;
+    float decimate_cps = (float) decimate_us * cycles_per_us / (float) (passes * count_of(in));
+    float post_cps = (float) post_us * cycles_per_us / (float) (passes * BLOCK_SAMPLES);
+    printf("FIR decimation: %.1f cycles per input sample\n", decimate_cps);
+    printf("DC blocker and metering: %.1f cycles per output sample\n", post_cps);
+    printf("Load at %d Hz: %.1f%%\n", ADC_RATE_HZ,
+           100.f * (decimate_cps + post_cps / DECIMATION) * ADC_RATE_HZ / (float) clock_get_hz(clk_sys));
+}
+
+int main() {
+    stdio_init_all();
+    printf("Beep boop, listening at %d Hz...\n", ADC_RATE_HZ / DECIMATION);
+
+    bi_decl(bi_program_description("Analog microphone DSP example for Raspberry Pi Pico")); // for picotool
+    bi_decl(bi_1pin_with_name(ADC_PIN, "ADC input pin"));
+
+    audio_fir_design_lowpass(coeffs, N_TAPS, (float) CUTOFF_HZ / ADC_RATE_HZ);
+    if (!check_decimator()) {
+        printf("Decimator check failed\n");
+        return 1;
+    }
+    benchmark();
+
+    audio_decimator_init(&decimator, coeffs, N_TAPS, DECIMATION);
+    audio_dc_blocker_init(&dc_blocker, DC_SHIFT);
+    if (!adc_stream_init(1u << ADC_NUM, ADC_RATE_HZ, BLOCK_SAMPLES * DECIMATION, audio_block, NULL)) {
+        printf("Failed to set up ADC stream\n");
+        return 1;
+    }
+    adc_stream_start();
+
+    while (1) {
+        adc_stream_task();
+        if (blocks < REPORT_BLOCKS)
+            continue;
+        uint16_t rms = (uint16_t) sqrtf((float) rms_sq_sum / (float) blocks);
+        printf("RMS %6.1f dBFS  peak %6.1f dBFS  dropped %u\n", audio_level_dbfs(rms), audio_level_dbfs(peak_hold),
+               adc_stream_dropped_blocks());
+        blocks = 0;
+        rms_sq_sum = 0;
+        peak_hold = 0;
+    }
+}
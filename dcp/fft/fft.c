@@ -0,0 +1,217 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "fft.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void portable_butterfly_radix2_twiddle_dit(double *x, double *y, double *tf) {
+    double re = tf[0] * y[0] - tf[1] * y[1];
+    double im = tf[1] * y[0] + tf[0] * y[1];
+    y[0] = x[0] - re;
+    y[1] = x[1] - im;
+    x[0] += re;
+    x[1] += im;
+}
+
+static void portable_butterfly_radix4(double *w, double *x, double *y, double *z) {
+    double a_re = w[0] + y[0], a_im = w[1] + y[1];
+    double b_re = x[0] + z[0], b_im = x[1] + z[1];
+    double c_re = w[0] - y[0], c_im = w[1] - y[1];
+    double d_re = x[0] - z[0], d_im = x[1] - z[1];
+    w[0] = a_re + b_re;
+    w[1] = a_im + b_im;
+    x[0] = a_re - b_re;
+    x[1] = a_im - b_im;
+    // -j(x - z) is (d_im, -d_re)
+    y[0] = c_re + d_im;
+    y[1] = c_im - d_re;
+    z[0] = c_re - d_im;
+    z[1] = c_im + d_re;
+}
+
+const fft_backend_t fft_backend_portable = {
+        .name = "portable",
+        .butterfly_radix2_twiddle_dit = portable_butterfly_radix2_twiddle_dit,
+        .butterfly_radix4 = portable_butterfly_radix4,
+};
+
+static inline int16_t q15_from_double(double x) {
+    long v = lround(x * 32768.0);
+    return (int16_t) (v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+bool fft_plan_init(fft_plan_t *plan, unsigned int n) {
+    unsigned int log2n = 0;
+    while ((1u << log2n) < n)
+        ++log2n;
+    if (n < 4 || n != 1u << log2n || log2n > FFT_MAX_LOG2_POINTS)
+        return false;
+    plan->n = n;
+    plan->log2n = log2n;
+    plan->bitrev = malloc(n * sizeof(uint16_t));
+    plan->twiddle = malloc(n / 2 * sizeof(fft_complex_t));
+    plan->twiddle_q15 = malloc(n / 2 * sizeof(fft_complex_q15_t));
+    plan->window = malloc(n * sizeof(float));
+    plan->window_q15 = malloc(n * sizeof(int16_t));
+    if (!plan->bitrev || !plan->twiddle || !plan->twiddle_q15 || !plan->window || !plan->window_q15) {
+        fft_plan_deinit(plan);
+        return false;
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int r = 0;
+        for (unsigned int b = 0; b < log2n; ++b)
+            r |= ((i >> b) & 1u) << (log2n - 1 - b);
+        plan->bitrev[i] = (uint16_t) r;
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+        plan->window[i] = (float) w;
+        plan->window_q15[i] = q15_from_double(w);
+    }
+    for (unsigned int k = 0; k < n / 2; ++k) {
+        double a = -2.0 * M_PI * k / n;
+        plan->twiddle[k].re = cos(a);
+        plan->twiddle[k].im = sin(a);
+        plan->twiddle_q15[k].re = q15_from_double(cos(a));
+        plan->twiddle_q15[k].im = q15_from_double(sin(a));
+    }
+    return true;
+}
+
+void fft_plan_deinit(fft_plan_t *plan) {
+    free(plan->bitrev);
+    free(plan->twiddle);
+    free(plan->twiddle_q15);
+    free(plan->window);
+    free(plan->window_q15);
+    plan->bitrev = NULL;
+    plan->twiddle = NULL;
+    plan->twiddle_q15 = NULL;
+    plan->window = NULL;
+    plan->window_q15 = NULL;
+}
+
+void fft_forward(const fft_plan_t *plan, const fft_backend_t *backend, fft_complex_t *data) {
+    const unsigned int n = plan->n;
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int r = plan->bitrev[i];
+        if (i < r) {
+            fft_complex_t t = data[i];
+            data[i] = data[r];
+            data[r] = t;
+        }
+    }
+    // First two stages. The radix-4 butterfly leaves its outputs in
+    // bit-reversed order, so pass the middle two inputs the other way round.
+    for (unsigned int i = 0; i < n; i += 4)
+        backend->butterfly_radix4(&data[i].re, &data[i + 2].re, &data[i + 1].re, &data[i + 3].re);
+    for (unsigned int half = 4; half < n; half *= 2) {
+        unsigned int stride = n / (2 * half);
+        for (unsigned int group = 0; group < n; group += 2 * half) {
+            for (unsigned int k = 0; k < half; ++k) {
+                backend->butterfly_radix2_twiddle_dit(&data[group + k].re, &data[group + k + half].re,
+                                                      &plan->twiddle[k * stride].re);
+            }
+        }
+    }
+}
+
+void fft_forward_q15(const fft_plan_t *plan, fft_complex_q15_t *data) {
+    const unsigned int n = plan->n;
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int r = plan->bitrev[i];
+        if (i < r) {
+            fft_complex_q15_t t = data[i];
+            data[i] = data[r];
+            data[r] = t;
+        }
+    }
+    // First two stages, scaled by 1/4
+    for (unsigned int i = 0; i < n; i += 4) {
+        fft_complex_q15_t *p = &data[i];
+        int32_t a_re = p[0].re + p[1].re, a_im = p[0].im + p[1].im;
+        int32_t b_re = p[2].re + p[3].re, b_im = p[2].im + p[3].im;
+        int32_t c_re = p[0].re - p[1].re, c_im = p[0].im - p[1].im;
+        int32_t d_re = p[2].re - p[3].re, d_im = p[2].im - p[3].im;
+        p[0].re = (int16_t) ((a_re + b_re) >> 2);
+        p[0].im = (int16_t) ((a_im + b_im) >> 2);
+        p[2].re = (int16_t) ((a_re - b_re) >> 2);
+        p[2].im = (int16_t) ((a_im - b_im) >> 2);
+        p[1].re = (int16_t) ((c_re + d_im) >> 2);
+        p[1].im = (int16_t) ((c_im - d_re) >> 2);
+        p[3].re = (int16_t) ((c_re - d_im) >> 2);
+        p[3].im = (int16_t) ((c_im + d_re) >> 2);
+    }
+    // Remaining stages, each scaled by 1/2
+    for (unsigned int half = 4; half < n; half *= 2) {
+        unsigned int stride = n / (2 * half);
+        for (unsigned int group = 0; group < n; group += 2 * half) {
+            for (unsigned int k = 0; k < half; ++k) {
+                fft_complex_q15_t *x = &data[group + k], *y = &data[group + k + half];
+                fft_complex_q15_t w = plan->twiddle_q15[k * stride];
+                int32_t t_re = (w.re * y->re - w.im * y->im + (1 << 14)) >> 15;
+                int32_t t_im = (w.im * y->re + w.re * y->im + (1 << 14)) >> 15;
+                int32_t x_re = x->re, x_im = x->im;
+                x->re = (int16_t) ((x_re + t_re) >> 1);
+                x->im = (int16_t) ((x_im + t_im) >> 1);
+                y->re = (int16_t) ((x_re - t_re) >> 1);
+                y->im = (int16_t) ((x_im - t_im) >> 1);
+            }
+        }
+    }
+}
+
+void fft_load_real(const fft_plan_t *plan, fft_complex_t *data, const float *samples) {
+    for (unsigned int i = 0; i < plan->n; ++i) {
+        data[i].re = samples[i] * plan->window[i];
+        data[i].im = 0.0;
+    }
+}
+
+void fft_load_real_q15(const fft_plan_t *plan, fft_complex_q15_t *data, const int16_t *samples) {
+    for (unsigned int i = 0; i < plan->n; ++i) {
+        data[i].re = (int16_t) ((samples[i] * plan->window_q15[i] + (1 << 14)) >> 15);
+        data[i].im = 0;
+    }
+}
+
+// A sine of amplitude A gives |X| = A * n / 4 with a Hann window: half from
+// the negative frequency, and half again from the window's coherent gain
+void fft_magnitude(const fft_plan_t *plan, const fft_complex_t *data, float *mag) {
+    double scale = 4.0 / plan->n;
+    for (unsigned int k = 0; k <= plan->n / 2; ++k)
+        mag[k] = (float) (sqrt(data[k].re * data[k].re + data[k].im * data[k].im) * scale);
+}
+
+static uint32_t isqrt32(uint32_t x) {
+    uint32_t result = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= result + bit) {
+            x -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+void fft_magnitude_q15(const fft_plan_t *plan, const fft_complex_q15_t *data, uint16_t *mag) {
+    // The Q15 transform is already divided by n
+    for (unsigned int k = 0; k <= plan->n / 2; ++k) {
+        uint32_t sq = (uint32_t) (data[k].re * data[k].re) + (uint32_t) (data[k].im * data[k].im);
+        uint32_t m = isqrt32(sq) * 4;
+        mag[k] = (uint16_t) (m > INT16_MAX ? INT16_MAX : m);
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _FFT_H
+#define _FFT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// In-place complex FFT, from 4 to 4096 points (powers of 2).
+//
+// The transform is decimation in time: the input is put into bit-reversed
+// order, the first two stages are done together with radix-4 butterflies
+// (which need no twiddle factors), and the remaining stages with radix-2
+// butterflies.
+//
+// There are two versions:
+//
+// - Double precision, with the butterflies supplied by a backend. The
+//   butterflies have the same interface as the DCP routines in
+//   hello_dcp/dcp_examples.S, and fft_backend_portable is a C version of them.
+//
+// - Q15 fixed point. Each stage is scaled by 1/2 to prevent overflow, so the
+//   result is the transform divided by the number of points.
+
+#define FFT_MAX_LOG2_POINTS 12
+#define FFT_MAX_POINTS (1u << FFT_MAX_LOG2_POINTS)
+
+// Two doubles, real part first, as the DCP routines expect
+typedef struct {
+    double re;
+    double im;
+} fft_complex_t;
+
+typedef struct {
+    int16_t re;
+    int16_t im;
+} fft_complex_q15_t;
+
+typedef struct {
+    const char *name;
+    // x = x + ωy, y = x - ωy
+    void (*butterfly_radix2_twiddle_dit)(double *x, double *y, double *tf);
+    // w = w + x + y + z, x = w - x + y - z, y = w - jx - y + jz, z = w + jx - y - jz
+    void (*butterfly_radix4)(double *w, double *x, double *y, double *z);
+} fft_backend_t;
+
+extern const fft_backend_t fft_backend_portable;
+
+// Tables for one transform size. These are allocated by fft_plan_init().
+typedef struct {
+    unsigned int n;
+    unsigned int log2n;
+    uint16_t *bitrev;
+    // exp(-2πik/n) for k < n/2
+    fft_complex_t *twiddle;
+    fft_complex_q15_t *twiddle_q15;
+    // Hann window
+    float *window;
+    int16_t *window_q15;
+} fft_plan_t;
+
+bool fft_plan_init(fft_plan_t *plan, unsigned int n);
+
+void fft_plan_deinit(fft_plan_t *plan);
+
+void fft_forward(const fft_plan_t *plan, const fft_backend_t *backend, fft_complex_t *data);
+
+void fft_forward_q15(const fft_plan_t *plan, fft_complex_q15_t *data);
+
+// Apply the window to n real samples, and load them as complex data ready for
+// the transform
+void fft_load_real(const fft_plan_t *plan, fft_complex_t *data, const float *samples);
+
+void fft_load_real_q15(const fft_plan_t *plan, fft_complex_q15_t *data, const int16_t *samples);
+
+// Magnitude of bins 0 to n/2 of a transformed windowed real signal, scaled so
+// a full scale sine wave centred on a bin gives 1.0 (or 32767 for Q15).
+void fft_magnitude(const fft_plan_t *plan, const fft_complex_t *data, float *mag);
+
+void fft_magnitude_q15(const fft_plan_t *plan, const fft_complex_q15_t *data, uint16_t *mag);
+
+#endif
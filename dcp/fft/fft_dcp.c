@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+
+#include "fft.h"
+
+/*
+FFTs using the DCP butterflies from hello_dcp.
+
+The same transform (see fft.h) is run with three sets of butterflies: the DCP
+routines from dcp_examples.S, the portable C versions (which use the compiler's
+double-precision arithmetic), and the Q15 fixed-point version. We check they
+agree, find the peak in the spectrum of a test tone, and then compare how
+many points per second each can transform at a few sizes.
+
+NOTE: as with hello_dcp, the DCP routines don't check the DCP's engaged flag,
+so should not be used from more than one thread or from interrupt handlers.
+*/
+
+extern void dcp_butterfly_radix2_twiddle_dit(double *x, double *y, double *tf);
+extern void dcp_butterfly_radix4(double *w, double *x, double *y, double *z);
+
+static const fft_backend_t fft_backend_dcp = {
+        .name = "DCP",
+        .butterfly_radix2_twiddle_dit = dcp_butterfly_radix2_twiddle_dit,
+        .butterfly_radix4 = dcp_butterfly_radix4,
+};
+
+#define CHECK_POINTS 1024
+// Test tone, in bins
+#define TONE_BIN 100
+#define BENCHMARK_POINTS_TOTAL (1u << 16)
+
+static fft_complex_t data[FFT_MAX_POINTS];
+static fft_complex_t ref[FFT_MAX_POINTS];
+static fft_complex_q15_t data_q15[FFT_MAX_POINTS];
+static float samples[FFT_MAX_POINTS];
+static int16_t samples_q15[FFT_MAX_POINTS];
+static float mag[FFT_MAX_POINTS / 2 + 1];
+static uint16_t mag_q15[FFT_MAX_POINTS / 2 + 1];
+
+static void make_tone(uint n) {
+    for (uint i = 0; i < n; ++i) {
+        samples[i] = 0.5f * sinf(2.f * (float) M_PI * TONE_BIN * (float) i / (float) n) +
+                     0.01f * (float) (rand() % 201 - 100) / 100.f;
+        samples_q15[i] = (int16_t) lroundf(samples[i] * 32767.f);
+    }
+}
+
+static uint peak_bin(const float *m, uint n_bins) {
+    uint peak = 0;
+    for (uint k = 1; k < n_bins; ++k)
+        if (m[k] > m[peak])
+            peak = k;
+    return peak;
+}
+
+static bool check(void) {
+    fft_plan_t plan;
+    if (!fft_plan_init(&plan, CHECK_POINTS))
+        return false;
+    make_tone(CHECK_POINTS);
+
+    fft_load_real(&plan, ref, samples);
+    fft_forward(&plan, &fft_backend_portable, ref);
+    fft_load_real(&plan, data, samples);
+    fft_forward(&plan, &fft_backend_dcp, data);
+    double max_diff = 0.0;
+    for (uint k = 0; k < CHECK_POINTS; ++k) {
+        double d = fabs(data[k].re - ref[k].re) + fabs(data[k].im - ref[k].im);
+        if (d > max_diff)
+            max_diff = d;
+    }
+    printf("DCP vs portable: max difference %g\n", max_diff);
+
+    fft_load_real_q15(&plan, data_q15, samples_q15);
+    fft_forward_q15(&plan, data_q15);
+    int max_err = 0;
+    for (uint k = 0; k < CHECK_POINTS; ++k) {
+        // The Q15 result is scaled by 32768 / n relative to the double one
+        int err_re = abs(data_q15[k].re - (int) lround(ref[k].re * 32767.0 / CHECK_POINTS));
+        int err_im = abs(data_q15[k].im - (int) lround(ref[k].im * 32767.0 / CHECK_POINTS));
+        if (err_re > max_err)
+            max_err = err_re;
+        if (err_im > max_err)
+            max_err = err_im;
+    }
+    printf("Q15 vs portable: max error %d LSB\n", max_err);
+
+    fft_magnitude(&plan, data, mag);
+    fft_magnitude_q15(&plan, data_q15, mag_q15);
+    uint peak = peak_bin(mag, CHECK_POINTS / 2 + 1);
+    printf("Spectrum peak: bin %u, magnitude %.4f (Q15 %u)\n", peak, mag[peak], mag_q15[peak]);
+    fft_plan_deinit(&plan);
+    return max_diff < 1e-9 && max_err <= 8 && peak == TONE_BIN;
+}
+
+static void benchmark(uint n) {
+    fft_plan_t plan;
+    if (!fft_plan_init(&plan, n)) {
+        printf("Not enough memory for %u points\n", n);
+        return;
+    }
+    make_tone(n);
+    uint reps = BENCHMARK_POINTS_TOTAL / n;
+    const fft_backend_t *backends[] = {&fft_backend_dcp, &fft_backend_portable};
+    for (uint b = 0; b < count_of(backends); ++b) {
+        uint64_t us = 0;
+        for (uint r = 0; r < reps; ++r) {
+            fft_load_real(&plan, data, samples);
+            uint64_t start = time_us_64();
+            fft_forward(&plan, backends[b], data);
+            us += time_us_64() - start;
+        }
+        printf("%4u points, %-8s: %8.0f points/s\n", n, backends[b]->name, (double) n * reps * 1e6 / (double) us);
+    }
+    uint64_t us = 0;
+    for (uint r = 0; r < reps; ++r) {
+        fft_load_real_q15(&plan, data_q15, samples_q15);
+        uint64_t start = time_us_64();
+        fft_forward_q15(&plan, data_q15);
+        us += time_us_64() - start;
+    }
+    printf("%4u points, %-8s: %8.0f points/s\n", n, "Q15", (double) n * reps * 1e6 / (double) us);
+    fft_plan_deinit(&plan);
+}
+
+int main() {
+    stdio_init_all();
+
+    printf("DCP FFT example\n");
+
+    if (!check()) {
+        printf("FFT check failed\n");
+        return 1;
+    }
+    for (uint n = 256; n <= FFT_MAX_POINTS; n *= 4)
+        benchmark(n);
+    return 0;
+}
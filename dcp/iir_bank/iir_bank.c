@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iir_bank.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Delay line arrays per stage: x[t-2], y[t-2], x[t-1], y[t-1]
+#define STATE_ARRAYS 4
+
+bool iir_bank_init(iir_bank_t *bank, unsigned int n_channels, unsigned int n_stages, const float *coeffs) {
+    if (!n_channels || !n_stages || n_stages > IIR_BANK_MAX_STAGES)
+        return false;
+    bank->n_channels = n_channels;
+    bank->n_stages = n_stages;
+    bank->coeffs = coeffs;
+    bank->state = malloc(n_stages * STATE_ARRAYS * n_channels * sizeof(float));
+    if (!bank->state)
+        return false;
+    iir_bank_reset(bank);
+    return true;
+}
+
+void iir_bank_deinit(iir_bank_t *bank) {
+    free(bank->state);
+    bank->state = NULL;
+}
+
+void iir_bank_reset(iir_bank_t *bank) {
+    memset(bank->state, 0, bank->n_stages * STATE_ARRAYS * bank->n_channels * sizeof(float));
+}
+
+void iir_bank_process(iir_bank_t *bank, const float *in, float *out, size_t n_frames) {
+    const unsigned int n_channels = bank->n_channels;
+    for (unsigned int stage = 0; stage < bank->n_stages; ++stage) {
+        const float *c = bank->coeffs + stage * IIR_BIQUAD_COEFFS;
+        const double b2 = c[0], a2 = c[1], b1 = c[2], a1 = c[3], b0 = c[4];
+        float *x2 = bank->state + stage * STATE_ARRAYS * n_channels;
+        float *y2 = x2 + n_channels;
+        float *x1 = y2 + n_channels;
+        float *y1 = x1 + n_channels;
+        // The first stage reads the input, later ones work in place on out
+        const float *src = stage ? out : in;
+        for (size_t f = 0; f < n_frames; ++f) {
+            const float *s = src + f * n_channels;
+            float *d = out + f * n_channels;
+            for (unsigned int ch = 0; ch < n_channels; ++ch) {
+                float x = s[ch];
+                // Same order of operations as dcp_iirx(). Products of two
+                // floats are exact in double precision.
+                double acc = b2 * x2[ch] - a2 * y2[ch];
+                acc += b1 * x1[ch];
+                acc -= a1 * y1[ch];
+                acc += b0 * x;
+                float y = (float) acc;
+                x2[ch] = x1[ch];
+                y2[ch] = y1[ch];
+                x1[ch] = x;
+                y1[ch] = y;
+                d[ch] = y;
+            }
+        }
+    }
+}
+
+static void biquad_from_cookbook(float *coeffs, double b0, double b1, double b2, double a0, double a1, double a2) {
+    coeffs[0] = (float) (b2 / a0);
+    coeffs[1] = (float) (a2 / a0);
+    coeffs[2] = (float) (b1 / a0);
+    coeffs[3] = (float) (a1 / a0);
+    coeffs[4] = (float) (b0 / a0);
+}
+
+void iir_biquad_lowpass(float *coeffs, float cutoff, float q) {
+    double w0 = 2.0 * M_PI * cutoff;
+    double alpha = sin(w0) / (2.0 * q);
+    double cw = cos(w0);
+    biquad_from_cookbook(coeffs, (1.0 - cw) / 2.0, 1.0 - cw, (1.0 - cw) / 2.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+void iir_biquad_highpass(float *coeffs, float cutoff, float q) {
+    double w0 = 2.0 * M_PI * cutoff;
+    double alpha = sin(w0) / (2.0 * q);
+    double cw = cos(w0);
+    biquad_from_cookbook(coeffs, (1.0 + cw) / 2.0, -(1.0 + cw), (1.0 + cw) / 2.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
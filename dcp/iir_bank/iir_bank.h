@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _IIR_BANK_H
+#define _IIR_BANK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A bank of identical cascaded biquad filters, one per channel, processing
+// blocks of interleaved samples (one sample from each channel in turn, as
+// from the ADC in round-robin mode).
+//
+// Each biquad is computed the same way as dcp_iirx() in
+// hello_dcp/dcp_examples.S: direct form I, with exact float products summed
+// in double precision in the same order, and the result rounded to float.
+// So the output is bit-for-bit the same as running dcp_iirx() on each
+// channel, as long as the compiler doesn't fuse multiply-adds
+// (-ffp-contract=off).
+//
+// Coefficients are shared by all the channels, and are in dcp_iirx() order:
+// b2, a2, b1, a1, b0 (with a0 = 1).
+//
+// The state is struct-of-arrays: for each stage, x[t-2], y[t-2], x[t-1] and
+// y[t-1] (the same order as dcp_iirx()'s temporary storage), each stored for
+// all the channels together. Processing runs a whole block through one stage
+// at a time, so a stage's coefficients stay in registers and its state is
+// read sequentially.
+
+#define IIR_BIQUAD_COEFFS 5
+#define IIR_BANK_MAX_STAGES 8
+
+typedef struct {
+    unsigned int n_channels;
+    unsigned int n_stages;
+    const float *coeffs;
+    float *state;
+} iir_bank_t;
+
+// coeffs holds IIR_BIQUAD_COEFFS per stage, and must remain valid whilst the
+// bank is in use. The state is allocated, and cleared.
+bool iir_bank_init(iir_bank_t *bank, unsigned int n_channels, unsigned int n_stages, const float *coeffs);
+
+void iir_bank_deinit(iir_bank_t *bank);
+
+void iir_bank_reset(iir_bank_t *bank);
+
+// Filter n_frames frames of interleaved samples. in and out may be the same.
+void iir_bank_process(iir_bank_t *bank, const float *in, float *out, size_t n_frames);
+
+// Low and high pass biquads (from the Audio EQ Cookbook). cutoff is a
+// fraction of the sample rate; q of 0.7071 gives a Butterworth response.
+void iir_biquad_lowpass(float *coeffs, float cutoff, float q);
+
+void iir_biquad_highpass(float *coeffs, float cutoff, float q);
+
+#endif
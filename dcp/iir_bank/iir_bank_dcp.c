@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "iir_bank.h"
+
+/*
+A bank of cascaded biquad filters over several channels.
+
+hello_dcp runs dcp_iirx() on one channel, one sample at a time. Here eight
+channels each go through a cascade of low pass biquads, a block at a time,
+using iir_bank (see iir_bank.h). We check the bank's output is bit-for-bit the
+same as calling dcp_iirx() for every channel and stage, and then compare the
+number of samples per second each can filter, for filter orders 2, 4 and 8.
+
+NOTE: as with hello_dcp, dcp_iirx() doesn't check the DCP's engaged flag,
+so should not be used from more than one thread or from interrupt handlers.
+*/
+
+extern float dcp_iirx(float x, float *temp, float *coeff, int order);
+
+#define N_CHANNELS 8
+#define MAX_STAGES 4
+#define BLOCK_FRAMES 256
+#define BENCHMARK_BLOCKS 16
+
+static float coeffs[MAX_STAGES * IIR_BIQUAD_COEFFS];
+static float input[N_CHANNELS * BLOCK_FRAMES];
+static float output[N_CHANNELS * BLOCK_FRAMES];
+static float output_dcp[N_CHANNELS * BLOCK_FRAMES];
+// dcp_iirx() state for each channel and stage: x[t-2], y[t-2], x[t-1], y[t-1]
+static float dcp_temp[N_CHANNELS][MAX_STAGES][4];
+
+static void dcp_process(uint n_stages, const float *in, float *out, uint n_frames) {
+    for (uint f = 0; f < n_frames; ++f) {
+        for (uint ch = 0; ch < N_CHANNELS; ++ch) {
+            float x = in[f * N_CHANNELS + ch];
+            for (uint stage = 0; stage < n_stages; ++stage)
+                x = dcp_iirx(x, dcp_temp[ch][stage], &coeffs[stage * IIR_BIQUAD_COEFFS], 2);
+            out[f * N_CHANNELS + ch] = x;
+        }
+    }
+}
+
+static void make_input(void) {
+    for (uint i = 0; i < count_of(input); ++i)
+        input[i] = (float) (rand() % 2001 - 1000) / 1000.f;
+}
+
+static bool check(void) {
+    iir_bank_t bank;
+    if (!iir_bank_init(&bank, N_CHANNELS, MAX_STAGES, coeffs))
+        return false;
+    memset(dcp_temp, 0, sizeof(dcp_temp));
+    uint mismatches = 0;
+    // Several blocks, to check the state is carried over properly
+    for (uint block = 0; block < 4; ++block) {
+        make_input();
+        iir_bank_process(&bank, input, output, BLOCK_FRAMES);
+        dcp_process(MAX_STAGES, input, output_dcp, BLOCK_FRAMES);
+        for (uint i = 0; i < count_of(output); ++i)
+            if (memcmp(&output[i], &output_dcp[i], sizeof(float)))
+                ++mismatches;
+    }
+    iir_bank_deinit(&bank);
+    printf("iir_bank vs dcp_iirx: %u of %u samples differ\n", mismatches, (uint) (4 * count_of(output)));
+    return !mismatches;
+}
+
+static void benchmark(uint n_stages) {
+    iir_bank_t bank;
+    if (!iir_bank_init(&bank, N_CHANNELS, n_stages, coeffs))
+        return;
+    make_input();
+    uint32_t n_samples = BENCHMARK_BLOCKS * BLOCK_FRAMES * N_CHANNELS;
+
+    uint64_t start = time_us_64();
+    for (uint block = 0; block < BENCHMARK_BLOCKS; ++block)
+        iir_bank_process(&bank, input, output, BLOCK_FRAMES);
+    uint64_t bank_us = time_us_64() - start;
+
+    start = time_us_64();
+    for (uint block = 0; block < BENCHMARK_BLOCKS; ++block)
+        dcp_process(n_stages, input, output_dcp, BLOCK_FRAMES);
+    uint64_t dcp_us = time_us_64() - start;
+
+    printf("Order %u: iir_bank %8.0f samples/s, dcp_iirx %8.0f samples/s\n", 2 * n_stages,
+           (double) n_samples * 1e6 / (double) bank_us, (double) n_samples * 1e6 / (double) dcp_us);
+    iir_bank_deinit(&bank);
+}
+
+int main() {
+    stdio_init_all();
+
+    printf("DCP IIR filter bank example\n");
+
+    // A mix of low pass sections, so the cascade is not too well behaved
+    for (uint stage = 0; stage < MAX_STAGES; ++stage)
+        iir_biquad_lowpass(&coeffs[stage * IIR_BIQUAD_COEFFS], 0.05f + 0.02f * stage, 0.5f + 0.3f * stage);
+
+    if (!check()) {
+        printf("Filter bank check failed\n");
+        return 1;
+    }
+    for (uint n_stages = 1; n_stages <= MAX_STAGES; n_stages *= 2)
+        benchmark(n_stages);
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "dma_sg.h"
+
+dma_sg_layout_info_t dma_sg_layout_info(dma_sg_layout_t layout) {
+    switch (layout) {
+        case DMA_SG_COUNT_READ:
+            return (dma_sg_layout_info_t) {.reg_offset = 0x38, .words = 2, .ring_bits = 3};
+        case DMA_SG_READ_WRITE:
+            return (dma_sg_layout_info_t) {.reg_offset = 0x28, .words = 2, .ring_bits = 3};
+        case DMA_SG_WRITE_COUNT:
+            return (dma_sg_layout_info_t) {.reg_offset = 0x18, .words = 2, .ring_bits = 3};
+        default:
+            return (dma_sg_layout_info_t) {.reg_offset = 0x10, .words = 4, .ring_bits = 4};
+    }
+}
+
+void dma_sg_list_init(dma_sg_list_t *list, dma_sg_layout_t layout, const dma_sg_block_t *base, uint32_t *words,
+                      dma_sg_block_t *blocks, uint32_t capacity, dma_sg_encode_ctrl_t encode_ctrl, void *encode_ctx) {
+    list->layout = layout;
+    list->base = *base;
+    list->encode_ctrl = encode_ctrl;
+    list->encode_ctx = encode_ctx;
+    list->words = words;
+    list->blocks = blocks;
+    list->capacity = capacity;
+    dma_sg_list_clear(list);
+}
+
+void dma_sg_list_clear(dma_sg_list_t *list) {
+    list->count = 0;
+    list->finished = false;
+}
+
+// The words of a block, in the order the layout loads them
+static void block_words(const dma_sg_list_t *list, const dma_sg_block_t *b, uint32_t *w) {
+    switch (list->layout) {
+        case DMA_SG_COUNT_READ:
+            w[0] = b->count;
+            w[1] = (uint32_t) b->read;
+            break;
+        case DMA_SG_READ_WRITE:
+            w[0] = (uint32_t) b->read;
+            w[1] = (uint32_t) b->write;
+            break;
+        case DMA_SG_WRITE_COUNT:
+            w[0] = (uint32_t) b->write;
+            w[1] = b->count;
+            break;
+        default:
+            w[0] = list->encode_ctrl(&b->xfer, list->encode_ctx);
+            w[1] = (uint32_t) b->read;
+            w[2] = (uint32_t) b->write;
+            w[3] = b->count;
+            break;
+    }
+}
+
+static void append(dma_sg_list_t *list, const dma_sg_block_t *b) {
+    uint32_t n = dma_sg_layout_info(list->layout).words;
+    list->blocks[list->count] = *b;
+    block_words(list, b, &list->words[list->count * n]);
+    ++list->count;
+}
+
+bool dma_sg_add(dma_sg_list_t *list, uintptr_t read, uintptr_t write, uint32_t count, const dma_sg_xfer_t *xfer) {
+    if (list->finished || list->count >= list->capacity)
+        return false;
+    dma_sg_block_t b = {.read = read, .write = write, .count = count, .xfer = xfer ? *xfer : list->base.xfer};
+    // Fields this layout doesn't load come from the previous block
+    switch (list->layout) {
+        case DMA_SG_COUNT_READ:
+            b.write = 0;
+            break;
+        case DMA_SG_READ_WRITE:
+            b.count = list->base.count;
+            break;
+        case DMA_SG_WRITE_COUNT:
+            b.read = 0;
+            break;
+        default:
+            break;
+    }
+    if (!b.count || b.count > DMA_SG_MAX_COUNT)
+        return false;
+    // A zero in the trigger word would end the list early, as a null trigger
+    if ((list->layout == DMA_SG_COUNT_READ && !b.read) || (list->layout == DMA_SG_READ_WRITE && !b.write))
+        return false;
+    if (list->layout != DMA_SG_FULL)
+        b.xfer = list->base.xfer;
+    append(list, &b);
+    return true;
+}
+
+bool dma_sg_finish(dma_sg_list_t *list) {
+    if (list->finished)
+        return false;
+    dma_sg_block_t b = {.xfer = list->base.xfer};
+    append(list, &b);
+    // The null block doesn't count as a block
+    --list->count;
+    list->finished = true;
+    return true;
+}
+
+typedef struct {
+    uintptr_t read;
+    uintptr_t write;
+    uint32_t count;
+    dma_sg_xfer_t xfer;
+} channel_regs_t;
+
+static void load_block(const dma_sg_list_t *list, const dma_sg_block_t *b, channel_regs_t *regs) {
+    switch (list->layout) {
+        case DMA_SG_COUNT_READ:
+            regs->count = b->count;
+            regs->read = b->read;
+            break;
+        case DMA_SG_READ_WRITE:
+            regs->read = b->read;
+            regs->write = b->write;
+            break;
+        case DMA_SG_WRITE_COUNT:
+            regs->write = b->write;
+            regs->count = b->count;
+            break;
+        default:
+            regs->xfer = b->xfer;
+            regs->read = b->read;
+            regs->write = b->write;
+            regs->count = b->count;
+            break;
+    }
+    // TRANS_COUNT isn't written with the aliases that don't load it, but the
+    // count reloads from the value last written
+    if (list->layout == DMA_SG_READ_WRITE)
+        regs->count = list->base.count;
+}
+
+// Address after n transfers
+static uintptr_t advance(uintptr_t addr, uint32_t n, bool incr, bool ring, const dma_sg_xfer_t *xfer) {
+    if (!incr)
+        return addr;
+    uintptr_t next = addr + (uintptr_t) n * xfer->size;
+    if (ring && xfer->ring_bits) {
+        uintptr_t mask = ((uintptr_t) 1 << xfer->ring_bits) - 1;
+        next = (addr & ~mask) | (next & mask);
+    }
+    return next;
+}
+
+static dma_sg_error_t check_block(const channel_regs_t *regs) {
+    const dma_sg_xfer_t *x = &regs->xfer;
+    if (!regs->count || regs->count > DMA_SG_MAX_COUNT)
+        return DMA_SG_ERR_COUNT;
+    if (x->size != 1 && x->size != 2 && x->size != 4)
+        return DMA_SG_ERR_SIZE;
+    if (!regs->read || !regs->write)
+        return DMA_SG_ERR_NULL_ADDRESS;
+    if ((regs->read | regs->write) & (x->size - 1u))
+        return DMA_SG_ERR_ALIGNMENT;
+    if (x->ring_bits && ((1u << x->ring_bits) < x->size || x->ring_bits > 15))
+        return DMA_SG_ERR_RING;
+    return DMA_SG_OK;
+}
+
+// Step through the list with a model of the data channel's registers,
+// optionally doing the transfers
+static dma_sg_error_t run(const dma_sg_list_t *list, uint32_t *block_out, dma_sg_write_fn write, void *ctx,
+                          dma_sg_stats_t *stats) {
+    uint32_t n = dma_sg_layout_info(list->layout).words;
+    channel_regs_t regs = {
+            .read = list->base.read, .write = list->base.write, .count = list->base.count, .xfer = list->base.xfer
+    };
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+    if (!list->finished)
+        return DMA_SG_ERR_NOT_FINISHED;
+    for (uint32_t i = 0; i <= list->count; ++i) {
+        if (block_out)
+            *block_out = i;
+        uint32_t expect[4];
+        block_words(list, &list->blocks[i], expect);
+        if (memcmp(expect, &list->words[i * n], n * sizeof(uint32_t)))
+            return DMA_SG_ERR_WORDS;
+        // A zero trigger word is a null trigger, which ends the list
+        bool null_trigger = !list->words[i * n + n - 1];
+        if (null_trigger != (i == list->count)) {
+            if (i == list->count)
+                return DMA_SG_ERR_WORDS;
+            bool count_triggers = list->layout == DMA_SG_WRITE_COUNT || list->layout == DMA_SG_FULL;
+            return count_triggers ? DMA_SG_ERR_COUNT : DMA_SG_ERR_NULL_ADDRESS;
+        }
+        if (null_trigger)
+            break;
+
+        load_block(list, &list->blocks[i], &regs);
+        dma_sg_error_t err = check_block(&regs);
+        if (err)
+            return err;
+        const dma_sg_xfer_t *x = &regs.xfer;
+        if (write) {
+            for (uint32_t t = 0; t < regs.count; ++t) {
+                uint32_t data = 0;
+                memcpy(&data, (const void *) regs.read, x->size);
+                write(regs.write, data, x->size, ctx);
+                regs.read = advance(regs.read, 1, x->incr_read, !x->ring_write, x);
+                regs.write = advance(regs.write, 1, x->incr_write, x->ring_write, x);
+            }
+        } else {
+            regs.read = advance(regs.read, regs.count, x->incr_read, !x->ring_write, x);
+            regs.write = advance(regs.write, regs.count, x->incr_write, x->ring_write, x);
+        }
+        if (stats) {
+            ++stats->blocks;
+            stats->transfers += regs.count;
+            stats->bytes += regs.count * x->size;
+        }
+    }
+    return DMA_SG_OK;
+}
+
+dma_sg_error_t dma_sg_validate(const dma_sg_list_t *list, uint32_t *block_out) {
+    return run(list, block_out, NULL, NULL, NULL);
+}
+
+void dma_sg_simulate(const dma_sg_list_t *list, dma_sg_write_fn write, void *ctx, dma_sg_stats_t *stats) {
+    run(list, NULL, write, ctx, stats);
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _DMA_SG_H
+#define _DMA_SG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Build lists of DMA control blocks for scatter-gather transfers, and check
+// them by simulating what the DMA will do with them.
+//
+// As in the control_blocks example, a control channel copies each control
+// block into one of the register aliases of a data channel, the last word
+// landing on the alias's trigger register. When the data channel finishes it
+// chains back to the control channel, which loads the next block. A block
+// whose trigger word is zero (a null trigger) ends the list.
+//
+// The layout chooses which alias, and so which registers each block loads;
+// registers which aren't loaded keep their values from the previous block
+// (or from the data channel's initial configuration, the list's base). So
+// with DMA_SG_COUNT_READ and a fixed write address, fragments anywhere in
+// memory are gathered to a peripheral FIFO, and with DMA_SG_WRITE_COUNT a
+// stream of data is scattered to several places.
+//
+// Only DMA_SG_FULL loads CTRL, which is needed to change the transfer size,
+// DREQ, address increments or ring for each block. The CTRL register's
+// layout differs between chips, so blocks are described portably with
+// dma_sg_xfer_t, and the list has a function to turn these into CTRL values.
+// That function must also set CHAIN_TO to the control channel, and
+// IRQ_QUIET, so the data channel interrupts only on the null trigger.
+
+typedef enum {
+    DMA_SG_COUNT_READ,  // Alias 3: TRANS_COUNT, READ_ADDR_TRIG
+    DMA_SG_READ_WRITE,  // Alias 2: READ_ADDR, WRITE_ADDR_TRIG
+    DMA_SG_WRITE_COUNT, // Alias 1: WRITE_ADDR, TRANS_COUNT_TRIG
+    DMA_SG_FULL,        // Alias 1: CTRL, READ_ADDR, WRITE_ADDR, TRANS_COUNT_TRIG
+} dma_sg_layout_t;
+
+typedef struct {
+    // Offset of the first register loaded, from the start of the channel's registers
+    uint32_t reg_offset;
+    uint32_t words;
+    // Write address ring size for the control channel
+    uint32_t ring_bits;
+} dma_sg_layout_info_t;
+
+// Same value as DREQ_FORCE on RP2040 and RP2350
+#define DMA_SG_DREQ_FORCE 0x3f
+
+// TRANS_COUNT is 28 bits on RP2350, the top 4 bits being a mode
+#define DMA_SG_MAX_COUNT 0x0fffffffu
+
+typedef struct {
+    // Bytes per transfer: 1, 2 or 4
+    uint8_t size;
+    bool incr_read;
+    bool incr_write;
+    // Wrap the read (or write) address on a 1 << ring_bits byte boundary, 0 for no ring
+    uint8_t ring_bits;
+    bool ring_write;
+    uint8_t dreq;
+} dma_sg_xfer_t;
+
+typedef struct {
+    uintptr_t read;
+    uintptr_t write;
+    uint32_t count;
+    dma_sg_xfer_t xfer;
+} dma_sg_block_t;
+
+typedef uint32_t (*dma_sg_encode_ctrl_t)(const dma_sg_xfer_t *xfer, void *ctx);
+
+typedef struct {
+    dma_sg_layout_t layout;
+    // The data channel's initial configuration
+    dma_sg_block_t base;
+    dma_sg_encode_ctrl_t encode_ctrl;
+    void *encode_ctx;
+    // Control blocks, for the control channel to read
+    uint32_t *words;
+    // What each control block does, for checking
+    dma_sg_block_t *blocks;
+    uint32_t capacity;
+    uint32_t count;
+    bool finished;
+} dma_sg_list_t;
+
+// Words needed for a list of n_blocks blocks (plus the null block)
+#define DMA_SG_LIST_WORDS(layout, n_blocks) (((layout) == DMA_SG_FULL ? 4 : 2) * ((n_blocks) + 1))
+
+dma_sg_layout_info_t dma_sg_layout_info(dma_sg_layout_t layout);
+
+// words must have room for DMA_SG_LIST_WORDS(layout, capacity) words, blocks
+// for capacity + 1 blocks. encode_ctrl is only needed for DMA_SG_FULL.
+void dma_sg_list_init(dma_sg_list_t *list, dma_sg_layout_t layout, const dma_sg_block_t *base, uint32_t *words,
+                      dma_sg_block_t *blocks, uint32_t capacity, dma_sg_encode_ctrl_t encode_ctrl, void *encode_ctx);
+
+// Empty the list, to build it again
+void dma_sg_list_clear(dma_sg_list_t *list);
+
+// Add a block. Fields the layout doesn't load are ignored, and xfer may be
+// NULL to use the base settings. Returns false if the list is full or
+// finished, count is 0 or too big, or the field that lands on the trigger
+// register (read for DMA_SG_COUNT_READ, write for DMA_SG_READ_WRITE) is 0.
+bool dma_sg_add(dma_sg_list_t *list, uintptr_t read, uintptr_t write, uint32_t count, const dma_sg_xfer_t *xfer);
+
+// Add the null block, after which the list can be used
+bool dma_sg_finish(dma_sg_list_t *list);
+
+typedef enum {
+    DMA_SG_OK = 0,
+    DMA_SG_ERR_NOT_FINISHED,
+    DMA_SG_ERR_WORDS,        // a control block doesn't match what it should do
+    DMA_SG_ERR_COUNT,        // zero or too big
+    DMA_SG_ERR_SIZE,         // transfer size isn't 1, 2 or 4
+    DMA_SG_ERR_ALIGNMENT,    // an address isn't aligned to the transfer size
+    DMA_SG_ERR_RING,         // ring smaller than a transfer, or more than 15 bits
+    DMA_SG_ERR_NULL_ADDRESS, // transfer from or to address 0
+} dma_sg_error_t;
+
+// Check the list is well formed, and returns the first problem found. If
+// block_out is non-NULL it is set to the index of the offending block.
+dma_sg_error_t dma_sg_validate(const dma_sg_list_t *list, uint32_t *block_out);
+
+typedef void (*dma_sg_write_fn)(uintptr_t addr, uint32_t data, uint32_t size, void *ctx);
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t transfers;
+    uint32_t bytes;
+} dma_sg_stats_t;
+
+// Run the list as the DMA would, reading memory directly and passing each
+// write to the write function. The list should be valid.
+void dma_sg_simulate(const dma_sg_list_t *list, dma_sg_write_fn write, void *ctx, dma_sg_stats_t *stats);
+
+#endif
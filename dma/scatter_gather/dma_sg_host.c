@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the scatter-gather list builder, validator and simulator
+// (dma_sg.h), run on the host. Build with PICO_PLATFORM=host.
+//
+// Well formed lists of each layout must validate, and the simulator must
+// gather, scatter and copy the data as the DMA would. Then malformed lists
+// (unfinished, control blocks not matching what they should do, a null
+// trigger in the middle or missing at the end, bad counts, sizes, alignment,
+// rings and null addresses) must each be caught at the right block, and
+// dma_sg_add() must refuse the blocks it can see are wrong.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "dma_sg.h"
+
+#define MAX_BLOCKS 16
+#define STREAM_SIZE 256
+
+static uint32_t list_words[DMA_SG_LIST_WORDS(DMA_SG_FULL, MAX_BLOCKS)];
+static dma_sg_block_t list_blocks[MAX_BLOCKS + 1];
+static dma_sg_list_t list;
+
+// Stand-ins for peripheral FIFOs
+static uint32_t fifo_a, fifo_b;
+
+static uint8_t __attribute__((aligned(16))) ring_pattern[16] = "0123456789abcdef";
+static uint32_t table[8] = {1, 22, 333, 4444, 55555, 666666, 7777777, 88888888};
+static uint32_t copy_dest[8];
+static uint8_t scatter_dest[3][8];
+
+typedef struct {
+    char stream[2][STREAM_SIZE];
+    uint stream_len[2];
+    bool stray;
+} sim_t;
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static bool in_buffer(uintptr_t addr, uint32_t size, const void *buf, size_t buf_size) {
+    return addr >= (uintptr_t) buf && addr + size <= (uintptr_t) buf + buf_size;
+}
+
+static void sim_write(uintptr_t addr, uint32_t data, uint32_t size, void *ctx) {
+    sim_t *sim = (sim_t *) ctx;
+    for (uint i = 0; i < 2; ++i) {
+        if (addr == (i ? (uintptr_t) &fifo_b : (uintptr_t) &fifo_a)) {
+            if (sim->stream_len[i] < STREAM_SIZE)
+                sim->stream[i][sim->stream_len[i]++] = (char) data;
+            return;
+        }
+    }
+    if (in_buffer(addr, size, copy_dest, sizeof(copy_dest)) ||
+        in_buffer(addr, size, scatter_dest, sizeof(scatter_dest)))
+        memcpy((void *) addr, &data, size);
+    else
+        sim->stray = true;
+}
+
+// Any encoding will do, as long as different settings give different words
+static uint32_t encode_ctrl(const dma_sg_xfer_t *xfer, __unused void *ctx) {
+    return xfer->size | xfer->incr_read << 3 | xfer->incr_write << 4 | xfer->ring_write << 5 |
+           (uint32_t) xfer->ring_bits << 8 | (uint32_t) xfer->dreq << 16;
+}
+
+static const char *error_names[] = {
+        "ok", "not finished", "words", "count", "size", "alignment", "ring", "null address"
+};
+
+static void check_error(const char *name, dma_sg_error_t expected, uint32_t expected_block) {
+    uint32_t block = ~0u;
+    dma_sg_error_t err = dma_sg_validate(&list, &block);
+    if (err != expected || (expected && expected != DMA_SG_ERR_NOT_FINISHED && block != expected_block)) {
+        if (!errors++)
+            printf("%s: got %s at block %u, expected %s at block %u\n", name, error_names[err], (uint) block,
+                   error_names[expected], (uint) expected_block);
+    }
+}
+
+static const char *const fragments[] = {"Gathering ", "text ", "from ", "all ", "over ", "memory."};
+
+static void check_gather(void) {
+    const dma_sg_block_t base = {.write = (uintptr_t) &fifo_a, .xfer = {.size = 1, .incr_read = true}};
+    dma_sg_list_init(&list, DMA_SG_COUNT_READ, &base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    for (uint i = 0; i < count_of(fragments); ++i)
+        check(dma_sg_add(&list, (uintptr_t) fragments[i], 0, strlen(fragments[i]), NULL), "Adding a fragment");
+    check_error("Gather, before finishing", DMA_SG_ERR_NOT_FINISHED, 0);
+    check(dma_sg_finish(&list) && !dma_sg_finish(&list), "Finishing");
+    check(!dma_sg_add(&list, (uintptr_t) fragments[0], 0, 1, NULL), "Adding after finishing");
+    check_error("Gather", DMA_SG_OK, 0);
+    // Two words per block, and a null block at the end
+    check(list_words[0] == strlen(fragments[0]) && list_words[12] == 0 && list_words[13] == 0, "Gather words");
+
+    sim_t sim = {0};
+    dma_sg_stats_t stats;
+    dma_sg_simulate(&list, sim_write, &sim, &stats);
+    check(!sim.stray && sim.stream_len[0] == 36 && !memcmp(sim.stream[0], "Gathering text from all over memory.", 36),
+          "Gathered text");
+    check(stats.blocks == count_of(fragments) && stats.transfers == 36 && stats.bytes == 36, "Gather stats");
+}
+
+// One stream of bytes scattered to three places
+static void check_scatter(void) {
+    static const char stream[] = "ABCDEFGHIJKLMNOPQRSTUVWX";
+    const dma_sg_block_t base = {.read = (uintptr_t) stream, .xfer = {.size = 1, .incr_read = true,
+                                                                        .incr_write = true}};
+    dma_sg_list_init(&list, DMA_SG_WRITE_COUNT, &base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    memset(scatter_dest, 0, sizeof(scatter_dest));
+    check(dma_sg_add(&list, 0, (uintptr_t) scatter_dest[2], 8, NULL) &&
+          dma_sg_add(&list, 0, (uintptr_t) scatter_dest[0], 4, NULL) &&
+          dma_sg_add(&list, 0, (uintptr_t) scatter_dest[1], 8, NULL) && dma_sg_finish(&list), "Building a scatter");
+    check_error("Scatter", DMA_SG_OK, 0);
+    sim_t sim = {0};
+    dma_sg_stats_t stats;
+    dma_sg_simulate(&list, sim_write, &sim, &stats);
+    // The read address carries on from where the last block left it
+    check(!sim.stray && !memcmp(scatter_dest[2], "ABCDEFGH", 8) && !memcmp(scatter_dest[0], "IJKL\0\0\0\0", 8) &&
+          !memcmp(scatter_dest[1], "MNOPQRST", 8), "Scattered data");
+    check(stats.blocks == 3 && stats.bytes == 20, "Scatter stats");
+}
+
+// Each block changes everything, including the transfer size and ring
+static void check_full(void) {
+    static const char header[] = "Full: ";
+    const dma_sg_block_t base = {.xfer = {.size = 1, .incr_read = true}};
+    const dma_sg_xfer_t bytes = {.size = 1, .incr_read = true};
+    const dma_sg_xfer_t ring = {.size = 1, .incr_read = true, .ring_bits = 4};
+    const dma_sg_xfer_t copy_words = {.size = 4, .incr_read = true, .incr_write = true, .dreq = DMA_SG_DREQ_FORCE};
+    dma_sg_list_init(&list, DMA_SG_FULL, &base, list_words, list_blocks, MAX_BLOCKS, encode_ctrl, NULL);
+    check(dma_sg_add(&list, (uintptr_t) header, (uintptr_t) &fifo_a, strlen(header), &bytes) &&
+          dma_sg_add(&list, (uintptr_t) ring_pattern, (uintptr_t) &fifo_a, 40, &ring) &&
+          dma_sg_add(&list, (uintptr_t) table, (uintptr_t) copy_dest, count_of(table), &copy_words) &&
+          dma_sg_add(&list, (uintptr_t) header, (uintptr_t) &fifo_b, 4, NULL) && dma_sg_finish(&list),
+          "Building a full list");
+    check_error("Full", DMA_SG_OK, 0);
+    check(list_words[0] == encode_ctrl(&bytes, NULL) && list_words[3] == strlen(header) &&
+          list_words[8] == encode_ctrl(&copy_words, NULL), "Full words");
+
+    memset(copy_dest, 0, sizeof(copy_dest));
+    sim_t sim = {0};
+    dma_sg_stats_t stats;
+    dma_sg_simulate(&list, sim_write, &sim, &stats);
+    check(!sim.stray && sim.stream_len[0] == 46 &&
+          !memcmp(sim.stream[0], "Full: 0123456789abcdef0123456789abcdef01234567", 46), "Text with a ring");
+    check(!memcmp(copy_dest, table, sizeof(table)), "Word copy");
+    check(sim.stream_len[1] == 4 && !memcmp(sim.stream[1], "Full", 4), "Bytes to the second FIFO");
+    check(stats.blocks == 4 && stats.transfers == 6 + 40 + 8 + 4 && stats.bytes == 6 + 40 + 32 + 4, "Full stats");
+}
+
+// Memory to memory copies, with the count from the base
+static void check_read_write(void) {
+    const dma_sg_block_t base = {.count = 2, .xfer = {.size = 4, .incr_read = true, .incr_write = true}};
+    dma_sg_list_init(&list, DMA_SG_READ_WRITE, &base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    memset(copy_dest, 0, sizeof(copy_dest));
+    check(dma_sg_add(&list, (uintptr_t) &table[6], (uintptr_t) &copy_dest[0], 99, NULL) &&
+          dma_sg_add(&list, (uintptr_t) &table[0], (uintptr_t) &copy_dest[4], 99, NULL) && dma_sg_finish(&list),
+          "Building a copy list");
+    check_error("Copies", DMA_SG_OK, 0);
+    sim_t sim = {0};
+    dma_sg_simulate(&list, sim_write, &sim, NULL);
+    check(!sim.stray && copy_dest[0] == table[6] && copy_dest[1] == table[7] && !copy_dest[2] &&
+          copy_dest[4] == table[0] && copy_dest[5] == table[1] && !copy_dest[6], "Copies");
+}
+
+static void check_malformed(void) {
+    const dma_sg_block_t gather_base = {.write = (uintptr_t) &fifo_a, .xfer = {.size = 1, .incr_read = true}};
+    const dma_sg_block_t full_base = {.xfer = {.size = 1, .incr_read = true}};
+
+    // dma_sg_add() refuses what it can see is wrong
+    dma_sg_list_init(&list, DMA_SG_COUNT_READ, &gather_base, list_words, list_blocks, 2, NULL, NULL);
+    check(!dma_sg_add(&list, (uintptr_t) fragments[0], 0, 0, NULL), "Refusing a count of 0");
+    check(!dma_sg_add(&list, (uintptr_t) fragments[0], 0, DMA_SG_MAX_COUNT + 1, NULL), "Refusing a big count");
+    check(!dma_sg_add(&list, 0, 0, 1, NULL), "Refusing a null trigger");
+    check(dma_sg_add(&list, (uintptr_t) fragments[0], 0, 1, NULL) &&
+          dma_sg_add(&list, (uintptr_t) fragments[1], 0, 1, NULL) &&
+          !dma_sg_add(&list, (uintptr_t) fragments[2], 0, 1, NULL), "Refusing a block when full");
+    dma_sg_finish(&list);
+    check_error("Full capacity", DMA_SG_OK, 0);
+
+    // A control block which doesn't match its description
+    ++list_words[2];
+    check_error("Changed word", DMA_SG_ERR_WORDS, 1);
+    --list_words[2];
+    // A zero read address in the middle is a null trigger, ending the list early
+    list_blocks[1].read = 0;
+    list_words[3] = 0;
+    check_error("Early null trigger", DMA_SG_ERR_NULL_ADDRESS, 1);
+    // And no null trigger at the end runs on into whatever follows
+    list_blocks[1].read = (uintptr_t) fragments[1];
+    list_words[3] = (uint32_t) (uintptr_t) fragments[1];
+    list_blocks[2].read = (uintptr_t) fragments[2];
+    list_words[5] = (uint32_t) (uintptr_t) fragments[2];
+    check_error("Missing null trigger", DMA_SG_ERR_WORDS, 2);
+
+    // The write address stays at the base's, which is null
+    const dma_sg_block_t null_write = {.xfer = {.size = 1, .incr_read = true}};
+    dma_sg_list_init(&list, DMA_SG_COUNT_READ, &null_write, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    dma_sg_add(&list, (uintptr_t) fragments[0], 0, 4, NULL);
+    dma_sg_finish(&list);
+    check_error("Null base write address", DMA_SG_ERR_NULL_ADDRESS, 0);
+
+    // A zero count in the middle of a scatter is a null trigger
+    dma_sg_list_init(&list, DMA_SG_WRITE_COUNT, &full_base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    list.base.read = (uintptr_t) fragments[0];
+    dma_sg_add(&list, 0, (uintptr_t) scatter_dest[0], 4, NULL);
+    dma_sg_add(&list, 0, (uintptr_t) scatter_dest[1], 4, NULL);
+    dma_sg_add(&list, 0, (uintptr_t) scatter_dest[2], 4, NULL);
+    dma_sg_finish(&list);
+    check_error("Scatter", DMA_SG_OK, 0);
+    list_blocks[1].count = 0;
+    list_words[3] = 0;
+    check_error("Zero count", DMA_SG_ERR_COUNT, 1);
+
+    // Problems only the simulation finds, in the second block of a full list
+    static const struct {
+        const char *name;
+        dma_sg_xfer_t xfer;
+        uintptr_t read_offset;
+        bool null_write;
+        dma_sg_error_t error;
+    } bad_blocks[] = {
+            {"Transfer size of 3", {.size = 3, .incr_read = true}, 0, false, DMA_SG_ERR_SIZE},
+            {"Unaligned read", {.size = 4, .incr_read = true}, 2, false, DMA_SG_ERR_ALIGNMENT},
+            {"Ring smaller than a transfer", {.size = 4, .incr_read = true, .ring_bits = 1}, 0, false, DMA_SG_ERR_RING},
+            {"Ring of 16 bits", {.size = 1, .incr_read = true, .ring_bits = 16}, 0, false, DMA_SG_ERR_RING},
+            {"Null write address", {.size = 1, .incr_read = true}, 0, true, DMA_SG_ERR_NULL_ADDRESS},
+    };
+    for (uint i = 0; i < count_of(bad_blocks); ++i) {
+        dma_sg_list_init(&list, DMA_SG_FULL, &full_base, list_words, list_blocks, MAX_BLOCKS, encode_ctrl, NULL);
+        dma_sg_add(&list, (uintptr_t) table, (uintptr_t) &fifo_a, 4, NULL);
+        check(dma_sg_add(&list, (uintptr_t) table + bad_blocks[i].read_offset,
+                         bad_blocks[i].null_write ? 0 : (uintptr_t) copy_dest, 4, &bad_blocks[i].xfer),
+              "Adding a block the simulation must catch");
+        dma_sg_add(&list, (uintptr_t) table, (uintptr_t) &fifo_a, 4, NULL);
+        dma_sg_finish(&list);
+        check_error(bad_blocks[i].name, bad_blocks[i].error, 1);
+    }
+}
+
+int main() {
+    printf("DMA scatter-gather host tests\n");
+    check_gather();
+    check_scatter();
+    check_full();
+    check_read_write();
+    check_malformed();
+    printf(errors ? "FAILED\n" : "All scatter-gather checks passed\n");
+    return errors != 0;
+}
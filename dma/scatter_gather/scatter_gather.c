@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Scatter-gather DMA using lists of control blocks built at runtime.
+//
+// The control_blocks example sends a fixed table of control blocks to the
+// UART. Here the lists are built with dma_sg.h, which can use any of the
+// register alias layouts, and a small engine runs them with two channels and
+// calls a function when the null block at the end is reached:
+//
+// - A DMA_SG_COUNT_READ list gathers fragments of text to the UART, as in the
+//   control_blocks example.
+//
+// - A DMA_SG_FULL list changes everything for each block: text to the UART,
+//   a 16-byte pattern repeated from a ring buffer to the UART, a word-sized
+//   memory copy, and bytes to the SPI TX FIFO.
+//
+// Each list is checked with dma_sg_validate() and run through the simulator
+// first, and the memory the DMA writes is compared with what the simulator
+// predicted. Finally we time how long it takes to build and check a list.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "hardware/structs/uart.h"
+
+#include "dma_sg.h"
+
+#define MAX_BLOCKS 64
+
+typedef void (*sg_done_fn)(void *arg);
+
+typedef struct {
+    uint ctrl_chan;
+    uint data_chan;
+    sg_done_fn done;
+    void *arg;
+    volatile bool busy;
+} sg_engine_t;
+
+static sg_engine_t engine;
+
+static uint32_t list_words[DMA_SG_LIST_WORDS(DMA_SG_FULL, MAX_BLOCKS)];
+static dma_sg_block_t list_blocks[MAX_BLOCKS + 1];
+static dma_sg_list_t list;
+
+// CTRL for a block: the data channel always chains back to the control
+// channel, and only interrupts on a null trigger
+static uint32_t encode_ctrl(const dma_sg_xfer_t *xfer, void *ctx) {
+    const sg_engine_t *e = (const sg_engine_t *) ctx;
+    dma_channel_config c = dma_channel_get_default_config(e->data_chan);
+    channel_config_set_transfer_data_size(&c, xfer->size == 4 ? DMA_SIZE_32 : xfer->size == 2 ? DMA_SIZE_16 : DMA_SIZE_8);
+    channel_config_set_read_increment(&c, xfer->incr_read);
+    channel_config_set_write_increment(&c, xfer->incr_write);
+    channel_config_set_ring(&c, xfer->ring_write, xfer->ring_bits);
+    channel_config_set_dreq(&c, xfer->dreq);
+    channel_config_set_chain_to(&c, e->ctrl_chan);
+    channel_config_set_irq_quiet(&c, true);
+    return channel_config_get_ctrl_value(&c);
+}
+
+void sg_dma_handler() {
+    if (dma_channel_get_irq0_status(engine.data_chan)) {
+        dma_channel_acknowledge_irq0(engine.data_chan);
+        engine.busy = false;
+        if (engine.done)
+            engine.done(engine.arg);
+    }
+}
+
+void sg_engine_init(sg_engine_t *e) {
+    e->ctrl_chan = dma_claim_unused_channel(true);
+    e->data_chan = dma_claim_unused_channel(true);
+    dma_channel_set_irq0_enabled(e->data_chan, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, sg_dma_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+// Start the data channel with the list's base settings, and have the control
+// channel load the first block. done is called from the DMA interrupt.
+void sg_engine_start(sg_engine_t *e, const dma_sg_list_t *l, sg_done_fn done, void *arg) {
+    e->done = done;
+    e->arg = arg;
+    e->busy = true;
+
+    dma_channel_hw_t *data = dma_channel_hw_addr(e->data_chan);
+    data->read_addr = l->base.read;
+    data->write_addr = l->base.write;
+    data->transfer_count = l->base.count;
+    data->al1_ctrl = encode_ctrl(&l->base.xfer, e);
+
+    // The control channel writes the same registers each time it's
+    // triggered, as its write address wraps around
+    dma_sg_layout_info_t info = dma_sg_layout_info(l->layout);
+    dma_channel_config c = dma_channel_get_default_config(e->ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, info.ring_bits);
+    dma_channel_configure(e->ctrl_chan, &c, (uint8_t *) data + info.reg_offset, l->words, info.words, true);
+}
+
+// ----------------------------------------------------------------------------
+// Simulation
+
+#define SIM_STREAM_SIZE 256
+
+typedef struct {
+    uintptr_t fifo[2];
+    char stream[2][SIM_STREAM_SIZE];
+    uint stream_len[2];
+    // Memory writes go to a shadow copy of this buffer
+    uintptr_t mem_base;
+    uint8_t *shadow;
+    uint mem_size;
+    bool stray;
+} sim_t;
+
+static void sim_write(uintptr_t addr, uint32_t data, uint32_t size, void *ctx) {
+    sim_t *sim = (sim_t *) ctx;
+    for (uint i = 0; i < 2; ++i) {
+        if (addr == sim->fifo[i]) {
+            if (sim->stream_len[i] < SIM_STREAM_SIZE)
+                sim->stream[i][sim->stream_len[i]++] = (char) data;
+            return;
+        }
+    }
+    if (addr >= sim->mem_base && addr + size <= sim->mem_base + sim->mem_size)
+        memcpy(&sim->shadow[addr - sim->mem_base], &data, size);
+    else
+        sim->stray = true;
+}
+
+static const char *error_names[] = {
+        "ok", "not finished", "words", "count", "size", "alignment", "ring", "null address"
+};
+
+static bool check_list(const char *name, sim_t *sim) {
+    uint32_t block;
+    dma_sg_error_t err = dma_sg_validate(&list, &block);
+    if (err) {
+        printf("%s: invalid at block %u: %s\n", name, (uint) block, error_names[err]);
+        return false;
+    }
+    dma_sg_stats_t stats;
+    dma_sg_simulate(&list, sim_write, sim, &stats);
+    printf("%s: %u blocks, %u bytes, %u words of control blocks%s\n", name, (uint) stats.blocks,
+           (uint) stats.bytes, (uint) ((list.count + 1) * dma_sg_layout_info(list.layout).words),
+           sim->stray ? ", STRAY WRITES" : "");
+    return !sim->stray;
+}
+
+// ----------------------------------------------------------------------------
+// Main program
+
+static const char *const words[] = {"Gathering ", "text ", "from ", "all ", "over ", "memory.\n"};
+
+static uint8_t __attribute__((aligned(16))) ring_pattern[16] = "-=-=-=-=-=-=-=-=";
+static const uint32_t table[16] = {
+        0x00000001, 0x00000004, 0x00000009, 0x00000010, 0x00000019, 0x00000024, 0x00000031, 0x00000040,
+        0x00000051, 0x00000064, 0x00000079, 0x00000090, 0x000000a9, 0x000000c4, 0x000000e1, 0x00000100,
+};
+static uint32_t copy_dest[16];
+static uint8_t shadow[sizeof(copy_dest)];
+static const char spi_message[] = "Sent to the SPI TX FIFO";
+
+static volatile uint lists_done;
+
+static void on_done(void *arg) {
+    lists_done = lists_done + 1;
+    (void) arg;
+}
+
+static void wait_for_engine() {
+    while (engine.busy)
+        __wfi();
+}
+
+static void benchmark_build() {
+    const uint n_lists = 100;
+    const dma_sg_block_t base = {
+            .write = (uintptr_t) &uart_get_hw(uart_default)->dr,
+            .xfer = {.size = 1, .incr_read = true, .dreq = uart_get_dreq(uart_default, true)},
+    };
+    uint64_t start = time_us_64();
+    for (uint n = 0; n < n_lists; ++n) {
+        dma_sg_list_init(&list, DMA_SG_COUNT_READ, &base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+        for (uint i = 0; i < MAX_BLOCKS; ++i)
+            dma_sg_add(&list, (uintptr_t) words[i % count_of(words)], 0, 4, NULL);
+        dma_sg_finish(&list);
+    }
+    uint64_t build_us = time_us_64() - start;
+    start = time_us_64();
+    for (uint n = 0; n < n_lists; ++n)
+        dma_sg_validate(&list, NULL);
+    uint64_t validate_us = time_us_64() - start;
+    printf("Building: %u ns per block, validating: %u ns per block\n",
+           (uint) (build_us * 1000 / (n_lists * MAX_BLOCKS)), (uint) (validate_us * 1000 / (n_lists * MAX_BLOCKS)));
+}
+
+int main() {
+#ifndef uart_default
+#warning dma/scatter_gather example requires a UART
+#else
+    stdio_init_all();
+    puts("DMA scatter-gather example:");
+
+    sg_engine_init(&engine);
+    uintptr_t uart_fifo = (uintptr_t) &uart_get_hw(uart_default)->dr;
+    uint uart_dreq = uart_get_dreq(uart_default, true);
+
+    // Gather, as in the control_blocks example: each block loads a length
+    // and read address, and the write address stays on the UART
+    const dma_sg_block_t gather_base = {
+            .write = uart_fifo,
+            .xfer = {.size = 1, .incr_read = true, .dreq = uart_dreq},
+    };
+    dma_sg_list_init(&list, DMA_SG_COUNT_READ, &gather_base, list_words, list_blocks, MAX_BLOCKS, NULL, NULL);
+    for (uint i = 0; i < count_of(words); ++i)
+        dma_sg_add(&list, (uintptr_t) words[i], 0, strlen(words[i]), NULL);
+    dma_sg_finish(&list);
+    sim_t sim = {.fifo = {uart_fifo}};
+    if (!check_list("Gather", &sim))
+        return 1;
+    printf("Simulated output: %.*s", (int) sim.stream_len[0], sim.stream[0]);
+    uart_default_tx_wait_blocking();
+    sg_engine_start(&engine, &list, on_done, NULL);
+    wait_for_engine();
+
+    // Different transfer sizes, DREQs and destinations in one list
+    spi_init(spi0, 1000 * 1000);
+    uintptr_t spi_fifo = (uintptr_t) &spi_get_hw(spi0)->dr;
+    const dma_sg_xfer_t to_uart = {.size = 1, .incr_read = true, .dreq = uart_dreq};
+    const dma_sg_xfer_t ring_to_uart = {.size = 1, .incr_read = true, .ring_bits = 4, .dreq = uart_dreq};
+    const dma_sg_xfer_t copy_words = {.size = 4, .incr_read = true, .incr_write = true, .dreq = DMA_SG_DREQ_FORCE};
+    const dma_sg_xfer_t to_spi = {.size = 1, .incr_read = true, .dreq = spi_get_dreq(spi0, true)};
+    static const char header[] = "Full control blocks: ";
+    static const char newline[] = "\n";
+    dma_sg_list_init(&list, DMA_SG_FULL, &gather_base, list_words, list_blocks, MAX_BLOCKS, encode_ctrl, &engine);
+    dma_sg_add(&list, (uintptr_t) header, uart_fifo, strlen(header), &to_uart);
+    dma_sg_add(&list, (uintptr_t) ring_pattern, uart_fifo, 40, &ring_to_uart);
+    dma_sg_add(&list, (uintptr_t) newline, uart_fifo, 1, &to_uart);
+    dma_sg_add(&list, (uintptr_t) table, (uintptr_t) copy_dest, count_of(table), &copy_words);
+    dma_sg_add(&list, (uintptr_t) spi_message, spi_fifo, strlen(spi_message), &to_spi);
+    dma_sg_finish(&list);
+    sim = (sim_t) {.fifo = {uart_fifo, spi_fifo}, .mem_base = (uintptr_t) copy_dest, .shadow = shadow,
+                   .mem_size = sizeof(copy_dest)};
+    if (!check_list("Full", &sim))
+        return 1;
+    uart_default_tx_wait_blocking();
+    sg_engine_start(&engine, &list, on_done, NULL);
+    wait_for_engine();
+    printf("Memory copy %s the simulation, %u bytes to SPI predicted\n",
+           memcmp(copy_dest, shadow, sizeof(shadow)) ? "DIFFERS FROM" : "matches", sim.stream_len[1]);
+
+    benchmark_build();
+    printf("%u lists completed. DMA finished.\n", lists_done);
+#endif
+}
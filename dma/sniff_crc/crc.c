@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "crc.h"
+
+const crc_params_t crc_params_crc32 = {
+        .name = "CRC-32", .width = 32, .reflect = true, .poly = 0x04c11db7,
+        .init = 0xffffffff, .xorout = 0xffffffff, .check = 0xcbf43926,
+};
+
+const crc_params_t crc_params_crc32c = {
+        .name = "CRC-32C", .width = 32, .reflect = true, .poly = 0x1edc6f41,
+        .init = 0xffffffff, .xorout = 0xffffffff, .check = 0xe3069283,
+};
+
+// Also known as CRC-16/IBM-3740
+const crc_params_t crc_params_crc16_ccitt = {
+        .name = "CRC-16/CCITT-FALSE", .width = 16, .reflect = false, .poly = 0x1021,
+        .init = 0xffff, .xorout = 0, .check = 0x29b1,
+};
+
+// Also known as CRC-8/SMBUS
+const crc_params_t crc_params_crc8 = {
+        .name = "CRC-8", .width = 8, .reflect = false, .poly = 0x07,
+        .init = 0, .xorout = 0, .check = 0xf4,
+};
+
+static uint32_t reverse_bits(uint32_t x, unsigned int width) {
+    uint32_t r = 0;
+    for (unsigned int i = 0; i < width; ++i, x >>= 1)
+        r = (r << 1) | (x & 1u);
+    return r;
+}
+
+static inline uint32_t load_le32(const uint8_t *p) {
+    return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline uint32_t load_be32(const uint8_t *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+// Polynomial in working form: reflected, or shifted to the top
+static uint32_t working_poly(const crc_params_t *params) {
+    return params->reflect ? reverse_bits(params->poly, params->width) : params->poly << (32 - params->width);
+}
+
+void crc_init(crc_t *crc, const crc_params_t *params) {
+    crc->params = params;
+    uint32_t poly = working_poly(params);
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t r;
+        if (params->reflect) {
+            r = b;
+            for (unsigned int bit = 0; bit < 8; ++bit)
+                r = (r >> 1) ^ ((r & 1u) ? poly : 0);
+        } else {
+            r = b << 24;
+            for (unsigned int bit = 0; bit < 8; ++bit)
+                r = (r << 1) ^ ((r & 0x80000000u) ? poly : 0);
+        }
+        crc->table[0][b] = r;
+    }
+    // table[k][b] is the effect of byte b followed by k zero bytes
+    for (unsigned int k = 1; k < 8; ++k) {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t r = crc->table[k - 1][b];
+            if (params->reflect)
+                crc->table[k][b] = (r >> 8) ^ crc->table[0][r & 0xff];
+            else
+                crc->table[k][b] = (r << 8) ^ crc->table[0][r >> 24];
+        }
+    }
+}
+
+uint32_t crc_start(const crc_t *crc) {
+    const crc_params_t *params = crc->params;
+    return params->reflect ? reverse_bits(params->init, params->width) : params->init << (32 - params->width);
+}
+
+uint32_t crc_finish(const crc_t *crc, uint32_t state) {
+    const crc_params_t *params = crc->params;
+    // A reflected CRC's output is the reflected register, which is the state
+    uint32_t value = params->reflect ? state : state >> (32 - params->width);
+    return value ^ params->xorout;
+}
+
+uint32_t crc_update_bitwise(const crc_t *crc, uint32_t state, const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint32_t poly = working_poly(crc->params);
+    if (crc->params->reflect) {
+        while (len--) {
+            state ^= *p++;
+            for (unsigned int bit = 0; bit < 8; ++bit)
+                state = (state >> 1) ^ ((state & 1u) ? poly : 0);
+        }
+    } else {
+        while (len--) {
+            state ^= (uint32_t) *p++ << 24;
+            for (unsigned int bit = 0; bit < 8; ++bit)
+                state = (state << 1) ^ ((state & 0x80000000u) ? poly : 0);
+        }
+    }
+    return state;
+}
+
+uint32_t crc_update_bytewise(const crc_t *crc, uint32_t state, const void *data, size_t len) {
+    const uint8_t *p = data;
+    const uint32_t *t = crc->table[0];
+    if (crc->params->reflect) {
+        while (len--)
+            state = (state >> 8) ^ t[(state ^ *p++) & 0xff];
+    } else {
+        while (len--)
+            state = (state << 8) ^ t[(state >> 24) ^ *p++];
+    }
+    return state;
+}
+
+uint32_t crc_update(const crc_t *crc, uint32_t state, const void *data, size_t len) {
+    const uint8_t *p = data;
+    const uint32_t (*t)[256] = crc->table;
+    if (crc->params->reflect) {
+        for (; len >= 8; len -= 8, p += 8) {
+            uint32_t a = state ^ load_le32(p), b = load_le32(p + 4);
+            state = t[7][a & 0xff] ^ t[6][(a >> 8) & 0xff] ^ t[5][(a >> 16) & 0xff] ^ t[4][a >> 24] ^
+                    t[3][b & 0xff] ^ t[2][(b >> 8) & 0xff] ^ t[1][(b >> 16) & 0xff] ^ t[0][b >> 24];
+        }
+    } else {
+        for (; len >= 8; len -= 8, p += 8) {
+            uint32_t a = state ^ load_be32(p), b = load_be32(p + 4);
+            state = t[7][a >> 24] ^ t[6][(a >> 16) & 0xff] ^ t[5][(a >> 8) & 0xff] ^ t[4][a & 0xff] ^
+                    t[3][b >> 24] ^ t[2][(b >> 16) & 0xff] ^ t[1][(b >> 8) & 0xff] ^ t[0][b & 0xff];
+        }
+    }
+    return crc_update_bytewise(crc, state, p, len);
+}
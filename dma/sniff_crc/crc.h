@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _CRC_H
+#define _CRC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Table-driven CRCs of up to 32 bits.
+//
+// A CRC is described by its parameters (as in the "Catalogue of parametrised
+// CRC algorithms"), and crc_init() builds eight 256-entry tables for it. The
+// CRC can then be calculated a bit at a time, a byte at a time with one
+// table, or eight bytes at a time with all eight ("slice-by-8").
+//
+// For streaming, crc_start() gives the initial state, crc_update() can be
+// called on each piece of data in turn, and crc_finish() turns the state into
+// the CRC value. Between those calls, the state is kept in a working form:
+// for reflected CRCs it is the bit-reversed register, and for others the
+// register shifted to the top of 32 bits. Either way, the working form is what
+// the DMA sniffer's accumulator holds (see crc_sniff.h).
+
+typedef struct {
+    const char *name;
+    uint8_t width;
+    bool reflect;
+    uint32_t poly;
+    uint32_t init;
+    uint32_t xorout;
+    // CRC of the ASCII string "123456789"
+    uint32_t check;
+} crc_params_t;
+
+extern const crc_params_t crc_params_crc32;
+extern const crc_params_t crc_params_crc32c;
+extern const crc_params_t crc_params_crc16_ccitt;
+extern const crc_params_t crc_params_crc8;
+
+typedef struct {
+    const crc_params_t *params;
+    uint32_t table[8][256];
+} crc_t;
+
+void crc_init(crc_t *crc, const crc_params_t *params);
+
+uint32_t crc_start(const crc_t *crc);
+
+// Slice-by-8
+uint32_t crc_update(const crc_t *crc, uint32_t state, const void *data, size_t len);
+
+// One table lookup per byte
+uint32_t crc_update_bytewise(const crc_t *crc, uint32_t state, const void *data, size_t len);
+
+// One bit at a time, with no tables
+uint32_t crc_update_bitwise(const crc_t *crc, uint32_t state, const void *data, size_t len);
+
+uint32_t crc_finish(const crc_t *crc, uint32_t state);
+
+static inline uint32_t crc_compute(const crc_t *crc, const void *data, size_t len) {
+    return crc_finish(crc, crc_update(crc, crc_start(crc), data, len));
+}
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// CRC library example.
+//
+// sniff_crc calculates a CRC-32 one bit at a time to check the DMA sniffer.
+// This example uses crc.h, which calculates CRC-32, CRC-32C, CRC-16-CCITT and
+// CRC-8 a bit, a byte or eight bytes at a time, and crc_sniff.h, which hands
+// the CRC to the DMA sniffer when the data is being copied by the DMA anyway.
+//
+// We check every method against the standard check values, and against each
+// other on random data split into random pieces, then measure the throughput
+// of each.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+
+#include "crc.h"
+#include "crc_sniff.h"
+
+#define BUF_LEN (16 * 1024)
+
+static const crc_params_t *const all_params[] = {
+        &crc_params_crc32,
+        &crc_params_crc32c,
+        &crc_params_crc16_ccitt,
+        &crc_params_crc8,
+};
+
+static crc_t crcs[count_of(all_params)];
+
+static uint8_t src[BUF_LEN] __attribute__((aligned(4)));
+static uint8_t dst[BUF_LEN] __attribute__((aligned(4)));
+
+typedef uint32_t (*crc_update_fn)(const crc_t *crc, uint32_t state, const void *data, size_t len);
+
+static const struct {
+    const char *name;
+    crc_update_fn update;
+} methods[] = {
+        {"bitwise", crc_update_bitwise},
+        {"bytewise", crc_update_bytewise},
+        {"slice-by-8", crc_update},
+};
+
+static bool check_vectors(const crc_t *crc) {
+    bool ok = true;
+    for (uint m = 0; m < count_of(methods); ++m) {
+        uint32_t value = crc_finish(crc, methods[m].update(crc, crc_start(crc), "123456789", 9));
+        if (value != crc->params->check) {
+            printf("%s %s: got 0x%08x, expected 0x%08x\n", crc->params->name, methods[m].name, value,
+                   crc->params->check);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Feed the buffer in random sized pieces, using a random method for each, and
+// check the result matches doing it all at once
+static bool check_streaming(const crc_t *crc, uint dma_chan) {
+    uint32_t expected = crc_compute(crc, src, BUF_LEN);
+    uint32_t state = crc_start(crc);
+    size_t pos = 0;
+    while (pos < BUF_LEN) {
+        size_t len = 1 + rand() % 1500;
+        if (len > BUF_LEN - pos)
+            len = BUF_LEN - pos;
+        uint m = rand() % (count_of(methods) + 1);
+        if (m < count_of(methods)) {
+            state = methods[m].update(crc, state, src + pos, len);
+        } else {
+            // The copy must be complete, as well as the CRC right
+            memset(dst + pos, 0, len);
+            state = crc_update_dma_copy(crc, state, dma_chan, dst + pos, src + pos, len);
+            if (memcmp(dst + pos, src + pos, len)) {
+                printf("%s streaming: DMA copy of %u bytes at %u is wrong\n", crc->params->name, (uint) len,
+                       (uint) pos);
+                return false;
+            }
+        }
+        pos += len;
+    }
+    uint32_t value = crc_finish(crc, state);
+    if (value != expected)
+        printf("%s streaming: got 0x%08x, expected 0x%08x\n", crc->params->name, value, expected);
+    return value == expected;
+}
+
+static void benchmark(const crc_t *crc, uint dma_chan) {
+    printf("%s:\n", crc->params->name);
+    for (uint m = 0; m < count_of(methods); ++m) {
+        uint64_t start = time_us_64();
+        methods[m].update(crc, crc_start(crc), src, BUF_LEN);
+        uint64_t t = time_us_64() - start;
+        printf("  %-11s %6.2f MB/s\n", methods[m].name, (float) BUF_LEN / (float) t);
+    }
+    uint64_t start = time_us_64();
+    crc_update_dma_copy(crc, crc_start(crc), dma_chan, dst, src, BUF_LEN);
+    uint64_t t = time_us_64() - start;
+    printf("  %-11s %6.2f MB/s, including the copy%s\n", "DMA", (float) BUF_LEN / (float) t,
+           crc_sniff_supported(crc->params) ? "" : " (in software)");
+}
+
+int main() {
+    stdio_init_all();
+    printf("CRC library example\n");
+
+    for (uint i = 0; i < BUF_LEN; ++i)
+        src[i] = (uint8_t) rand();
+    uint dma_chan = dma_claim_unused_channel(true);
+
+    bool ok = true;
+    for (uint i = 0; i < count_of(all_params); ++i) {
+        crc_init(&crcs[i], all_params[i]);
+        ok &= check_vectors(&crcs[i]);
+        ok &= check_streaming(&crcs[i], dma_chan);
+    }
+    printf(ok ? "All CRC checks passed\n" : "ERROR - CRC checks FAILED!\n");
+
+    for (uint i = 0; i < count_of(all_params); ++i)
+        benchmark(&crcs[i], dma_chan);
+}
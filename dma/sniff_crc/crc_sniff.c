@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+
+#include "crc_sniff.h"
+
+#define CRC32_POLY 0x04c11db7
+#define CRC16_CCITT_POLY 0x1021
+
+static uint32_t reverse32(uint32_t x) {
+    x = (x >> 16) | (x << 16);
+    x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+    x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    return ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+}
+
+bool crc_sniff_supported(const crc_params_t *params) {
+    if (params->width == 32 && params->poly == CRC32_POLY)
+        return true;
+    return params->width == 16 && params->poly == CRC16_CCITT_POLY && !params->reflect;
+}
+
+bool crc_sniff_start(const crc_t *crc, uint channel, enum dma_channel_transfer_size size, uint32_t state) {
+    const crc_params_t *params = crc->params;
+    if (!crc_sniff_supported(params))
+        return false;
+    uint mode;
+    if (params->width == 16) {
+        // The accumulator holds the register in its low 16 bits
+        mode = DMA_SNIFF_CTRL_CALC_VALUE_CRC16;
+        dma_sniffer_set_data_accumulator(state >> 16);
+    } else if (params->reflect) {
+        // The accumulator holds the register unreflected, and the output
+        // reverse turns it back into our working form when read
+        mode = DMA_SNIFF_CTRL_CALC_VALUE_CRC32R;
+        dma_sniffer_set_data_accumulator(reverse32(state));
+    } else {
+        mode = DMA_SNIFF_CTRL_CALC_VALUE_CRC32;
+        dma_sniffer_set_data_accumulator(state);
+    }
+    dma_sniffer_set_output_reverse_enabled(params->width == 32 && params->reflect);
+    dma_sniffer_set_output_invert_enabled(false);
+    // Unreflected CRCs take each word most significant bit first, so the bytes
+    // of wider transfers must be swapped to go in memory order
+    dma_sniffer_set_byte_swap_enabled(!params->reflect && size != DMA_SIZE_8);
+    dma_sniffer_enable(channel, mode, false);
+    return true;
+}
+
+uint32_t crc_sniff_state(const crc_t *crc) {
+    uint32_t acc = dma_sniffer_get_data_accumulator();
+    return crc->params->width == 16 ? (acc & 0xffff) << 16 : acc;
+}
+
+void crc_sniff_stop(void) {
+    dma_sniffer_disable();
+}
+
+uint32_t crc_update_dma_copy(const crc_t *crc, uint32_t state, uint channel, void *dst, const void *src, size_t len) {
+    bool aligned = !(((uintptr_t) dst | (uintptr_t) src | len) & 3);
+    enum dma_channel_transfer_size size = aligned ? DMA_SIZE_32 : DMA_SIZE_8;
+    dma_channel_config c = dma_channel_get_default_config(channel);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    bool sniff = crc_sniff_supported(crc->params);
+    channel_config_set_sniff_enable(&c, sniff);
+    if (sniff)
+        crc_sniff_start(crc, channel, size, state);
+    dma_channel_configure(channel, &c, dst, src, aligned ? len / 4 : len, true);
+    if (!sniff) {
+        // Do the CRC in software whilst the DMA copies
+        state = crc_update(crc, state, src, len);
+        dma_channel_wait_for_finish_blocking(channel);
+        return state;
+    }
+    dma_channel_wait_for_finish_blocking(channel);
+    state = crc_sniff_state(crc);
+    crc_sniff_stop();
+    return state;
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _CRC_SNIFF_H
+#define _CRC_SNIFF_H
+
+#include "hardware/dma.h"
+#include "crc.h"
+
+// Offload CRCs from crc.h to the DMA sniffer, for data which is being moved
+// by the DMA anyway.
+//
+// The sniffer can calculate CRCs using the CRC-32 polynomial (reflected or
+// not) and the CRC-16-CCITT polynomial (not reflected). The state passed in
+// and returned is the same working form as crc_update() uses, so software and
+// DMA updates can be freely mixed on one stream of data.
+//
+// There is only one sniffer, so only one channel can be sniffed at a time.
+
+bool crc_sniff_supported(const crc_params_t *params);
+
+// Start sniffing channel, from the given state. The channel's config must
+// have sniffing enabled (channel_config_set_sniff_enable()), and transfer
+// the given size. Returns false if the CRC isn't supported.
+bool crc_sniff_start(const crc_t *crc, uint channel, enum dma_channel_transfer_size size, uint32_t state);
+
+// The updated state, once the channel's transfers are complete
+uint32_t crc_sniff_state(const crc_t *crc);
+
+void crc_sniff_stop(void);
+
+// Copy len bytes from src to dst using the DMA channel, and update the CRC
+// state with them. Uses the sniffer if it can, or the slice-by-8 code
+// otherwise. Word-aligned buffers are copied a word at a time.
+uint32_t crc_update_dma_copy(const crc_t *crc, uint32_t state, uint channel, void *dst, const void *src, size_t len);
+
+#endif
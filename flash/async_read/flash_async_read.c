@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Asynchronous flash reads, overlapped with processing of the data.
+//
+// The xip_stream and ssi_dma examples each do a single blocking read. Here a
+// queue of reads of mixed sizes is served by flash_reader.h, using the XIP
+// stream and DMA a chunk at a time, whilst the main loop processes the chunk
+// before. The SSI FIFO route of ssi_dma is faster, but needs the processor to
+// stay out of flash for the whole transfer, so can't overlap with anything.
+//
+// Every chunk is verified, both with a backend which copies from flash with
+// the processor and with the XIP stream. The effective read speed is printed,
+// along with the time saved by overlapping reads with (simulated) work on
+// the data.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/xip_ctrl.h"
+
+#include "flash_reader.h"
+
+// Reads come from the first 256 kB of flash, whatever is there
+#define TEST_REGION_SIZE (256 * 1024)
+#define CHUNK_BYTES 4096
+#define N_REQUESTS 64
+#define MAX_REQUEST_BYTES (16 * 1024)
+// Processing time for each byte read, for the overlap test
+#define WORK_NS_PER_BYTE 40
+
+static const uint8_t *flash_ref = (const uint8_t *) XIP_NOCACHE_NOALLOC_BASE;
+
+static uint32_t chunk_buf[2][CHUNK_BYTES / 4];
+// Every fourth request reads straight into one of these
+static uint32_t dest_buf[4][MAX_REQUEST_BYTES / 4];
+
+static flash_read_req_t reqs[N_REQUESTS];
+static uint mismatches;
+static uint requests_done;
+static bool do_work;
+
+// ----------------------------------------------------------------------------
+// XIP stream backend
+
+static uint stream_dma_chan;
+static dma_channel_config stream_dma_config;
+
+static void xip_stream_start(__unused void *ctx, uint32_t offset, uint32_t *dest, uint32_t words) {
+    while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY))
+        (void) xip_ctrl_hw->stream_fifo;
+    xip_ctrl_hw->stream_addr = XIP_BASE + offset;
+    xip_ctrl_hw->stream_ctr = words;
+    dma_channel_configure(stream_dma_chan, &stream_dma_config, dest, (const void *) XIP_AUX_BASE, words, true);
+}
+
+static bool xip_stream_busy(__unused void *ctx) {
+    return dma_channel_is_busy(stream_dma_chan);
+}
+
+static void xip_stream_backend_init(flash_reader_backend_t *backend) {
+    stream_dma_chan = dma_claim_unused_channel(true);
+    stream_dma_config = dma_channel_get_default_config(stream_dma_chan);
+    channel_config_set_read_increment(&stream_dma_config, false);
+    channel_config_set_write_increment(&stream_dma_config, true);
+    channel_config_set_dreq(&stream_dma_config, DREQ_XIP_STREAM);
+    backend->start = xip_stream_start;
+    backend->busy = xip_stream_busy;
+    backend->ctx = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Requests
+
+static void on_chunk(flash_read_req_t *req, const uint8_t *data, uint32_t offset, uint32_t len) {
+    if (memcmp(data, flash_ref + req->offset + offset, len))
+        ++mismatches;
+    if (do_work)
+        busy_wait_us(len * WORK_NS_PER_BYTE / 1000);
+}
+
+static void on_done(__unused flash_read_req_t *req) {
+    ++requests_done;
+}
+
+static void make_requests() {
+    static const uint32_t sizes[] = {64, 512, 4096, MAX_REQUEST_BYTES};
+    for (uint i = 0; i < N_REQUESTS; ++i) {
+        uint32_t len = sizes[rand() % count_of(sizes)];
+        reqs[i] = (flash_read_req_t) {
+                .offset = (rand() % (TEST_REGION_SIZE - len)) & ~3u,
+                .len = len,
+                // At most 16 requests are queued, so no two of these overlap
+                .dest = i % 4 ? NULL : (uint8_t *) dest_buf[(i % 16) / 4],
+                .on_chunk = on_chunk,
+                .on_done = on_done,
+        };
+    }
+}
+
+// Submit all the requests, keeping the queue topped up, and return the time taken
+static uint64_t run_requests(flash_reader_t *reader) {
+    requests_done = 0;
+    uint submitted = 0;
+    uint64_t start = time_us_64();
+    while (submitted < N_REQUESTS || !flash_reader_idle(reader)) {
+        while (submitted < N_REQUESTS && flash_reader_submit(reader, &reqs[submitted]))
+            ++submitted;
+        flash_reader_poll(reader);
+    }
+    return time_us_64() - start;
+}
+
+static uint32_t total_bytes() {
+    uint32_t bytes = 0;
+    for (uint i = 0; i < N_REQUESTS; ++i)
+        bytes += reqs[i].len;
+    return bytes;
+}
+
+int main() {
+    stdio_init_all();
+    printf("Flash async read example\n");
+
+    if ((uintptr_t) run_requests >= SRAM_BASE) {
+        printf("You need to run this example from flash!\n");
+        exit(-1);
+    }
+
+    make_requests();
+    flash_reader_t reader;
+
+    // Processor copies, to check the scheduling
+    flash_reader_backend_t mem_backend;
+    flash_reader_mem_backend_t mem = {.flash = flash_ref, .flash_size = TEST_REGION_SIZE};
+    flash_reader_mem_backend_init(&mem_backend, &mem);
+    flash_reader_init(&reader, &mem_backend, chunk_buf[0], chunk_buf[1], CHUNK_BYTES);
+    mismatches = 0;
+    run_requests(&reader);
+    printf("Memory backend: %u requests, %u chunks, %s\n", requests_done, (uint) reader.chunks_read,
+           mismatches ? "MISMATCH" : "data ok");
+
+    flash_reader_backend_t xip_backend;
+    xip_stream_backend_init(&xip_backend);
+    flash_reader_init(&reader, &xip_backend, chunk_buf[0], chunk_buf[1], CHUNK_BYTES);
+    mismatches = 0;
+    uint64_t read_us = run_requests(&reader);
+    uint32_t bytes = total_bytes();
+    printf("XIP stream:     %u requests, %u chunks, %s\n", requests_done, (uint) reader.chunks_read,
+           mismatches ? "MISMATCH" : "data ok");
+    printf("Read %u bytes in %u us: %.2f MB/s\n", (uint) bytes, (uint) read_us, (float) bytes / (float) read_us);
+
+    // Now with some work on each chunk, which the next read overlaps with
+    do_work = true;
+    flash_reader_init(&reader, &xip_backend, chunk_buf[0], chunk_buf[1], CHUNK_BYTES);
+    uint64_t overlapped_us = run_requests(&reader);
+    uint64_t work_us = 0;
+    for (uint i = 0; i < N_REQUESTS; ++i)
+        for (uint32_t offset = 0; offset < reqs[i].len; offset += CHUNK_BYTES)
+            work_us += MIN(CHUNK_BYTES, reqs[i].len - offset) * WORK_NS_PER_BYTE / 1000;
+    printf("With %u ns/byte of work: %u us overlapped, %u us one after the other, %.2f MB/s effective\n",
+           WORK_NS_PER_BYTE, (uint) overlapped_us, (uint) (read_us + work_us),
+           (float) bytes / (float) overlapped_us);
+}
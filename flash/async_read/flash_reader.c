@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "flash_reader.h"
+
+void flash_reader_init(flash_reader_t *reader, const flash_reader_backend_t *backend, uint32_t *buf0,
+                       uint32_t *buf1, uint32_t chunk_bytes) {
+    memset(reader, 0, sizeof(*reader));
+    reader->backend = *backend;
+    reader->buf[0] = buf0;
+    reader->buf[1] = buf1;
+    reader->chunk_bytes = chunk_bytes & ~3u;
+    reader->filling = -1;
+}
+
+bool flash_reader_submit(flash_reader_t *reader, flash_read_req_t *req) {
+    if (reader->queue_count == FLASH_READER_QUEUE_LEN || ((req->offset | req->len) & 3u) ||
+        ((uintptr_t) req->dest & 3u))
+        return false;
+    req->issued = 0;
+    req->consumed = 0;
+    reader->queue[(reader->queue_head + reader->queue_count++) % FLASH_READER_QUEUE_LEN] = req;
+    return true;
+}
+
+bool flash_reader_idle(const flash_reader_t *reader) {
+    return !reader->queue_count;
+}
+
+// The first queued request with bytes left to start
+static flash_read_req_t *next_to_issue(flash_reader_t *reader) {
+    for (uint32_t i = 0; i < reader->queue_count; ++i) {
+        flash_read_req_t *req = reader->queue[(reader->queue_head + i) % FLASH_READER_QUEUE_LEN];
+        if (req->issued < req->len)
+            return req;
+    }
+    return NULL;
+}
+
+static void finish_transfer(flash_reader_t *reader) {
+    if (reader->filling >= 0 && !reader->backend.busy(reader->backend.ctx)) {
+        flash_reader_slot_t *slot = &reader->slots[reader->filling];
+        slot->full = true;
+        reader->bytes_read += slot->len;
+        ++reader->chunks_read;
+        reader->filling = -1;
+    }
+}
+
+static void start_transfer(flash_reader_t *reader) {
+    finish_transfer(reader);
+    if (reader->filling >= 0 || reader->n_slots_used == 2)
+        return;
+    flash_read_req_t *req = next_to_issue(reader);
+    if (!req)
+        return;
+    int s = (int) ((reader->oldest + reader->n_slots_used) % 2);
+    flash_reader_slot_t *slot = &reader->slots[s];
+    slot->req = req;
+    slot->offset = req->issued;
+    slot->len = req->len - req->issued;
+    if (slot->len > reader->chunk_bytes)
+        slot->len = reader->chunk_bytes;
+    slot->data = req->dest ? req->dest + req->issued : (const uint8_t *) reader->buf[s];
+    slot->full = false;
+    req->issued += slot->len;
+    ++reader->n_slots_used;
+    reader->filling = s;
+    reader->backend.start(reader->backend.ctx, req->offset + slot->offset, (uint32_t *) slot->data, slot->len / 4);
+    // A backend may finish straight away
+    finish_transfer(reader);
+}
+
+static void complete_head(flash_reader_t *reader) {
+    flash_read_req_t *req = reader->queue[reader->queue_head];
+    reader->queue_head = (reader->queue_head + 1) % FLASH_READER_QUEUE_LEN;
+    --reader->queue_count;
+    if (req->on_done)
+        req->on_done(req);
+}
+
+// Zero length requests have nothing to transfer, so they complete as soon as
+// they reach the head of the queue
+static void complete_empty_heads(flash_reader_t *reader) {
+    while (reader->queue_count && !reader->queue[reader->queue_head]->len)
+        complete_head(reader);
+}
+
+void flash_reader_poll(flash_reader_t *reader) {
+    complete_empty_heads(reader);
+    start_transfer(reader);
+    while (reader->n_slots_used && reader->slots[reader->oldest].full) {
+        flash_reader_slot_t *slot = &reader->slots[reader->oldest];
+        flash_read_req_t *req = slot->req;
+        // Keep the backend busy while the chunk is consumed
+        start_transfer(reader);
+        if (req->on_chunk)
+            req->on_chunk(req, slot->data, slot->offset, slot->len);
+        req->consumed += slot->len;
+        slot->full = false;
+        reader->oldest ^= 1;
+        --reader->n_slots_used;
+        if (req->consumed == req->len) {
+            // Requests complete in order, and any empty ones before this were
+            // completed along with the one before them, so this is the head
+            complete_head(reader);
+            complete_empty_heads(reader);
+        }
+        start_transfer(reader);
+    }
+}
+
+static void mem_start(void *ctx, uint32_t offset, uint32_t *dest, uint32_t words) {
+    flash_reader_mem_backend_t *mem = (flash_reader_mem_backend_t *) ctx;
+    uint32_t bytes = words * 4;
+    if (offset < mem->flash_size) {
+        uint32_t n = mem->flash_size - offset < bytes ? mem->flash_size - offset : bytes;
+        memcpy(dest, mem->flash + offset, n);
+        // Unprogrammed flash reads as ones
+        memset((uint8_t *) dest + n, 0xff, bytes - n);
+    } else {
+        memset(dest, 0xff, bytes);
+    }
+    ++mem->transfers;
+    if (mem->bytes_per_us)
+        mem->done_at_us = mem->now_us() + mem->setup_us + bytes / mem->bytes_per_us;
+}
+
+static bool mem_busy(void *ctx) {
+    const flash_reader_mem_backend_t *mem = (const flash_reader_mem_backend_t *) ctx;
+    return mem->bytes_per_us && mem->now_us() < mem->done_at_us;
+}
+
+void flash_reader_mem_backend_init(flash_reader_backend_t *backend, flash_reader_mem_backend_t *mem) {
+    mem->done_at_us = 0;
+    mem->transfers = 0;
+    backend->start = mem_start;
+    backend->busy = mem_busy;
+    backend->ctx = mem;
+}
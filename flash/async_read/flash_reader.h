@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _FLASH_READER_H
+#define _FLASH_READER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Queue of asynchronous flash reads, streamed a chunk at a time.
+//
+// Requests are served in order, each split into chunks of at most
+// chunk_bytes. A read either goes straight to its destination, or, if it has
+// none, into one of the reader's two chunk buffers, for its on_chunk function
+// to consume (e.g. to decode an image or fill an audio buffer). Either way
+// on_chunk is called as each chunk arrives.
+//
+// Everything happens in flash_reader_poll(), which should be called often
+// from the main loop. It starts the next transfer before calling on_chunk,
+// so one chunk is being read while the previous one is consumed, and again
+// afterwards, so the backend is never idle whilst there is work queued.
+//
+// The backend does the transfers, e.g. with the XIP stream and DMA, or with
+// memcpy (see flash_reader_mem_backend_init()). Addresses and lengths must be
+// multiples of 4 bytes.
+
+#define FLASH_READER_QUEUE_LEN 16
+
+typedef struct flash_read_req flash_read_req_t;
+
+// data points at the chunk, which is offset bytes into the request
+typedef void (*flash_read_chunk_fn)(flash_read_req_t *req, const uint8_t *data, uint32_t offset, uint32_t len);
+typedef void (*flash_read_done_fn)(flash_read_req_t *req);
+
+struct flash_read_req {
+    // Offset into flash
+    uint32_t offset;
+    uint32_t len;
+    // NULL to read into the chunk buffers
+    uint8_t *dest;
+    flash_read_chunk_fn on_chunk;
+    flash_read_done_fn on_done;
+    void *user;
+    // Bytes started and consumed, used by the reader
+    uint32_t issued;
+    uint32_t consumed;
+};
+
+typedef struct {
+    // Start reading words from a flash offset
+    void (*start)(void *ctx, uint32_t offset, uint32_t *dest, uint32_t words);
+    bool (*busy)(void *ctx);
+    void *ctx;
+} flash_reader_backend_t;
+
+typedef struct {
+    flash_read_req_t *req;
+    uint32_t offset;
+    uint32_t len;
+    const uint8_t *data;
+    bool full;
+} flash_reader_slot_t;
+
+typedef struct {
+    flash_reader_backend_t backend;
+    uint32_t *buf[2];
+    uint32_t chunk_bytes;
+    flash_read_req_t *queue[FLASH_READER_QUEUE_LEN];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    // Chunks in order: slots[oldest] is delivered first
+    flash_reader_slot_t slots[2];
+    uint32_t oldest;
+    uint32_t n_slots_used;
+    // The slot the backend is filling, or -1
+    int filling;
+    uint64_t bytes_read;
+    uint32_t chunks_read;
+} flash_reader_t;
+
+// buf0 and buf1 are chunk_bytes each, chunk_bytes a multiple of 4
+void flash_reader_init(flash_reader_t *reader, const flash_reader_backend_t *backend, uint32_t *buf0,
+                       uint32_t *buf1, uint32_t chunk_bytes);
+
+// Queue a read. Returns false if the queue is full or the request isn't
+// word aligned. req must stay valid until its on_done is called.
+bool flash_reader_submit(flash_reader_t *reader, flash_read_req_t *req);
+
+// Move things along, calling on_chunk and on_done as needed
+void flash_reader_poll(flash_reader_t *reader);
+
+// No requests queued or in progress
+bool flash_reader_idle(const flash_reader_t *reader);
+
+// A backend that copies from memory, finishing each transfer as it starts
+// it, or, with a non-zero bytes_per_us, after the time the transfer would
+// take at that speed by the given clock.
+typedef struct {
+    const uint8_t *flash;
+    uint32_t flash_size;
+    uint32_t bytes_per_us;
+    uint32_t setup_us;
+    uint64_t (*now_us)(void);
+    uint64_t done_at_us;
+    uint32_t transfers;
+} flash_reader_mem_backend_t;
+
+void flash_reader_mem_backend_init(flash_reader_backend_t *backend, flash_reader_mem_backend_t *mem);
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the asynchronous flash reader (flash_reader.h), run on the host
+// against the memory backend. Build with PICO_PLATFORM=host.
+//
+// Requests of all lengths, including zero and past the end of the flash,
+// some into their own buffers and some through the chunk buffers, must each
+// deliver their chunks in order and complete in the order they were
+// submitted, with every byte as in the flash. This is done with a backend
+// which finishes each transfer at once, and with one which takes time by a
+// simulated clock, where the next chunk must be being read while each one is
+// consumed. Misaligned requests and a full queue must be refused.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "flash_reader.h"
+
+#define FLASH_SIZE (64 * 1024)
+#define CHUNK_BYTES 256
+#define MAX_REQ_BYTES 4096
+
+static uint8_t flash[FLASH_SIZE];
+static uint32_t chunk_buf[2][CHUNK_BYTES / 4];
+
+typedef struct {
+    flash_read_req_t req;
+    uint32_t dest_buf[MAX_REQ_BYTES / 4];
+    uint8_t received[MAX_REQ_BYTES];
+    uint32_t next_offset;
+    uint32_t chunks;
+    bool done;
+} test_req_t;
+
+static test_req_t reqs[FLASH_READER_QUEUE_LEN];
+static uint32_t done_order[FLASH_READER_QUEUE_LEN];
+static uint32_t n_done;
+
+static flash_reader_t reader;
+static flash_reader_mem_backend_t mem;
+
+static uint64_t fake_time_us;
+
+// The clock moves on a little every time it's looked at
+static uint64_t fake_now_us(void) {
+    return fake_time_us++;
+}
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static uint32_t chunks_consumed;
+static uint32_t total_chunks;
+
+static void on_chunk(flash_read_req_t *req, const uint8_t *data, uint32_t offset, uint32_t len) {
+    test_req_t *t = (test_req_t *) req->user;
+    check(offset == t->next_offset && len && len <= CHUNK_BYTES && offset + len <= req->len, "Chunk order");
+    check(!req->dest || data == req->dest + offset, "Chunk address");
+    memcpy(t->received + offset, data, len);
+    t->next_offset = offset + len;
+    ++t->chunks;
+    ++chunks_consumed;
+    // The next chunk has been started (or read already) before this one is
+    // consumed
+    if (chunks_consumed < total_chunks)
+        check(mem.transfers > chunks_consumed, "Overlap of reading and consuming");
+}
+
+static void on_done(flash_read_req_t *req) {
+    test_req_t *t = (test_req_t *) req->user;
+    check(!t->done && t->next_offset == req->len, "Completion after every chunk");
+    t->done = true;
+    done_order[n_done++] = (uint32_t) (t - reqs);
+}
+
+static void make_req(uint i, uint32_t offset, uint32_t len, bool own_buffer) {
+    test_req_t *t = &reqs[i];
+    memset(t, 0, sizeof(*t));
+    t->req = (flash_read_req_t) {.offset = offset, .len = len, .dest = own_buffer ? (uint8_t *) t->dest_buf : NULL,
+                                 .on_chunk = on_chunk, .on_done = on_done, .user = t};
+}
+
+// The bytes a request should have got, with unprogrammed flash as ones
+static bool received_ok(const test_req_t *t) {
+    for (uint32_t i = 0; i < t->req.len; ++i) {
+        uint8_t expected = t->req.offset + i < FLASH_SIZE ? flash[t->req.offset + i] : 0xff;
+        if (t->received[i] != expected || (t->req.dest && t->req.dest[i] != expected))
+            return false;
+    }
+    return true;
+}
+
+static void run_reqs(uint n_reqs) {
+    n_done = 0;
+    chunks_consumed = 0;
+    total_chunks = 0;
+    for (uint i = 0; i < n_reqs; ++i) {
+        check(flash_reader_submit(&reader, &reqs[i].req), "Submitting a request");
+        total_chunks += (reqs[i].req.len + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    }
+    for (uint polls = 0; !flash_reader_idle(&reader) && polls < 1000000; ++polls)
+        flash_reader_poll(&reader);
+    check(flash_reader_idle(&reader), "Finishing every request");
+    check(n_done == n_reqs, "Number of requests done");
+    for (uint i = 0; i < n_done; ++i)
+        check(done_order[i] == i, "Completion order");
+    for (uint i = 0; i < n_reqs; ++i) {
+        check(received_ok(&reqs[i]), "Data read");
+        check(reqs[i].chunks == (reqs[i].req.len + CHUNK_BYTES - 1) / CHUNK_BYTES, "Number of chunks");
+    }
+}
+
+static void init_reader(uint32_t bytes_per_us) {
+    flash_reader_backend_t backend;
+    mem = (flash_reader_mem_backend_t) {.flash = flash, .flash_size = FLASH_SIZE, .bytes_per_us = bytes_per_us,
+                                        .setup_us = bytes_per_us ? 3 : 0, .now_us = fake_now_us};
+    flash_reader_mem_backend_init(&backend, &mem);
+    flash_reader_init(&reader, &backend, chunk_buf[0], chunk_buf[1], CHUNK_BYTES);
+}
+
+static void check_by_hand(uint32_t bytes_per_us) {
+    init_reader(bytes_per_us);
+    // An empty one at the head, then several chunks into the chunk buffers,
+    // empty ones in the middle, a partial chunk into its own buffer, one
+    // running off the end of the flash, and an empty one to finish
+    make_req(0, 0, 0, false);
+    make_req(1, 1024, 3 * CHUNK_BYTES + 12, false);
+    make_req(2, 8, 0, true);
+    make_req(3, 16, 0, false);
+    make_req(4, 4096, 100, true);
+    make_req(5, FLASH_SIZE - 64, 512, false);
+    make_req(6, 0, 0, true);
+    run_reqs(7);
+    check(reader.bytes_read == 3 * CHUNK_BYTES + 12 + 100 + 512, "Bytes read");
+    check(reader.chunks_read == 4 + 1 + 2 && mem.transfers == reader.chunks_read, "Chunks read");
+
+    // Only empty requests
+    make_req(0, 0, 0, false);
+    make_req(1, 4, 0, true);
+    run_reqs(2);
+}
+
+static void check_refused(void) {
+    init_reader(0);
+    make_req(0, 2, 8, false);
+    check(!flash_reader_submit(&reader, &reqs[0].req), "Refusing an unaligned offset");
+    make_req(0, 0, 6, false);
+    check(!flash_reader_submit(&reader, &reqs[0].req), "Refusing an unaligned length");
+    make_req(0, 0, 8, true);
+    reqs[0].req.dest += 2;
+    check(!flash_reader_submit(&reader, &reqs[0].req), "Refusing an unaligned destination");
+    check(flash_reader_idle(&reader), "Idle after refusing");
+
+    n_done = 0;
+    for (uint i = 0; i < FLASH_READER_QUEUE_LEN; ++i) {
+        make_req(i, i * 4, 4, false);
+        check(flash_reader_submit(&reader, &reqs[i].req), "Filling the queue");
+    }
+    flash_read_req_t extra = {.offset = 0, .len = 4};
+    check(!flash_reader_submit(&reader, &extra), "Refusing a request when the queue is full");
+    while (!flash_reader_idle(&reader))
+        flash_reader_poll(&reader);
+    check(n_done == FLASH_READER_QUEUE_LEN, "Requests done after filling the queue");
+}
+
+static void check_random(uint n_rounds) {
+    for (uint round = 0; round < n_rounds && !errors; ++round) {
+        init_reader(rand() % 2 ? 0 : 1 + rand() % 64);
+        uint n_reqs = 1 + rand() % FLASH_READER_QUEUE_LEN;
+        for (uint i = 0; i < n_reqs; ++i) {
+            uint32_t len = rand() % 4 ? 4 * (rand() % (MAX_REQ_BYTES / 4 + 1)) : 4 * (rand() % 4);
+            make_req(i, 4 * (rand() % ((FLASH_SIZE + 1024) / 4)), len, rand() & 1);
+        }
+        run_reqs(n_reqs);
+    }
+}
+
+int main() {
+    printf("Flash reader host tests, against the memory backend\n");
+    for (uint i = 0; i < FLASH_SIZE; ++i)
+        flash[i] = (uint8_t) rand();
+
+    check_by_hand(0);
+    check_by_hand(16);
+    check_refused();
+    const uint n_rounds = 500;
+    check_random(n_rounds);
+    printf(errors ? "FAILED\n" : "All flash reader checks passed\n");
+    return errors != 0;
+}
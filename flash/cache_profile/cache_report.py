@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+
+# Turns the samples printed by flash_cache_profile into a report of which
+# functions miss the flash cache, and which of them are worth moving into RAM
+# with __not_in_flash_func().
+#
+# The program counters are looked up in the linker map (<program>.elf.map in
+# the build directory), or in the output of `arm-none-eabi-nm -S -n <elf>`.
+#
+# Usage: python3 cache_report.py <map or nm file> <log file> [--ram-budget BYTES] [--top N]
+# eg. python3 cache_report.py build/flash/cache_profile/flash_cache_profile.elf.map profile.log
+#
+# The log may contain several profiles, each from a "# profile" line to a
+# "# end" line. Anything else in it is ignored.
+
+import argparse
+import bisect
+import re
+import sys
+
+FLASH_BASE = 0x10000000
+FLASH_END = 0x20000000
+RAM_BASE = 0x20000000
+
+# Sections holding code, as named in the map
+CODE_SECTION = re.compile(r'^\.(text|time_critical|ram_func)(\.|$)')
+
+
+class Function:
+    def __init__(self, start, size, name, source):
+        self.start = start
+        self.size = size
+        self.name = name
+        self.source = source
+        self.samples = 0
+        self.accesses = 0
+        self.misses = 0
+
+    def in_flash(self):
+        return FLASH_BASE <= self.start < FLASH_END
+
+
+def parse_map(f):
+    # In the memory map part of the file, each input section looks like
+    #
+    #  .text.name     0x10000348       0x24 path/to/file.c.obj
+    #                 0x10000348                name
+    #
+    # where a long section name puts the address on a line of its own, and
+    # static functions have no symbol line, only a section named after them.
+    sections = []
+    in_memory_map = False
+    pending_name = None
+    for line in f:
+        line = line.rstrip('\n')
+        if line.startswith('Linker script and memory map'):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+        m = re.match(r'^ (\.\S+)$', line)
+        if m:
+            pending_name = m.group(1)
+            continue
+        m = re.match(r'^ (\.\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$', line)
+        if m:
+            name = m.group(1) or pending_name
+            pending_name = None
+            sections.append([name, int(m.group(2), 16), int(m.group(3), 16), m.group(4), []])
+            continue
+        pending_name = None
+        m = re.match(r'^\s+0x([0-9a-f]+)\s+([A-Za-z_$][\w$.]*)$', line)
+        if m and sections:
+            sections[-1][4].append((int(m.group(1), 16), m.group(2)))
+
+    functions = []
+    for name, start, size, source, symbols in sections:
+        if not CODE_SECTION.match(name) or not size or not start:
+            continue
+        end = start + size
+        symbols = sorted(s for s in symbols if start <= s[0] < end)
+        if not symbols:
+            # .text.foo or .time_critical.foo holds foo
+            parts = name.split('.', 2)
+            symbols = [(start, parts[2] if len(parts) > 2 else source + ':' + name)]
+        for i, (addr, sym) in enumerate(symbols):
+            sym_end = symbols[i + 1][0] if i + 1 < len(symbols) else end
+            functions.append(Function(addr & ~1, sym_end - addr, sym, source))
+    return functions
+
+
+def parse_nm(f):
+    # "10000348 00000024 T name", from nm -S -n
+    functions = []
+    for line in f:
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in 'tTW':
+            functions.append(Function(int(parts[0], 16) & ~1, int(parts[1], 16), parts[3], ''))
+    return functions
+
+
+def load_symbols(path):
+    with open(path) as f:
+        text = f.read()
+    lines = text.splitlines()
+    if any(l.startswith('Linker script and memory map') for l in lines):
+        functions = parse_map(lines)
+    else:
+        functions = parse_nm(lines)
+    functions.sort(key=lambda fn: fn.start)
+    return functions
+
+
+def parse_log(f):
+    profiles = []
+    current = None
+    for line in f:
+        parts = line.split()
+        if not parts:
+            continue
+        if parts[:2] == ['#', 'profile'] and len(parts) >= 3:
+            current = {'name': parts[2], 'samples': [], 'time_us': None}
+            profiles.append(current)
+        elif parts[0] == 'S' and current is not None and len(parts) == 5:
+            try:
+                current['samples'].append(tuple(int(p, 16 if i == 0 else 10) for i, p in enumerate(parts[1:])))
+            except ValueError:
+                # A line damaged in transit
+                continue
+        elif parts[:2] == ['#', 'end'] and current is not None:
+            fields = dict(zip(parts[3::2], parts[4::2]))
+            if 'time_us' in fields:
+                current['time_us'] = int(fields['time_us'])
+            current = None
+    return profiles
+
+
+def attribute(functions, samples):
+    starts = [fn.start for fn in functions]
+    by_name = {}
+    unknown = Function(0, 0, '<unknown>', '')
+    for fn in functions:
+        fn.samples = fn.accesses = fn.misses = 0
+    for pc, count, accesses, misses in samples:
+        i = bisect.bisect_right(starts, pc) - 1
+        fn = functions[i] if i >= 0 and pc < functions[i].start + max(functions[i].size, 2) else None
+        if fn is None:
+            if pc < FLASH_BASE:
+                fn = by_name.setdefault('<boot rom>', Function(0, 0, '<boot rom>', ''))
+            else:
+                fn = unknown
+        fn.samples += count
+        fn.accesses += accesses
+        fn.misses += misses
+    hit = [fn for fn in functions if fn.samples] + [fn for fn in by_name.values()]
+    if unknown.samples:
+        hit.append(unknown)
+    return hit
+
+
+# Greedily pick the flash functions which save the most misses per byte of
+# RAM, until the budget is used up
+def recommend(functions, total_misses, budget, min_share):
+    candidates = [fn for fn in functions if fn.in_flash() and fn.size and fn.misses >= min_share * total_misses]
+    candidates.sort(key=lambda fn: fn.misses / fn.size, reverse=True)
+    picked = []
+    used = 0
+    for fn in candidates:
+        if used + fn.size <= budget:
+            picked.append(fn)
+            used += fn.size
+    return picked, used
+
+
+def report(profile, functions, budget, top, min_share, out):
+    hit = attribute(functions, profile['samples'])
+    total_samples = sum(fn.samples for fn in hit)
+    total_accesses = sum(fn.accesses for fn in hit)
+    total_misses = sum(fn.misses for fn in hit)
+    print('Profile %s: %d samples, %d XIP accesses, %d misses (%.1f%% hit rate)%s' % (
+        profile['name'], total_samples, total_accesses, total_misses,
+        100.0 * (total_accesses - total_misses) / total_accesses if total_accesses else 0.0,
+        ', %d us' % profile['time_us'] if profile['time_us'] is not None else ''), file=out)
+    if not total_samples:
+        return
+
+    hit.sort(key=lambda fn: (fn.misses, fn.samples), reverse=True)
+    print('  %8s %7s %8s %7s %6s %-6s %s' % ('misses', '% miss', 'miss/smp', '% time', 'size', 'where', 'function'),
+          file=out)
+    for fn in hit[:top]:
+        where = 'flash' if fn.in_flash() else 'ram' if fn.start >= RAM_BASE else '-'
+        print('  %8d %6.1f%% %8.2f %6.1f%% %6s %-6s %s' % (
+            fn.misses, 100.0 * fn.misses / total_misses if total_misses else 0.0, fn.misses / fn.samples,
+            100.0 * fn.samples / total_samples, fn.size or '-', where, fn.name), file=out)
+
+    picked, used = recommend(hit, total_misses, budget, min_share)
+    if not picked:
+        print('  Nothing worth moving into RAM', file=out)
+        return
+    saved = sum(fn.misses for fn in picked)
+    print('  Moving these into RAM (%d bytes) would remove up to %.0f%% of the misses:' % (
+        used, 100.0 * saved / total_misses), file=out)
+    for fn in picked:
+        # Code from the SDK or C library can't just be annotated
+        note = '' if not fn.source or 'CMakeFiles' in fn.source else '  (from %s)' % fn.source
+        print('    __not_in_flash_func(%s)%s' % (fn.name, note), file=out)
+    print('  Misses are charged to the code running at the time, so some may be its data reads.', file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report on flash_cache_profile samples')
+    parser.add_argument('symbols', help='linker map (.elf.map), or output of nm -S -n')
+    parser.add_argument('log', help='log captured from the serial port, or - for stdin')
+    parser.add_argument('--ram-budget', type=int, default=4096, help='bytes of RAM to spend on code')
+    parser.add_argument('--top', type=int, default=15, help='functions to list')
+    parser.add_argument('--min-share', type=float, default=0.01,
+                        help='smallest fraction of the misses worth moving a function for')
+    args = parser.parse_args()
+
+    functions = load_symbols(args.symbols)
+    if not functions:
+        sys.exit('No functions found in ' + args.symbols)
+    if args.log == '-':
+        profiles = parse_log(sys.stdin)
+    else:
+        with open(args.log, errors='replace') as f:
+            profiles = parse_log(f)
+    if not profiles:
+        sys.exit('No profiles found in ' + args.log)
+    for profile in profiles:
+        report(profile, functions, args.ram_budget, args.top, args.min_share, sys.stdout)
+        print()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Find out which functions are missing the flash cache.
+//
+// The cache_perfctr example reads the XIP cache counters once, around a whole
+// computation. Here a timer interrupt samples them every SAMPLE_PERIOD_US,
+// along with the program counter it interrupted, and the misses since the
+// last sample are charged to that program counter. Afterwards the totals for
+// each program counter are printed, for cache_report.py to look up in the
+// linker map, add up by function, and recommend which functions to move into
+// RAM with __not_in_flash_func().
+//
+// The interrupt handler runs from RAM, so sampling doesn't disturb the cache.
+//
+// To show it working, we run some code whose working set (about 20kB) is
+// larger than the 16kB cache, profile it, then move the three functions the
+// report would pick into RAM and run it again.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/structs/timer.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/timer.h"
+
+#define SAMPLE_PERIOD_US 50
+
+// Program counters with their own totals. Any more go in dropped_samples.
+#define N_PC_SLOTS 1024
+#define MAX_PROBE 16
+
+typedef struct {
+    uint32_t pc;
+    uint32_t samples;
+    uint32_t accesses;
+    uint32_t misses;
+} pc_stats_t;
+
+static pc_stats_t pc_stats[N_PC_SLOTS];
+static uint32_t dropped_samples;
+static uint32_t total_samples;
+static uint32_t last_acc, last_hit;
+static uint alarm_num;
+
+// Called from profile_isr() with the exception stack frame, which holds the
+// interrupted r0-r3, r12, lr, pc and xpsr
+void __not_in_flash_func(cache_profile_sample)(const uint32_t *frame) {
+    timer_hw->intr = 1u << alarm_num;
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + SAMPLE_PERIOD_US;
+
+    uint32_t acc = xip_ctrl_hw->ctr_acc;
+    uint32_t hit = xip_ctrl_hw->ctr_hit;
+    uint32_t accesses = acc - last_acc;
+    uint32_t misses = accesses - (hit - last_hit);
+    last_acc = acc;
+    last_hit = hit;
+
+    uint32_t pc = frame[6];
+    ++total_samples;
+    uint32_t i = ((pc >> 1) * 2654435761u) >> 22;
+    for (uint probe = 0; probe < MAX_PROBE; ++probe, i = (i + 1) % N_PC_SLOTS) {
+        pc_stats_t *s = &pc_stats[i];
+        if (!s->samples)
+            s->pc = pc;
+        if (s->pc == pc) {
+            s->samples++;
+            s->accesses += accesses;
+            s->misses += misses;
+            return;
+        }
+    }
+    ++dropped_samples;
+}
+
+// The handler proper needs the stack pointer as it was on entry, before any
+// C prologue has moved it. The return from cache_profile_sample() returns
+// from the exception, as lr still holds the EXC_RETURN value.
+static void __attribute__((naked)) __not_in_flash_func(profile_isr)(void) {
+    asm volatile(
+            "mov r0, sp\n"
+            "ldr r1, 1f\n"
+            "bx r1\n"
+            ".align 2\n"
+            "1: .word cache_profile_sample\n"
+            );
+}
+
+static void profile_init() {
+    alarm_num = (uint) hardware_alarm_claim_unused(true);
+    uint irq = TIMER_IRQ_0 + alarm_num;
+    irq_set_exclusive_handler(irq, profile_isr);
+    // Sample inside other interrupt handlers too
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+}
+
+static void profile_start() {
+    memset(pc_stats, 0, sizeof(pc_stats));
+    dropped_samples = 0;
+    total_samples = 0;
+    last_acc = xip_ctrl_hw->ctr_acc;
+    last_hit = xip_ctrl_hw->ctr_hit;
+    hw_set_bits(&timer_hw->inte, 1u << alarm_num);
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + SAMPLE_PERIOD_US;
+}
+
+static void profile_stop() {
+    hw_clear_bits(&timer_hw->inte, 1u << alarm_num);
+    timer_hw->armed = 1u << alarm_num;
+}
+
+// The log read by cache_report.py: one line per program counter, in hex,
+// with its samples, XIP accesses and XIP misses
+static void profile_print(const char *name, uint64_t us) {
+    uint32_t accesses = 0, misses = 0;
+    printf("# profile %s period_us %u\n", name, SAMPLE_PERIOD_US);
+    for (uint i = 0; i < N_PC_SLOTS; ++i) {
+        const pc_stats_t *s = &pc_stats[i];
+        if (s->samples) {
+            printf("S %08x %u %u %u\n", (uint) s->pc, (uint) s->samples, (uint) s->accesses, (uint) s->misses);
+            accesses += s->accesses;
+            misses += s->misses;
+        }
+    }
+    printf("# end %s samples %u dropped %u accesses %u misses %u time_us %u\n", name, (uint) total_samples,
+           (uint) dropped_samples, (uint) accesses, (uint) misses, (uint) us);
+    printf("%s: %.1f%% hit rate, %u us\n", name, accesses ? 100.f * (float) (accesses - misses) / (float) accesses : 0.f,
+           (uint) us);
+}
+
+// Straight-line code, about 2.5kB per function
+#define STEP(k) x = (x ^ (k)) * 0x9e3779b1u; x = (x << 5) | (x >> 27);
+#define STEP4(k) STEP(k) STEP((k) + 0x1111u) STEP((k) + 0x2222u) STEP((k) + 0x3333u)
+#define STEP16(k) STEP4(k) STEP4((k) + 0x44444u) STEP4((k) + 0x88888u) STEP4((k) + 0xcccccu)
+#define STEP128(k) STEP16(k) STEP16((k) + 0x1000000u) STEP16((k) + 0x2000000u) STEP16((k) + 0x3000000u) \
+                   STEP16((k) + 0x4000000u) STEP16((k) + 0x5000000u) STEP16((k) + 0x6000000u) \
+                   STEP16((k) + 0x7000000u)
+
+#define BIG_FUNC(name, seed) uint32_t __noinline name(uint32_t x) { STEP128(seed) return x; }
+#define BIG_FUNC_RAM(name, seed) uint32_t __no_inline_not_in_flash_func(name)(uint32_t x) { STEP128(seed) return x; }
+
+BIG_FUNC(stage0, 0x10000000u)
+BIG_FUNC(stage1, 0x20000000u)
+BIG_FUNC(stage2, 0x30000000u)
+BIG_FUNC(stage3, 0x40000000u)
+BIG_FUNC(stage4, 0x50000000u)
+BIG_FUNC(stage5, 0x60000000u)
+BIG_FUNC(stage6, 0x70000000u)
+BIG_FUNC(stage7, 0x80000000u)
+
+// The same as stage0-stage2, moved into RAM
+BIG_FUNC_RAM(stage0_ram, 0x10000000u)
+BIG_FUNC_RAM(stage1_ram, 0x20000000u)
+BIG_FUNC_RAM(stage2_ram, 0x30000000u)
+
+typedef uint32_t (*stage_fn)(uint32_t);
+
+static const stage_fn stages_flash[8] = {stage0, stage1, stage2, stage3, stage4, stage5, stage6, stage7};
+static const stage_fn stages_mixed[8] = {stage0_ram, stage1_ram, stage2_ram, stage3, stage4, stage5, stage6,
+                                         stage7};
+
+static uint32_t run_stages(const stage_fn *stages, uint n_iter) {
+    uint32_t x = 1;
+    for (uint i = 0; i < n_iter; ++i)
+        for (uint s = 0; s < 8; ++s)
+            x = stages[s](x);
+    return x;
+}
+
+int recursive_fibonacci(int n) {
+    if (n <= 1)
+        return 1;
+    else
+        return recursive_fibonacci(n - 1) + recursive_fibonacci(n - 2);
+}
+
+int main() {
+    stdio_init_all();
+    printf("Flash cache profiler example\n");
+    if (xip_ctrl_hw->ctr_acc == 0)
+        printf("It looks like you're running this example from SRAM, so there is nothing to profile\n");
+    profile_init();
+
+    // A small hot loop: almost everything hits
+    profile_start();
+    uint64_t start = time_us_64();
+    int fib = recursive_fibonacci(27);
+    uint64_t us = time_us_64() - start;
+    profile_stop();
+    profile_print("fibonacci", us);
+
+    // Eight stages, each 2.5kB, don't fit in the cache together
+    const uint n_iter = 2000;
+    profile_start();
+    start = time_us_64();
+    uint32_t result_flash = run_stages(stages_flash, n_iter);
+    us = time_us_64() - start;
+    profile_stop();
+    profile_print("stages_in_flash", us);
+
+    // With the first three stages in RAM, the rest do
+    profile_start();
+    start = time_us_64();
+    uint32_t result_mixed = run_stages(stages_mixed, n_iter);
+    us = time_us_64() - start;
+    profile_stop();
+    profile_print("stages_0_to_2_in_ram", us);
+
+    printf("fibonacci %d, results %s\n", fib, result_flash == result_mixed ? "match" : "DIFFER");
+    printf("Save the lines from \"# profile\" to \"# end\" in a file, and run\n"
+           "    cache_report.py flash_cache_profile.elf.map <file>\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+
+# Tests for cache_report.py, using a linker map and a log from
+# flash_cache_profile kept in testdata/.
+#
+# Usage: python3 -m unittest discover -s flash/cache_profile -p 'test_*.py'
+# or just: python3 test_cache_report.py
+#
+# If the report format changes on purpose, regenerate the expected output with
+#   python3 cache_report.py testdata/flash_cache_profile.elf.map testdata/profile.log --ram-budget 8192 \
+#       > testdata/expected_report.txt
+
+import io
+import os
+import subprocess
+import sys
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+
+import cache_report
+
+MAP = os.path.join(HERE, 'testdata', 'flash_cache_profile.elf.map')
+LOG = os.path.join(HERE, 'testdata', 'profile.log')
+EXPECTED = os.path.join(HERE, 'testdata', 'expected_report.txt')
+
+
+class MapTest(unittest.TestCase):
+    def setUp(self):
+        self.functions = {fn.name: fn for fn in cache_report.load_symbols(MAP)}
+
+    def test_functions_with_symbols(self):
+        fn = self.functions['stage1']
+        self.assertEqual((fn.start, fn.size), (0x10000b3c, 0x9f8))
+        self.assertTrue(fn.in_flash())
+        self.assertIn('flash_cache_profile.c.obj', fn.source)
+
+    def test_section_with_several_symbols(self):
+        # Each symbol runs up to the next one
+        self.assertEqual(self.functions['_entry_point'].size, 0xc)
+        self.assertEqual(self.functions['_reset_handler'].size, 0x2c)
+        self.assertEqual(self.functions['data_cpy'].size, 0xc)
+
+    def test_static_function_named_from_section(self):
+        fn = self.functions['run_stages']
+        self.assertEqual((fn.start, fn.size), (0x10005104, 0x30))
+
+    def test_ram_functions(self):
+        fn = self.functions['stage2_ram']
+        self.assertFalse(fn.in_flash())
+        self.assertIn('cache_profile_sample', self.functions)
+
+    def test_code_only(self):
+        self.assertNotIn('stages_flash', self.functions)
+        self.assertNotIn('.rodata.stages_flash', self.functions)
+        # Empty sections are skipped
+        self.assertNotIn('unused_helper', self.functions)
+
+
+class LogTest(unittest.TestCase):
+    def setUp(self):
+        with open(LOG) as f:
+            self.profiles = cache_report.parse_log(f)
+
+    def test_profiles(self):
+        self.assertEqual([p['name'] for p in self.profiles],
+                         ['fibonacci', 'stages_in_flash', 'stages_0_to_2_in_ram'])
+        self.assertEqual([p['time_us'] for p in self.profiles], [120700, 91500, 58200])
+
+    def test_damaged_line_skipped(self):
+        samples = self.profiles[1]['samples']
+        self.assertEqual(len(samples), 26)
+        self.assertNotIn(0x1000534, [s[0] for s in samples])
+
+    def test_attribution(self):
+        functions = cache_report.load_symbols(MAP)
+        hit = {fn.name: fn for fn in cache_report.attribute(functions, self.profiles[1]['samples'])}
+        self.assertEqual(hit['stage0'].misses, 9000)
+        self.assertEqual(hit['stage0'].samples, 300)
+        self.assertEqual(hit['<unknown>'].samples, 2)
+        hit = {fn.name: fn for fn in cache_report.attribute(functions, self.profiles[0]['samples'])}
+        self.assertEqual(hit['<boot rom>'].samples, 3)
+
+
+class ReportTest(unittest.TestCase):
+    def test_recommendation(self):
+        functions = cache_report.load_symbols(MAP)
+        with open(LOG) as f:
+            profile = cache_report.parse_log(f)[1]
+        out = io.StringIO()
+        cache_report.report(profile, functions, 8192, 15, 0.01, out)
+        picked = [l.strip() for l in out.getvalue().splitlines() if '__not_in_flash_func' in l]
+        # Most misses per byte first; a fourth stage wouldn't fit
+        self.assertEqual(picked, ['__not_in_flash_func(%s)' % name
+                                  for name in ('run_stages', 'stage0', 'stage1', 'stage2')])
+
+    def test_nothing_to_move(self):
+        functions = cache_report.load_symbols(MAP)
+        with open(LOG) as f:
+            profile = cache_report.parse_log(f)[1]
+        out = io.StringIO()
+        cache_report.report(profile, functions, 16, 15, 0.01, out)
+        self.assertIn('Nothing worth moving into RAM', out.getvalue())
+
+    def test_whole_report(self):
+        result = subprocess.run([sys.executable, os.path.join(HERE, 'cache_report.py'), MAP, LOG,
+                                 '--ram-budget', '8192'], stdout=subprocess.PIPE, universal_newlines=True, check=True)
+        with open(EXPECTED) as f:
+            self.assertEqual(result.stdout, f.read())
+
+
+if __name__ == '__main__':
+    unittest.main()
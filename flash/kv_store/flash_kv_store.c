@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Wear-levelled key-value store in internal flash.
+//
+// The program example erases a whole sector to change a single page. Do that
+// every time a setting changes and the sector wears out quickly, and if power
+// fails between the erase and the program, the old settings are lost too. The
+// store in kv_store.h only ever appends to flash, and spreads the erases over
+// all of its sectors.
+//
+// Here the store lives in the last sectors of flash, and counts how many
+// times the board has booted. Its power failure tests and benchmarks run on
+// the host instead, against a flash image in a file: see kv_store_host.c.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "kv_store.h"
+
+// The store lives in the last sectors of flash, well away from the program
+#define KV_FLASH_SECTORS 8
+#define KV_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - KV_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+
+static kv_store_t kv;
+
+static bool flash_read(__unused void *ctx, uint32_t addr, void *buf, uint32_t len) {
+    memcpy(buf, (const void *) (XIP_BASE + KV_FLASH_OFFSET + addr), len);
+    return true;
+}
+
+// flash_range_program() only takes whole pages, but programming 0xff leaves
+// a byte as it was, so pad the data out with 0xff
+static bool flash_program(__unused void *ctx, uint32_t addr, const void *data, uint32_t len) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xff, sizeof(page));
+    memcpy(page + addr % FLASH_PAGE_SIZE, data, len);
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(KV_FLASH_OFFSET + addr - addr % FLASH_PAGE_SIZE, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+    return true;
+}
+
+static bool flash_erase(__unused void *ctx, uint32_t sector) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(KV_FLASH_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+    return true;
+}
+
+static const kv_flash_t real_flash = {
+        .sector_size = FLASH_SECTOR_SIZE,
+        .page_size = FLASH_PAGE_SIZE,
+        .n_sectors = KV_FLASH_SECTORS,
+        .read = flash_read,
+        .program = flash_program,
+        .erase = flash_erase,
+};
+
+int main() {
+    stdio_init_all();
+    printf("Flash key-value store example\n");
+
+    uint64_t start = time_us_64();
+    kv_err_t err = kv_init(&kv, &real_flash);
+    uint64_t mount_us = time_us_64() - start;
+    if (err != KV_OK) {
+        printf("Couldn't mount the store in flash (%d)\n", err);
+        return 1;
+    }
+    printf("Mounted the store at flash offset 0x%x in %u us, %u keys\n", KV_FLASH_OFFSET, (uint) mount_us,
+           (uint) kv_count(&kv));
+
+    uint32_t boot_count = 0, len;
+    if (kv_get(&kv, "boot_count", &boot_count, sizeof(boot_count), &len) != KV_OK)
+        boot_count = 0;
+    ++boot_count;
+    start = time_us_64();
+    err = kv_set(&kv, "boot_count", &boot_count, sizeof(boot_count));
+    uint64_t set_us = time_us_64() - start;
+    printf("This board has booted %u times (saved in %u us)\n", (uint) boot_count, (uint) set_us);
+    return err != KV_OK;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "kv_flash_emu.h"
+
+static uint8_t emu_rand(kv_flash_emu_t *emu) {
+    emu->rand ^= emu->rand << 13;
+    emu->rand ^= emu->rand >> 17;
+    emu->rand ^= emu->rand << 5;
+    return (uint8_t) emu->rand;
+}
+
+// Returns how many of len bytes can be done before power fails
+static uint32_t emu_budget(kv_flash_emu_t *emu, uint32_t len) {
+    if (emu->fail_countdown < 0)
+        return len;
+    if ((uint32_t) emu->fail_countdown >= len) {
+        emu->fail_countdown -= (int32_t) len;
+        return len;
+    }
+    uint32_t n = (uint32_t) emu->fail_countdown;
+    emu->fail_countdown = -1;
+    emu->powered = false;
+    return n;
+}
+
+static bool emu_read(void *ctx, uint32_t addr, void *buf, uint32_t len) {
+    kv_flash_emu_t *emu = ctx;
+    if (!emu->powered || addr + len > emu->n_sectors * emu->sector_size)
+        return false;
+    memcpy(buf, emu->mem + addr, len);
+    return true;
+}
+
+static bool emu_program(void *ctx, uint32_t addr, const void *data, uint32_t len) {
+    kv_flash_emu_t *emu = ctx;
+    if (!emu->powered || addr + len > emu->n_sectors * emu->sector_size ||
+        addr / emu->page_size != (addr + len - 1) / emu->page_size)
+        return false;
+    const uint8_t *src = data;
+    uint32_t n = emu_budget(emu, len);
+    for (uint32_t i = 0; i < n; ++i)
+        emu->mem[addr + i] &= src[i];
+    emu->bytes_programmed += n;
+    if (n < len) {
+        emu->mem[addr + n] &= src[n] | emu_rand(emu);
+        return false;
+    }
+    return true;
+}
+
+static bool emu_erase(void *ctx, uint32_t sector) {
+    kv_flash_emu_t *emu = ctx;
+    if (!emu->powered || sector >= emu->n_sectors)
+        return false;
+    uint8_t *end = emu->mem + (sector + 1) * emu->sector_size;
+    uint32_t n = emu_budget(emu, emu->sector_size);
+    memset(end - n, 0xff, n);
+    emu->erases++;
+    if (n < emu->sector_size) {
+        end[-1 - (int32_t) n] |= emu_rand(emu);
+        return false;
+    }
+    return true;
+}
+
+void kv_flash_emu_init(kv_flash_emu_t *emu, uint8_t *mem, uint32_t n_sectors, uint32_t sector_size,
+                       uint32_t page_size, kv_flash_t *flash) {
+    memset(emu, 0, sizeof(*emu));
+    emu->mem = mem;
+    emu->n_sectors = n_sectors;
+    emu->sector_size = sector_size;
+    emu->page_size = page_size;
+    emu->fail_countdown = -1;
+    emu->powered = true;
+    emu->rand = 0x2545f491;
+    memset(mem, 0xff, n_sectors * sector_size);
+
+    flash->sector_size = sector_size;
+    flash->page_size = page_size;
+    flash->n_sectors = n_sectors;
+    flash->read = emu_read;
+    flash->program = emu_program;
+    flash->erase = emu_erase;
+    flash->ctx = emu;
+}
+
+void kv_flash_emu_fail_after(kv_flash_emu_t *emu, int32_t bytes) {
+    emu->fail_countdown = bytes;
+}
+
+void kv_flash_emu_power_on(kv_flash_emu_t *emu) {
+    emu->powered = true;
+    emu->fail_countdown = -1;
+}
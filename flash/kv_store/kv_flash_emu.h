@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _KV_FLASH_EMU_H
+#define _KV_FLASH_EMU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "kv_store.h"
+
+// NOR flash emulated in RAM, with power failure injection.
+//
+// As with real flash, programming can only clear bits, and erasing sets a
+// whole sector back to 0xff. After kv_flash_emu_fail_after(), power fails
+// part of the way through a later program or erase: the byte being programmed
+// is left with a random subset of its bits cleared, and an erase is left
+// partly done, working back from the end of the sector so that the sector
+// header is the last thing to go. Every operation then fails until
+// kv_flash_emu_power_on(). kv_flash_file.h keeps the emulated flash in a
+// file, so that it lasts from one run to the next.
+
+typedef struct {
+    uint8_t *mem;
+    uint32_t sector_size;
+    uint32_t page_size;
+    uint32_t n_sectors;
+    // Bytes which may be programmed or erased before power fails, or
+    // negative for never
+    int32_t fail_countdown;
+    bool powered;
+    uint32_t rand;
+    uint32_t erases;
+    uint64_t bytes_programmed;
+} kv_flash_emu_t;
+
+// mem must hold n_sectors * sector_size bytes, and is erased
+void kv_flash_emu_init(kv_flash_emu_t *emu, uint8_t *mem, uint32_t n_sectors, uint32_t sector_size,
+                       uint32_t page_size, kv_flash_t *flash);
+
+void kv_flash_emu_fail_after(kv_flash_emu_t *emu, int32_t bytes);
+
+void kv_flash_emu_power_on(kv_flash_emu_t *emu);
+
+#endif
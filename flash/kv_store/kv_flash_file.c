@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kv_flash_file.h"
+
+static bool write_back(kv_flash_file_t *ff, uint32_t addr, uint32_t len) {
+    return !fseek(ff->file, (long) addr, SEEK_SET) && fwrite(ff->emu.mem + addr, 1, len, ff->file) == len &&
+           !fflush(ff->file);
+}
+
+static bool file_read(void *ctx, uint32_t addr, void *buf, uint32_t len) {
+    kv_flash_file_t *ff = ctx;
+    return ff->mem_flash.read(ff->mem_flash.ctx, addr, buf, len);
+}
+
+static bool file_program(void *ctx, uint32_t addr, const void *data, uint32_t len) {
+    kv_flash_file_t *ff = ctx;
+    if (addr + len > ff->emu.n_sectors * ff->emu.sector_size)
+        return false;
+    bool ok = ff->mem_flash.program(ff->mem_flash.ctx, addr, data, len);
+    return write_back(ff, addr, len) && ok;
+}
+
+static bool file_erase(void *ctx, uint32_t sector) {
+    kv_flash_file_t *ff = ctx;
+    if (sector >= ff->emu.n_sectors)
+        return false;
+    bool ok = ff->mem_flash.erase(ff->mem_flash.ctx, sector);
+    return write_back(ff, sector * ff->emu.sector_size, ff->emu.sector_size) && ok;
+}
+
+bool kv_flash_file_open(kv_flash_file_t *ff, const char *path, uint32_t n_sectors, uint32_t sector_size,
+                        uint32_t page_size, kv_flash_t *flash) {
+    uint32_t size = n_sectors * sector_size;
+    uint8_t *mem = malloc(size);
+    if (!mem)
+        return false;
+    kv_flash_emu_init(&ff->emu, mem, n_sectors, sector_size, page_size, &ff->mem_flash);
+
+    ff->file = fopen(path, "r+b");
+    if (ff->file && (fread(mem, 1, size, ff->file) != size || fgetc(ff->file) != EOF)) {
+        fclose(ff->file);
+        ff->file = NULL;
+        memset(mem, 0xff, size);
+    }
+    if (!ff->file) {
+        ff->file = fopen(path, "w+b");
+        if (!ff->file || !write_back(ff, 0, size)) {
+            kv_flash_file_close(ff);
+            return false;
+        }
+    }
+
+    *flash = ff->mem_flash;
+    flash->read = file_read;
+    flash->program = file_program;
+    flash->erase = file_erase;
+    flash->ctx = ff;
+    return true;
+}
+
+void kv_flash_file_close(kv_flash_file_t *ff) {
+    if (ff->file)
+        fclose(ff->file);
+    ff->file = NULL;
+    free(ff->emu.mem);
+    ff->emu.mem = NULL;
+}
@@ -0,0 +1,34 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _KV_FLASH_FILE_H
+#define _KV_FLASH_FILE_H
+
+#include <stdio.h>
+
+#include "kv_flash_emu.h"
+
+// The flash emulator in kv_flash_emu.h, kept in a file on the host.
+//
+// The file holds an image of the flash, which is read in when it is opened
+// and written back as each program or erase happens, including one which
+// power failure cut short. Closing and opening the file again is then a
+// reboot: the store comes back with exactly what reached the flash.
+
+typedef struct {
+    kv_flash_emu_t emu;
+    // The emulator's own operations, which these wrap
+    kv_flash_t mem_flash;
+    FILE *file;
+} kv_flash_file_t;
+
+// Open the image at path, creating it erased if it doesn't exist or is the
+// wrong size. Returns false if the file can't be used.
+bool kv_flash_file_open(kv_flash_file_t *ff, const char *path, uint32_t n_sectors, uint32_t sector_size,
+                        uint32_t page_size, kv_flash_t *flash);
+
+void kv_flash_file_close(kv_flash_file_t *ff);
+
+#endif
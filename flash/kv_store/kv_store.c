@@ -0,0 +1,599 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "crc.h"
+#include "kv_store.h"
+
+// Sector header, as 32-bit words:
+//
+//   0: magic
+//   1: erase count     written straight after the sector is erased
+//   2: ~erase count
+//   3: sequence number written when the sector is first appended to
+//   4: ~sequence number
+//   5: obsolete        cleared just before the sector is erased again
+//
+// Everything else is left erased. A sector whose erase count can't be read
+// is erased at boot, as is one which has been marked obsolete, since its
+// live data has already been copied elsewhere.
+#define KV_SECTOR_MAGIC 0x3153564bu
+#define KV_HDR_MAGIC 0
+#define KV_HDR_ERASE_COUNT 1
+#define KV_HDR_SEQ 3
+#define KV_HDR_OBSOLETE 5
+#define KV_HDR_WORDS 6
+
+// Record: header, key, value, padded with 0xff to a multiple of 4 bytes. The
+// CRC covers the first four bytes of the header, the key and the value.
+#define KV_RECORD_MAGIC 0x4bu
+#define KV_TOMBSTONE 0xffffu
+
+typedef struct {
+    uint8_t magic;
+    uint8_t key_len;
+    uint16_t value_len;
+    uint32_t crc;
+} kv_record_header_t;
+
+#define KV_MAX_RECORD_SIZE ((KV_RECORD_HEADER_SIZE + KV_MAX_KEY_LEN + KV_MAX_VALUE_LEN + 3) & ~3u)
+
+static crc_t crc32;
+static bool crc32_ready;
+
+static uint32_t record_size(uint32_t key_len, uint32_t value_len) {
+    if (value_len == KV_TOMBSTONE)
+        value_len = 0;
+    return (KV_RECORD_HEADER_SIZE + key_len + value_len + 3) & ~3u;
+}
+
+static uint32_t record_crc(const uint8_t *rec) {
+    const kv_record_header_t *hdr = (const kv_record_header_t *) rec;
+    uint32_t value_len = hdr->value_len == KV_TOMBSTONE ? 0 : hdr->value_len;
+    uint32_t state = crc_update(&crc32, crc_start(&crc32), rec, 4);
+    state = crc_update(&crc32, state, rec + KV_RECORD_HEADER_SIZE, hdr->key_len + value_len);
+    return crc_finish(&crc32, state);
+}
+
+// FNV-1a
+static uint32_t key_hash(const char *key, uint32_t key_len) {
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < key_len; ++i)
+        h = (h ^ (uint8_t) key[i]) * 16777619u;
+    return h;
+}
+
+static uint32_t sector_addr(const kv_store_t *kv, uint32_t sector) {
+    return sector * kv->flash.sector_size;
+}
+
+static bool flash_read(kv_store_t *kv, uint32_t addr, void *buf, uint32_t len) {
+    return kv->flash.read(kv->flash.ctx, addr, buf, len);
+}
+
+// Split into pages
+static bool flash_program(kv_store_t *kv, uint32_t addr, const void *data, uint32_t len) {
+    const uint8_t *p = data;
+    while (len) {
+        uint32_t chunk = kv->flash.page_size - addr % kv->flash.page_size;
+        if (chunk > len)
+            chunk = len;
+        if (!kv->flash.program(kv->flash.ctx, addr, p, chunk))
+            return false;
+        kv->stats.flash_bytes += chunk;
+        addr += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+// Read and check a whole record into rec, which must hold
+// KV_MAX_RECORD_SIZE bytes. Returns its size, 0 for free space, or -1 if it
+// is corrupt.
+static int read_record(kv_store_t *kv, uint32_t sector, uint32_t offset, uint8_t *rec) {
+    uint32_t sector_size = kv->flash.sector_size;
+    if (offset + KV_RECORD_HEADER_SIZE > sector_size)
+        return 0;
+    if (!flash_read(kv, sector_addr(kv, sector) + offset, rec, KV_RECORD_HEADER_SIZE))
+        return -1;
+    const kv_record_header_t *hdr = (const kv_record_header_t *) rec;
+    if (hdr->magic != KV_RECORD_MAGIC) {
+        static const uint8_t erased[KV_RECORD_HEADER_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+        return memcmp(rec, erased, KV_RECORD_HEADER_SIZE) ? -1 : 0;
+    }
+    if (!hdr->key_len || hdr->key_len > KV_MAX_KEY_LEN)
+        return -1;
+    if (hdr->value_len > KV_MAX_VALUE_LEN && hdr->value_len != KV_TOMBSTONE)
+        return -1;
+    uint32_t size = record_size(hdr->key_len, hdr->value_len);
+    if (offset + size > sector_size)
+        return -1;
+    if (!flash_read(kv, sector_addr(kv, sector) + offset + KV_RECORD_HEADER_SIZE, rec + KV_RECORD_HEADER_SIZE,
+                    size - KV_RECORD_HEADER_SIZE))
+        return -1;
+    if (record_crc(rec) != hdr->crc)
+        return -1;
+    return (int) size;
+}
+
+static bool key_matches(kv_store_t *kv, const kv_index_entry_t *e, const char *key, uint32_t key_len) {
+    uint8_t buf[KV_RECORD_HEADER_SIZE + KV_MAX_KEY_LEN];
+    if (!flash_read(kv, sector_addr(kv, e->sector) + e->offset, buf, KV_RECORD_HEADER_SIZE + key_len))
+        return false;
+    return buf[1] == key_len && !memcmp(buf + KV_RECORD_HEADER_SIZE, key, key_len);
+}
+
+// Open addressing with linear probing. Returns the slot holding the key, or
+// -1 if there is none.
+static int index_find(kv_store_t *kv, uint32_t hash, const char *key, uint32_t key_len) {
+    uint32_t mask = KV_INDEX_SIZE - 1;
+    for (uint32_t i = hash & mask; kv->index[i].size; i = (i + 1) & mask) {
+        if (kv->index[i].hash == hash && key_matches(kv, &kv->index[i], key, key_len))
+            return (int) i;
+    }
+    return -1;
+}
+
+// Move later entries back into the gap, so that no probe sequence is broken
+// and no tombstones are needed in the table
+static void index_remove(kv_store_t *kv, int slot) {
+    uint32_t mask = KV_INDEX_SIZE - 1;
+    uint32_t i = (uint32_t) slot;
+    kv_index_entry_t *e = &kv->index[i];
+    kv->sectors[e->sector].live_bytes -= e->size;
+    for (uint32_t j = (i + 1) & mask; kv->index[j].size; j = (j + 1) & mask) {
+        uint32_t home = kv->index[j].hash & mask;
+        // Leave entries whose home is cyclically within (i, j]
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            kv->index[i] = kv->index[j];
+            i = j;
+        }
+    }
+    kv->index[i].size = 0;
+    kv->n_keys--;
+}
+
+static bool index_set(kv_store_t *kv, uint32_t hash, const char *key, uint32_t key_len, uint32_t sector,
+                      uint32_t offset, uint32_t size) {
+    int slot = index_find(kv, hash, key, key_len);
+    kv_index_entry_t *e;
+    if (slot >= 0) {
+        e = &kv->index[slot];
+        kv->sectors[e->sector].live_bytes -= e->size;
+    } else {
+        if (kv->n_keys == KV_MAX_KEYS)
+            return false;
+        uint32_t mask = KV_INDEX_SIZE - 1;
+        uint32_t i = hash & mask;
+        while (kv->index[i].size)
+            i = (i + 1) & mask;
+        e = &kv->index[i];
+        e->hash = hash;
+        kv->n_keys++;
+    }
+    e->sector = (uint16_t) sector;
+    e->offset = (uint16_t) offset;
+    e->size = (uint16_t) size;
+    kv->sectors[sector].live_bytes += size;
+    return true;
+}
+
+static bool write_erase_count(kv_store_t *kv, uint32_t sector, uint32_t count) {
+    uint32_t words[3] = {KV_SECTOR_MAGIC, count, ~count};
+    return flash_program(kv, sector_addr(kv, sector), words, sizeof(words));
+}
+
+static kv_err_t erase_sector(kv_store_t *kv, uint32_t sector, uint32_t count) {
+    kv_sector_t *s = &kv->sectors[sector];
+    s->state = KV_SECTOR_BAD;
+    s->live_bytes = 0;
+    kv->stats.erases++;
+    if (!kv->flash.erase(kv->flash.ctx, sector) || !write_erase_count(kv, sector, count))
+        return KV_ERR_IO;
+    s->state = KV_SECTOR_FREE;
+    s->erase_count = count;
+    s->seq = 0;
+    s->write_offset = KV_SECTOR_HEADER_SIZE;
+    return KV_OK;
+}
+
+static uint32_t count_free(const kv_store_t *kv) {
+    uint32_t n = 0;
+    for (uint32_t s = 0; s < kv->flash.n_sectors; ++s)
+        n += kv->sectors[s].state == KV_SECTOR_FREE;
+    return n;
+}
+
+// Start appending to the least worn free sector
+static kv_err_t open_sector(kv_store_t *kv) {
+    int best = -1;
+    for (uint32_t s = 0; s < kv->flash.n_sectors; ++s) {
+        if (kv->sectors[s].state == KV_SECTOR_FREE &&
+            (best < 0 || kv->sectors[s].erase_count < kv->sectors[best].erase_count))
+            best = (int) s;
+    }
+    if (best < 0)
+        return KV_ERR_FULL;
+    kv_sector_t *s = &kv->sectors[best];
+    uint32_t seq = kv->next_seq++;
+    uint32_t words[2] = {seq, ~seq};
+    kv->active = -1;
+    if (!flash_program(kv, sector_addr(kv, best) + KV_HDR_SEQ * 4, words, sizeof(words)))
+        return KV_ERR_IO;
+    s->state = KV_SECTOR_USED;
+    s->seq = seq;
+    kv->active = best;
+    return KV_OK;
+}
+
+// Is there a record for the key in a sector with a sequence number in
+// [seq_min, seq_max]?
+static bool key_in_sectors(kv_store_t *kv, const uint8_t *key, uint32_t key_len, uint32_t seq_min,
+                           uint32_t seq_max) {
+    uint8_t rec[KV_MAX_RECORD_SIZE];
+    for (uint32_t s = 0; s < kv->flash.n_sectors; ++s) {
+        const kv_sector_t *sec = &kv->sectors[s];
+        if (sec->state != KV_SECTOR_USED || sec->seq < seq_min || sec->seq > seq_max)
+            continue;
+        int size;
+        for (uint32_t offset = KV_SECTOR_HEADER_SIZE; (size = read_record(kv, s, offset, rec)) > 0; offset += size) {
+            if (rec[1] == key_len && !memcmp(rec + KV_RECORD_HEADER_SIZE, key, key_len))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Does the garbage collector need to keep this record? If it is a value
+// still in use, *slot is set to its index entry.
+static bool record_is_live(kv_store_t *kv, uint32_t sector, uint32_t offset, const uint8_t *rec, int *slot) {
+    const kv_record_header_t *hdr = (const kv_record_header_t *) rec;
+    const char *key = (const char *) rec + KV_RECORD_HEADER_SIZE;
+    *slot = index_find(kv, key_hash(key, hdr->key_len), key, hdr->key_len);
+    if (hdr->value_len != KV_TOMBSTONE)
+        return *slot >= 0 && kv->index[*slot].sector == sector && kv->index[*slot].offset == offset;
+    // A deletion only matters while it is the newest record for the key, and
+    // an older record could reappear without it
+    uint32_t seq = kv->sectors[sector].seq;
+    return *slot < 0 && !key_in_sectors(kv, rec + KV_RECORD_HEADER_SIZE, hdr->key_len, seq + 1, UINT32_MAX) &&
+           key_in_sectors(kv, rec + KV_RECORD_HEADER_SIZE, hdr->key_len, 0, seq - 1);
+}
+
+// Can a sector be collected? Its live records must fit in the rest of the
+// active sector and the free sectors, and it mustn't hold a deletion which
+// is still needed. Copying a deletion to the end of the log would put it
+// after keys added since, and kv_init() replays the log in order, so it
+// could briefly see more than KV_MAX_KEYS keys. The sectors holding the older
+// records are collected first instead, which makes the deletion dead.
+static bool gc_possible(kv_store_t *kv, uint32_t victim) {
+    uint32_t sector_size = kv->flash.sector_size;
+    uint32_t space = kv->active >= 0 ? sector_size - kv->sectors[kv->active].write_offset : 0;
+    uint32_t n_free = count_free(kv);
+    uint8_t rec[KV_MAX_RECORD_SIZE];
+    int size, slot;
+    for (uint32_t offset = KV_SECTOR_HEADER_SIZE; (size = read_record(kv, victim, offset, rec)) > 0; offset += size) {
+        if (!record_is_live(kv, victim, offset, rec, &slot))
+            continue;
+        if (slot < 0)
+            return false;
+        if ((uint32_t) size > space) {
+            if (!n_free--)
+                return false;
+            space = sector_size - KV_SECTOR_HEADER_SIZE;
+        }
+        space -= (uint32_t) size;
+    }
+    return true;
+}
+
+// Normally the sector with the least live data, unless the erase counts have
+// drifted too far apart, when it is the least worn. Either way, it must be
+// possible to collect it.
+static int pick_victim(kv_store_t *kv, bool *wear_level) {
+    uint32_t min_count = UINT32_MAX, max_count = 0;
+    uint8_t candidates[KV_MAX_SECTORS];
+    uint32_t n = 0;
+    for (uint32_t s = 0; s < kv->flash.n_sectors; ++s) {
+        const kv_sector_t *sec = &kv->sectors[s];
+        if (sec->state == KV_SECTOR_BAD)
+            continue;
+        if (sec->erase_count < min_count)
+            min_count = sec->erase_count;
+        if (sec->erase_count > max_count)
+            max_count = sec->erase_count;
+        if (sec->state != KV_SECTOR_USED || (int) s == kv->active)
+            continue;
+        uint32_t i = n++;
+        while (i && kv->sectors[candidates[i - 1]].live_bytes > sec->live_bytes) {
+            candidates[i] = candidates[i - 1];
+            --i;
+        }
+        candidates[i] = (uint8_t) s;
+    }
+    *wear_level = false;
+    if (max_count - min_count > KV_WEAR_LEVEL_DELTA) {
+        for (uint32_t i = 0; i < n; ++i) {
+            if (kv->sectors[candidates[i]].erase_count == min_count && gc_possible(kv, candidates[i])) {
+                *wear_level = true;
+                return candidates[i];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        // Nothing would be gained
+        if (kv->sectors[candidates[i]].live_bytes >= kv->flash.sector_size - KV_SECTOR_HEADER_SIZE)
+            break;
+        if (gc_possible(kv, candidates[i]))
+            return candidates[i];
+    }
+    return -1;
+}
+
+// Copy the live records out of one sector, then erase it
+static kv_err_t collect_garbage(kv_store_t *kv) {
+    bool wear_level;
+    int victim = pick_victim(kv, &wear_level);
+    if (victim < 0)
+        return KV_ERR_FULL;
+    kv->stats.gc_runs++;
+    kv->stats.wear_level_moves += wear_level;
+
+    kv_sector_t *v = &kv->sectors[victim];
+    uint8_t rec[KV_MAX_RECORD_SIZE];
+    int size, slot;
+    for (uint32_t offset = KV_SECTOR_HEADER_SIZE; (size = read_record(kv, victim, offset, rec)) > 0; offset += size) {
+        // Only values are live here (see gc_possible())
+        if (!record_is_live(kv, victim, offset, rec, &slot))
+            continue;
+        if (kv->active < 0 || kv->sectors[kv->active].write_offset + size > kv->flash.sector_size) {
+            kv_err_t err = open_sector(kv);
+            if (err)
+                return err;
+        }
+        kv_sector_t *dest = &kv->sectors[kv->active];
+        uint32_t dest_offset = dest->write_offset;
+        dest->write_offset += (uint32_t) size;
+        if (!flash_program(kv, sector_addr(kv, kv->active) + dest_offset, rec, (uint32_t) size))
+            return KV_ERR_IO;
+        kv_index_entry_t *e = &kv->index[slot];
+        v->live_bytes -= e->size;
+        e->sector = (uint16_t) kv->active;
+        e->offset = (uint16_t) dest_offset;
+        dest->live_bytes += e->size;
+        kv->stats.gc_copied_bytes += (uint32_t) size;
+    }
+
+    uint32_t obsolete = 0;
+    if (!flash_program(kv, sector_addr(kv, victim) + KV_HDR_OBSOLETE * 4, &obsolete, sizeof(obsolete)))
+        return KV_ERR_IO;
+    return erase_sector(kv, victim, v->erase_count + 1);
+}
+
+// Make room for size bytes in the active sector, keeping the spare sectors
+// free for the garbage collector
+static kv_err_t reserve(kv_store_t *kv, uint32_t size) {
+    for (uint32_t tries = 0;; ++tries) {
+        if (kv->active >= 0 && kv->sectors[kv->active].write_offset + size <= kv->flash.sector_size)
+            return KV_OK;
+        kv_err_t err;
+        if (count_free(kv) > KV_SPARE_SECTORS)
+            err = open_sector(kv);
+        else if (tries < 2 * kv->flash.n_sectors)
+            err = collect_garbage(kv);
+        else
+            err = KV_ERR_FULL;
+        if (err)
+            return err;
+    }
+}
+
+static kv_err_t append_record(kv_store_t *kv, const char *key, uint32_t key_len, const void *value,
+                              uint32_t value_len, uint32_t *sector, uint32_t *offset) {
+    uint32_t size = record_size(key_len, value_len);
+    kv_err_t err = reserve(kv, size);
+    if (err)
+        return err;
+
+    uint8_t rec[KV_MAX_RECORD_SIZE];
+    kv_record_header_t *hdr = (kv_record_header_t *) rec;
+    hdr->magic = KV_RECORD_MAGIC;
+    hdr->key_len = (uint8_t) key_len;
+    hdr->value_len = (uint16_t) value_len;
+    memcpy(rec + KV_RECORD_HEADER_SIZE, key, key_len);
+    uint32_t data_len = key_len;
+    if (value_len != KV_TOMBSTONE) {
+        memcpy(rec + KV_RECORD_HEADER_SIZE + key_len, value, value_len);
+        data_len += value_len;
+    }
+    memset(rec + KV_RECORD_HEADER_SIZE + data_len, 0xff, size - KV_RECORD_HEADER_SIZE - data_len);
+    hdr->crc = record_crc(rec);
+
+    kv_sector_t *s = &kv->sectors[kv->active];
+    *sector = (uint32_t) kv->active;
+    *offset = s->write_offset;
+    // Whatever happens, don't write over this space again
+    s->write_offset += size;
+    if (!flash_program(kv, sector_addr(kv, *sector) + *offset, rec, size))
+        return KV_ERR_IO;
+    return KV_OK;
+}
+
+static kv_err_t scan_sector(kv_store_t *kv, uint32_t sector) {
+    uint8_t rec[KV_MAX_RECORD_SIZE];
+    kv_sector_t *s = &kv->sectors[sector];
+    uint32_t offset = KV_SECTOR_HEADER_SIZE;
+    int size;
+    while ((size = read_record(kv, sector, offset, rec)) > 0) {
+        const kv_record_header_t *hdr = (const kv_record_header_t *) rec;
+        const char *key = (const char *) rec + KV_RECORD_HEADER_SIZE;
+        uint32_t hash = key_hash(key, hdr->key_len);
+        if (hdr->value_len == KV_TOMBSTONE) {
+            int slot = index_find(kv, hash, key, hdr->key_len);
+            if (slot >= 0)
+                index_remove(kv, slot);
+        } else if (!index_set(kv, hash, key, hdr->key_len, sector, offset, (uint32_t) size)) {
+            return KV_ERR_TOO_MANY_KEYS;
+        }
+        offset += (uint32_t) size;
+    }
+    // A corrupt record ends the sector
+    s->write_offset = size < 0 ? kv->flash.sector_size : offset;
+    return KV_OK;
+}
+
+kv_err_t kv_init(kv_store_t *kv, const kv_flash_t *flash) {
+    memset(kv, 0, sizeof(*kv));
+    kv->flash = *flash;
+    kv->active = -1;
+    if (flash->n_sectors < KV_SPARE_SECTORS + 2 || flash->n_sectors > KV_MAX_SECTORS ||
+        flash->sector_size > 0x10000 || flash->sector_size % flash->page_size ||
+        flash->sector_size < KV_SECTOR_HEADER_SIZE + KV_MAX_RECORD_SIZE)
+        return KV_ERR_NO_FLASH;
+    if (!crc32_ready) {
+        crc_init(&crc32, &crc_params_crc32);
+        crc32_ready = true;
+    }
+
+    // Read the sector headers, and put the sectors in use in order
+    uint8_t order[KV_MAX_SECTORS];
+    uint32_t n_used = 0;
+    uint32_t max_count = 0;
+    bool count_known[KV_MAX_SECTORS];
+    for (uint32_t s = 0; s < flash->n_sectors; ++s) {
+        kv_sector_t *sec = &kv->sectors[s];
+        uint32_t h[KV_HDR_WORDS];
+        uint32_t first[2];
+        sec->state = KV_SECTOR_BAD;
+        count_known[s] = false;
+        if (!flash_read(kv, sector_addr(kv, s), h, sizeof(h)) ||
+            !flash_read(kv, sector_addr(kv, s) + KV_SECTOR_HEADER_SIZE, first, sizeof(first)))
+            return KV_ERR_IO;
+        if (h[KV_HDR_MAGIC] != KV_SECTOR_MAGIC || h[KV_HDR_ERASE_COUNT] != ~h[KV_HDR_ERASE_COUNT + 1])
+            continue;
+        sec->erase_count = h[KV_HDR_ERASE_COUNT];
+        count_known[s] = true;
+        if (sec->erase_count > max_count)
+            max_count = sec->erase_count;
+        if (h[KV_HDR_OBSOLETE] != 0xffffffffu)
+            continue;
+        if (h[KV_HDR_SEQ] == 0xffffffffu && h[KV_HDR_SEQ + 1] == 0xffffffffu) {
+            if (first[0] == 0xffffffffu && first[1] == 0xffffffffu) {
+                sec->state = KV_SECTOR_FREE;
+                sec->write_offset = KV_SECTOR_HEADER_SIZE;
+            }
+        } else if (h[KV_HDR_SEQ] == ~h[KV_HDR_SEQ + 1]) {
+            sec->state = KV_SECTOR_USED;
+            sec->seq = h[KV_HDR_SEQ];
+            uint32_t i = n_used++;
+            while (i && kv->sectors[order[i - 1]].seq > sec->seq) {
+                order[i] = order[i - 1];
+                --i;
+            }
+            order[i] = (uint8_t) s;
+        }
+    }
+
+    // Replay the log, oldest first. The records are in the order they were
+    // written, apart from values moved by the garbage collector, so there are
+    // never more than KV_MAX_KEYS keys along the way.
+    for (uint32_t i = 0; i < n_used; ++i) {
+        kv_err_t err = scan_sector(kv, order[i]);
+        if (err)
+            return err;
+    }
+    kv->next_seq = n_used ? kv->sectors[order[n_used - 1]].seq + 1 : 1;
+    // Only the newest sector may be appended to
+    if (n_used && kv->sectors[order[n_used - 1]].write_offset < flash->sector_size)
+        kv->active = order[n_used - 1];
+
+    for (uint32_t s = 0; s < flash->n_sectors; ++s) {
+        if (kv->sectors[s].state == KV_SECTOR_BAD) {
+            kv_err_t err = erase_sector(kv, s, count_known[s] ? kv->sectors[s].erase_count + 1 : max_count);
+            if (err)
+                return err;
+        }
+    }
+    return KV_OK;
+}
+
+kv_err_t kv_get(kv_store_t *kv, const char *key, void *buf, uint32_t buf_len, uint32_t *len) {
+    uint32_t key_len = (uint32_t) strlen(key);
+    if (!key_len || key_len > KV_MAX_KEY_LEN)
+        return KV_NOT_FOUND;
+    int slot = index_find(kv, key_hash(key, key_len), key, key_len);
+    if (slot < 0)
+        return KV_NOT_FOUND;
+    const kv_index_entry_t *e = &kv->index[slot];
+    kv_record_header_t hdr;
+    uint32_t addr = sector_addr(kv, e->sector) + e->offset;
+    if (!flash_read(kv, addr, &hdr, sizeof(hdr)))
+        return KV_ERR_IO;
+    *len = hdr.value_len;
+    if (buf_len > hdr.value_len)
+        buf_len = hdr.value_len;
+    if (!flash_read(kv, addr + KV_RECORD_HEADER_SIZE + key_len, buf, buf_len))
+        return KV_ERR_IO;
+    return KV_OK;
+}
+
+kv_err_t kv_set(kv_store_t *kv, const char *key, const void *value, uint32_t len) {
+    uint32_t key_len = (uint32_t) strlen(key);
+    if (!key_len || key_len > KV_MAX_KEY_LEN || len > KV_MAX_VALUE_LEN)
+        return KV_ERR_TOO_BIG;
+    uint32_t hash = key_hash(key, key_len);
+    int slot = index_find(kv, hash, key, key_len);
+    if (slot >= 0) {
+        // Don't wear the flash rewriting a value which hasn't changed
+        uint8_t old[KV_MAX_VALUE_LEN];
+        uint32_t old_len;
+        if (kv_get(kv, key, old, sizeof(old), &old_len) == KV_OK && old_len == len && !memcmp(old, value, len))
+            return KV_OK;
+    } else if (kv->n_keys == KV_MAX_KEYS) {
+        return KV_ERR_TOO_MANY_KEYS;
+    }
+    kv->stats.user_bytes += key_len + len;
+
+    uint32_t sector, offset;
+    kv_err_t err = append_record(kv, key, key_len, value, len, &sector, &offset);
+    if (err)
+        return err;
+    // The garbage collector may have moved the old record, so look it up again
+    if (!index_set(kv, hash, key, key_len, sector, offset, record_size(key_len, len)))
+        return KV_ERR_TOO_MANY_KEYS;
+    return KV_OK;
+}
+
+kv_err_t kv_delete(kv_store_t *kv, const char *key) {
+    uint32_t key_len = (uint32_t) strlen(key);
+    if (!key_len || key_len > KV_MAX_KEY_LEN)
+        return KV_NOT_FOUND;
+    uint32_t hash = key_hash(key, key_len);
+    if (index_find(kv, hash, key, key_len) < 0)
+        return KV_NOT_FOUND;
+    kv->stats.user_bytes += key_len;
+
+    uint32_t sector, offset;
+    kv_err_t err = append_record(kv, key, key_len, NULL, KV_TOMBSTONE, &sector, &offset);
+    if (err)
+        return err;
+    index_remove(kv, index_find(kv, hash, key, key_len));
+    return KV_OK;
+}
+
+void kv_erase_count_range(const kv_store_t *kv, uint32_t *min, uint32_t *max) {
+    *min = UINT32_MAX;
+    *max = 0;
+    for (uint32_t s = 0; s < kv->flash.n_sectors; ++s) {
+        uint32_t count = kv->sectors[s].erase_count;
+        if (count < *min)
+            *min = count;
+        if (count > *max)
+            *max = count;
+    }
+}
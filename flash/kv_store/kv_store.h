@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _KV_STORE_H
+#define _KV_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Log-structured key-value store for NOR flash.
+//
+// Records are only ever appended, so changing a value programs a few bytes
+// instead of erasing and rewriting a whole sector. Each record has a CRC, and
+// a record which is missing or corrupt (e.g. because power failed whilst it
+// was being written) ends its sector, so the previous value of the key is
+// kept.
+//
+// Each sector starts with a header holding its erase count, written straight
+// after the erase, and a sequence number, written when the sector is first
+// used, which orders the sectors so that the newest record for a key wins.
+//
+// When the free sectors run out, the garbage collector picks a sector, copies
+// the values in it which are still live to the end of the log, and erases
+// it. A sector holding a deletion which still hides an older value waits
+// until that value's sector has been collected, so deletions stay in order. It normally picks the sector with the least live data, but if the erase
+// counts drift too far apart it picks the least worn sector instead, so that
+// data which never changes doesn't pin its sectors at a low erase count.
+//
+// kv_init() scans the sectors once to build an in-RAM hash index of every
+// key, after which a lookup is one read from flash.
+//
+// The flash itself is reached through a kv_flash_t, either the real thing or
+// the emulator in kv_flash_emu.h.
+
+#define KV_MAX_SECTORS 32
+#define KV_MAX_KEYS 128
+#define KV_MAX_KEY_LEN 32
+#define KV_MAX_VALUE_LEN 256
+// Twice the number of keys, to keep the probe sequences short
+#define KV_INDEX_SIZE 256
+
+// Free sectors kept back for the garbage collector
+#define KV_SPARE_SECTORS 1
+// Erase count spread which triggers static wear levelling
+#define KV_WEAR_LEVEL_DELTA 8
+
+#define KV_SECTOR_HEADER_SIZE 32
+#define KV_RECORD_HEADER_SIZE 8
+
+typedef enum {
+    KV_OK = 0,
+    KV_NOT_FOUND,
+    KV_ERR_IO,
+    KV_ERR_FULL,
+    KV_ERR_TOO_BIG,
+    KV_ERR_TOO_MANY_KEYS,
+    KV_ERR_NO_FLASH,
+} kv_err_t;
+
+typedef struct {
+    uint32_t sector_size;
+    uint32_t page_size;
+    uint32_t n_sectors;
+    // Addresses are byte offsets from the start of the store. program() never
+    // crosses a page boundary. Each returns false if the operation failed.
+    bool (*read)(void *ctx, uint32_t addr, void *buf, uint32_t len);
+    bool (*program)(void *ctx, uint32_t addr, const void *data, uint32_t len);
+    bool (*erase)(void *ctx, uint32_t sector);
+    void *ctx;
+} kv_flash_t;
+
+typedef struct {
+    uint32_t hash;
+    uint16_t sector;
+    uint16_t offset;
+    // Length of the whole record, or 0 for an empty slot
+    uint16_t size;
+} kv_index_entry_t;
+
+typedef enum {
+    KV_SECTOR_FREE,
+    KV_SECTOR_USED,
+    // Header unreadable, needs erasing
+    KV_SECTOR_BAD,
+} kv_sector_state_t;
+
+typedef struct {
+    kv_sector_state_t state;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t write_offset;
+    uint32_t live_bytes;
+} kv_sector_t;
+
+typedef struct {
+    // Key and value bytes passed to kv_set() and kv_delete()
+    uint64_t user_bytes;
+    // Everything programmed into flash: records, sector headers and copies
+    // made by the garbage collector
+    uint64_t flash_bytes;
+    uint32_t erases;
+    uint32_t gc_runs;
+    uint32_t gc_copied_bytes;
+    uint32_t wear_level_moves;
+} kv_stats_t;
+
+typedef struct {
+    kv_flash_t flash;
+    kv_sector_t sectors[KV_MAX_SECTORS];
+    kv_index_entry_t index[KV_INDEX_SIZE];
+    uint32_t n_keys;
+    // Sector being appended to, or -1
+    int active;
+    uint32_t next_seq;
+    kv_stats_t stats;
+} kv_store_t;
+
+// Mount the store, erasing any sectors which aren't part of it yet. Returns
+// KV_ERR_TOO_MANY_KEYS if replaying the log would need more than KV_MAX_KEYS
+// keys in the index.
+kv_err_t kv_init(kv_store_t *kv, const kv_flash_t *flash);
+
+// On success *len is set to the length of the value. The value is truncated
+// to buf_len bytes.
+kv_err_t kv_get(kv_store_t *kv, const char *key, void *buf, uint32_t buf_len, uint32_t *len);
+
+kv_err_t kv_set(kv_store_t *kv, const char *key, const void *value, uint32_t len);
+
+kv_err_t kv_delete(kv_store_t *kv, const char *key);
+
+static inline uint32_t kv_count(const kv_store_t *kv) {
+    return kv->n_keys;
+}
+
+// Flash bytes programmed per byte of user data
+static inline float kv_write_amplification(const kv_store_t *kv) {
+    return kv->stats.user_bytes ? (float) kv->stats.flash_bytes / (float) kv->stats.user_bytes : 0.f;
+}
+
+void kv_erase_count_range(const kv_store_t *kv, uint32_t *min, uint32_t *max);
+
+#endif
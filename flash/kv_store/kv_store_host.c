@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests and benchmarks for the key-value store, run on the host against a
+// flash image in a file (see kv_flash_file.h). Build with PICO_PLATFORM=host.
+//
+// Power is cut at random points in the middle of sets and deletes, and each
+// time the store is remounted from the file and every key checked against a
+// copy held in RAM. Another test keeps the store full of keys whilst deleting
+// old ones and adding new ones, so the garbage collector has deletions to deal
+// with. Then we measure write amplification, wear levelling and the time taken
+// to rebuild the index when the store is mounted.
+//
+// The flash image is kv_store_host.bin, or the file named on the command
+// line, and is left behind afterwards.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "kv_flash_file.h"
+#include "kv_store.h"
+
+#define SECTORS 8
+#define SECTOR_SIZE 4096
+#define PAGE_SIZE 256
+
+static const char *image_path = "kv_store_host.bin";
+static kv_flash_file_t flash_file;
+static kv_flash_t flash;
+static kv_store_t kv;
+
+static uint32_t rand32() {
+    static uint32_t x = 0x12345678;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Start again with erased flash
+static bool new_image() {
+    kv_flash_file_close(&flash_file);
+    remove(image_path);
+    return kv_flash_file_open(&flash_file, image_path, SECTORS, SECTOR_SIZE, PAGE_SIZE, &flash) &&
+           kv_init(&kv, &flash) == KV_OK;
+}
+
+// Mount the store from what reached the file
+static kv_err_t reboot() {
+    kv_flash_file_close(&flash_file);
+    if (!kv_flash_file_open(&flash_file, image_path, SECTORS, SECTOR_SIZE, PAGE_SIZE, &flash))
+        return KV_ERR_NO_FLASH;
+    return kv_init(&kv, &flash);
+}
+
+// What the store should hold. A length of -1 means the key is absent.
+#define N_KEYS 40
+static uint8_t model[N_KEYS][KV_MAX_VALUE_LEN];
+static int model_len[N_KEYS];
+
+static void key_name(char *key, uint k) {
+    sprintf(key, "key%u", k);
+}
+
+static bool check_key(const char *key, const uint8_t *value, int len) {
+    uint8_t buf[KV_MAX_VALUE_LEN];
+    uint32_t got_len;
+    kv_err_t err = kv_get(&kv, key, buf, sizeof(buf), &got_len);
+    if (len < 0)
+        return err == KV_NOT_FOUND;
+    return err == KV_OK && got_len == (uint32_t) len && !memcmp(buf, value, (uint32_t) len);
+}
+
+// Random sets and deletes, with power failing after a random number of bytes
+// have been programmed or erased. Afterwards the key being changed when power
+// failed may have either its old or its new value, and every other key must
+// have its last value.
+static uint power_fail_test(uint n_cycles) {
+    if (!new_image())
+        return 1;
+    for (uint k = 0; k < N_KEYS; ++k)
+        model_len[k] = -1;
+
+    uint errors = 0;
+    for (uint cycle = 0; cycle < n_cycles; ++cycle) {
+        kv_flash_emu_fail_after(&flash_file.emu, (int32_t) (rand32() % 20000));
+        int failed_key = -1;
+        static uint8_t new_value[KV_MAX_VALUE_LEN];
+        int new_len = 0;
+        char key[16];
+        while (failed_key < 0) {
+            uint k = rand32() % N_KEYS;
+            key_name(key, k);
+            // A few large values amongst many small ones
+            new_len = rand32() % 4 ? (int) (rand32() % (k < 5 ? 200 : 40)) : -1;
+            for (int i = 0; i < new_len; ++i)
+                new_value[i] = (uint8_t) rand32();
+            kv_err_t err = new_len < 0 ? kv_delete(&kv, key) : kv_set(&kv, key, new_value, (uint32_t) new_len);
+            if (err == KV_OK || (new_len < 0 && err == KV_NOT_FOUND)) {
+                memcpy(model[k], new_value, new_len > 0 ? (uint32_t) new_len : 0);
+                model_len[k] = new_len;
+            } else {
+                failed_key = (int) k;
+            }
+        }
+
+        if (reboot() != KV_OK) {
+            printf("Mount failed after power failure %u\n", cycle);
+            return errors + 1;
+        }
+        if (check_key(key, new_value, new_len)) {
+            memcpy(model[failed_key], new_value, new_len > 0 ? (uint32_t) new_len : 0);
+            model_len[failed_key] = new_len;
+        }
+        for (uint k = 0; k < N_KEYS; ++k) {
+            key_name(key, k);
+            if (!check_key(key, model[k], model_len[k])) {
+                if (!errors++)
+                    printf("%s wrong after power failure %u\n", key, cycle);
+            }
+        }
+    }
+    return errors;
+}
+
+// Always KV_MAX_KEYS keys: each step deletes one and adds one which has never
+// been used, and every so often the store is remounted and checked. The value
+// of a key is its number.
+static uint full_churn_test(uint n_steps) {
+    static uint32_t live[KV_MAX_KEYS];
+    char key[16];
+    if (!new_image())
+        return 1;
+    uint32_t next = 0;
+    for (uint i = 0; i < KV_MAX_KEYS; ++i) {
+        live[i] = next++;
+        key_name(key, live[i]);
+        if (kv_set(&kv, key, &live[i], sizeof(live[i])) != KV_OK)
+            return 1;
+    }
+
+    uint errors = 0;
+    for (uint step = 0; step < n_steps && !errors; ++step) {
+        uint i = rand32() % KV_MAX_KEYS;
+        key_name(key, live[i]);
+        kv_err_t err = kv_delete(&kv, key);
+        live[i] = next++;
+        key_name(key, live[i]);
+        if (err == KV_OK)
+            err = kv_set(&kv, key, &live[i], sizeof(live[i]));
+        if (err != KV_OK) {
+            printf("Step %u failed (%d)\n", step, err);
+            return errors + 1;
+        }
+        if (step % 64 == 63) {
+            err = reboot();
+            if (err != KV_OK || kv_count(&kv) != KV_MAX_KEYS) {
+                printf("Mount after step %u gave %d with %u keys\n", step, err, (uint) kv_count(&kv));
+                return errors + 1;
+            }
+            for (uint j = 0; j < KV_MAX_KEYS; ++j) {
+                key_name(key, live[j]);
+                if (!check_key(key, (const uint8_t *) &live[j], sizeof(live[j])) && !errors++)
+                    printf("%s wrong after step %u\n", key, step);
+            }
+        }
+    }
+    return errors;
+}
+
+// A few settings which never change, and a few which are saved over and over
+static void write_amplification_test(uint n_saves) {
+    if (!new_image())
+        return;
+    uint8_t value[64];
+    for (uint i = 0; i < 16; ++i) {
+        char key[16];
+        sprintf(key, "static%u", i);
+        memset(value, (int) i, sizeof(value));
+        kv_set(&kv, key, value, sizeof(value));
+    }
+    uint64_t start = time_us_64();
+    for (uint i = 0; i < n_saves; ++i) {
+        char key[16];
+        sprintf(key, "setting%u", i % 4);
+        uint32_t x = i;
+        kv_set(&kv, key, &x, sizeof(x));
+    }
+    uint64_t us = time_us_64() - start;
+
+    uint32_t min_erases, max_erases;
+    kv_erase_count_range(&kv, &min_erases, &max_erases);
+    printf("%u saves of 4 byte settings: %.2f us each\n", n_saves, (float) us / (float) n_saves);
+    printf("Write amplification %.2f (rewriting a sector each time would be %u)\n",
+           kv_write_amplification(&kv), SECTOR_SIZE / (uint) (sizeof("setting0") - 1 + sizeof(uint32_t)));
+    printf("%u erases, %u garbage collections, %u for wear levelling, sectors erased %u to %u times\n",
+           (uint) kv.stats.erases, (uint) kv.stats.gc_runs, (uint) kv.stats.wear_level_moves, (uint) min_erases,
+           (uint) max_erases);
+
+    // The file is read in when it is opened, so this is the scan alone
+    const uint mounts = 100;
+    reboot();
+    start = time_us_64();
+    for (uint i = 0; i < mounts; ++i)
+        kv_init(&kv, &flash);
+    us = time_us_64() - start;
+    printf("Rebuilding the index of %u keys from %u sectors takes %.1f us\n", (uint) kv_count(&kv), SECTORS,
+           (float) us / (float) mounts);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1)
+        image_path = argv[1];
+    printf("Flash key-value store host tests, using %s\n", image_path);
+
+    const uint n_power_failures = 2000;
+    uint errors = power_fail_test(n_power_failures);
+    printf("%u power failures: %s\n", n_power_failures, errors ? "FAILED" : "no data lost");
+
+    const uint n_churn_steps = 20000;
+    uint churn_errors = full_churn_test(n_churn_steps);
+    printf("%u deletes and adds with %u keys: %s\n", n_churn_steps, KV_MAX_KEYS,
+           churn_errors ? "FAILED" : "every key kept");
+
+    write_amplification_test(20000);
+    kv_flash_file_close(&flash_file);
+    return errors || churn_errors;
+}
@@ -0,0 +1,321 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Generate DVI output using HSTX, in any of several video modes.
+//
+// The dvi_out_hstx_encoder example has 640x480 60 Hz built in to its command
+// lists and DMA interrupt. Here the command lists and the sequence of DMA
+// transfers for a whole frame are generated at startup from a table of
+// modes (see dvi_timing.h), and the interrupt just steps through them. Modes
+// with a pixel repeat of 2 show each source pixel as 2x2, for a quarter of
+// the memory and rendering time.
+//
+// First every mode's generated schedule is played through a model of the
+// HSTX command expander, and the line and frame totals it produces are
+// checked against the published CEA-861, DMT and CVT timings. Then the
+// system clock is set to 5 times the pixel clock of DVI_MODE, and a test
+// pattern is displayed: a white border around the active area, colour bars
+// and a grey ramp.
+//
+// The connections are the same as for dvi_out_hstx_encoder.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/structs/hstx_ctrl.h"
+#include "hardware/structs/hstx_fifo.h"
+
+#include "dvi_timing.h"
+
+// Index into dvi_modes[]
+#ifndef DVI_MODE
+#define DVI_MODE 0
+#endif
+
+// Fastest system clock we're prepared to run at. The HSTX clock, which is the
+// same, must be 5 times the pixel clock, so the 1280x720 mode is listed but
+// can't be output.
+#define MAX_SYS_CLOCK_KHZ 200000
+// Monitors tolerate a pixel clock slightly slower than nominal
+#define MAX_CLOCK_ERROR_PERMILLE 5
+
+#define DMACH_PING 0
+#define DMACH_PONG 1
+
+typedef struct {
+    const char *name;
+    uint32_t h_total;
+    uint32_t v_total;
+    uint32_t refresh_mhz;
+} published_timing_t;
+
+// Totals from the standards, to check dvi_timing.c against
+static const published_timing_t published_timings[] = {
+        {"640x480p60", 800, 525, 59940},
+        {"720x480p60", 858, 525, 59940},
+        {"800x600p60", 1056, 628, 60317},
+        {"1280x720p60 RB", 1440, 741, 59979},
+};
+
+static const dvi_mode_t *mode;
+static dvi_cmdlists_t cmdlists;
+static dvi_dma_step_t *schedule;
+static uint32_t schedule_len;
+
+// Test pattern lines, and which one to show on each source line
+enum { LINE_BORDER, LINE_BARS, LINE_RAMP, N_PATTERN_LINES };
+static uint32_t *pattern[N_PATTERN_LINES];
+static const uint32_t **line_data;
+
+// ----------------------------------------------------------------------------
+// DMA logic
+
+static bool dma_pong = false;
+
+// Both channels are primed with the first two steps, so the first time we
+// enter this handler it is to cue up the third
+static uint32_t step_index = 2;
+
+void __scratch_x("") dma_irq_handler() {
+    // dma_pong indicates the channel that just finished, which is the one
+    // we're about to reload.
+    uint ch_num = dma_pong ? DMACH_PONG : DMACH_PING;
+    dma_channel_hw_t *ch = &dma_hw->ch[ch_num];
+    dma_hw->intr = 1u << ch_num;
+    dma_pong = !dma_pong;
+
+    const dvi_dma_step_t *step = &schedule[step_index];
+    ch->read_addr = step->line < 0 ? (uintptr_t) step->cmdlist : (uintptr_t) line_data[step->line];
+    ch->transfer_count = step->count;
+    if (++step_index == schedule_len)
+        step_index = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Mode checks
+
+static bool check_mode(const dvi_mode_t *m) {
+    const dvi_timing_t *t = m->timing;
+    const published_timing_t *pub = NULL;
+    for (uint i = 0; i < count_of(published_timings); ++i)
+        if (!strcmp(published_timings[i].name, t->name))
+            pub = &published_timings[i];
+    if (!pub || !dvi_timing_valid(t))
+        return false;
+
+    dvi_cmdlists_t lists;
+    dvi_build_cmdlists(t, &lists);
+    uint32_t n = dvi_schedule_length(m);
+    dvi_dma_step_t *steps = malloc(n * sizeof(dvi_dma_step_t));
+    hard_assert(steps);
+    dvi_build_schedule(m, &lists, steps);
+    dvi_schedule_stats_t stats;
+    bool ok = dvi_schedule_measure(m, steps, n, &stats);
+    free(steps);
+
+    uint32_t refresh_mhz = dvi_timing_refresh_mhz(t);
+    return ok &&
+           dvi_timing_h_total(t) == pub->h_total && dvi_timing_v_total(t) == pub->v_total &&
+           refresh_mhz + 10 >= pub->refresh_mhz && refresh_mhz <= pub->refresh_mhz + 10 &&
+           stats.pixels == pub->h_total * pub->v_total &&
+           stats.lines == pub->v_total &&
+           stats.vsync_lines == t->v_sync_width &&
+           stats.hsync_pixels == t->h_sync_width * pub->v_total &&
+           stats.active_pixels == (uint32_t) t->h_active * t->v_active;
+}
+
+// Find the nearest system clock at or below the one wanted, which is close
+// enough. Returns 0 if there isn't one.
+static uint32_t find_sys_clock_khz(uint32_t wanted_khz) {
+    if (wanted_khz > MAX_SYS_CLOCK_KHZ)
+        return 0;
+    uint vco, postdiv1, postdiv2;
+    for (uint32_t khz = wanted_khz; khz >= wanted_khz - wanted_khz * MAX_CLOCK_ERROR_PERMILLE / 1000; --khz)
+        if (check_sys_clock_khz(khz, &vco, &postdiv1, &postdiv2))
+            return khz;
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Main program
+
+static __force_inline uint16_t colour_rgb565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint16_t)r & 0xf8) << 8 | ((uint16_t)g & 0xfc) << 3 | ((uint16_t)b & 0xf8) >> 3;
+}
+
+static void set_pixel(uint32_t *line, uint x, uint16_t colour) {
+    if (mode->pixel_repeat == 2) {
+        // One pixel per word, in the low half
+        line[x] = colour;
+    } else {
+        uint shift = (x & 1) * 16;
+        line[x / 2] = (line[x / 2] & ~(0xffffu << shift)) | (uint32_t) colour << shift;
+    }
+}
+
+static void make_test_pattern() {
+    uint width = dvi_mode_width(mode), height = dvi_mode_height(mode);
+    uint16_t white = colour_rgb565(255, 255, 255);
+    for (uint i = 0; i < N_PATTERN_LINES; ++i) {
+        pattern[i] = malloc(dvi_mode_line_words(mode) * sizeof(uint32_t));
+        hard_assert(pattern[i]);
+    }
+    for (uint x = 0; x < width; ++x) {
+        uint bar = x * 8 / width;
+        set_pixel(pattern[LINE_BORDER], x, white);
+        set_pixel(pattern[LINE_BARS], x, colour_rgb565(bar & 1 ? 0 : 255, bar & 2 ? 0 : 255, bar & 4 ? 0 : 255));
+        uint8_t grey = (uint8_t) (x * 256 / width);
+        set_pixel(pattern[LINE_RAMP], x, colour_rgb565(grey, grey, grey));
+    }
+    set_pixel(pattern[LINE_BARS], 0, white);
+    set_pixel(pattern[LINE_BARS], width - 1, white);
+    set_pixel(pattern[LINE_RAMP], 0, white);
+    set_pixel(pattern[LINE_RAMP], width - 1, white);
+
+    line_data = malloc(height * sizeof(uint32_t *));
+    hard_assert(line_data);
+    for (uint y = 0; y < height; ++y) {
+        uint i = (y == 0 || y == height - 1) ? LINE_BORDER : y < height / 2 ? LINE_BARS : LINE_RAMP;
+        line_data[y] = pattern[i];
+    }
+}
+
+int main(void) {
+    stdio_init_all();
+    printf("DVI video modes example\n");
+
+    printf("%-4s %-16s %-9s %10s %10s %12s %s\n", "mode", "timing", "source", "pclk kHz", "refresh", "sys clk kHz",
+           "check");
+    bool all_ok = true;
+    for (uint i = 0; i < dvi_n_modes; ++i) {
+        const dvi_mode_t *m = &dvi_modes[i];
+        const dvi_timing_t *t = m->timing;
+        bool ok = check_mode(m);
+        all_ok &= ok;
+        uint32_t refresh_mhz = dvi_timing_refresh_mhz(t);
+        uint32_t sys_khz = find_sys_clock_khz(dvi_timing_hstx_clock_khz(t));
+        char source[12];
+        snprintf(source, sizeof(source), "%ux%u", (uint) dvi_mode_width(m), (uint) dvi_mode_height(m));
+        printf("%-4u %-16s %-9s %10u %6u.%03u ", i, t->name, source, (uint) t->pixel_clock_khz,
+               (uint) (refresh_mhz / 1000), (uint) (refresh_mhz % 1000));
+        if (sys_khz)
+            printf("%12u", (uint) sys_khz);
+        else
+            printf("%12s", "too fast");
+        printf(" %s\n", ok ? "ok" : "FAILED");
+    }
+    printf(all_ok ? "All modes match the published timings\n" : "Some modes are wrong\n");
+
+    mode = &dvi_modes[DVI_MODE];
+    uint32_t sys_khz = find_sys_clock_khz(dvi_timing_hstx_clock_khz(mode->timing));
+    if (!sys_khz) {
+        printf("Mode %u needs too fast a clock\n", DVI_MODE);
+        return 1;
+    }
+    set_sys_clock_khz(sys_khz, true);
+    stdio_init_all();
+    // Run HSTX from the system clock, so that one pixel is 5 system clocks
+    clock_configure(clk_hstx, 0, CLOCKS_CLK_HSTX_CTRL_AUXSRC_VALUE_CLK_SYS, sys_khz * 1000, sys_khz * 1000);
+    printf("Showing %s at %u x %u, system clock %u kHz\n", mode->timing->name, (uint) dvi_mode_width(mode),
+           (uint) dvi_mode_height(mode), (uint) sys_khz);
+
+    dvi_build_cmdlists(mode->timing, &cmdlists);
+    schedule_len = dvi_schedule_length(mode);
+    schedule = malloc(schedule_len * sizeof(dvi_dma_step_t));
+    hard_assert(schedule);
+    dvi_build_schedule(mode, &cmdlists, schedule);
+    make_test_pattern();
+
+    // Configure HSTX's TMDS encoder for RGB565
+    hstx_ctrl_hw->expand_tmds =
+        4  << HSTX_CTRL_EXPAND_TMDS_L2_NBITS_LSB |
+        8  << HSTX_CTRL_EXPAND_TMDS_L2_ROT_LSB   |
+        5  << HSTX_CTRL_EXPAND_TMDS_L1_NBITS_LSB |
+        3  << HSTX_CTRL_EXPAND_TMDS_L1_ROT_LSB   |
+        4  << HSTX_CTRL_EXPAND_TMDS_L0_NBITS_LSB |
+        29 << HSTX_CTRL_EXPAND_TMDS_L0_ROT_LSB;
+
+    // Pixels (TMDS) come in 2 16-bit chunks, or with a pixel repeat of 2, the
+    // low 16 bits twice. Control symbols (RAW) are an entire 32-bit word.
+    uint32_t enc_n_shifts, enc_shift;
+    dvi_mode_enc_shift(mode, &enc_n_shifts, &enc_shift);
+    hstx_ctrl_hw->expand_shift =
+        enc_n_shifts << HSTX_CTRL_EXPAND_SHIFT_ENC_N_SHIFTS_LSB |
+        enc_shift    << HSTX_CTRL_EXPAND_SHIFT_ENC_SHIFT_LSB |
+        1            << HSTX_CTRL_EXPAND_SHIFT_RAW_N_SHIFTS_LSB |
+        0            << HSTX_CTRL_EXPAND_SHIFT_RAW_SHIFT_LSB;
+
+    // Serial output config: clock period of 5 cycles, pop from command
+    // expander every 5 cycles, shift the output shiftreg by 2 every cycle.
+    hstx_ctrl_hw->csr = 0;
+    hstx_ctrl_hw->csr =
+        HSTX_CTRL_CSR_EXPAND_EN_BITS |
+        5u << HSTX_CTRL_CSR_CLKDIV_LSB |
+        5u << HSTX_CTRL_CSR_N_SHIFTS_LSB |
+        2u << HSTX_CTRL_CSR_SHIFT_LSB |
+        HSTX_CTRL_CSR_EN_BITS;
+
+    // Pinout as dvi_out_hstx_encoder (Pico DVI Sock)
+    hstx_ctrl_hw->bit[2] = HSTX_CTRL_BIT0_CLK_BITS;
+    hstx_ctrl_hw->bit[3] = HSTX_CTRL_BIT0_CLK_BITS | HSTX_CTRL_BIT0_INV_BITS;
+    for (uint lane = 0; lane < 3; ++lane) {
+        static const int lane_to_output_bit[3] = {0, 6, 4};
+        int bit = lane_to_output_bit[lane];
+        uint32_t lane_data_sel_bits =
+            (lane * 10    ) << HSTX_CTRL_BIT0_SEL_P_LSB |
+            (lane * 10 + 1) << HSTX_CTRL_BIT0_SEL_N_LSB;
+        hstx_ctrl_hw->bit[bit    ] = lane_data_sel_bits;
+        hstx_ctrl_hw->bit[bit + 1] = lane_data_sel_bits | HSTX_CTRL_BIT0_INV_BITS;
+    }
+
+    for (int i = 12; i <= 19; ++i) {
+        gpio_set_function(i, 0); // HSTX
+    }
+
+    // The first two steps are always blanking lines (see dvi_timing_valid)
+    dma_channel_config c;
+    c = dma_channel_get_default_config(DMACH_PING);
+    channel_config_set_chain_to(&c, DMACH_PONG);
+    channel_config_set_dreq(&c, DREQ_HSTX);
+    dma_channel_configure(
+        DMACH_PING,
+        &c,
+        &hstx_fifo_hw->fifo,
+        schedule[0].cmdlist,
+        schedule[0].count,
+        false
+    );
+    c = dma_channel_get_default_config(DMACH_PONG);
+    channel_config_set_chain_to(&c, DMACH_PING);
+    channel_config_set_dreq(&c, DREQ_HSTX);
+    dma_channel_configure(
+        DMACH_PONG,
+        &c,
+        &hstx_fifo_hw->fifo,
+        schedule[1].cmdlist,
+        schedule[1].count,
+        false
+    );
+
+    dma_hw->ints0 = (1u << DMACH_PING) | (1u << DMACH_PONG);
+    dma_hw->inte0 = (1u << DMACH_PING) | (1u << DMACH_PONG);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
+
+    dma_channel_start(DMACH_PING);
+
+    while (1)
+        __wfi();
+}
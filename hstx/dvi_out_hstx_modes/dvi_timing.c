@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stddef.h>
+
+#include "dvi_timing.h"
+
+// 640x480 60 Hz, CEA-861 VIC 1 and VESA DMT
+const dvi_timing_t dvi_timing_640x480p60 = {
+        .name = "640x480p60",
+        .pixel_clock_khz = 25175,
+        .h_active = 640, .h_front_porch = 16, .h_sync_width = 96, .h_back_porch = 48,
+        .v_active = 480, .v_front_porch = 10, .v_sync_width = 2, .v_back_porch = 33,
+        .h_sync_positive = false, .v_sync_positive = false,
+};
+
+// 720x480 60 Hz, CEA-861 VIC 2/3
+const dvi_timing_t dvi_timing_720x480p60 = {
+        .name = "720x480p60",
+        .pixel_clock_khz = 27000,
+        .h_active = 720, .h_front_porch = 16, .h_sync_width = 62, .h_back_porch = 60,
+        .v_active = 480, .v_front_porch = 9, .v_sync_width = 6, .v_back_porch = 30,
+        .h_sync_positive = false, .v_sync_positive = false,
+};
+
+// 800x600 60 Hz, VESA DMT
+const dvi_timing_t dvi_timing_800x600p60 = {
+        .name = "800x600p60",
+        .pixel_clock_khz = 40000,
+        .h_active = 800, .h_front_porch = 40, .h_sync_width = 128, .h_back_porch = 88,
+        .v_active = 600, .v_front_porch = 1, .v_sync_width = 4, .v_back_porch = 23,
+        .h_sync_positive = true, .v_sync_positive = true,
+};
+
+// 1280x720 60 Hz, CVT reduced blanking
+const dvi_timing_t dvi_timing_1280x720p60_rb = {
+        .name = "1280x720p60 RB",
+        .pixel_clock_khz = 64000,
+        .h_active = 1280, .h_front_porch = 48, .h_sync_width = 32, .h_back_porch = 80,
+        .v_active = 720, .v_front_porch = 3, .v_sync_width = 5, .v_back_porch = 13,
+        .h_sync_positive = true, .v_sync_positive = false,
+};
+
+const dvi_mode_t dvi_modes[] = {
+        {.timing = &dvi_timing_640x480p60, .pixel_repeat = 1},
+        {.timing = &dvi_timing_640x480p60, .pixel_repeat = 2},
+        {.timing = &dvi_timing_720x480p60, .pixel_repeat = 1},
+        {.timing = &dvi_timing_720x480p60, .pixel_repeat = 2},
+        {.timing = &dvi_timing_800x600p60, .pixel_repeat = 1},
+        {.timing = &dvi_timing_800x600p60, .pixel_repeat = 2},
+        {.timing = &dvi_timing_1280x720p60_rb, .pixel_repeat = 2},
+};
+const unsigned int dvi_n_modes = sizeof(dvi_modes) / sizeof(dvi_modes[0]);
+
+// TMDS control symbols, indexed by (vsync << 1) | hsync
+static const uint32_t tmds_ctrl[4] = {0x354u, 0x0abu, 0x154u, 0x2abu};
+
+// HSTX command counts are 12 bits
+#define HSTX_CMD_COUNT_MAX 0xfffu
+
+static uint32_t sync_symbol(const dvi_timing_t *t, bool vsync, bool hsync) {
+    unsigned int v = vsync == t->v_sync_positive;
+    unsigned int h = hsync == t->h_sync_positive;
+    // Lanes 1 and 2 carry CTRL 00
+    return tmds_ctrl[v << 1 | h] | tmds_ctrl[0] << 10 | tmds_ctrl[0] << 20;
+}
+
+bool dvi_timing_valid(const dvi_timing_t *t) {
+    return t->h_active && t->v_active && !(t->h_active & 1) &&
+           t->h_front_porch && t->h_sync_width && t->h_back_porch && t->v_sync_width &&
+           t->h_active <= HSTX_CMD_COUNT_MAX &&
+           t->h_back_porch + t->h_active <= HSTX_CMD_COUNT_MAX &&
+           // Both DMA channels are primed with the first two blanking lines
+           dvi_timing_v_blank(t) >= 2;
+}
+
+static unsigned int blank_line(const dvi_timing_t *t, uint32_t *list, bool vsync) {
+    unsigned int n = 0;
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | t->h_front_porch;
+    list[n++] = sync_symbol(t, vsync, false);
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | t->h_sync_width;
+    list[n++] = sync_symbol(t, vsync, true);
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | (t->h_back_porch + t->h_active);
+    list[n++] = sync_symbol(t, vsync, false);
+    list[n++] = DVI_HSTX_CMD_NOP;
+    return n;
+}
+
+void dvi_build_cmdlists(const dvi_timing_t *t, dvi_cmdlists_t *lists) {
+    lists->vblank_vsync_off_len = blank_line(t, lists->vblank_vsync_off, false);
+    lists->vblank_vsync_on_len = blank_line(t, lists->vblank_vsync_on, true);
+
+    // The NOPs pad this list out to the HSTX FIFO size, so that the DMA
+    // doesn't rapidly ping-pong and trip up the IRQs
+    uint32_t *list = lists->vactive;
+    unsigned int n = 0;
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | t->h_front_porch;
+    list[n++] = sync_symbol(t, false, false);
+    list[n++] = DVI_HSTX_CMD_NOP;
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | t->h_sync_width;
+    list[n++] = sync_symbol(t, false, true);
+    list[n++] = DVI_HSTX_CMD_NOP;
+    list[n++] = DVI_HSTX_CMD_RAW_REPEAT | t->h_back_porch;
+    list[n++] = sync_symbol(t, false, false);
+    list[n++] = DVI_HSTX_CMD_TMDS | t->h_active;
+    lists->vactive_len = n;
+}
+
+void dvi_build_schedule(const dvi_mode_t *mode, const dvi_cmdlists_t *lists, dvi_dma_step_t *steps) {
+    const dvi_timing_t *t = mode->timing;
+    uint32_t blank = dvi_timing_v_blank(t);
+    unsigned int n = 0;
+    for (uint32_t y = 0; y < blank; ++y) {
+        bool vsync = y >= t->v_front_porch && y < t->v_front_porch + t->v_sync_width;
+        steps[n].cmdlist = vsync ? lists->vblank_vsync_on : lists->vblank_vsync_off;
+        steps[n].count = vsync ? lists->vblank_vsync_on_len : lists->vblank_vsync_off_len;
+        steps[n++].line = -1;
+    }
+    for (uint32_t y = 0; y < t->v_active; ++y) {
+        steps[n].cmdlist = lists->vactive;
+        steps[n].count = lists->vactive_len;
+        steps[n++].line = -1;
+        steps[n].cmdlist = NULL;
+        steps[n].count = (uint16_t) dvi_mode_line_words(mode);
+        steps[n++].line = (int16_t) (y / mode->pixel_repeat);
+    }
+}
+
+// Returns -1 if the word isn't a sync symbol
+static int decode_sync(const dvi_timing_t *t, uint32_t word, bool *vsync, bool *hsync) {
+    for (unsigned int i = 0; i < 4; ++i) {
+        if (word == (tmds_ctrl[i] | tmds_ctrl[0] << 10 | tmds_ctrl[0] << 20)) {
+            *vsync = (bool) (i >> 1) == t->v_sync_positive;
+            *hsync = (bool) (i & 1) == t->h_sync_positive;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+bool dvi_schedule_measure(const dvi_mode_t *mode, const dvi_dma_step_t *steps, uint32_t n_steps,
+                          dvi_schedule_stats_t *stats) {
+    const dvi_timing_t *t = mode->timing;
+    *stats = (dvi_schedule_stats_t) {0};
+    // Pixel data words the last TMDS command is waiting for
+    uint32_t pending_words = 0;
+    for (uint32_t s = 0; s < n_steps; ++s) {
+        const dvi_dma_step_t *step = &steps[s];
+        if (step->line >= 0) {
+            if (step->count != pending_words || (uint32_t) step->line >= dvi_mode_height(mode))
+                return false;
+            pending_words = 0;
+            continue;
+        }
+        if (pending_words)
+            return false;
+        ++stats->lines;
+        bool line_has_vsync = false;
+        for (uint32_t i = 0; i < step->count; ++i) {
+            uint32_t cmd = step->cmdlist[i] & 0xf000u;
+            uint32_t count = step->cmdlist[i] & HSTX_CMD_COUNT_MAX;
+            if (cmd == DVI_HSTX_CMD_NOP)
+                continue;
+            stats->pixels += count;
+            if (cmd == DVI_HSTX_CMD_TMDS) {
+                // The data comes from the next step, so this must be last
+                if (i != step->count - 1u || (count & 1))
+                    return false;
+                stats->active_pixels += count;
+                pending_words = count / 2;
+                continue;
+            }
+            if (cmd != DVI_HSTX_CMD_RAW_REPEAT || i + 1 >= step->count)
+                return false;
+            bool vsync, hsync;
+            if (decode_sync(t, step->cmdlist[++i], &vsync, &hsync))
+                return false;
+            line_has_vsync |= vsync;
+            if (hsync)
+                stats->hsync_pixels += count;
+        }
+        if (line_has_vsync)
+            ++stats->vsync_lines;
+    }
+    return !pending_words;
+}
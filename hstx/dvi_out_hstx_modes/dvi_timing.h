@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _DVI_TIMING_H
+#define _DVI_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// DVI video modes, and the HSTX command lists and DMA schedule to output them.
+//
+// Each line starts with the front porch, then horizontal sync, back porch and
+// active pixels. Each frame likewise starts with the vertical front porch,
+// then vertical sync, back porch and active lines.
+//
+// The DMA schedule has one step per blanking line (a command list) and two
+// per active line (a command list ending in a TMDS command, then the pixel
+// data), in the same way as the dvi_out_hstx_encoder example. Pixels are
+// RGB565, 2 per 32-bit word. With a pixel repeat of 2, each word holds one
+// source pixel in its low half, shown twice, and each source line is sent
+// twice, so the source is half the width and height of the display.
+
+// HSTX clocks per pixel: 10 TMDS bits, 2 per clock
+#define DVI_HSTX_CLOCKS_PER_PIXEL 5
+
+// Command list length, padded with NOPs to be at least the HSTX FIFO size
+#define DVI_CMDLIST_MAX_WORDS 9
+
+#define DVI_HSTX_CMD_RAW         (0x0u << 12)
+#define DVI_HSTX_CMD_RAW_REPEAT  (0x1u << 12)
+#define DVI_HSTX_CMD_TMDS        (0x2u << 12)
+#define DVI_HSTX_CMD_TMDS_REPEAT (0x3u << 12)
+#define DVI_HSTX_CMD_NOP         (0xfu << 12)
+
+typedef struct {
+    const char *name;
+    uint32_t pixel_clock_khz;
+    uint16_t h_active;
+    uint16_t h_front_porch;
+    uint16_t h_sync_width;
+    uint16_t h_back_porch;
+    uint16_t v_active;
+    uint16_t v_front_porch;
+    uint16_t v_sync_width;
+    uint16_t v_back_porch;
+    bool h_sync_positive;
+    bool v_sync_positive;
+} dvi_timing_t;
+
+typedef struct {
+    const dvi_timing_t *timing;
+    // 1, or 2 to show each source pixel as 2x2
+    uint8_t pixel_repeat;
+} dvi_mode_t;
+
+extern const dvi_timing_t dvi_timing_640x480p60;
+extern const dvi_timing_t dvi_timing_720x480p60;
+extern const dvi_timing_t dvi_timing_800x600p60;
+extern const dvi_timing_t dvi_timing_1280x720p60_rb;
+
+extern const dvi_mode_t dvi_modes[];
+extern const unsigned int dvi_n_modes;
+
+static inline uint32_t dvi_timing_h_total(const dvi_timing_t *t) {
+    return t->h_active + t->h_front_porch + t->h_sync_width + t->h_back_porch;
+}
+
+static inline uint32_t dvi_timing_v_total(const dvi_timing_t *t) {
+    return t->v_active + t->v_front_porch + t->v_sync_width + t->v_back_porch;
+}
+
+static inline uint32_t dvi_timing_v_blank(const dvi_timing_t *t) {
+    return t->v_front_porch + t->v_sync_width + t->v_back_porch;
+}
+
+// Refresh rate in thousandths of a Hz
+static inline uint32_t dvi_timing_refresh_mhz(const dvi_timing_t *t) {
+    return (uint32_t) ((uint64_t) t->pixel_clock_khz * 1000000u / (dvi_timing_h_total(t) * dvi_timing_v_total(t)));
+}
+
+static inline uint32_t dvi_timing_hstx_clock_khz(const dvi_timing_t *t) {
+    return t->pixel_clock_khz * DVI_HSTX_CLOCKS_PER_PIXEL;
+}
+
+static inline uint32_t dvi_mode_width(const dvi_mode_t *mode) {
+    return mode->timing->h_active / mode->pixel_repeat;
+}
+
+static inline uint32_t dvi_mode_height(const dvi_mode_t *mode) {
+    return mode->timing->v_active / mode->pixel_repeat;
+}
+
+// Pixel data words per active line
+static inline uint32_t dvi_mode_line_words(const dvi_mode_t *mode) {
+    return mode->timing->h_active / 2;
+}
+
+// TMDS encoder shift settings (HSTX EXPAND_SHIFT ENC_N_SHIFTS and ENC_SHIFT)
+static inline void dvi_mode_enc_shift(const dvi_mode_t *mode, uint32_t *n_shifts, uint32_t *shift) {
+    *n_shifts = 2;
+    *shift = mode->pixel_repeat == 2 ? 0 : 16;
+}
+
+// Check the timing can be expressed in HSTX commands
+bool dvi_timing_valid(const dvi_timing_t *t);
+
+typedef struct {
+    uint32_t vblank_vsync_off[DVI_CMDLIST_MAX_WORDS];
+    uint32_t vblank_vsync_on[DVI_CMDLIST_MAX_WORDS];
+    uint32_t vactive[DVI_CMDLIST_MAX_WORDS];
+    uint16_t vblank_vsync_off_len;
+    uint16_t vblank_vsync_on_len;
+    uint16_t vactive_len;
+} dvi_cmdlists_t;
+
+void dvi_build_cmdlists(const dvi_timing_t *t, dvi_cmdlists_t *lists);
+
+// One DMA transfer: either a command list, or the pixels of a source line
+// (which the caller turns into an address)
+typedef struct {
+    const uint32_t *cmdlist;
+    uint16_t count;
+    int16_t line;
+} dvi_dma_step_t;
+
+static inline uint32_t dvi_schedule_length(const dvi_mode_t *mode) {
+    return dvi_timing_v_blank(mode->timing) + 2 * mode->timing->v_active;
+}
+
+// Fill in dvi_schedule_length() steps for one frame
+void dvi_build_schedule(const dvi_mode_t *mode, const dvi_cmdlists_t *lists, dvi_dma_step_t *steps);
+
+// Play the schedule through a model of the HSTX command expander, counting
+// pixel periods, lines, vsync lines and pixel data words. Returns false if
+// the commands and data don't match up.
+typedef struct {
+    uint32_t pixels;
+    uint32_t lines;
+    uint32_t vsync_lines;
+    uint32_t hsync_pixels;
+    uint32_t active_pixels;
+} dvi_schedule_stats_t;
+
+bool dvi_schedule_measure(const dvi_mode_t *mode, const dvi_dma_step_t *steps, uint32_t n_steps,
+                          dvi_schedule_stats_t *stats);
+
+#endif
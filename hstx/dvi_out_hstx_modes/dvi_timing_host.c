@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the DVI timings and command lists (dvi_timing.h), run on the host.
+// Build with PICO_PLATFORM=host.
+//
+// Every timing must have the totals, pixel clock, refresh rate and sync
+// polarities of its published CEA-861, DMT or CVT mode, and the sync symbols
+// in its command lists must drive the sync lines that way. Then the schedule
+// of every mode is played through the command expander model, and must give
+// a whole frame of the right shape.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "dvi_timing.h"
+
+typedef struct {
+    const dvi_timing_t *timing;
+    uint32_t pixel_clock_khz;
+    uint32_t h_total;
+    uint32_t v_total;
+    uint32_t refresh_mhz;
+    bool h_sync_positive;
+    bool v_sync_positive;
+} published_timing_t;
+
+static const published_timing_t published_timings[] = {
+        {&dvi_timing_640x480p60, 25175, 800, 525, 59940, false, false},
+        {&dvi_timing_720x480p60, 27000, 858, 525, 59940, false, false},
+        {&dvi_timing_800x600p60, 40000, 1056, 628, 60317, true, true},
+        {&dvi_timing_1280x720p60_rb, 64000, 1440, 741, 59979, true, false},
+};
+
+// TMDS control symbols from the DVI specification, indexed by C1 C0, where
+// lane 0 carries C0 = hsync and C1 = vsync
+static const uint32_t tmds_ctrl[4] = {0x354u, 0x0abu, 0x154u, 0x2abu};
+
+static uint errors;
+
+static void check(bool ok, const char *name, const char *what) {
+    if (!ok && !errors++)
+        printf("%s: %s is wrong\n", name, what);
+}
+
+static uint32_t sync_word(bool vsync_level, bool hsync_level) {
+    return tmds_ctrl[vsync_level << 1 | hsync_level] | tmds_ctrl[0] << 10 | tmds_ctrl[0] << 20;
+}
+
+static void check_timing(const published_timing_t *pub) {
+    const dvi_timing_t *t = pub->timing;
+    check(dvi_timing_valid(t), t->name, "Validity");
+    check(t->pixel_clock_khz == pub->pixel_clock_khz, t->name, "Pixel clock");
+    check(dvi_timing_hstx_clock_khz(t) == pub->pixel_clock_khz * 5, t->name, "HSTX clock");
+    check(dvi_timing_h_total(t) == pub->h_total, t->name, "Horizontal total");
+    check(dvi_timing_v_total(t) == pub->v_total, t->name, "Vertical total");
+    uint32_t refresh_mhz = dvi_timing_refresh_mhz(t);
+    check(refresh_mhz + 10 >= pub->refresh_mhz && refresh_mhz <= pub->refresh_mhz + 10, t->name, "Refresh rate");
+    check(t->h_sync_positive == pub->h_sync_positive, t->name, "Horizontal sync polarity");
+    check(t->v_sync_positive == pub->v_sync_positive, t->name, "Vertical sync polarity");
+
+    // Each blanking line is front porch, sync, then back porch and active,
+    // each a repeat command followed by its symbol
+    dvi_cmdlists_t lists;
+    dvi_build_cmdlists(t, &lists);
+    bool h_idle = !pub->h_sync_positive, v_idle = !pub->v_sync_positive;
+    check(lists.vblank_vsync_off[1] == sync_word(v_idle, h_idle) &&
+          lists.vblank_vsync_off[3] == sync_word(v_idle, !h_idle) &&
+          lists.vblank_vsync_off[5] == sync_word(v_idle, h_idle), t->name, "Blanking line sync levels");
+    check(lists.vblank_vsync_on[1] == sync_word(!v_idle, h_idle) &&
+          lists.vblank_vsync_on[3] == sync_word(!v_idle, !h_idle) &&
+          lists.vblank_vsync_on[5] == sync_word(!v_idle, h_idle), t->name, "Vertical sync line sync levels");
+    check(lists.vactive[1] == sync_word(v_idle, h_idle) && lists.vactive[4] == sync_word(v_idle, !h_idle) &&
+          lists.vactive[7] == sync_word(v_idle, h_idle), t->name, "Active line sync levels");
+    check(lists.vblank_vsync_off[2] == (DVI_HSTX_CMD_RAW_REPEAT | t->h_sync_width) &&
+          lists.vactive[lists.vactive_len - 1] == (DVI_HSTX_CMD_TMDS | t->h_active), t->name, "Command counts");
+}
+
+static void check_mode(const dvi_mode_t *mode) {
+    const dvi_timing_t *t = mode->timing;
+    dvi_cmdlists_t lists;
+    dvi_build_cmdlists(t, &lists);
+    uint32_t n = dvi_schedule_length(mode);
+    dvi_dma_step_t *steps = malloc(n * sizeof(dvi_dma_step_t));
+    dvi_build_schedule(mode, &lists, steps);
+    dvi_schedule_stats_t stats;
+    bool ok = dvi_schedule_measure(mode, steps, n, &stats);
+    check(ok, t->name, "Schedule");
+    uint32_t h_total = dvi_timing_h_total(t), v_total = dvi_timing_v_total(t);
+    check(stats.pixels == h_total * v_total, t->name, "Pixels per frame");
+    check(stats.lines == v_total, t->name, "Lines per frame");
+    check(stats.vsync_lines == t->v_sync_width, t->name, "Vertical sync lines");
+    check(stats.hsync_pixels == t->h_sync_width * v_total, t->name, "Horizontal sync pixels");
+    check(stats.active_pixels == (uint32_t) t->h_active * t->v_active, t->name, "Active pixels");
+
+    // Every source line is sent pixel_repeat times, in order
+    uint32_t line = 0, repeats = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (steps[i].line < 0)
+            continue;
+        if ((uint32_t) steps[i].line != line) {
+            check(repeats == mode->pixel_repeat && (uint32_t) steps[i].line == line + 1, t->name, "Line order");
+            line = steps[i].line;
+            repeats = 0;
+        }
+        ++repeats;
+    }
+    check(line + 1 == dvi_mode_height(mode) && repeats == mode->pixel_repeat, t->name, "Source lines");
+    free(steps);
+}
+
+int main() {
+    printf("DVI timing host tests\n");
+    for (uint i = 0; i < count_of(published_timings); ++i)
+        check_timing(&published_timings[i]);
+    for (uint i = 0; i < dvi_n_modes; ++i)
+        check_mode(&dvi_modes[i]);
+
+    // A broken timing must be caught by dvi_timing_valid()
+    dvi_timing_t bad = dvi_timing_640x480p60;
+    bad.h_active = 641;
+    check(!dvi_timing_valid(&bad), "Odd width", "Validity");
+    bad = dvi_timing_640x480p60;
+    bad.v_front_porch = 1;
+    bad.v_sync_width = 1;
+    bad.v_back_porch = 0;
+    check(dvi_timing_valid(&bad), "Two blanking lines", "Validity");
+    bad.v_sync_width = 0;
+    check(!dvi_timing_valid(&bad), "No vertical sync", "Validity");
+    bad = dvi_timing_640x480p60;
+    bad.h_back_porch = 0xfff;
+    check(!dvi_timing_valid(&bad), "Back porch and active too long", "Validity");
+
+    printf(errors ? "FAILED\n" : "All DVI timing checks passed\n");
+    return errors != 0;
+}
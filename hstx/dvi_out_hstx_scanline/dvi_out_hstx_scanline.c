@@ -0,0 +1,476 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Generate 640x480 RGB565 DVI output using HSTX, rendering each scanline just
+// before it is needed instead of keeping a frame buffer.
+//
+// The dvi_out_hstx_encoder example sends an RGB332 frame buffer which must be
+// entirely in memory; at RGB565 that would be 600 kB. Here core 1 renders
+// each line from tile, sprite and text layers (see scanline_compositor.h)
+// into a small ring of line buffers, a few lines ahead of the one being
+// sent. The DMA interrupt on core 0 sends each buffer as its line comes up,
+// and counts any lines that weren't ready in time. If core 1 gets behind, it
+// gives up on the lines already sent and carries on from the display's
+// current position, rather than staying late for the rest of the frame.
+//
+// Before starting the display, we time the rendering of each line of the
+// scene and compare it with the time available per line.
+//
+// The connections are the same as for dvi_out_hstx_encoder.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/bus_ctrl.h"
+#include "hardware/structs/hstx_ctrl.h"
+#include "hardware/structs/hstx_fifo.h"
+#include "pico/multicore.h"
+
+#include "scanline_compositor.h"
+#include "ssd1306_font.h"
+
+// ----------------------------------------------------------------------------
+// DVI constants
+
+#define TMDS_CTRL_00 0x354u
+#define TMDS_CTRL_01 0x0abu
+#define TMDS_CTRL_10 0x154u
+#define TMDS_CTRL_11 0x2abu
+
+#define SYNC_V0_H0 (TMDS_CTRL_00 | (TMDS_CTRL_00 << 10) | (TMDS_CTRL_00 << 20))
+#define SYNC_V0_H1 (TMDS_CTRL_01 | (TMDS_CTRL_00 << 10) | (TMDS_CTRL_00 << 20))
+#define SYNC_V1_H0 (TMDS_CTRL_10 | (TMDS_CTRL_00 << 10) | (TMDS_CTRL_00 << 20))
+#define SYNC_V1_H1 (TMDS_CTRL_11 | (TMDS_CTRL_00 << 10) | (TMDS_CTRL_00 << 20))
+
+#define MODE_H_SYNC_POLARITY 0
+#define MODE_H_FRONT_PORCH   16
+#define MODE_H_SYNC_WIDTH    96
+#define MODE_H_BACK_PORCH    48
+#define MODE_H_ACTIVE_PIXELS 640
+
+#define MODE_V_SYNC_POLARITY 0
+#define MODE_V_FRONT_PORCH   10
+#define MODE_V_SYNC_WIDTH    2
+#define MODE_V_BACK_PORCH    33
+#define MODE_V_ACTIVE_LINES  480
+
+#define MODE_H_TOTAL_PIXELS ( \
+    MODE_H_FRONT_PORCH + MODE_H_SYNC_WIDTH + \
+    MODE_H_BACK_PORCH  + MODE_H_ACTIVE_PIXELS \
+)
+#define MODE_V_TOTAL_LINES  ( \
+    MODE_V_FRONT_PORCH + MODE_V_SYNC_WIDTH + \
+    MODE_V_BACK_PORCH  + MODE_V_ACTIVE_LINES \
+)
+
+// HSTX clock of 125 MHz, 5 clocks per pixel
+#define PIXEL_CLOCK_HZ 25000000u
+
+#define HSTX_CMD_RAW         (0x0u << 12)
+#define HSTX_CMD_RAW_REPEAT  (0x1u << 12)
+#define HSTX_CMD_TMDS        (0x2u << 12)
+#define HSTX_CMD_TMDS_REPEAT (0x3u << 12)
+#define HSTX_CMD_NOP         (0xfu << 12)
+
+// ----------------------------------------------------------------------------
+// HSTX command lists
+
+// Lists are padded with NOPs to be >= HSTX FIFO size, to avoid DMA rapidly
+// pingponging and tripping up the IRQs.
+
+static uint32_t vblank_line_vsync_off[] = {
+    HSTX_CMD_RAW_REPEAT | MODE_H_FRONT_PORCH,
+    SYNC_V1_H1,
+    HSTX_CMD_RAW_REPEAT | MODE_H_SYNC_WIDTH,
+    SYNC_V1_H0,
+    HSTX_CMD_RAW_REPEAT | (MODE_H_BACK_PORCH + MODE_H_ACTIVE_PIXELS),
+    SYNC_V1_H1,
+    HSTX_CMD_NOP
+};
+
+static uint32_t vblank_line_vsync_on[] = {
+    HSTX_CMD_RAW_REPEAT | MODE_H_FRONT_PORCH,
+    SYNC_V0_H1,
+    HSTX_CMD_RAW_REPEAT | MODE_H_SYNC_WIDTH,
+    SYNC_V0_H0,
+    HSTX_CMD_RAW_REPEAT | (MODE_H_BACK_PORCH + MODE_H_ACTIVE_PIXELS),
+    SYNC_V0_H1,
+    HSTX_CMD_NOP
+};
+
+static uint32_t vactive_line[] = {
+    HSTX_CMD_RAW_REPEAT | MODE_H_FRONT_PORCH,
+    SYNC_V1_H1,
+    HSTX_CMD_NOP,
+    HSTX_CMD_RAW_REPEAT | MODE_H_SYNC_WIDTH,
+    SYNC_V1_H0,
+    HSTX_CMD_NOP,
+    HSTX_CMD_RAW_REPEAT | MODE_H_BACK_PORCH,
+    SYNC_V1_H1,
+    HSTX_CMD_TMDS       | MODE_H_ACTIVE_PIXELS
+};
+
+// ----------------------------------------------------------------------------
+// Line buffers
+
+// Active lines are numbered from 0 since the start, across frames, so line n
+// goes in buffer n % N_LINE_BUFS. When the interrupt posts line n, line n - 1
+// has finished sending, so core 1 may render up to N_LINE_BUFS - 2 lines
+// ahead of the last one posted. If core 1 falls behind, it drops the lines
+// that have already gone out and starts again just ahead of the display.
+#define N_LINE_BUFS 4
+
+static uint16_t line_buf[N_LINE_BUFS][MODE_H_ACTIVE_PIXELS];
+static volatile uint32_t line_rendered[N_LINE_BUFS];
+static volatile uint32_t lines_posted;
+static volatile uint32_t late_lines;
+static volatile uint32_t dropped_lines;
+
+// ----------------------------------------------------------------------------
+// DMA logic
+
+#define DMACH_PING 0
+#define DMACH_PONG 1
+
+// First we ping. Then we pong. Then... we ping again.
+static bool dma_pong = false;
+
+// A ping and a pong are cued up initially, so the first time we enter this
+// handler it is to cue up the second ping after the first ping has completed.
+// This is the third scanline overall (-> =2 because zero-based).
+static uint v_scanline = 2;
+
+// During the vertical active period, we take two IRQs per scanline: one to
+// post the command list, and another to post the pixels.
+static bool vactive_cmdlist_posted = false;
+
+void __scratch_x("") dma_irq_handler() {
+    // dma_pong indicates the channel that just finished, which is the one
+    // we're about to reload.
+    uint ch_num = dma_pong ? DMACH_PONG : DMACH_PING;
+    dma_channel_hw_t *ch = &dma_hw->ch[ch_num];
+    dma_hw->intr = 1u << ch_num;
+    dma_pong = !dma_pong;
+
+    if (v_scanline >= MODE_V_FRONT_PORCH && v_scanline < (MODE_V_FRONT_PORCH + MODE_V_SYNC_WIDTH)) {
+        ch->read_addr = (uintptr_t)vblank_line_vsync_on;
+        ch->transfer_count = count_of(vblank_line_vsync_on);
+    } else if (v_scanline < MODE_V_FRONT_PORCH + MODE_V_SYNC_WIDTH + MODE_V_BACK_PORCH) {
+        ch->read_addr = (uintptr_t)vblank_line_vsync_off;
+        ch->transfer_count = count_of(vblank_line_vsync_off);
+    } else if (!vactive_cmdlist_posted) {
+        ch->read_addr = (uintptr_t)vactive_line;
+        ch->transfer_count = count_of(vactive_line);
+        vactive_cmdlist_posted = true;
+    } else {
+        // If core 1 is behind, the buffer still holds an older line, which
+        // is sent anyway
+        uint32_t n = lines_posted;
+        uint buf = n % N_LINE_BUFS;
+        if (line_rendered[buf] != n)
+            late_lines = late_lines + 1;
+        ch->read_addr = (uintptr_t)line_buf[buf];
+        ch->transfer_count = MODE_H_ACTIVE_PIXELS * sizeof(uint16_t) / sizeof(uint32_t);
+        lines_posted = n + 1;
+        vactive_cmdlist_posted = false;
+    }
+
+    if (!vactive_cmdlist_posted) {
+        v_scanline = (v_scanline + 1) % MODE_V_TOTAL_LINES;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Scene
+
+#define LOG_MAP_SIZE 6
+#define MAP_SIZE (1 << LOG_MAP_SIZE)
+#define N_TILES 16
+#define N_SPRITES 48
+#define SPRITE_SIZE 16
+#define TEXT_COLUMNS (MODE_H_ACTIVE_PIXELS / SCANLINE_TILE_SIZE)
+
+static scanline_compositor_t comp;
+static uint8_t tiles[N_TILES * SCANLINE_TILE_SIZE * SCANLINE_TILE_SIZE];
+static uint8_t tile_map[MAP_SIZE * MAP_SIZE];
+static uint16_t tile_palette[256];
+static uint8_t ball[SPRITE_SIZE * SPRITE_SIZE];
+static uint16_t ball_palette[N_SPRITES][256];
+static scanline_sprite_t sprites[N_SPRITES];
+static int8_t sprite_dx[N_SPRITES], sprite_dy[N_SPRITES];
+static uint8_t row_font[256 * SCANLINE_TILE_SIZE];
+static uint8_t text[TEXT_COLUMNS];
+
+static __force_inline uint16_t colour_rgb565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint16_t)r & 0xf8) << 8 | ((uint16_t)g & 0xfc) << 3 | ((uint16_t)b & 0xf8) >> 3;
+}
+
+// The SSD1306 font has a byte per column for ' ', 'A'-'Z' then '0'-'9'; we
+// want a byte per row, indexed by ASCII code
+static void make_font() {
+    static const char chars[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    for (uint i = 0; i < count_of(chars) - 1; ++i) {
+        uint8_t *glyph = &row_font[(uint8_t) chars[i] * SCANLINE_TILE_SIZE];
+        for (uint col = 0; col < SCANLINE_TILE_SIZE; ++col)
+            for (uint row = 0; row < SCANLINE_TILE_SIZE; ++row)
+                if (font[i * SCANLINE_TILE_SIZE + col] & (1u << row))
+                    glyph[row] |= 0x80u >> col;
+    }
+}
+
+static void set_text(const char *s) {
+    for (uint i = 0; i < TEXT_COLUMNS; ++i) {
+        char c = *s ? *s++ : ' ';
+        text[i] = (uint8_t) ((c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c);
+    }
+}
+
+static void make_scene() {
+    scanline_compositor_init(&comp, MODE_H_ACTIVE_PIXELS, MODE_V_ACTIVE_LINES);
+
+    // Tiles are bricks and gradients in 16 shades of one palette
+    for (uint t = 0; t < N_TILES; ++t) {
+        for (uint y = 0; y < SCANLINE_TILE_SIZE; ++y) {
+            for (uint x = 0; x < SCANLINE_TILE_SIZE; ++x) {
+                bool mortar = (t & 1) && (y == 0 || x == ((y < 4) ? 0 : 4));
+                tiles[(t * SCANLINE_TILE_SIZE + y) * SCANLINE_TILE_SIZE + x] =
+                        (uint8_t) (mortar ? 255 : t * 16 + (x + y) * 15 / 14);
+            }
+        }
+    }
+    for (uint i = 0; i < 256; ++i)
+        tile_palette[i] = colour_rgb565((i >> 4) * 16, (i & 15) * 8, 128 - (i >> 4) * 8);
+    tile_palette[255] = colour_rgb565(200, 200, 200);
+    for (uint i = 0; i < count_of(tile_map); ++i)
+        tile_map[i] = (uint8_t) (rand() % N_TILES);
+    comp.tiles = (scanline_tile_layer_t) {
+            .tiles = tiles,
+            .map = tile_map,
+            .palette = tile_palette,
+            .log_map_width = LOG_MAP_SIZE,
+            .log_map_height = LOG_MAP_SIZE,
+            .enabled = true,
+    };
+
+    // Shaded balls, each with its own colour
+    for (int y = 0; y < SPRITE_SIZE; ++y) {
+        for (int x = 0; x < SPRITE_SIZE; ++x) {
+            int dx = 2 * x - SPRITE_SIZE + 1, dy = 2 * y - SPRITE_SIZE + 1;
+            int d2 = dx * dx + dy * dy;
+            ball[y * SPRITE_SIZE + x] = d2 < SPRITE_SIZE * SPRITE_SIZE ? (uint8_t) (255 - d2 * 254 / (SPRITE_SIZE * SPRITE_SIZE)) : 0;
+        }
+    }
+    for (uint i = 0; i < N_SPRITES; ++i) {
+        uint r = rand() & 0xff, g = rand() & 0xff, b = rand() & 0xff;
+        for (uint j = 0; j < 256; ++j)
+            ball_palette[i][j] = colour_rgb565(r * j / 255, g * j / 255, b * j / 255);
+        sprites[i] = (scanline_sprite_t) {
+                .pixels = ball,
+                .palette = ball_palette[i],
+                .x = rand() % (MODE_H_ACTIVE_PIXELS - SPRITE_SIZE),
+                .y = rand() % (MODE_V_ACTIVE_LINES - SPRITE_SIZE),
+                .width = SPRITE_SIZE,
+                .height = SPRITE_SIZE,
+                .visible = true,
+        };
+        sprite_dx[i] = (int8_t) (rand() % 7 - 3);
+        sprite_dy[i] = (int8_t) (rand() % 7 - 3);
+    }
+    comp.sprites = sprites;
+    comp.n_sprites = N_SPRITES;
+
+    // Status line along the top
+    make_font();
+    comp.text = (scanline_text_layer_t) {
+            .font = row_font,
+            .text = text,
+            .columns = TEXT_COLUMNS,
+            .rows = 1,
+            .fg = colour_rgb565(255, 255, 255),
+            .bg = colour_rgb565(0, 0, 96),
+            .opaque = true,
+            .enabled = true,
+    };
+    set_text("SCANLINE RENDERING");
+}
+
+// Called by core 1 between frames
+static void animate_scene() {
+    comp.tiles.scroll_x++;
+    comp.tiles.scroll_y += 2;
+    for (uint i = 0; i < N_SPRITES; ++i) {
+        scanline_sprite_t *s = &sprites[i];
+        if (s->x + sprite_dx[i] < 0 || s->x + sprite_dx[i] > MODE_H_ACTIVE_PIXELS - SPRITE_SIZE)
+            sprite_dx[i] = (int8_t) -sprite_dx[i];
+        if (s->y + sprite_dy[i] < 0 || s->y + sprite_dy[i] > MODE_V_ACTIVE_LINES - SPRITE_SIZE)
+            sprite_dy[i] = (int8_t) -sprite_dy[i];
+        s->x = (int16_t) (s->x + sprite_dx[i]);
+        s->y = (int16_t) (s->y + sprite_dy[i]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Rendering on core 1
+
+static void core1_main() {
+    uint32_t n = 0;
+    uint32_t animated_frame = ~0u;
+    while (true) {
+        // Wait until the buffer for line n is no longer being sent
+        while ((int32_t) (n - lines_posted) > N_LINE_BUFS - 2)
+            tight_loop_contents();
+        // Line n has already been sent, and so have any after it up to
+        // lines_posted. Rendering them would only keep us behind, so skip to
+        // the line after the next one to go out, which leaves a whole line's
+        // time to draw it.
+        uint32_t posted = lines_posted;
+        if ((int32_t) (n - posted) < 0) {
+            dropped_lines = dropped_lines + (posted + 1 - n);
+            n = posted + 1;
+        }
+        // Once per frame, even if the first lines were dropped
+        if (n / MODE_V_ACTIVE_LINES != animated_frame) {
+            animate_scene();
+            animated_frame = n / MODE_V_ACTIVE_LINES;
+        }
+        uint y = n % MODE_V_ACTIVE_LINES;
+        scanline_render_line(&comp, y, line_buf[n % N_LINE_BUFS]);
+        __dmb();
+        line_rendered[n % N_LINE_BUFS] = n;
+        ++n;
+    }
+}
+
+// Time to render each line of the current scene, in system clock cycles
+static void benchmark_lines() {
+    const uint repeats = 8;
+    uint32_t clk_hz = clock_get_hz(clk_sys);
+    uint32_t budget = (uint32_t) ((uint64_t) clk_hz * MODE_H_TOTAL_PIXELS / PIXEL_CLOCK_HZ);
+    uint32_t worst = 0, worst_y = 0;
+    uint64_t total = 0;
+    for (uint y = 0; y < MODE_V_ACTIVE_LINES; ++y) {
+        uint64_t start = time_us_64();
+        for (uint i = 0; i < repeats; ++i)
+            scanline_render_line(&comp, y, line_buf[0]);
+        uint32_t cycles = (uint32_t) ((time_us_64() - start) * (clk_hz / 1000000) / repeats);
+        total += cycles;
+        if (cycles > worst) {
+            worst = cycles;
+            worst_y = y;
+        }
+    }
+    printf("Render: average %u cycles/line, worst %u (line %u), budget %u cycles/line\n",
+           (uint) (total / MODE_V_ACTIVE_LINES), (uint) worst, (uint) worst_y, (uint) budget);
+    printf("Worst line uses %u%% of core 1\n", (uint) (worst * 100 / budget));
+}
+
+// ----------------------------------------------------------------------------
+// Main program
+
+int main(void) {
+    stdio_init_all();
+    printf("DVI scanline rendering example\n");
+
+    make_scene();
+    benchmark_lines();
+
+    // Configure HSTX's TMDS encoder for RGB565
+    hstx_ctrl_hw->expand_tmds =
+        4  << HSTX_CTRL_EXPAND_TMDS_L2_NBITS_LSB |
+        8  << HSTX_CTRL_EXPAND_TMDS_L2_ROT_LSB   |
+        5  << HSTX_CTRL_EXPAND_TMDS_L1_NBITS_LSB |
+        3  << HSTX_CTRL_EXPAND_TMDS_L1_ROT_LSB   |
+        4  << HSTX_CTRL_EXPAND_TMDS_L0_NBITS_LSB |
+        29 << HSTX_CTRL_EXPAND_TMDS_L0_ROT_LSB;
+
+    // Pixels (TMDS) come in 2 16-bit chunks. Control symbols (RAW) are an
+    // entire 32-bit word.
+    hstx_ctrl_hw->expand_shift =
+        2  << HSTX_CTRL_EXPAND_SHIFT_ENC_N_SHIFTS_LSB |
+        16 << HSTX_CTRL_EXPAND_SHIFT_ENC_SHIFT_LSB |
+        1  << HSTX_CTRL_EXPAND_SHIFT_RAW_N_SHIFTS_LSB |
+        0  << HSTX_CTRL_EXPAND_SHIFT_RAW_SHIFT_LSB;
+
+    // Serial output config: clock period of 5 cycles, pop from command
+    // expander every 5 cycles, shift the output shiftreg by 2 every cycle.
+    hstx_ctrl_hw->csr = 0;
+    hstx_ctrl_hw->csr =
+        HSTX_CTRL_CSR_EXPAND_EN_BITS |
+        5u << HSTX_CTRL_CSR_CLKDIV_LSB |
+        5u << HSTX_CTRL_CSR_N_SHIFTS_LSB |
+        2u << HSTX_CTRL_CSR_SHIFT_LSB |
+        HSTX_CTRL_CSR_EN_BITS;
+
+    // Pinout as dvi_out_hstx_encoder (Pico DVI Sock)
+    hstx_ctrl_hw->bit[2] = HSTX_CTRL_BIT0_CLK_BITS;
+    hstx_ctrl_hw->bit[3] = HSTX_CTRL_BIT0_CLK_BITS | HSTX_CTRL_BIT0_INV_BITS;
+    for (uint lane = 0; lane < 3; ++lane) {
+        static const int lane_to_output_bit[3] = {0, 6, 4};
+        int bit = lane_to_output_bit[lane];
+        uint32_t lane_data_sel_bits =
+            (lane * 10    ) << HSTX_CTRL_BIT0_SEL_P_LSB |
+            (lane * 10 + 1) << HSTX_CTRL_BIT0_SEL_N_LSB;
+        hstx_ctrl_hw->bit[bit    ] = lane_data_sel_bits;
+        hstx_ctrl_hw->bit[bit + 1] = lane_data_sel_bits | HSTX_CTRL_BIT0_INV_BITS;
+    }
+
+    for (int i = 12; i <= 19; ++i) {
+        gpio_set_function(i, 0); // HSTX
+    }
+
+    // Let core 1 fill the line buffers before the first active line
+    for (uint i = 0; i < N_LINE_BUFS; ++i)
+        line_rendered[i] = ~0u;
+    multicore_launch_core1(core1_main);
+
+    dma_channel_config c;
+    c = dma_channel_get_default_config(DMACH_PING);
+    channel_config_set_chain_to(&c, DMACH_PONG);
+    channel_config_set_dreq(&c, DREQ_HSTX);
+    dma_channel_configure(
+        DMACH_PING,
+        &c,
+        &hstx_fifo_hw->fifo,
+        vblank_line_vsync_off,
+        count_of(vblank_line_vsync_off),
+        false
+    );
+    c = dma_channel_get_default_config(DMACH_PONG);
+    channel_config_set_chain_to(&c, DMACH_PING);
+    channel_config_set_dreq(&c, DREQ_HSTX);
+    dma_channel_configure(
+        DMACH_PONG,
+        &c,
+        &hstx_fifo_hw->fifo,
+        vblank_line_vsync_off,
+        count_of(vblank_line_vsync_off),
+        false
+    );
+
+    dma_hw->ints0 = (1u << DMACH_PING) | (1u << DMACH_PONG);
+    dma_hw->inte0 = (1u << DMACH_PING) | (1u << DMACH_PONG);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
+
+    dma_channel_start(DMACH_PING);
+
+    while (1) {
+        sleep_ms(1000);
+        char status[TEXT_COLUMNS + 1];
+        snprintf(status, sizeof(status), "SCANLINE RENDERING   %u LATE LINES", (uint) late_lines);
+        set_text(status);
+        printf("%u lines sent, %u late, %u dropped by core 1\n", (uint) lines_posted, (uint) late_lines,
+               (uint) dropped_lines);
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "scanline_compositor.h"
+
+void scanline_compositor_init(scanline_compositor_t *comp, uint16_t width, uint16_t height) {
+    *comp = (scanline_compositor_t) {
+            .width = width,
+            .height = height,
+    };
+}
+
+static void render_tiles(const scanline_tile_layer_t *layer, unsigned int y, uint16_t *line, unsigned int width) {
+    unsigned int map_w = 1u << layer->log_map_width;
+    unsigned int x_mask = (map_w << 3) - 1;
+    unsigned int y_mask = (SCANLINE_TILE_SIZE << layer->log_map_height) - 1;
+    unsigned int map_y = (y + layer->scroll_y) & y_mask;
+    const uint8_t *map_row = layer->map + (map_y / SCANLINE_TILE_SIZE) * map_w;
+    unsigned int tile_row = (map_y % SCANLINE_TILE_SIZE) * SCANLINE_TILE_SIZE;
+    const uint16_t *palette = layer->palette;
+
+    unsigned int map_x = layer->scroll_x & x_mask;
+    unsigned int x = 0;
+    // Partial tile at the left edge, then whole tiles
+    while (x < width) {
+        const uint8_t *src = layer->tiles + map_row[map_x / SCANLINE_TILE_SIZE] * 64 + tile_row;
+        unsigned int start = map_x % SCANLINE_TILE_SIZE;
+        if (start == 0 && x + SCANLINE_TILE_SIZE <= width) {
+            uint16_t *dst = line + x;
+            dst[0] = palette[src[0]];
+            dst[1] = palette[src[1]];
+            dst[2] = palette[src[2]];
+            dst[3] = palette[src[3]];
+            dst[4] = palette[src[4]];
+            dst[5] = palette[src[5]];
+            dst[6] = palette[src[6]];
+            dst[7] = palette[src[7]];
+            x += SCANLINE_TILE_SIZE;
+            map_x = (map_x + SCANLINE_TILE_SIZE) & x_mask;
+        } else {
+            unsigned int n = SCANLINE_TILE_SIZE - start;
+            if (n > width - x)
+                n = width - x;
+            for (unsigned int i = 0; i < n; ++i)
+                line[x + i] = palette[src[start + i]];
+            x += n;
+            map_x = (map_x + n) & x_mask;
+        }
+    }
+}
+
+static void render_sprite(const scanline_sprite_t *sprite, unsigned int y, uint16_t *line, unsigned int width) {
+    int row = (int) y - sprite->y;
+    if (!sprite->visible || row < 0 || row >= sprite->height)
+        return;
+    int x0 = sprite->x, x1 = sprite->x + sprite->width;
+    int skip = 0;
+    if (x0 < 0) {
+        skip = -x0;
+        x0 = 0;
+    }
+    if (x1 > (int) width)
+        x1 = (int) width;
+    const uint8_t *src = sprite->pixels + row * sprite->width + skip;
+    const uint16_t *palette = sprite->palette;
+    for (int x = x0; x < x1; ++x) {
+        uint8_t p = *src++;
+        if (p)
+            line[x] = palette[p];
+    }
+}
+
+static void render_text(const scanline_text_layer_t *layer, unsigned int y, uint16_t *line, unsigned int width) {
+    int text_y = (int) y - layer->y;
+    if (text_y < 0 || text_y >= layer->rows * SCANLINE_TILE_SIZE)
+        return;
+    const uint8_t *chars = layer->text + (text_y / SCANLINE_TILE_SIZE) * layer->columns;
+    const uint8_t *font = layer->font + text_y % SCANLINE_TILE_SIZE;
+    uint16_t fg = layer->fg, bg = layer->bg;
+    for (unsigned int col = 0; col < layer->columns; ++col) {
+        int x = layer->x + (int) col * SCANLINE_TILE_SIZE;
+        if (x >= (int) width)
+            break;
+        if (x + SCANLINE_TILE_SIZE <= 0)
+            continue;
+        uint8_t bits = font[chars[col] * SCANLINE_TILE_SIZE];
+        if (!bits && !layer->opaque)
+            continue;
+        for (unsigned int i = 0; i < SCANLINE_TILE_SIZE; ++i, bits <<= 1) {
+            int px = x + (int) i;
+            if (px < 0 || px >= (int) width)
+                continue;
+            if (bits & 0x80)
+                line[px] = fg;
+            else if (layer->opaque)
+                line[px] = bg;
+        }
+    }
+}
+
+void scanline_render_line(const scanline_compositor_t *comp, unsigned int y, uint16_t *line) {
+    unsigned int width = comp->width;
+    if (comp->tiles.enabled) {
+        render_tiles(&comp->tiles, y, line, width);
+    } else {
+        for (unsigned int x = 0; x < width; ++x)
+            line[x] = comp->background;
+    }
+    for (unsigned int i = 0; i < comp->n_sprites; ++i)
+        render_sprite(&comp->sprites[i], y, line, width);
+    if (comp->text.enabled)
+        render_text(&comp->text, y, line, width);
+}
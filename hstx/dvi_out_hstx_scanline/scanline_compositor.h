@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _SCANLINE_COMPOSITOR_H
+#define _SCANLINE_COMPOSITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Renders a display one RGB565 line at a time from layers, so there need not
+// be a frame buffer. From bottom to top:
+//
+// - A background colour
+//
+// - A scrolling tile map of 8x8 tiles with 8-bit pixels, looked up in a
+//   palette. The map is a power of two tiles wide and high, and wraps.
+//
+// - Sprites with 8-bit pixels, each with its own palette. Pixel value 0 is
+//   transparent. Later sprites are drawn over earlier ones.
+//
+// - A text layer of 8x8 characters from a 1 bit per pixel font, with an
+//   optional background colour.
+//
+// Only the layer data for the one line is looked at, so the time taken
+// depends on what is on that line, not on the size of the display.
+
+#define SCANLINE_TILE_SIZE 8
+#define SCANLINE_MAX_SPRITES 64
+
+typedef struct {
+    // 64 bytes for each tile, row by row
+    const uint8_t *tiles;
+    // Tile numbers, row by row, (1 << log_map_width) by (1 << log_map_height)
+    const uint8_t *map;
+    const uint16_t *palette;
+    uint8_t log_map_width;
+    uint8_t log_map_height;
+    // Map pixel shown at the top left of the display
+    uint16_t scroll_x;
+    uint16_t scroll_y;
+    bool enabled;
+} scanline_tile_layer_t;
+
+typedef struct {
+    // width * height pixels, row by row
+    const uint8_t *pixels;
+    const uint16_t *palette;
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    bool visible;
+} scanline_sprite_t;
+
+typedef struct {
+    // 8 bytes per character, top row first, leftmost pixel in the MSB
+    const uint8_t *font;
+    // columns * rows characters, row by row
+    const uint8_t *text;
+    uint16_t columns;
+    uint16_t rows;
+    int16_t x;
+    int16_t y;
+    uint16_t fg;
+    uint16_t bg;
+    bool opaque;
+    bool enabled;
+} scanline_text_layer_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t background;
+    scanline_tile_layer_t tiles;
+    scanline_sprite_t *sprites;
+    unsigned int n_sprites;
+    scanline_text_layer_t text;
+} scanline_compositor_t;
+
+// Set the display size, with a black background and every layer disabled
+void scanline_compositor_init(scanline_compositor_t *comp, uint16_t width, uint16_t height);
+
+// Render line y into line, which has room for comp->width pixels
+void scanline_render_line(const scanline_compositor_t *comp, unsigned int y, uint16_t *line);
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the line compositor (scanline_compositor.h), run on the host.
+// Build with PICO_PLATFORM=host.
+//
+// A few pixels of each layer are checked by hand: the background, a scrolled
+// tile map wrapping at its edges, transparent and overlapping sprites off the
+// edges of the display, and opaque and transparent text. Then random scenes
+// are rendered line by line, and every pixel must be what a simple pixel at a
+// time renderer gives.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "scanline_compositor.h"
+
+#define WIDTH 100
+#define HEIGHT 60
+#define N_SPRITES 12
+
+static uint8_t tiles[256 * 64];
+static uint8_t map[1 << 8];
+static uint16_t palette[256];
+static uint8_t sprite_pixels[N_SPRITES][32 * 32];
+static uint16_t sprite_palettes[N_SPRITES][256];
+static scanline_sprite_t sprites[N_SPRITES];
+static uint8_t font[256 * 8];
+static uint8_t text[20 * 10];
+static uint16_t line[WIDTH];
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+// The colour of one pixel, working down from the top layer
+static uint16_t reference_pixel(const scanline_compositor_t *comp, int x, int y) {
+    const scanline_text_layer_t *text_layer = &comp->text;
+    if (text_layer->enabled) {
+        int tx = x - text_layer->x, ty = y - text_layer->y;
+        if (tx >= 0 && ty >= 0 && tx < text_layer->columns * 8 && ty < text_layer->rows * 8) {
+            uint8_t c = text_layer->text[(ty / 8) * text_layer->columns + tx / 8];
+            if (text_layer->font[c * 8 + ty % 8] & (0x80 >> (tx % 8)))
+                return text_layer->fg;
+            if (text_layer->opaque)
+                return text_layer->bg;
+        }
+    }
+    for (int i = (int) comp->n_sprites - 1; i >= 0; --i) {
+        const scanline_sprite_t *s = &comp->sprites[i];
+        int sx = x - s->x, sy = y - s->y;
+        if (s->visible && sx >= 0 && sy >= 0 && sx < s->width && sy < s->height && s->pixels[sy * s->width + sx])
+            return s->palette[s->pixels[sy * s->width + sx]];
+    }
+    const scanline_tile_layer_t *t = &comp->tiles;
+    if (!t->enabled)
+        return comp->background;
+    uint mx = (x + t->scroll_x) % (8u << t->log_map_width);
+    uint my = (y + t->scroll_y) % (8u << t->log_map_height);
+    uint tile = t->map[(my / 8 << t->log_map_width) + mx / 8];
+    return t->palette[t->tiles[tile * 64 + (my % 8) * 8 + mx % 8]];
+}
+
+static void check_background(void) {
+    scanline_compositor_t comp;
+    scanline_compositor_init(&comp, WIDTH, HEIGHT);
+    comp.background = 0x1234;
+    scanline_render_line(&comp, 7, line);
+    bool ok = true;
+    for (uint x = 0; x < WIDTH; ++x)
+        ok &= line[x] == 0x1234;
+    check(ok, "Background");
+}
+
+// Tile n has every pixel n, and each palette entry is its own index, so the
+// colour is the tile number
+static void check_tiles(void) {
+    static uint8_t flat_tiles[4 * 64];
+    static uint16_t identity[4];
+    static const uint8_t small_map[4 * 2] = {0, 1, 2, 3,
+                                             3, 2, 1, 0};
+    for (uint i = 0; i < count_of(flat_tiles); ++i)
+        flat_tiles[i] = (uint8_t) (i / 64);
+    for (uint i = 0; i < count_of(identity); ++i)
+        identity[i] = (uint16_t) i;
+    scanline_compositor_t comp;
+    scanline_compositor_init(&comp, WIDTH, HEIGHT);
+    comp.tiles = (scanline_tile_layer_t) {.tiles = flat_tiles, .map = small_map, .palette = identity,
+                                          .log_map_width = 2, .log_map_height = 1, .enabled = true};
+    scanline_render_line(&comp, 0, line);
+    check(line[0] == 0 && line[8] == 1 && line[31] == 3 && line[32] == 0 && line[99] == 0, "Unscrolled tiles");
+    // Scrolled part way into a tile, and down into the second row of the map
+    comp.tiles.scroll_x = 5;
+    comp.tiles.scroll_y = 9;
+    scanline_render_line(&comp, 0, line);
+    check(line[0] == 3 && line[2] == 3 && line[3] == 2 && line[27] == 3 && line[26] == 0, "Scrolled tiles");
+    // Past the bottom of the map, wrapping to the top
+    scanline_render_line(&comp, 7, line);
+    check(line[0] == 0 && line[3] == 1, "Tiles wrapping vertically");
+}
+
+static void check_sprites(void) {
+    static const uint8_t square[3 * 3] = {1, 1, 1,
+                                          1, 0, 1,
+                                          1, 1, 1};
+    static const uint16_t red[2] = {0, 0xf800}, blue[2] = {0, 0x001f};
+    scanline_sprite_t pair[2] = {
+            {.pixels = square, .palette = red, .x = -1, .y = 0, .width = 3, .height = 3, .visible = true},
+            {.pixels = square, .palette = blue, .x = 0, .y = 1, .width = 3, .height = 3, .visible = true},
+    };
+    scanline_compositor_t comp;
+    scanline_compositor_init(&comp, WIDTH, HEIGHT);
+    comp.sprites = pair;
+    comp.n_sprites = 2;
+    scanline_render_line(&comp, 0, line);
+    check(line[0] == 0xf800 && line[1] == 0xf800 && line[2] == 0, "Sprite off the left edge");
+    // The hole in the middle of the red square shows the blue one
+    scanline_render_line(&comp, 1, line);
+    check(line[0] == 0x001f && line[1] == 0x001f && line[2] == 0x001f, "Overlapping sprites");
+    scanline_render_line(&comp, 2, line);
+    check(line[0] == 0x001f && line[1] == 0xf800 && line[2] == 0x001f, "Transparent pixels");
+    scanline_render_line(&comp, 4, line);
+    check(line[0] == 0 && line[1] == 0, "Line below the sprites");
+    pair[1].visible = false;
+    pair[0].x = WIDTH - 2;
+    scanline_render_line(&comp, 0, line);
+    check(line[WIDTH - 3] == 0 && line[WIDTH - 2] == 0xf800 && line[WIDTH - 1] == 0xf800,
+          "Sprite off the right edge");
+}
+
+static void check_text(void) {
+    static uint8_t bar_font[2 * 8];
+    static const uint8_t chars[2] = {1, 0};
+    // Character 1 has its leftmost and rightmost columns set; character 0 is blank
+    for (uint i = 8; i < 16; ++i)
+        bar_font[i] = 0x81;
+    scanline_compositor_t comp;
+    scanline_compositor_init(&comp, WIDTH, HEIGHT);
+    comp.background = 1;
+    comp.text = (scanline_text_layer_t) {.font = bar_font, .text = chars, .columns = 2, .rows = 1, .x = -7,
+                                         .y = 10, .fg = 2, .bg = 3, .opaque = false, .enabled = true};
+    scanline_render_line(&comp, 10, line);
+    check(line[0] == 2 && line[1] == 1 && line[8] == 1, "Transparent text");
+    comp.text.opaque = true;
+    scanline_render_line(&comp, 17, line);
+    check(line[0] == 2 && line[1] == 3 && line[8] == 3 && line[9] == 1, "Opaque text");
+    scanline_render_line(&comp, 18, line);
+    check(line[0] == 1, "Line below the text");
+}
+
+static void random_scene(scanline_compositor_t *comp) {
+    scanline_compositor_init(comp, (uint16_t) (1 + rand() % WIDTH), HEIGHT);
+    comp->background = (uint16_t) rand();
+    comp->tiles = (scanline_tile_layer_t) {.tiles = tiles, .map = map, .palette = palette,
+                                           .log_map_width = (uint8_t) (rand() % 5),
+                                           .log_map_height = (uint8_t) (rand() % 4),
+                                           .scroll_x = (uint16_t) rand(), .scroll_y = (uint16_t) rand(),
+                                           .enabled = rand() % 4 != 0};
+    comp->n_sprites = rand() % (N_SPRITES + 1);
+    comp->sprites = sprites;
+    for (uint i = 0; i < comp->n_sprites; ++i) {
+        sprites[i] = (scanline_sprite_t) {.pixels = sprite_pixels[i], .palette = sprite_palettes[i],
+                                          .width = (uint16_t) (1 + rand() % 32),
+                                          .height = (uint16_t) (1 + rand() % 32), .visible = rand() % 8 != 0};
+        sprites[i].x = (int16_t) (rand() % (WIDTH + 64) - 32);
+        sprites[i].y = (int16_t) (rand() % (HEIGHT + 64) - 32);
+    }
+    comp->text = (scanline_text_layer_t) {.font = font, .text = text, .columns = (uint16_t) (1 + rand() % 20),
+                                          .rows = (uint16_t) (1 + rand() % 10), .fg = (uint16_t) rand(),
+                                          .bg = (uint16_t) rand(), .opaque = rand() & 1, .enabled = rand() & 1};
+    comp->text.x = (int16_t) (rand() % (WIDTH + 40) - 40);
+    comp->text.y = (int16_t) (rand() % (HEIGHT + 40) - 40);
+}
+
+static void check_random(uint n_scenes) {
+    for (uint scene = 0; scene < n_scenes && !errors; ++scene) {
+        scanline_compositor_t comp;
+        random_scene(&comp);
+        for (uint y = 0; y < HEIGHT && !errors; ++y) {
+            // The compositor must write only the width of the display
+            memset(line, 0xaa, sizeof(line));
+            scanline_render_line(&comp, y, line);
+            for (uint x = 0; x < WIDTH; ++x) {
+                uint16_t expected = x < comp.width ? reference_pixel(&comp, (int) x, (int) y) : 0xaaaa;
+                if (line[x] != expected) {
+                    if (!errors++)
+                        printf("Scene %u: pixel (%u, %u) is 0x%04x, expected 0x%04x\n", scene, x, y, line[x],
+                               expected);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    printf("Scanline compositor host tests\n");
+    for (uint i = 0; i < count_of(tiles); ++i)
+        tiles[i] = (uint8_t) rand();
+    for (uint i = 0; i < count_of(map); ++i)
+        map[i] = (uint8_t) rand();
+    for (uint i = 0; i < count_of(palette); ++i)
+        palette[i] = (uint16_t) rand();
+    for (uint i = 0; i < N_SPRITES; ++i) {
+        // Plenty of transparent pixels
+        for (uint j = 0; j < count_of(sprite_pixels[i]); ++j)
+            sprite_pixels[i][j] = rand() % 3 ? (uint8_t) rand() : 0;
+        for (uint j = 0; j < count_of(sprite_palettes[i]); ++j)
+            sprite_palettes[i][j] = (uint16_t) rand();
+    }
+    for (uint i = 0; i < count_of(font); ++i)
+        font[i] = (uint8_t) rand();
+    for (uint i = 0; i < count_of(text); ++i)
+        text[i] = (uint8_t) rand();
+
+    check_background();
+    check_tiles();
+    check_sprites();
+    check_text();
+    const uint n_scenes = 2000;
+    check_random(n_scenes);
+    printf(errors ? "FAILED\n" : "All compositor checks passed\n");
+    return errors != 0;
+}
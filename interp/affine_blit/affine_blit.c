@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+
+#include "affine_blit.h"
+#include "interp_emu.h"
+
+#if AFFINE_BLIT_EMULATE
+typedef interp_emu_t blit_interp_t;
+static interp_emu_t emu_interp[2];
+#define blit_interp0 (&emu_interp[0])
+#define blit_interp1 (&emu_interp[1])
+#define interp_config interp_emu_config
+#define interp_default_config interp_emu_default_config
+#define interp_config_set_shift interp_emu_config_set_shift
+#define interp_config_set_mask interp_emu_config_set_mask
+#define interp_config_set_add_raw interp_emu_config_set_add_raw
+#define interp_config_set_blend interp_emu_config_set_blend
+#define interp_set_config interp_emu_set_config
+
+static inline uint32_t blit_pop_full(blit_interp_t *interp) {
+    return interp_emu_pop(interp, 2);
+}
+
+static inline uint32_t blit_peek_lane1(blit_interp_t *interp) {
+    return interp_emu_peek(interp, 1);
+}
+
+// Host pointers may not fit in 32 bits, so the texture's address is added
+// afterwards rather than by the interpolator
+#define BLIT_TEXTURE_BASE(pixels) 0u
+#define BLIT_TEXEL(type, pixels, result) (*(const type *) ((const uint8_t *) (pixels) + (result)))
+#else
+#include "hardware/interp.h"
+typedef interp_hw_t blit_interp_t;
+#define blit_interp0 interp0
+#define blit_interp1 interp1
+
+static inline uint32_t blit_pop_full(blit_interp_t *interp) {
+    return interp->pop[2];
+}
+
+static inline uint32_t blit_peek_lane1(blit_interp_t *interp) {
+    return interp->peek[1];
+}
+
+#define BLIT_TEXTURE_BASE(pixels) ((uint32_t) (uintptr_t) (pixels))
+#define BLIT_TEXEL(type, pixels, result) (*(const type *) (uintptr_t) (result))
+#endif
+
+bool affine_texture_valid(const affine_texture_t *texture) {
+    return texture->pixels && texture->log_width >= 1 && texture->log_width <= AFFINE_BLIT_MAX_LOG_SIZE &&
+           texture->log_height >= 1 && texture->log_height <= AFFINE_BLIT_MAX_LOG_SIZE;
+}
+
+void affine_blit_set_rotozoom(affine_blit_t *blit, float angle, float scale, float dst_x, float dst_y, float tex_u,
+                              float tex_v) {
+    // Texture steps are the inverse transform: rotate back and shrink
+    float one = (float) (1 << AFFINE_BLIT_FRAC_BITS);
+    float c = cosf(angle) / scale, s = sinf(angle) / scale;
+    blit->du_dx = (int32_t) (c * one);
+    blit->dv_dx = (int32_t) (-s * one);
+    blit->du_dy = (int32_t) (s * one);
+    blit->dv_dy = (int32_t) (c * one);
+    blit->u = (int32_t) ((tex_u - c * dst_x - s * dst_y) * one);
+    blit->v = (int32_t) ((tex_v + s * dst_x - c * dst_y) * one);
+}
+
+// RGB565 spread out as 00000000 000000gg gggg0000 000bbbbb with red in bits
+// 31:27, leaving room for each channel's 8 fractional bits during a blend
+static inline uint32_t spread565(uint16_t c) {
+    return (c & 0x001fu) | (c & 0x07e0u) << 8 | (uint32_t) (c & 0xf800u) << 16;
+}
+
+static inline uint16_t unspread565(uint32_t s) {
+    return (uint16_t) ((s & 0x001fu) | ((s >> 8) & 0x07e0u) | ((s >> 16) & 0xf800u));
+}
+
+static inline uint16_t blend565(uint16_t dst, uint16_t src, unsigned int alpha) {
+    unsigned int r = ((dst >> 11) * (256 - alpha) + (src >> 11) * alpha) >> 8;
+    unsigned int g = (((dst >> 5) & 0x3f) * (256 - alpha) + ((src >> 5) & 0x3f) * alpha) >> 8;
+    unsigned int b = ((dst & 0x1f) * (256 - alpha) + (src & 0x1f) * alpha) >> 8;
+    return (uint16_t) (r << 11 | g << 5 | b);
+}
+
+static inline uint16_t texel(const affine_texture_t *texture, uint32_t x, uint32_t y) {
+    uint32_t i = y << texture->log_width | x;
+    if (texture->palette)
+        return texture->palette[((const uint8_t *) texture->pixels)[i]];
+    return ((const uint16_t *) texture->pixels)[i];
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Narrow [*x0, *x1) to the pixels where 0 <= a + x * d < limit
+static void span_inside(int64_t a, int32_t d, int64_t limit, int64_t *x0, int64_t *x1) {
+    int64_t lo, hi;
+    if (d == 0) {
+        if (a >= 0 && a < limit)
+            return;
+        lo = 0;
+        hi = 0;
+    } else if (d > 0) {
+        lo = -floor_div(a, d);
+        hi = -floor_div(a - limit, d);
+    } else {
+        lo = floor_div(a - limit, -d) + 1;
+        hi = floor_div(a, -d) + 1;
+    }
+    if (lo > *x0)
+        *x0 = lo;
+    if (hi < *x1)
+        *x1 = hi;
+    if (*x1 < *x0)
+        *x1 = *x0;
+}
+
+static void reference_pixel(const affine_blit_t *blit, int64_t u, int64_t v, uint16_t *dst) {
+    const affine_texture_t *texture = blit->texture;
+    int64_t w = 1 << texture->log_width, h = 1 << texture->log_height;
+    int64_t x = u >> AFFINE_BLIT_FRAC_BITS, y = v >> AFFINE_BLIT_FRAC_BITS;
+    switch (blit->edge) {
+        case AFFINE_BLIT_WRAP:
+            x &= w - 1;
+            y &= h - 1;
+            break;
+        case AFFINE_BLIT_CLIP:
+            if (x < 0 || x >= w || y < 0 || y >= h)
+                return;
+            break;
+        case AFFINE_BLIT_CLAMP:
+            x = x < 0 ? 0 : x >= w ? w - 1 : x;
+            y = y < 0 ? 0 : y >= h ? h - 1 : y;
+            break;
+    }
+    uint16_t colour = texel(texture, (uint32_t) x, (uint32_t) y);
+    if (blit->alpha < AFFINE_BLIT_OPAQUE)
+        colour = blend565(*dst, colour, blit->alpha);
+    *dst = colour;
+}
+
+static void setup_interps(const affine_blit_t *blit) {
+    const affine_texture_t *texture = blit->texture;
+    // Byte offset of a texel is (v << log_width | u) << texel_shift
+    unsigned int texel_shift = texture->palette ? 0 : 1;
+    unsigned int uv_shift = AFFINE_BLIT_FRAC_BITS - texel_shift;
+    unsigned int u_bits = texture->log_width, v_bits = texture->log_height;
+#if AFFINE_BLIT_EMULATE
+    interp_emu_init(blit_interp0, 0, false);
+    interp_emu_init(blit_interp1, 1, false);
+#endif
+    blit_interp_t *addr = blit_interp1;
+    interp_config cfg = interp_default_config();
+    interp_config_set_add_raw(&cfg, true);
+    interp_config_set_shift(&cfg, uv_shift);
+    interp_config_set_mask(&cfg, texel_shift, texel_shift + u_bits - 1);
+    interp_set_config(addr, 0, &cfg);
+    interp_config_set_shift(&cfg, uv_shift - u_bits);
+    interp_config_set_mask(&cfg, texel_shift + u_bits, texel_shift + u_bits + v_bits - 1);
+    interp_set_config(addr, 1, &cfg);
+    addr->base[0] = (uint32_t) blit->du_dx;
+    addr->base[1] = (uint32_t) blit->dv_dx;
+    addr->base[2] = BLIT_TEXTURE_BASE(texture->pixels);
+
+    if (blit->alpha < AFFINE_BLIT_OPAQUE) {
+        // Lane 1 blends BASE0 (destination) and BASE1 (texel) by ACCUM1
+        blit_interp_t *mix = blit_interp0;
+        cfg = interp_default_config();
+        interp_config_set_blend(&cfg, true);
+        interp_set_config(mix, 0, &cfg);
+        cfg = interp_default_config();
+        interp_set_config(mix, 1, &cfg);
+        mix->accum[1] = blit->alpha;
+    }
+}
+
+static void span_interp(const affine_blit_t *blit, uint16_t *dst, unsigned int n, uint32_t u, uint32_t v) {
+    const affine_texture_t *texture = blit->texture;
+    const uint16_t *palette = texture->palette;
+    blit_interp_t *addr = blit_interp1;
+    addr->accum[0] = u;
+    addr->accum[1] = v;
+    if (blit->alpha >= AFFINE_BLIT_OPAQUE) {
+        if (palette) {
+            for (unsigned int i = 0; i < n; ++i)
+                dst[i] = palette[BLIT_TEXEL(uint8_t, texture->pixels, blit_pop_full(addr))];
+        } else {
+            for (unsigned int i = 0; i < n; ++i)
+                dst[i] = BLIT_TEXEL(uint16_t, texture->pixels, blit_pop_full(addr));
+        }
+    } else {
+        blit_interp_t *mix = blit_interp0;
+        for (unsigned int i = 0; i < n; ++i) {
+            uint16_t colour = palette ? palette[BLIT_TEXEL(uint8_t, texture->pixels, blit_pop_full(addr))]
+                                      : BLIT_TEXEL(uint16_t, texture->pixels, blit_pop_full(addr));
+            mix->base[0] = spread565(dst[i]);
+            mix->base[1] = spread565(colour);
+            dst[i] = unspread565(blit_peek_lane1(mix));
+        }
+    }
+}
+
+void affine_blit_rows(const affine_blit_t *blit, uint16_t *dst, unsigned int dst_stride, unsigned int width,
+                      unsigned int y_start, unsigned int y_end, unsigned int y_step) {
+    const affine_texture_t *texture = blit->texture;
+    int64_t u_limit = (int64_t) 1 << (texture->log_width + AFFINE_BLIT_FRAC_BITS);
+    int64_t v_limit = (int64_t) 1 << (texture->log_height + AFFINE_BLIT_FRAC_BITS);
+    setup_interps(blit);
+    for (unsigned int y = y_start; y < y_end; y += y_step) {
+        uint16_t *row = dst + y * dst_stride;
+        int64_t u = blit->u + (int64_t) y * blit->du_dy;
+        int64_t v = blit->v + (int64_t) y * blit->dv_dy;
+        int64_t x0 = 0, x1 = width;
+        if (blit->edge != AFFINE_BLIT_WRAP) {
+            span_inside(u, blit->du_dx, u_limit, &x0, &x1);
+            span_inside(v, blit->dv_dx, v_limit, &x0, &x1);
+        }
+        if (x1 > x0)
+            span_interp(blit, row + x0, (unsigned int) (x1 - x0), (uint32_t) (u + x0 * blit->du_dx),
+                        (uint32_t) (v + x0 * blit->dv_dx));
+        if (blit->edge == AFFINE_BLIT_CLAMP) {
+            for (int64_t x = 0; x < width; ++x) {
+                if (x == x0)
+                    x = x1;
+                if (x < width)
+                    reference_pixel(blit, u + x * blit->du_dx, v + x * blit->dv_dx, &row[x]);
+            }
+        }
+    }
+}
+
+void affine_blit_rows_reference(const affine_blit_t *blit, uint16_t *dst, unsigned int dst_stride,
+                                unsigned int width, unsigned int y_start, unsigned int y_end, unsigned int y_step) {
+    for (unsigned int y = y_start; y < y_end; y += y_step) {
+        int64_t u = blit->u + (int64_t) y * blit->du_dy;
+        int64_t v = blit->v + (int64_t) y * blit->dv_dy;
+        for (unsigned int x = 0; x < width; ++x)
+            reference_pixel(blit, u + (int64_t) x * blit->du_dx, v + (int64_t) x * blit->dv_dx,
+                            &dst[y * dst_stride + x]);
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _AFFINE_BLIT_H
+#define _AFFINE_BLIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Affine texture mapping (rotation, scaling, shearing) of power-of-two sized
+// textures into an RGB565 destination, using the interpolators.
+//
+// Interpolator 1 generates the texel addresses: lane 0 steps the u
+// coordinate, lane 1 the v coordinate, and the full result adds both, masked
+// to the texture size, to the texture's address. This is the same as the
+// st7789_lcd and hello_interp texture mapping, for any texture size. Textures
+// are either RGB565, or 8-bit indices into an RGB565 palette.
+//
+// When blending, interpolator 0 mixes each texel with the destination. The
+// three channels are spread out in a 32-bit word, far enough apart that one
+// blend does all three at once.
+//
+// Outside the texture, pixels can wrap around (repeat), be left alone (clip)
+// or take the colour of the nearest edge texel (clamp). For clip and clamp,
+// the part of each row which is inside the texture is found first, so only
+// that part goes through the interpolators.
+//
+// Each core has its own interpolators, so both cores can draw at once, e.g.
+// one doing even rows and the other odd rows. The calling core's
+// interpolators are overwritten.
+//
+// If AFFINE_BLIT_EMULATE is defined, interp_emu.h models the interpolators
+// instead, so this can be built and tested without them.
+
+#define AFFINE_BLIT_FRAC_BITS 16
+#define AFFINE_BLIT_MAX_LOG_SIZE 15
+#define AFFINE_BLIT_OPAQUE 256
+
+typedef enum {
+    AFFINE_BLIT_WRAP,
+    AFFINE_BLIT_CLIP,
+    AFFINE_BLIT_CLAMP,
+} affine_blit_edge_t;
+
+typedef struct {
+    // RGB565 texels, or 8-bit indices if there is a palette. Rows are
+    // 1 << log_width texels, with no padding.
+    const void *pixels;
+    const uint16_t *palette;
+    uint8_t log_width;
+    uint8_t log_height;
+} affine_texture_t;
+
+typedef struct {
+    const affine_texture_t *texture;
+    // Texture coordinates of destination pixel (0, 0), and how much they
+    // change for each pixel to the right and each row down, with
+    // AFFINE_BLIT_FRAC_BITS fractional bits
+    int32_t u;
+    int32_t v;
+    int32_t du_dx;
+    int32_t dv_dx;
+    int32_t du_dy;
+    int32_t dv_dy;
+    affine_blit_edge_t edge;
+    // AFFINE_BLIT_OPAQUE replaces the destination, anything less blends
+    // with it: dst = (dst * (256 - alpha) + texel * alpha) >> 8 per channel
+    uint16_t alpha;
+} affine_blit_t;
+
+// Texture dimensions must be 2 to 1 << AFFINE_BLIT_MAX_LOG_SIZE
+bool affine_texture_valid(const affine_texture_t *texture);
+
+// Rotate anticlockwise by angle (radians) and magnify by scale about
+// (dst_x, dst_y) in the destination, which shows texture point (tex_u, tex_v)
+void affine_blit_set_rotozoom(affine_blit_t *blit, float angle, float scale, float dst_x, float dst_y, float tex_u,
+                              float tex_v);
+
+// Draw rows y_start, y_start + y_step, ... (up to y_end) of a destination
+// width pixels wide, with rows dst_stride pixels apart
+void affine_blit_rows(const affine_blit_t *blit, uint16_t *dst, unsigned int dst_stride, unsigned int width,
+                      unsigned int y_start, unsigned int y_end, unsigned int y_step);
+
+// The same, one pixel at a time without the interpolators. This gives exactly
+// the same results, and is for testing and comparison.
+void affine_blit_rows_reference(const affine_blit_t *blit, uint16_t *dst, unsigned int dst_stride,
+                                unsigned int width, unsigned int y_start, unsigned int y_end, unsigned int y_step);
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Affine texture mapping with the interpolators, on both cores.
+//
+// The interpolator model (interp_emu.h), which lets the blitter be built
+// and tested without hardware, is compared with this core's real
+// interpolators using random settings. Each blitter mode must then match
+// its plain C reference, and is timed in pixels per second on one core and
+// on two.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/interp.h"
+
+#include "affine_blit.h"
+#include "interp_emu.h"
+
+#define WIDTH 240
+#define HEIGHT 240
+
+#if PICO_RP2350
+#define INTERP_ROTATES true
+#else
+#define INTERP_ROTATES false
+#endif
+
+// Writable bits of INTERPx_CTRL_LANEy
+#define CTRL_WRITABLE 0x7fffffu
+
+static uint16_t frame[WIDTH * HEIGHT];
+static uint16_t ref_frame[WIDTH * HEIGHT];
+
+#define LOG_TEX_SIZE 7
+#define TEX_SIZE (1 << LOG_TEX_SIZE)
+static uint16_t tex_rgb565[TEX_SIZE * TEX_SIZE];
+static uint8_t tex_indexed[TEX_SIZE * TEX_SIZE];
+static uint16_t palette[256];
+
+static uint32_t rand32() {
+    static uint32_t x = 0x12345678;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static uint check_interp_model(uint n_trials) {
+    uint errors = 0;
+    for (uint num = 0; num < 2; ++num) {
+        interp_hw_t *hw = num ? interp1 : interp0;
+        interp_emu_t emu;
+        interp_emu_init(&emu, num, INTERP_ROTATES);
+        for (uint trial = 0; trial < n_trials; ++trial) {
+            for (uint lane = 0; lane < 2; ++lane) {
+                emu.ctrl[lane] = rand32() & CTRL_WRITABLE;
+                hw->ctrl[lane] = emu.ctrl[lane];
+                emu.accum[lane] = rand32();
+                hw->accum[lane] = emu.accum[lane];
+            }
+            for (uint i = 0; i < 3; ++i) {
+                emu.base[i] = rand32();
+                hw->base[i] = emu.base[i];
+            }
+            if (rand32() & 1) {
+                uint32_t base01 = rand32();
+                interp_emu_set_base01(&emu, base01);
+                hw->base01 = base01;
+            }
+            bool ok = true;
+            for (uint lane = 0; lane < 3; ++lane)
+                ok &= hw->peek[lane] == interp_emu_peek(&emu, lane);
+            for (uint lane = 0; lane < 2; ++lane)
+                ok &= hw->add_raw[lane] == interp_emu_get_add_raw(&emu, lane);
+            uint pop_lane = rand32() % 3;
+            ok &= hw->pop[pop_lane] == interp_emu_pop(&emu, pop_lane);
+            for (uint lane = 0; lane < 2; ++lane)
+                ok &= hw->accum[lane] == emu.accum[lane];
+            if (!ok && !errors++)
+                printf("interp%u differs with ctrl %08x %08x\n", num, (uint) emu.ctrl[0], (uint) emu.ctrl[1]);
+        }
+    }
+    return errors;
+}
+
+static void core1_entry() {
+    while (true) {
+        const affine_blit_t *blit = (const affine_blit_t *) multicore_fifo_pop_blocking();
+        affine_blit_rows(blit, frame, WIDTH, WIDTH, 1, HEIGHT, 2);
+        multicore_fifo_push_blocking(0);
+    }
+}
+
+// Core 0 does the even rows and core 1 the odd rows
+static void blit_both_cores(const affine_blit_t *blit) {
+    multicore_fifo_push_blocking((uintptr_t) blit);
+    affine_blit_rows(blit, frame, WIDTH, WIDTH, 0, HEIGHT, 2);
+    multicore_fifo_pop_blocking();
+}
+
+static void make_textures() {
+    for (uint y = 0; y < TEX_SIZE; ++y) {
+        for (uint x = 0; x < TEX_SIZE; ++x) {
+            uint r = (x * 2) & 0xff, g = ((x ^ y) & 16) ? 0xff : 0x40, b = (y * 2) & 0xff;
+            tex_rgb565[y * TEX_SIZE + x] = (uint16_t) ((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+            int dx = (int) x - TEX_SIZE / 2, dy = (int) y - TEX_SIZE / 2;
+            tex_indexed[y * TEX_SIZE + x] = (uint8_t) ((dx * dx + dy * dy) / 16);
+        }
+    }
+    for (uint i = 0; i < 256; ++i)
+        palette[i] = (uint16_t) ((i >> 3) << 11 | ((255 - i) >> 2) << 5 | ((i * 4) & 0xff) >> 3);
+}
+
+int main() {
+    stdio_init_all();
+    printf("Affine blit example\n");
+
+    uint errors = check_interp_model(10000);
+    printf("Interpolator model: %s\n", errors ? "MISMATCH" : "matches hardware");
+
+    make_textures();
+    const affine_texture_t textures[] = {
+            {.pixels = tex_rgb565, .log_width = LOG_TEX_SIZE, .log_height = LOG_TEX_SIZE},
+            {.pixels = tex_indexed, .palette = palette, .log_width = LOG_TEX_SIZE, .log_height = LOG_TEX_SIZE},
+    };
+    const char *edge_names[] = {"wrap", "clip", "clamp"};
+
+    multicore_launch_core1(core1_entry);
+
+    // Each mode: checked against the reference, then timed
+    const uint n_frames = 10;
+    printf("%-8s %-6s %-6s %12s %12s %12s\n", "texture", "edge", "alpha", "C Mpix/s", "1 core", "2 cores");
+    for (uint t = 0; t < count_of(textures); ++t) {
+        for (uint edge = AFFINE_BLIT_WRAP; edge <= AFFINE_BLIT_CLAMP; ++edge) {
+            for (uint alpha = 128; alpha <= AFFINE_BLIT_OPAQUE; alpha += 128) {
+                affine_blit_t blit = {.texture = &textures[t], .edge = edge, .alpha = alpha};
+                affine_blit_set_rotozoom(&blit, 0.5f, 1.5f, WIDTH / 2, HEIGHT / 2, TEX_SIZE / 2, TEX_SIZE / 2);
+
+                for (uint i = 0; i < count_of(frame); ++i)
+                    frame[i] = ref_frame[i] = (uint16_t) i;
+                affine_blit_rows_reference(&blit, ref_frame, WIDTH, WIDTH, 0, HEIGHT, 1);
+                blit_both_cores(&blit);
+                if (memcmp(frame, ref_frame, sizeof(frame))) {
+                    printf("%s %s alpha %u: MISMATCH\n", t ? "indexed" : "rgb565", edge_names[edge], alpha);
+                    ++errors;
+                }
+
+                uint64_t us[3];
+                uint64_t start = time_us_64();
+                for (uint i = 0; i < n_frames; ++i)
+                    affine_blit_rows_reference(&blit, frame, WIDTH, WIDTH, 0, HEIGHT, 1);
+                us[0] = time_us_64() - start;
+                start = time_us_64();
+                for (uint i = 0; i < n_frames; ++i)
+                    affine_blit_rows(&blit, frame, WIDTH, WIDTH, 0, HEIGHT, 1);
+                us[1] = time_us_64() - start;
+                start = time_us_64();
+                for (uint i = 0; i < n_frames; ++i)
+                    blit_both_cores(&blit);
+                us[2] = time_us_64() - start;
+
+                printf("%-8s %-6s %-6u", t ? "indexed" : "rgb565", edge_names[edge], alpha);
+                for (uint i = 0; i < 3; ++i)
+                    printf(" %12.2f", (float) (n_frames * WIDTH * HEIGHT) / (float) us[i]);
+                printf("\n");
+            }
+        }
+    }
+    printf(errors ? "FAILED\n" : "All results match\n");
+
+    // Frame rate for a typical rotozoom
+    affine_blit_t blit = {.texture = &textures[1], .edge = AFFINE_BLIT_WRAP, .alpha = AFFINE_BLIT_OPAQUE};
+    float angle = 0.f;
+    uint frames = 0;
+    uint64_t start = time_us_64();
+    while (frames < 200) {
+        angle += 0.02f;
+        affine_blit_set_rotozoom(&blit, angle, 1.f + 0.5f * sinf(angle), WIDTH / 2, HEIGHT / 2, 0, 0);
+        blit_both_cores(&blit);
+        ++frames;
+    }
+    printf("%u frames/s rotozooming on two cores\n", (uint) (frames * 1000000ull / (time_us_64() - start)));
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "interp_emu.h"
+
+#define INTERP_EMU_CTRL_SHIFT_LSB        0
+#define INTERP_EMU_CTRL_MASK_LSB_LSB     5
+#define INTERP_EMU_CTRL_MASK_MSB_LSB     10
+#define INTERP_EMU_CTRL_SIGNED           (1u << 15)
+#define INTERP_EMU_CTRL_CROSS_INPUT      (1u << 16)
+#define INTERP_EMU_CTRL_CROSS_RESULT     (1u << 17)
+#define INTERP_EMU_CTRL_ADD_RAW          (1u << 18)
+#define INTERP_EMU_CTRL_FORCE_MSB_LSB    19
+#define INTERP_EMU_CTRL_BLEND            (1u << 21)
+#define INTERP_EMU_CTRL_CLAMP            (1u << 22)
+
+void interp_emu_init(interp_emu_t *interp, unsigned int num, bool rotate) {
+    for (unsigned int i = 0; i < 2; ++i) {
+        interp->accum[i] = 0;
+        interp->ctrl[i] = 0;
+    }
+    for (unsigned int i = 0; i < 3; ++i)
+        interp->base[i] = 0;
+    interp->num = num;
+    interp->rotate = rotate;
+}
+
+static uint32_t lane_ctrl(const interp_emu_t *interp, unsigned int lane) {
+    uint32_t ctrl = interp->ctrl[lane];
+    // BLEND is only on lane 0 of interpolator 0, CLAMP only on lane 0 of
+    // interpolator 1
+    if (lane != 0 || interp->num != 0)
+        ctrl &= ~INTERP_EMU_CTRL_BLEND;
+    if (lane != 0 || interp->num != 1)
+        ctrl &= ~INTERP_EMU_CTRL_CLAMP;
+    return ctrl;
+}
+
+static uint32_t lane_input(const interp_emu_t *interp, unsigned int lane) {
+    return interp->accum[(lane_ctrl(interp, lane) & INTERP_EMU_CTRL_CROSS_INPUT) ? lane ^ 1 : lane];
+}
+
+// Shifted, masked and (if SIGNED) sign-extended input
+static uint32_t lane_shift_mask(const interp_emu_t *interp, unsigned int lane) {
+    uint32_t ctrl = lane_ctrl(interp, lane);
+    uint32_t input = lane_input(interp, lane);
+    unsigned int shift = (ctrl >> INTERP_EMU_CTRL_SHIFT_LSB) & 0x1f;
+    unsigned int mask_lsb = (ctrl >> INTERP_EMU_CTRL_MASK_LSB_LSB) & 0x1f;
+    unsigned int mask_msb = (ctrl >> INTERP_EMU_CTRL_MASK_MSB_LSB) & 0x1f;
+    uint32_t shifted = input >> shift;
+    if (interp->rotate && shift)
+        shifted |= input << (32 - shift);
+    uint32_t mask = (0xffffffffu >> (31 - mask_msb)) & (0xffffffffu << mask_lsb);
+    uint32_t value = shifted & mask;
+    if ((ctrl & INTERP_EMU_CTRL_SIGNED) && (value & (1u << mask_msb)))
+        value |= 0xffffffffu << mask_msb;
+    return value;
+}
+
+// Lane and full results as seen inside the interpolator, i.e. before FORCE_MSB
+static void interp_results(const interp_emu_t *interp, uint32_t result[3]) {
+    uint32_t ctrl0 = lane_ctrl(interp, 0), ctrl1 = lane_ctrl(interp, 1);
+    uint32_t sm0 = lane_shift_mask(interp, 0);
+    uint32_t sm1 = lane_shift_mask(interp, 1);
+    uint32_t add0 = (ctrl0 & INTERP_EMU_CTRL_ADD_RAW) ? lane_input(interp, 0) : sm0;
+    uint32_t add1 = (ctrl1 & INTERP_EMU_CTRL_ADD_RAW) ? lane_input(interp, 1) : sm1;
+
+    if (ctrl0 & INTERP_EMU_CTRL_BLEND) {
+        // Lane 1 is interpolated between BASE0 and BASE1 by the 8 LSBs of
+        // its shifted and masked value, signed if lane 1 is
+        uint32_t alpha = sm1 & 0xff;
+        if (ctrl1 & INTERP_EMU_CTRL_SIGNED) {
+            int64_t b0 = (int32_t) interp->base[0], b1 = (int32_t) interp->base[1];
+            result[1] = (uint32_t) ((b0 * (int64_t) (256 - alpha) + b1 * (int64_t) alpha) >> 8);
+        } else {
+            uint64_t b0 = interp->base[0], b1 = interp->base[1];
+            result[1] = (uint32_t) ((b0 * (256 - alpha) + b1 * alpha) >> 8);
+        }
+        result[0] = alpha;
+        result[2] = interp->base[2] + sm0;
+        return;
+    }
+
+    if (ctrl0 & INTERP_EMU_CTRL_CLAMP) {
+        // Lane 0 is its shifted and masked value, clamped to BASE0..BASE1
+        if (ctrl0 & INTERP_EMU_CTRL_SIGNED) {
+            int32_t v = (int32_t) sm0;
+            if (v < (int32_t) interp->base[0])
+                v = (int32_t) interp->base[0];
+            if (v > (int32_t) interp->base[1])
+                v = (int32_t) interp->base[1];
+            result[0] = (uint32_t) v;
+        } else {
+            uint32_t v = sm0;
+            if (v < interp->base[0])
+                v = interp->base[0];
+            if (v > interp->base[1])
+                v = interp->base[1];
+            result[0] = v;
+        }
+    } else {
+        result[0] = interp->base[0] + add0;
+    }
+    result[1] = interp->base[1] + add1;
+    result[2] = interp->base[2] + sm0 + sm1;
+}
+
+static uint32_t force_msb(const interp_emu_t *interp, unsigned int lane, uint32_t value) {
+    if (lane > 1)
+        return value;
+    uint32_t msb = (lane_ctrl(interp, lane) >> INTERP_EMU_CTRL_FORCE_MSB_LSB) & 3;
+    return value | msb << 28;
+}
+
+uint32_t interp_emu_peek(const interp_emu_t *interp, unsigned int lane) {
+    uint32_t result[3];
+    interp_results(interp, result);
+    return force_msb(interp, lane, result[lane]);
+}
+
+uint32_t interp_emu_pop(interp_emu_t *interp, unsigned int lane) {
+    uint32_t result[3];
+    interp_results(interp, result);
+    interp->accum[0] = (lane_ctrl(interp, 0) & INTERP_EMU_CTRL_CROSS_RESULT) ? result[1] : result[0];
+    interp->accum[1] = (lane_ctrl(interp, 1) & INTERP_EMU_CTRL_CROSS_RESULT) ? result[0] : result[1];
+    return force_msb(interp, lane, result[lane]);
+}
+
+uint32_t interp_emu_get_add_raw(const interp_emu_t *interp, unsigned int lane) {
+    return lane_shift_mask(interp, lane);
+}
+
+void interp_emu_set_base01(interp_emu_t *interp, uint32_t value) {
+    // In blend mode both halves follow lane 1, which sets the signedness of
+    // the blend
+    bool blend = lane_ctrl(interp, 0) & INTERP_EMU_CTRL_BLEND;
+    for (unsigned int lane = 0; lane < 2; ++lane) {
+        uint32_t half = (value >> (16 * lane)) & 0xffff;
+        if ((lane_ctrl(interp, blend ? 1 : lane) & INTERP_EMU_CTRL_SIGNED) && (half & 0x8000))
+            half |= 0xffff0000u;
+        interp->base[lane] = half;
+    }
+}
+
+interp_emu_config interp_emu_default_config(void) {
+    // The SDK's default: pass the accumulator straight through
+    interp_emu_config c = {0};
+    interp_emu_config_set_mask(&c, 0, 31);
+    return c;
+}
+
+void interp_emu_config_set_shift(interp_emu_config *c, unsigned int shift) {
+    c->ctrl = (c->ctrl & ~(0x1fu << INTERP_EMU_CTRL_SHIFT_LSB)) | (shift & 0x1f) << INTERP_EMU_CTRL_SHIFT_LSB;
+}
+
+void interp_emu_config_set_mask(interp_emu_config *c, unsigned int mask_lsb, unsigned int mask_msb) {
+    c->ctrl = (c->ctrl & ~(0x3ffu << INTERP_EMU_CTRL_MASK_LSB_LSB)) |
+              (mask_lsb & 0x1f) << INTERP_EMU_CTRL_MASK_LSB_LSB | (mask_msb & 0x1f) << INTERP_EMU_CTRL_MASK_MSB_LSB;
+}
+
+void interp_emu_config_set_add_raw(interp_emu_config *c, bool add_raw) {
+    c->ctrl = add_raw ? c->ctrl | INTERP_EMU_CTRL_ADD_RAW : c->ctrl & ~INTERP_EMU_CTRL_ADD_RAW;
+}
+
+void interp_emu_config_set_blend(interp_emu_config *c, bool blend) {
+    c->ctrl = blend ? c->ctrl | INTERP_EMU_CTRL_BLEND : c->ctrl & ~INTERP_EMU_CTRL_BLEND;
+}
+
+void interp_emu_set_config(interp_emu_t *interp, unsigned int lane, const interp_emu_config *config) {
+    interp->ctrl[lane] = config->ctrl;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _INTERP_EMU_H
+#define _INTERP_EMU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Software model of one SIO interpolator, giving the same results as the
+// hardware for the same register values, so code built on the interpolators
+// can be tested and benchmarked without one.
+//
+// The control register bits are those of SIO INTERPx_CTRL_LANEy. BLEND only
+// exists on interpolator 0 and CLAMP only on interpolator 1; they are ignored
+// on the other, as in hardware. RP2040 shifts the accumulator right, whereas
+// RP2350 rotates it. The overflow flags are not modelled.
+
+// A control register value, built up as with the SDK's interp_config
+typedef struct {
+    uint32_t ctrl;
+} interp_emu_config;
+
+interp_emu_config interp_emu_default_config(void);
+void interp_emu_config_set_shift(interp_emu_config *c, unsigned int shift);
+void interp_emu_config_set_mask(interp_emu_config *c, unsigned int mask_lsb, unsigned int mask_msb);
+void interp_emu_config_set_add_raw(interp_emu_config *c, bool add_raw);
+void interp_emu_config_set_blend(interp_emu_config *c, bool blend);
+
+typedef struct {
+    uint32_t accum[2];
+    uint32_t base[3];
+    uint32_t ctrl[2];
+    unsigned int num;
+    bool rotate;
+} interp_emu_t;
+
+// Reset to the power-on state, as interpolator num (0 or 1). rotate selects
+// the RP2350 shifter.
+void interp_emu_init(interp_emu_t *interp, unsigned int num, bool rotate);
+
+// Equivalent to interp_set_config()
+void interp_emu_set_config(interp_emu_t *interp, unsigned int lane, const interp_emu_config *config);
+
+// Equivalent to reading PEEK_LANE0, PEEK_LANE1 and PEEK_FULL (lane 2)
+uint32_t interp_emu_peek(const interp_emu_t *interp, unsigned int lane);
+
+// Equivalent to reading POP_LANE0, POP_LANE1 and POP_FULL: both lanes write
+// their results back to the accumulators
+uint32_t interp_emu_pop(interp_emu_t *interp, unsigned int lane);
+
+// Equivalent to reading ACCUMx_ADD: the lane's shifted and masked value,
+// without BASEx added
+uint32_t interp_emu_get_add_raw(const interp_emu_t *interp, unsigned int lane);
+
+// Equivalent to writing BASE_1AND0: the low and high halves go to BASE0 and
+// BASE1, sign-extended according to each lane's SIGNED flag (lane 1's for
+// both in blend mode)
+void interp_emu_set_base01(interp_emu_t *interp, uint32_t value);
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// DMA-driven APA102/SK9822 example, with extended dynamic range.
+//
+// The apa102 example writes every LED to the PIO FIFO from the processor,
+// with a fixed global brightness. Here:
+//
+// - Whole frames are packed into memory (see apa102_hdr.h) and sent by DMA,
+//   so the processor is free while a frame goes out.
+//
+// - Several strips are driven at once, each by its own state machine running
+//   the apa102_mini program, with its own DMA channel. Each strip has two
+//   frame buffers, so the next frame can be drawn whilst the last is sent,
+//   and all the strips are started together.
+//
+// - Colours are 16-bit linear, and the 5-bit global brightness field is
+//   chosen per LED to make the most of the 8-bit colour values, which gives
+//   much smoother fades at low brightness.
+//
+// Before starting, we check the encoding is accurate for every 16-bit level,
+// and measure how many LEDs per second can be encoded and sent.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "apa102.pio.h"
+
+#include "apa102_hdr.h"
+
+#define N_STRIPS 2
+#define N_LEDS 150
+#define SERIAL_FREQ (10 * 1000 * 1000)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const uint pin_clk[N_STRIPS] = {2, 4};
+static const uint pin_din[N_STRIPS] = {3, 5};
+
+typedef struct {
+    PIO pio;
+    uint sm;
+    uint dma_chan;
+    uint32_t *frame[2];
+} apa102_strip_t;
+
+static apa102_strip_t strips[N_STRIPS];
+// The frame buffers being sent
+static uint front_buf;
+static uint32_t frame_words;
+
+static uint16_t colours[N_LEDS * 3];
+
+static void apa102_strip_init(apa102_strip_t *strip, PIO pio, uint sm, uint offset, uint clk, uint din) {
+    strip->pio = pio;
+    strip->sm = sm;
+    apa102_mini_program_init(pio, sm, offset, SERIAL_FREQ, clk, din);
+    for (uint i = 0; i < 2; ++i) {
+        strip->frame[i] = calloc(frame_words, sizeof(uint32_t));
+        hard_assert(strip->frame[i]);
+    }
+    strip->dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(strip->dma_chan);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(strip->dma_chan, &c, &pio->txf[sm], NULL, frame_words, false);
+}
+
+// The frame buffer which isn't being sent, and is safe to draw into
+static uint32_t *apa102_back_buffer(uint strip) {
+    return strips[strip].frame[front_buf ^ 1];
+}
+
+// Wait for the last frames to be sent, then send the back buffers of all
+// strips together
+static void apa102_show_blocking() {
+    uint32_t mask = 0;
+    for (uint i = 0; i < N_STRIPS; ++i) {
+        dma_channel_wait_for_finish_blocking(strips[i].dma_chan);
+        mask |= 1u << strips[i].dma_chan;
+    }
+    front_buf ^= 1;
+    for (uint i = 0; i < N_STRIPS; ++i)
+        dma_channel_set_read_addr(strips[i].dma_chan, strips[i].frame[front_buf], false);
+    dma_start_channel_mask(mask);
+}
+
+// Check every level of a channel decodes to within half a step, at the
+// brightness the encoder chose, of what was asked for
+static uint check_encoding() {
+    uint errors = 0;
+    uint max_error = 0;
+    for (uint32_t c = 0; c <= 0xffff; ++c) {
+        uint16_t r, g, b;
+        uint32_t word = apa102_hdr_encode((uint16_t) c, (uint16_t) (c / 2), (uint16_t) (c / 7));
+        apa102_hdr_decode(word, &r, &g, &b);
+        uint gb = (word >> 24) & 0x1fu;
+        uint half_step = (gb * 65535u + APA102_MAX_BRIGHTNESS * 255u) / (2 * APA102_MAX_BRIGHTNESS * 255u);
+        uint error = (uint) abs((int) r - (int) c);
+        if (error > max_error)
+            max_error = error;
+        if (error > half_step + 1 || abs((int) g - (int) (c / 2)) > (int) half_step + 1 ||
+            abs((int) b - (int) (c / 7)) > (int) half_step + 1)
+            ++errors;
+    }
+    // Dimmest non-black level with a fixed brightness of 31 is 257
+    printf("Encoding: largest error %u/65535, dimmest level %u/65535 (%u with 8-bit colour)\n", max_error,
+           (uint) (65535u / (APA102_MAX_BRIGHTNESS * 255u)), 257);
+    return errors;
+}
+
+static void benchmark() {
+    for (uint i = 0; i < count_of(colours); ++i)
+        colours[i] = (uint16_t) rand();
+    const uint n_frames = 100;
+    uint64_t start = time_us_64();
+    for (uint f = 0; f < n_frames; ++f)
+        apa102_hdr_pack_frame(apa102_back_buffer(0), colours, N_LEDS);
+    uint64_t pack_us = time_us_64() - start;
+
+    start = time_us_64();
+    for (uint f = 0; f < n_frames; ++f)
+        apa102_show_blocking();
+    for (uint i = 0; i < N_STRIPS; ++i)
+        dma_channel_wait_for_finish_blocking(strips[i].dma_chan);
+    uint64_t send_us = time_us_64() - start;
+
+    printf("Encoding: %u LEDs/s on one core\n", (uint) (n_frames * N_LEDS * 1000000ull / pack_us));
+    printf("Sending:  %u LEDs/s over %u strips at %u MHz\n", (uint) (n_frames * N_LEDS * N_STRIPS * 1000000ull / send_us),
+           N_STRIPS, SERIAL_FREQ / 1000000);
+}
+
+int main() {
+    stdio_init_all();
+    printf("APA102 DMA example\n");
+
+    uint errors = check_encoding();
+    printf(errors ? "Encoding: %u levels out of range\n" : "Encoding: all levels within half a step\n", errors);
+
+    PIO pio = pio0;
+    uint offset = pio_add_program(pio, &apa102_mini_program);
+    frame_words = apa102_frame_words(N_LEDS);
+    for (uint i = 0; i < N_STRIPS; ++i)
+        apa102_strip_init(&strips[i], pio, i, offset, pin_clk[i], pin_din[i]);
+
+    benchmark();
+
+    // A slow rainbow fading down to almost nothing and back, which would step
+    // visibly with 8-bit colour. The second strip runs the other way.
+    uint t = 0;
+    while (true) {
+        float level = powf(0.5f + 0.5f * cosf((float) t * 0.01f), 4.f);
+        for (uint s = 0; s < N_STRIPS; ++s) {
+            for (uint i = 0; i < N_LEDS; ++i) {
+                float phase = (float) ((s ? N_LEDS - i : i) + t) * (float) (2 * M_PI / N_LEDS);
+                for (uint c = 0; c < 3; ++c) {
+                    float v = 0.5f + 0.5f * sinf(phase + (float) c * (float) (2 * M_PI / 3));
+                    colours[i * 3 + c] = (uint16_t) (v * level * 65535.f);
+                }
+            }
+            apa102_hdr_pack_frame(apa102_back_buffer(s), colours, N_LEDS);
+        }
+        apa102_show_blocking();
+        sleep_ms(10);
+        ++t;
+    }
+}
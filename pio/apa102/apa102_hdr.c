@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "apa102_hdr.h"
+
+// Full intensity in units of the smallest step
+#define FULL_SCALE (APA102_MAX_BRIGHTNESS * 255u)
+
+// c / 65535 of full intensity at brightness gb, to the nearest 8-bit step
+static inline uint32_t to_8bit(uint32_t c, uint32_t gb) {
+    uint32_t d = 65535u * gb;
+    uint32_t v = (c * FULL_SCALE + d / 2) / d;
+    return v > 255 ? 255 : v;
+}
+
+uint32_t apa102_hdr_encode(uint16_t r, uint16_t g, uint16_t b) {
+    uint32_t max = r > g ? r : g;
+    if (b > max)
+        max = b;
+    if (!max)
+        return apa102_led_word(0, 0, 0, 0);
+    // Smallest brightness with max * FULL_SCALE / 65535 <= 255 * gb
+    uint32_t gb = (max * APA102_MAX_BRIGHTNESS + 65534u) / 65535u;
+    return apa102_led_word(gb, (uint8_t) to_8bit(r, gb), (uint8_t) to_8bit(g, gb), (uint8_t) to_8bit(b, gb));
+}
+
+void apa102_hdr_decode(uint32_t word, uint16_t *r, uint16_t *g, uint16_t *b) {
+    uint32_t gb = (word >> 24) & 0x1fu;
+    *r = (uint16_t) (((word & 0xffu) * gb * 65535u + FULL_SCALE / 2) / FULL_SCALE);
+    *g = (uint16_t) ((((word >> 8) & 0xffu) * gb * 65535u + FULL_SCALE / 2) / FULL_SCALE);
+    *b = (uint16_t) ((((word >> 16) & 0xffu) * gb * 65535u + FULL_SCALE / 2) / FULL_SCALE);
+}
+
+void apa102_hdr_pack_frame(uint32_t *frame, const uint16_t *rgb, uint32_t n_leds) {
+    *frame++ = 0;
+    for (uint32_t i = 0; i < n_leds; ++i, rgb += 3)
+        *frame++ = apa102_hdr_encode(rgb[0], rgb[1], rgb[2]);
+    for (uint32_t i = 0; i < apa102_end_words(n_leds); ++i)
+        *frame++ = 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _APA102_HDR_H
+#define _APA102_HDR_H
+
+#include <stdint.h>
+
+// Pack frames for APA102/SK9822 LEDs, using the 5-bit global brightness field
+// to extend the dynamic range of 8-bit colour.
+//
+// Each LED shows (brightness / 31) * (colour / 255) of full intensity. Rather
+// than fixing the brightness, we take 16-bit linear colour and choose the
+// smallest brightness at which the brightest channel still fits in 8 bits.
+// Dim colours then keep their full 8 bits of resolution: at brightness 1 the
+// smallest step is 1/7905 of full scale, rather than 1/255.
+//
+// A frame is a zero start word, one word per LED (which the apa102_mini PIO
+// program shifts out MSB first), then apa102_end_words() zero words to clock
+// the data through to the end of the strip. Zeros rather than ones are used
+// so the end frame also works as the SK9822's reset frame, and doesn't light
+// up any LEDs beyond the end.
+
+#define APA102_MAX_BRIGHTNESS 31
+
+static inline uint32_t apa102_led_word(uint32_t brightness, uint8_t r, uint8_t g, uint8_t b) {
+    return 0x7u << 29 | (brightness & 0x1fu) << 24 | (uint32_t) b << 16 | (uint32_t) g << 8 | r;
+}
+
+// Each LED needs half a clock to pass the data on to the next
+static inline uint32_t apa102_end_words(uint32_t n_leds) {
+    return 1 + n_leds / 64;
+}
+
+static inline uint32_t apa102_frame_words(uint32_t n_leds) {
+    return 1 + n_leds + apa102_end_words(n_leds);
+}
+
+// 16-bit linear colour to an LED word
+uint32_t apa102_hdr_encode(uint16_t r, uint16_t g, uint16_t b);
+
+// What the LED will show for an LED word, in the same 16-bit units
+void apa102_hdr_decode(uint32_t word, uint16_t *r, uint16_t *g, uint16_t *b);
+
+// Fill in a whole frame from n_leds triples of 16-bit R, G, B
+void apa102_hdr_pack_frame(uint32_t *frame, const uint16_t *rgb, uint32_t n_leds);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the APA102 HDR encoding (apa102_hdr.h), run on the host. Build with
+// PICO_PLATFORM=host.
+//
+// For every 16-bit level of the brightest channel, and several ratios of the
+// other channels to it, the LED word must have the smallest global brightness
+// the brightest channel fits in, and must decode to within half a step of
+// each channel. Then the dim end of the range and the frame layout are
+// checked by hand.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "apa102_hdr.h"
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+// Half of 1/255 of brightness gb, in 16-bit units, rounded up
+static uint half_step(uint gb) {
+    return (gb * 65535u + APA102_MAX_BRIGHTNESS * 255u) / (2 * APA102_MAX_BRIGHTNESS * 255u);
+}
+
+static bool within_half_step(uint decoded, uint wanted, uint gb) {
+    return (uint) abs((int) decoded - (int) wanted) <= half_step(gb) + 1;
+}
+
+// Other channels as a fraction of the brightest, in 1/256ths
+static const uint ratios[] = {0, 1, 37, 128, 255, 256};
+
+static uint check_accuracy(void) {
+    uint max_error = 0;
+    for (uint i = 0; i < count_of(ratios) && !errors; ++i) {
+        for (uint32_t c = 0; c <= 0xffff; ++c) {
+            uint16_t wanted[3] = {(uint16_t) (c * ratios[i] / 256), (uint16_t) c, (uint16_t) (c * ratios[i] / 256)};
+            // Each channel in turn is the brightest
+            uint16_t rgb[3] = {wanted[i % 3], wanted[(i + 1) % 3], wanted[(i + 2) % 3]};
+            uint32_t word = apa102_hdr_encode(rgb[0], rgb[1], rgb[2]);
+            uint16_t r, g, b;
+            apa102_hdr_decode(word, &r, &g, &b);
+            uint gb = (word >> 24) & 0x1fu;
+            uint brightest = MAX(word & 0xffu, MAX((word >> 8) & 0xffu, (word >> 16) & 0xffu));
+            check(word >> 29 == 7, "Start bits of the LED word");
+            if (!c) {
+                check(!gb && !r && !g && !b, "Black");
+                continue;
+            }
+            // At one less brightness, the brightest channel wouldn't fit
+            check(gb >= 1 && c * APA102_MAX_BRIGHTNESS <= gb * 65535u &&
+                  c * APA102_MAX_BRIGHTNESS > (gb - 1) * 65535u, "Choice of brightness");
+            // So it uses at least half of its 8 bits
+            check(gb == 1 || brightest >= 128, "Resolution of the brightest channel");
+            check(within_half_step(r, rgb[0], gb) && within_half_step(g, rgb[1], gb) &&
+                  within_half_step(b, rgb[2], gb), "Decoded level");
+            uint error = (uint) abs((int) MAX(r, MAX(g, b)) - (int) c);
+            if (error > max_error)
+                max_error = error;
+        }
+    }
+    return max_error;
+}
+
+static void check_dim(void) {
+    // The smallest step at brightness 1 is 65535 / (31 * 255), a little over
+    // 8, where a fixed brightness of 31 would give 257
+    uint16_t r, g, b;
+    apa102_hdr_decode(apa102_hdr_encode(8, 0, 0), &r, &g, &b);
+    check(r == 8 && !g && !b, "Dimmest level");
+    check(apa102_hdr_encode(3, 0, 0) == apa102_led_word(1, 0, 0, 0), "Level below half the dimmest step");
+    check(apa102_hdr_encode(0, 1000, 0) == apa102_led_word(1, 0, 121, 0), "Dim green");
+    check(apa102_hdr_encode(65535, 65535, 65535) == apa102_led_word(31, 255, 255, 255), "Full white");
+}
+
+static void check_frame(void) {
+    const uint32_t n_leds = 130;
+    static uint16_t rgb[130 * 3];
+    static uint32_t frame[1 + 130 + 4];
+    for (uint i = 0; i < count_of(rgb); ++i)
+        rgb[i] = (uint16_t) rand();
+    check(apa102_end_words(n_leds) == 3 && apa102_frame_words(n_leds) == 134, "Frame length");
+    memset(frame, 0xff, sizeof(frame));
+    apa102_hdr_pack_frame(frame, rgb, n_leds);
+    check(frame[0] == 0, "Start frame");
+    for (uint i = 0; i < n_leds; ++i)
+        check(frame[1 + i] == apa102_hdr_encode(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]), "LED word in a frame");
+    check(!frame[131] && !frame[132] && !frame[133], "End frame");
+    check(frame[134] == 0xffffffffu, "Word after the frame");
+}
+
+int main() {
+    printf("APA102 HDR encoding host tests\n");
+    uint max_error = check_accuracy();
+    printf("Largest error of the brightest channel: %u/65535\n", max_error);
+    check_dim();
+    check_frame();
+    printf(errors ? "FAILED\n" : "All HDR encoding checks passed\n");
+    return errors != 0;
+}
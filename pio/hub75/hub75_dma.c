@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// DMA-driven HUB75 example.
+//
+// The basic hub75 example gamma-corrects every pixel on every refresh and
+// feeds both state machines from the processor, so core 0 does nothing but
+// refresh the panel. Here instead:
+//
+// - Each frame is colour-corrected and packed into bit planes once, when it
+//   is drawn (see hub75_pack.h).
+//
+// - The display can be made of several daisy-chained panels, with any of the
+//   common scan rates, and 8 to 12 bits per channel (see hub75_layout.h).
+//
+// - The two state machines synchronise with each other using PIO IRQ flags
+//   (see hub75_dma.pio), so neither needs the processor.
+//
+// - One DMA channel streams the packed bit planes to the data SM, another
+//   streams the precomputed row select/pulse width records to the row SM.
+//
+// - There are two packed frame buffers. A single interrupt at the end of each
+//   frame restarts both channels, on whichever buffer is due to be displayed
+//   next, so swapping buffers is tear-free.
+//
+// To show this off we scroll the image, and measure how much of core 0 is
+// left over whilst the panel is being refreshed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hub75_dma.pio.h"
+
+#include "hub75_pack.h"
+#include "mountains_128x64_rgb565.h"
+
+#define DATA_BASE_PIN 0
+#define DATA_N_PINS 6
+#define ROWSEL_BASE_PIN 6
+#define CLK_PIN 11
+#define STROBE_PIN 12
+#define OEN_PIN 13
+
+#define WIDTH 128
+#define HEIGHT 64
+
+// One 128x64 1/32 scan panel. A wall of four 64x32 1/16 scan panels, two
+// wide and two high, with the second row chained back right to left, would be:
+//
+//     { .panel_width = 64, .panel_height = 32, .scan_rows = 16,
+//       .panels_x = 2, .panels_y = 2, .serpentine = true }
+static const hub75_layout_t layout = {
+        .panel_width = WIDTH,
+        .panel_height = HEIGHT,
+        .scan_rows = 32,
+        .panels_x = 1,
+        .panels_y = 1,
+};
+
+// Bits per colour channel
+#define N_PLANES 10
+// Two system clocks per pixel at full speed is too fast for most panels
+#define DATA_CLKDIV 4.f
+// OEn pulse length for the least significant bit plane, in system clocks
+#define OEN_BASE_CYCLES 25u
+
+static hub75_packer_t packer;
+static hub75_timing_t timing;
+static uint32_t *packed_frame[2];
+static uint32_t packed_words;
+static uint32_t *row_cmds;
+static uint32_t n_row_cmds;
+
+static PIO pio = pio0;
+static uint sm_data = 0;
+static uint sm_row = 1;
+static uint data_chan;
+static uint row_chan;
+
+static volatile uint displayed_buf;
+static volatile uint next_buf;
+static volatile uint32_t frame_count;
+
+void hub75_dma_handler() {
+    dma_channel_acknowledge_irq0(data_chan);
+    // The row channel is always ahead of the data channel, but make sure
+    dma_channel_wait_for_finish_blocking(row_chan);
+    displayed_buf = next_buf;
+    dma_channel_set_read_addr(row_chan, row_cmds, true);
+    dma_channel_set_read_addr(data_chan, packed_frame[displayed_buf], true);
+    frame_count = frame_count + 1;
+}
+
+void hub75_dma_init() {
+    // Row select and OEn pulse width for each row and bit plane. These never
+    // change, so just build them once. The row select field is always 5 bits
+    // wide, whatever the number of row select pins.
+    n_row_cmds = layout.scan_rows * timing.n_planes;
+    row_cmds = malloc(n_row_cmds * sizeof(uint32_t));
+    hard_assert(row_cmds);
+    for (uint row = 0; row < layout.scan_rows; ++row)
+        for (uint plane = 0; plane < timing.n_planes; ++plane)
+            row_cmds[row * timing.n_planes + plane] = row | (timing.oe_cycles[plane] - 1) << 5;
+
+    uint data_prog_offs = pio_add_program(pio, &hub75_data_packed_program);
+    uint row_prog_offs = pio_add_program(pio, &hub75_row_sync_program);
+    hub75_data_packed_program_init(pio, sm_data, data_prog_offs, DATA_BASE_PIN, CLK_PIN,
+                                   hub75_layout_shift_length(&layout), timing.data_clkdiv);
+    hub75_row_sync_program_init(pio, sm_row, row_prog_offs, ROWSEL_BASE_PIN, hub75_layout_rowsel_pins(&layout),
+                                STROBE_PIN);
+
+    data_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(data_chan);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_data, true));
+    dma_channel_configure(data_chan, &c, &pio->txf[sm_data], NULL, packed_words, false);
+
+    row_chan = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(row_chan);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_row, true));
+    dma_channel_configure(row_chan, &c, &pio->txf[sm_row], NULL, n_row_cmds, false);
+
+    dma_channel_set_irq0_enabled(data_chan, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, hub75_dma_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    pio_enable_sm_mask_in_sync(pio, (1u << sm_data) | (1u << sm_row));
+    dma_channel_set_read_addr(row_chan, row_cmds, true);
+    dma_channel_set_read_addr(data_chan, packed_frame[displayed_buf], true);
+}
+
+// The buffer which isn't being displayed, and is safe to draw into
+uint32_t *hub75_get_back_buffer() {
+    return packed_frame[displayed_buf ^ 1];
+}
+
+// Display the back buffer from the start of the next frame. Blocks until the
+// old front buffer is no longer being displayed, and so can be drawn into.
+void hub75_swap_blocking() {
+    next_buf = displayed_buf ^ 1;
+    while (displayed_buf != next_buf)
+        tight_loop_contents();
+}
+
+// Count how many times we can go round a loop in a fixed time, as a measure
+// of how much of the processor is available
+static uint32_t __no_inline_not_in_flash_func(count_idle_loops)(uint32_t us) {
+    uint32_t count = 0;
+    absolute_time_t end = make_timeout_time_us(us);
+    while (absolute_time_diff_us(get_absolute_time(), end) > 0)
+        ++count;
+    return count;
+}
+
+int main() {
+    stdio_init_all();
+    printf("HUB75 DMA example\n");
+
+    hard_assert(hub75_layout_width(&layout) == WIDTH && hub75_layout_height(&layout) == HEIGHT);
+    if (!hub75_packer_init(&packer, &layout, N_PLANES)) {
+        printf("Unsupported panel layout\n");
+        return 1;
+    }
+    // Each panel can have its own brightness and gamma, e.g. to match panels
+    // from different batches
+    hub75_packer_set_panel_lut(&packer, 0, 2.2f, 1.f);
+    hub75_timing_init_bcm(&timing, N_PLANES, OEN_BASE_CYCLES, DATA_CLKDIV);
+
+    packed_words = HUB75_PACKED_WORDS(hub75_layout_shift_length(&layout), layout.scan_rows, N_PLANES);
+    for (uint i = 0; i < 2; ++i) {
+        packed_frame[i] = malloc(packed_words * sizeof(uint32_t));
+        hard_assert(packed_frame[i]);
+    }
+
+    // Frame preparation benchmark
+    static uint16_t img[WIDTH * HEIGHT];
+    memcpy(img, mountains_128x64, sizeof(img));
+    uint64_t start = time_us_64();
+    hub75_pack_frame(&packer, packed_frame[0], img);
+    uint64_t pack_us = time_us_64() - start;
+    printf("Packing a %dx%d frame with %d bit planes takes %llu us\n", WIDTH, HEIGHT, N_PLANES, pack_us);
+    printf("Expected refresh rate %.1f Hz, %.0f%% duty cycle\n",
+           hub75_refresh_rate_hz(&layout, &timing, clock_get_hz(clk_sys)), 100.f * hub75_duty_cycle(&layout, &timing));
+
+    uint32_t idle_loops = count_idle_loops(100000);
+    hub75_dma_init();
+    uint32_t refresh_loops = count_idle_loops(100000);
+    uint32_t frames = frame_count;
+    sleep_ms(1000);
+    uint32_t permille = (uint32_t) ((uint64_t) refresh_loops * 1000 / idle_loops);
+    printf("Refresh rate %u Hz, core 0 available during refresh: %u.%u%%\n", frame_count - frames,
+           permille / 10, permille % 10);
+
+    // Scroll the image sideways, one column per frame
+    const uint16_t *src = (const uint16_t *) mountains_128x64;
+    uint scroll = 0;
+    while (true) {
+        scroll = (scroll + 1) % WIDTH;
+        for (uint y = 0; y < HEIGHT; ++y) {
+            memcpy(&img[y * WIDTH], &src[y * WIDTH + scroll], (WIDTH - scroll) * sizeof(uint16_t));
+            memcpy(&img[y * WIDTH + WIDTH - scroll], &src[y * WIDTH], scroll * sizeof(uint16_t));
+        }
+        hub75_pack_frame(&packer, hub75_get_back_buffer(), img);
+        hub75_swap_blocking();
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the HUB75 panel layout (hub75_layout.h), run on the host. Build
+// with PICO_PLATFORM=host.
+//
+// A few pixels of each arrangement are checked by hand: a single panel,
+// panels chained left to right, a serpentine grid with every other row of
+// panels upside down, and a panel whose rows are folded across its shift
+// register. Then for a range of layouts, the remap table must hold every
+// display pixel exactly once, each where hub75_layout_map() puts it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "hub75_layout.h"
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static void check_map(const hub75_layout_t *layout, uint x, uint y, uint scan_row, uint lane, uint shift_pos,
+                      uint panel) {
+    uint got_scan_row, got_lane, got_shift_pos;
+    hub75_layout_map(layout, x, y, &got_scan_row, &got_lane, &got_shift_pos);
+    if (got_scan_row != scan_row || got_lane != lane || got_shift_pos != shift_pos ||
+        hub75_layout_panel_at(layout, got_shift_pos) != panel) {
+        if (!errors++)
+            printf("(%u, %u) is scan row %u lane %u shift position %u on panel %u, expected %u %u %u on %u\n", x, y,
+                   got_scan_row, got_lane, got_shift_pos, hub75_layout_panel_at(layout, got_shift_pos), scan_row,
+                   lane, shift_pos, panel);
+    }
+}
+
+static void check_valid(void) {
+    hub75_layout_t layout = {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 1, .panels_y = 1};
+    check(hub75_layout_valid(&layout), "64x32 1/16 scan");
+    check(hub75_layout_rowsel_pins(&layout) == 4, "Row select pins for 1/16 scan");
+    layout.scan_rows = 32;
+    check(!hub75_layout_valid(&layout), "More scan rows than half the panel");
+    layout.panel_height = 64;
+    check(hub75_layout_valid(&layout) && hub75_layout_rowsel_pins(&layout) == 5, "64x64 1/32 scan");
+    layout.scan_rows = 12;
+    check(!hub75_layout_valid(&layout), "1/12 scan");
+    layout.scan_rows = 8;
+    check(!hub75_layout_valid(&layout), "Folded panel without a chunk size");
+    layout.fold_chunk = 16;
+    check(hub75_layout_valid(&layout) && hub75_layout_rows_per_scan(&layout) == 4, "64x64 1/8 scan, folded");
+    layout.fold_chunk = 24;
+    check(!hub75_layout_valid(&layout), "Chunk size which doesn't divide the width");
+    layout = (hub75_layout_t) {.panel_width = 62, .panel_height = 32, .scan_rows = 16, .panels_x = 1, .panels_y = 1};
+    check(!hub75_layout_valid(&layout), "Width not a multiple of 4");
+    layout.panel_width = 64;
+    layout.panels_x = 8;
+    layout.panels_y = 4;
+    check(hub75_layout_valid(&layout), "8x4 chain of 64x32");
+    layout.panels_y = 5;
+    check(!hub75_layout_valid(&layout), "More than 65536 pixels");
+    layout.panels_x = 0;
+    check(!hub75_layout_valid(&layout), "No panels");
+}
+
+static void check_single(void) {
+    const hub75_layout_t layout = {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 1,
+                                   .panels_y = 1};
+    check_map(&layout, 0, 0, 0, 0, 0, 0);
+    check_map(&layout, 63, 0, 0, 0, 63, 0);
+    check_map(&layout, 5, 15, 15, 0, 5, 0);
+    check_map(&layout, 5, 16, 0, 1, 5, 0);
+    check_map(&layout, 63, 31, 15, 1, 63, 0);
+}
+
+// The panel nearest the Pico receives the last pixels shifted in
+static void check_chain(void) {
+    const hub75_layout_t layout = {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 3,
+                                   .panels_y = 1};
+    check(hub75_layout_shift_length(&layout) == 192, "Shift length of 3 panels");
+    check_map(&layout, 0, 0, 0, 0, 128, 0);
+    check_map(&layout, 64, 0, 0, 0, 64, 1);
+    check_map(&layout, 191, 31, 15, 1, 63, 2);
+}
+
+// The second row of panels runs right to left, upside down
+static void check_serpentine(void) {
+    const hub75_layout_t layout = {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 2,
+                                   .panels_y = 2, .serpentine = true};
+    check_map(&layout, 0, 0, 0, 0, 192, 0);
+    check_map(&layout, 127, 0, 0, 0, 191, 1);
+    // top right of the second row: the top left of panel 2, upside down
+    check_map(&layout, 127, 32, 15, 1, 64, 2);
+    // bottom left of the display: the end of the last panel
+    check_map(&layout, 0, 63, 0, 0, 63, 3);
+    check_map(&layout, 1, 62, 1, 0, 62, 3);
+}
+
+// A 32x32 1/8 scan panel drives two rows from each scan row, with the shift
+// register folded across them 8 pixels at a time
+static void check_folded(void) {
+    const hub75_layout_t layout = {.panel_width = 32, .panel_height = 32, .scan_rows = 8, .fold_chunk = 8,
+                                   .panels_x = 1, .panels_y = 1};
+    check(hub75_layout_shift_length(&layout) == 64, "Shift length of a folded panel");
+    check_map(&layout, 0, 0, 0, 0, 0, 0);
+    check_map(&layout, 7, 0, 0, 0, 7, 0);
+    check_map(&layout, 0, 8, 0, 0, 8, 0);
+    check_map(&layout, 8, 0, 0, 0, 16, 0);
+    check_map(&layout, 9, 9, 1, 0, 25, 0);
+    check_map(&layout, 31, 31, 7, 1, 63, 0);
+}
+
+// Every display pixel must appear in the remap exactly once
+static void check_remap(const hub75_layout_t *layout) {
+    uint width = hub75_layout_width(layout);
+    uint n_pixels = width * hub75_layout_height(layout);
+    uint shift_length = hub75_layout_shift_length(layout);
+    uint n_entries = layout->scan_rows * shift_length * 2;
+    check(n_entries == n_pixels, "Size of the remap");
+    uint16_t *remap = malloc(n_entries * sizeof(uint16_t));
+    uint8_t *seen = calloc(n_pixels, 1);
+    memset(remap, 0xff, n_entries * sizeof(uint16_t));
+    hub75_layout_build_remap(layout, remap);
+    for (uint i = 0; i < n_entries; ++i) {
+        if (remap[i] >= n_pixels || seen[remap[i]]++) {
+            check(false, "Remap");
+            break;
+        }
+        uint x = remap[i] % width, y = remap[i] / width;
+        uint scan_row, lane, shift_pos;
+        hub75_layout_map(layout, x, y, &scan_row, &lane, &shift_pos);
+        check((scan_row * shift_length + shift_pos) * 2 + lane == i, "Remap against hub75_layout_map()");
+    }
+    free(seen);
+    free(remap);
+}
+
+int main() {
+    printf("HUB75 layout host tests\n");
+    check_valid();
+    check_single();
+    check_chain();
+    check_serpentine();
+    check_folded();
+
+    static const hub75_layout_t layouts[] = {
+            {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 1, .panels_y = 1},
+            {.panel_width = 64, .panel_height = 64, .scan_rows = 32, .panels_x = 4, .panels_y = 1},
+            {.panel_width = 64, .panel_height = 32, .scan_rows = 16, .panels_x = 3, .panels_y = 3, .serpentine = true},
+            {.panel_width = 32, .panel_height = 32, .scan_rows = 8, .fold_chunk = 8, .panels_x = 2, .panels_y = 2,
+             .serpentine = true},
+            {.panel_width = 64, .panel_height = 64, .scan_rows = 8, .fold_chunk = 16, .panels_x = 2, .panels_y = 3},
+    };
+    for (uint i = 0; i < count_of(layouts); ++i) {
+        check(hub75_layout_valid(&layouts[i]), "Test layout");
+        check_remap(&layouts[i]);
+    }
+
+    hub75_timing_t timing;
+    hub75_timing_init_bcm(&timing, 4, 10, 1.f);
+    check(timing.oe_cycles[0] == 10 && timing.oe_cycles[3] == 80, "Binary-coded modulation pulse widths");
+
+    printf(errors ? "FAILED\n" : "All layout checks passed\n");
+    return errors != 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "hub75_layout.h"
+
+// Overheads of the PIO programs in hub75_dma.pio, in state machine cycles
+#define ROW_SM_SETUP_CYCLES 3       // out, out, wait
+#define ROW_SM_LATCH_CYCLES 9       // nop [7], irq set
+#define DATA_SM_ROW_OVERHEAD 3      // mov, irq set, wait
+#define DATA_SM_CYCLES_PER_PIXEL 2
+
+bool hub75_layout_valid(const hub75_layout_t *layout) {
+    if (!layout->panels_x || !layout->panels_y || !layout->panel_width || layout->panel_width % 4)
+        return false;
+    if (layout->scan_rows != 8 && layout->scan_rows != 16 && layout->scan_rows != 32)
+        return false;
+    if (layout->panel_height % (2u * layout->scan_rows))
+        return false;
+    unsigned int rows_per_scan = hub75_layout_rows_per_scan(layout);
+    if (rows_per_scan != 1 && rows_per_scan != 2 && rows_per_scan != 4)
+        return false;
+    if (rows_per_scan > 1 && (!layout->fold_chunk || layout->panel_width % layout->fold_chunk))
+        return false;
+    return hub75_layout_width(layout) * hub75_layout_height(layout) <= 65536u;
+}
+
+unsigned int hub75_layout_rowsel_pins(const hub75_layout_t *layout) {
+    unsigned int pins = 0;
+    while ((1u << pins) < layout->scan_rows)
+        ++pins;
+    return pins;
+}
+
+unsigned int hub75_layout_panel_at(const hub75_layout_t *layout, unsigned int shift_pos) {
+    unsigned int segment = layout->panel_width * hub75_layout_rows_per_scan(layout);
+    return hub75_layout_n_panels(layout) - 1 - shift_pos / segment;
+}
+
+void hub75_layout_map(const hub75_layout_t *layout, unsigned int x, unsigned int y,
+                      unsigned int *scan_row, unsigned int *lane, unsigned int *shift_pos) {
+    unsigned int px = x / layout->panel_width, lx = x % layout->panel_width;
+    unsigned int py = y / layout->panel_height, ly = y % layout->panel_height;
+    unsigned int chain_index;
+    if (layout->serpentine && (py & 1)) {
+        chain_index = py * layout->panels_x + (layout->panels_x - 1 - px);
+        lx = layout->panel_width - 1 - lx;
+        ly = layout->panel_height - 1 - ly;
+    } else {
+        chain_index = py * layout->panels_x + px;
+    }
+
+    unsigned int half_height = layout->panel_height / 2;
+    unsigned int rows_per_scan = hub75_layout_rows_per_scan(layout);
+    *lane = ly / half_height;
+    ly %= half_height;
+    *scan_row = ly % layout->scan_rows;
+    unsigned int fold = ly / layout->scan_rows;
+
+    unsigned int p = lx;
+    if (rows_per_scan > 1) {
+        unsigned int chunk = layout->fold_chunk;
+        p = ((lx / chunk) * rows_per_scan + fold) * chunk + lx % chunk;
+    }
+    unsigned int segment = layout->panel_width * rows_per_scan;
+    *shift_pos = (hub75_layout_n_panels(layout) - 1 - chain_index) * segment + p;
+}
+
+void hub75_layout_build_remap(const hub75_layout_t *layout, uint16_t *remap) {
+    unsigned int width = hub75_layout_width(layout);
+    unsigned int height = hub75_layout_height(layout);
+    unsigned int shift_length = hub75_layout_shift_length(layout);
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            unsigned int scan_row, lane, shift_pos;
+            hub75_layout_map(layout, x, y, &scan_row, &lane, &shift_pos);
+            remap[(scan_row * shift_length + shift_pos) * 2 + lane] = (uint16_t) (y * width + x);
+        }
+    }
+}
+
+void hub75_timing_init_bcm(hub75_timing_t *timing, unsigned int n_planes, uint32_t base_cycles, float data_clkdiv) {
+    timing->n_planes = n_planes;
+    for (unsigned int plane = 0; plane < n_planes; ++plane)
+        timing->oe_cycles[plane] = base_cycles << plane;
+    timing->data_clkdiv = data_clkdiv;
+}
+
+uint32_t hub75_frame_cycles(const hub75_layout_t *layout, const hub75_timing_t *timing) {
+    uint32_t shift_cycles = (uint32_t) ((hub75_layout_shift_length(layout) * DATA_SM_CYCLES_PER_PIXEL +
+                                         DATA_SM_ROW_OVERHEAD) * timing->data_clkdiv);
+    uint32_t row_cycles = 0;
+    for (unsigned int plane = 0; plane < timing->n_planes; ++plane) {
+        // The data for this plane is shifted in during the previous plane's
+        // OEn pulse; the row SM can't latch it until both have finished.
+        uint32_t prev_oe = timing->oe_cycles[plane ? plane - 1 : timing->n_planes - 1];
+        uint32_t ready = prev_oe + ROW_SM_SETUP_CYCLES;
+        row_cycles += (shift_cycles > ready ? shift_cycles : ready) + ROW_SM_LATCH_CYCLES;
+    }
+    return row_cycles * layout->scan_rows;
+}
+
+float hub75_duty_cycle(const hub75_layout_t *layout, const hub75_timing_t *timing) {
+    uint32_t lit = 0;
+    for (unsigned int plane = 0; plane < timing->n_planes; ++plane)
+        lit += timing->oe_cycles[plane];
+    return (float) (lit * layout->scan_rows) / (float) hub75_frame_cycles(layout, timing);
+}
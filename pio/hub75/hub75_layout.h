@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HUB75_LAYOUT_H
+#define _HUB75_LAYOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Layout of one or more HUB75 panels daisy-chained into a single display.
+//
+// The panels are arranged in a grid of panels_x by panels_y, and the chain
+// starts at the top left panel (the one plugged into the Pico). If
+// `serpentine` is set, odd rows of panels are chained right to left and
+// mounted upside down, which keeps the ribbon cables short on a wall.
+//
+// Each panel is scanned as two halves (R0/G0/B0 and R1/G1/B1), with
+// `scan_rows` rows selected by the address lines, so 1/8, 1/16 and 1/32 scan
+// panels have scan_rows of 8, 16 and 32. If a half has more rows than that,
+// each scan row drives several panel rows, and the panel's shift register is
+// folded across them in chunks of `fold_chunk` pixels: the first chunk goes
+// to the first row, the second chunk to the next row down, and so on. This
+// is the most common arrangement, but there are others.
+//
+// The first pixel shifted into the chain ends up at the far end, i.e. on the
+// left of the last panel.
+
+#define HUB75_MAX_PLANES 12
+
+typedef struct {
+    uint16_t panel_width;
+    uint16_t panel_height;
+    uint16_t scan_rows;
+    uint16_t fold_chunk;
+    uint8_t panels_x;
+    uint8_t panels_y;
+    bool serpentine;
+} hub75_layout_t;
+
+// Check the layout is one we can drive. The width of each panel must be a
+// multiple of 4, and the whole display may have at most 65536 pixels.
+bool hub75_layout_valid(const hub75_layout_t *layout);
+
+static inline unsigned int hub75_layout_width(const hub75_layout_t *layout) {
+    return layout->panel_width * layout->panels_x;
+}
+
+static inline unsigned int hub75_layout_height(const hub75_layout_t *layout) {
+    return layout->panel_height * layout->panels_y;
+}
+
+static inline unsigned int hub75_layout_n_panels(const hub75_layout_t *layout) {
+    return layout->panels_x * layout->panels_y;
+}
+
+// Number of panel rows driven by each scan row, in each half of a panel
+static inline unsigned int hub75_layout_rows_per_scan(const hub75_layout_t *layout) {
+    return layout->panel_height / (2u * layout->scan_rows);
+}
+
+// Number of pixels shifted into the chain for each scan row
+static inline unsigned int hub75_layout_shift_length(const hub75_layout_t *layout) {
+    return hub75_layout_n_panels(layout) * layout->panel_width * hub75_layout_rows_per_scan(layout);
+}
+
+// Number of row select lines needed
+unsigned int hub75_layout_rowsel_pins(const hub75_layout_t *layout);
+
+// Index in the chain (0 is nearest the Pico) of the panel which receives
+// shift position shift_pos
+unsigned int hub75_layout_panel_at(const hub75_layout_t *layout, unsigned int shift_pos);
+
+// Find where display pixel (x, y) is driven: which scan row, which half
+// (lane 0 is R0/G0/B0, lane 1 is R1/G1/B1) and which shift position
+void hub75_layout_map(const hub75_layout_t *layout, unsigned int x, unsigned int y,
+                      unsigned int *scan_row, unsigned int *lane, unsigned int *shift_pos);
+
+// Build the reverse mapping used for packing: for each scan row, shift
+// position and lane, the index (y * width + x) of the display pixel.
+// `remap` must have room for scan_rows * shift_length * 2 entries.
+void hub75_layout_build_remap(const hub75_layout_t *layout, uint16_t *remap);
+
+// OEn pulse width for each bit plane, in system clocks, and the data state
+// machine's clock divider
+typedef struct {
+    unsigned int n_planes;
+    uint32_t oe_cycles[HUB75_MAX_PLANES];
+    float data_clkdiv;
+} hub75_timing_t;
+
+// Plain binary-coded modulation: plane n is lit for base_cycles << n
+void hub75_timing_init_bcm(hub75_timing_t *timing, unsigned int n_planes, uint32_t base_cycles, float data_clkdiv);
+
+// System clocks taken to refresh the whole display once, from the PIO
+// programs in hub75_dma.pio. Shifting the next row overlaps the current OEn
+// pulse, so short planes cost the shift time rather than their pulse width.
+uint32_t hub75_frame_cycles(const hub75_layout_t *layout, const hub75_timing_t *timing);
+
+static inline float hub75_refresh_rate_hz(const hub75_layout_t *layout, const hub75_timing_t *timing,
+                                          uint32_t sys_clk_hz) {
+    return (float) sys_clk_hz / (float) hub75_frame_cycles(layout, timing);
+}
+
+// Fraction of the frame for which the LEDs are enabled (at full brightness)
+float hub75_duty_cycle(const hub75_layout_t *layout, const hub75_timing_t *timing);
+
+#endif
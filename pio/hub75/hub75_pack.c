@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "hub75_pack.h"
+
+// The lookup tables don't hold plain colour values. Instead, bit n of the
+// corrected value is moved to bit 0 of byte n (of 12). ORing together the six
+// channels of a pixel pair, each shifted to its own pin position, then gives
+// all the 6-bit plane values at once, one per byte. This is split into 32-bit
+// words so it is also quick on cores without 64-bit shifts.
+static hub75_spread_t spread_bits(uint32_t v) {
+    hub75_spread_t s = {{0, 0, 0}};
+    for (unsigned int bit = 0; bit < HUB75_MAX_PLANES; ++bit)
+        s.planes[bit / 4] |= ((v >> bit) & 1u) << (8 * (bit % 4));
+    return s;
+}
+
+static void build_channel_lut(hub75_spread_t *lut, unsigned int in_bits, unsigned int n_planes, float gamma,
+                              float brightness) {
+    float in_max = (float) ((1u << in_bits) - 1);
+    float out_max = (float) ((1u << n_planes) - 1);
+    for (unsigned int i = 0; i < (1u << in_bits); ++i)
+        lut[i] = spread_bits((uint32_t) (powf(i / in_max, gamma) * brightness * out_max + 0.5f));
+}
+
+bool hub75_packer_init(hub75_packer_t *packer, const hub75_layout_t *layout, unsigned int n_planes) {
+    if (!hub75_layout_valid(layout) || !n_planes || n_planes > HUB75_MAX_PLANES)
+        return false;
+    packer->layout = layout;
+    packer->n_planes = n_planes;
+    packer->remap = malloc(layout->scan_rows * hub75_layout_shift_length(layout) * 2 * sizeof(uint16_t));
+    packer->lut = malloc(hub75_layout_n_panels(layout) * HUB75_LUT_ENTRIES * sizeof(hub75_spread_t));
+    if (!packer->remap || !packer->lut) {
+        hub75_packer_deinit(packer);
+        return false;
+    }
+    hub75_layout_build_remap(layout, packer->remap);
+    for (unsigned int panel = 0; panel < hub75_layout_n_panels(layout); ++panel)
+        hub75_packer_set_panel_lut(packer, panel, 2.f, 1.f);
+    return true;
+}
+
+void hub75_packer_deinit(hub75_packer_t *packer) {
+    free(packer->remap);
+    free(packer->lut);
+    packer->remap = NULL;
+    packer->lut = NULL;
+}
+
+void hub75_packer_set_panel_lut(hub75_packer_t *packer, unsigned int panel, float gamma, float brightness) {
+    hub75_spread_t *lut = packer->lut + panel * HUB75_LUT_ENTRIES;
+    build_channel_lut(lut, 5, packer->n_planes, gamma, brightness);
+    build_channel_lut(lut + 32, 6, packer->n_planes, gamma, brightness);
+    build_channel_lut(lut + 96, 5, packer->n_planes, gamma, brightness);
+}
+
+static inline void pixel_pair_planes(hub75_spread_t *p, const hub75_spread_t *lut, uint16_t upper, uint16_t lower) {
+    const hub75_spread_t *r0 = &lut[upper >> 11], *g0 = &lut[32 + ((upper >> 5) & 0x3f)], *b0 = &lut[96 + (upper & 0x1f)];
+    const hub75_spread_t *r1 = &lut[lower >> 11], *g1 = &lut[32 + ((lower >> 5) & 0x3f)], *b1 = &lut[96 + (lower & 0x1f)];
+    for (unsigned int i = 0; i < 3; ++i) {
+        p->planes[i] = r0->planes[i] | g0->planes[i] << 1 | b0->planes[i] << 2 |
+                       r1->planes[i] << 3 | g1->planes[i] << 4 | b1->planes[i] << 5;
+    }
+}
+
+void hub75_pack_frame(const hub75_packer_t *packer, uint32_t *packed, const uint16_t *rgb565) {
+    const hub75_layout_t *layout = packer->layout;
+    const unsigned int shift_length = hub75_layout_shift_length(layout);
+    const unsigned int plane_words = shift_length / 4;
+    const unsigned int n_planes = packer->n_planes;
+    for (unsigned int row = 0; row < layout->scan_rows; ++row) {
+        const uint16_t *remap = packer->remap + row * shift_length * 2;
+        uint32_t *out = packed + row * n_planes * plane_words;
+        for (unsigned int s = 0; s < shift_length; s += 4) {
+            // A panel's segment of the chain is always a multiple of 4 long
+            const hub75_spread_t *lut = packer->lut + hub75_layout_panel_at(layout, s) * HUB75_LUT_ENTRIES;
+            hub75_spread_t p[4];
+            for (unsigned int k = 0; k < 4; ++k)
+                pixel_pair_planes(&p[k], lut, rgb565[remap[(s + k) * 2]], rgb565[remap[(s + k) * 2 + 1]]);
+            uint32_t *o = out + s / 4;
+            for (unsigned int plane = 0; plane < n_planes; ++plane) {
+                unsigned int i = plane / 4, shift = 8 * (plane % 4);
+                o[plane * plane_words] =
+                        ((p[0].planes[i] >> shift) & 0x3f) |
+                        ((p[1].planes[i] >> shift) & 0x3f) << 6 |
+                        ((p[2].planes[i] >> shift) & 0x3f) << 12 |
+                        ((p[3].planes[i] >> shift) & 0x3f) << 18;
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HUB75_PACK_H
+#define _HUB75_PACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hub75_layout.h"
+
+// Bit-plane packing for HUB75 panels.
+//
+// Each scan row drives two lanes at once (see hub75_layout.h). For
+// binary-coded modulation, each scan row is shifted out once per bit plane,
+// so we need every pixel's bit n from all six channels side by side.
+//
+// The packed buffer holds, for each scan row and then each bit plane, one
+// 6-bit value per shift position:
+//
+//     bit 0: R0   bit 1: G0   bit 2: B0   bit 3: R1   bit 4: G1   bit 5: B1
+//
+// packed 4 per 32-bit word (bits 0-23, LSB first), ready to be shifted out
+// with `out pins, 6` and an autopull threshold of 24.
+//
+// Each panel has its own colour lookup table, from RGB565 to n_planes bits
+// per channel, so that panels from different batches can be matched.
+
+// Number of words in a packed frame
+#define HUB75_PACKED_WORDS(shift_length, scan_rows, n_planes) ((scan_rows) * (n_planes) * (shift_length) / 4)
+
+typedef struct {
+    uint32_t planes[3];
+} hub75_spread_t;
+
+typedef struct {
+    const hub75_layout_t *layout;
+    unsigned int n_planes;
+    // Display pixel index for each scan row, shift position and lane
+    uint16_t *remap;
+    // Per panel: 32 red, 64 green and 32 blue entries
+    hub75_spread_t *lut;
+} hub75_packer_t;
+
+#define HUB75_LUT_ENTRIES (32 + 64 + 32)
+
+// Allocate the remap and lookup tables. All panels start with a gamma of 2.0
+// at full brightness, like gamma_correct_565_888() in hub75.c.
+bool hub75_packer_init(hub75_packer_t *packer, const hub75_layout_t *layout, unsigned int n_planes);
+
+void hub75_packer_deinit(hub75_packer_t *packer);
+
+// Set the colour curve for one panel (index in the chain). brightness is
+// 0.0 to 1.0, and scales each channel after gamma correction.
+void hub75_packer_set_panel_lut(hub75_packer_t *packer, unsigned int panel, float gamma, float brightness);
+
+// Colour-correct, remap and pack a display-sized RGB565 image
+void hub75_pack_frame(const hub75_packer_t *packer, uint32_t *packed, const uint16_t *rgb565);
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pio_i2c.h"
+#include "pio_i2c_dma.h"
+#include "i2c_bus_sim.h"
+
+// The pio_i2c_bus_scan example keeps the processor busy for the whole of
+// every transaction, feeding the FIFO a word at a time. Here transactions
+// (write, read, or write then read) are queued, and fed to the state machine
+// by DMA, with a callback when each one is done, so several buses can be
+// busy at once whilst the processor does something else.
+//
+// Before touching the real bus, the queue runs against simulated buses with
+// sensors on them, which also gives the transaction rate for 1 to 8 buses.
+// The bus on SDA 2 / SCL 3 is then scanned, blocking and asynchronously, and
+// registers are read both ways from whatever answers.
+
+#define PIN_SDA 2
+#define PIN_SCL 3
+
+#define DMA_IRQ_INDEX 0
+#define PIO_IRQ_INDEX 0
+
+#define N_SIM_BUSES 8
+#define SIM_OVERHEAD_NS 2000
+
+#define N_READS 100
+
+static bool reserved_addr(uint8_t addr) {
+    return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
+}
+
+static i2c_txn_queue_t sim_queues[N_SIM_BUSES];
+static i2c_bus_sim_t sims[N_SIM_BUSES];
+static i2c_sim_device_t sim_devices[N_SIM_BUSES][2];
+
+static void init_sim_buses(uint n_buses, uint32_t bit_ns) {
+    for (uint b = 0; b < n_buses; ++b) {
+        // A temperature sensor and a pressure sensor on each bus, with
+        // something different in every register
+        i2c_sim_device_t *devs = sim_devices[b];
+        memset(devs, 0, sizeof(sim_devices[b]));
+        devs[0].addr = 0x48;
+        devs[1].addr = 0x76;
+        for (uint r = 0; r < 256; ++r) {
+            devs[0].regs[r] = (uint8_t) (r ^ b);
+            devs[1].regs[r] = (uint8_t) (r * 7 + b);
+        }
+        i2c_bus_sim_init(&sims[b], &sim_queues[b], devs, 2, bit_ns, SIM_OVERHEAD_NS);
+    }
+}
+
+static void run_sim_buses(uint n_buses) {
+    bool busy = true;
+    while (busy) {
+        busy = false;
+        for (uint b = 0; b < n_buses; ++b) {
+            i2c_bus_sim_advance(&sims[b], 10000);
+            busy |= !i2c_txn_queue_idle(&sim_queues[b]);
+        }
+    }
+}
+
+// Writes, reads and probes, queued on every bus at once, must each do what
+// the devices say, and NAK where there's nothing there
+static bool check_queue(void) {
+    init_sim_buses(N_SIM_BUSES, 2500);
+
+    enum {
+        READ_REGS, WRITE_REGS, READ_BACK, READ_ON, PROBE, PROBE_MISSING, READ_MISSING, N_TXNS
+    };
+    static const uint8_t read_reg[] = {0x10};
+    static const uint8_t write_regs[] = {0x20, 0xde, 0xad, 0xbe, 0xef};
+    static const uint8_t read_back_reg[] = {0x20};
+    static i2c_txn_t txns[N_SIM_BUSES][N_TXNS];
+    static uint8_t rx[N_SIM_BUSES][N_TXNS][8];
+    for (uint b = 0; b < N_SIM_BUSES; ++b) {
+        i2c_txn_t *t = txns[b];
+        t[READ_REGS] = (i2c_txn_t) {.addr = 0x48, .tx = read_reg, .tx_len = 1, .rx = rx[b][READ_REGS], .rx_len = 6};
+        t[WRITE_REGS] = (i2c_txn_t) {.addr = 0x76, .tx = write_regs, .tx_len = sizeof(write_regs)};
+        t[READ_BACK] = (i2c_txn_t) {.addr = 0x76, .tx = read_back_reg, .tx_len = 1, .rx = rx[b][READ_BACK],
+                .rx_len = 4};
+        // Carries on from where the last read left the pointer
+        t[READ_ON] = (i2c_txn_t) {.addr = 0x76, .rx = rx[b][READ_ON], .rx_len = 2};
+        t[PROBE] = (i2c_txn_t) {.addr = 0x48};
+        t[PROBE_MISSING] = (i2c_txn_t) {.addr = 0x50};
+        t[READ_MISSING] = (i2c_txn_t) {.addr = 0x50, .tx = read_reg, .tx_len = 1, .rx = rx[b][READ_MISSING],
+                .rx_len = 2};
+        for (uint i = 0; i < N_TXNS; ++i) {
+            if (!i2c_txn_submit(&sim_queues[b], &t[i])) {
+                printf("Transaction %u on bus %u was refused\n", i, b);
+                return false;
+            }
+        }
+    }
+    i2c_txn_t too_long = {.addr = 0x48, .tx = write_regs, .tx_len = I2C_TXN_MAX_LEN + 1};
+    if (i2c_txn_submit(&sim_queues[0], &too_long)) {
+        printf("Over-long transaction was accepted\n");
+        return false;
+    }
+
+    run_sim_buses(N_SIM_BUSES);
+
+    for (uint b = 0; b < N_SIM_BUSES; ++b) {
+        i2c_txn_t *t = txns[b];
+        for (uint i = 0; i < N_TXNS; ++i) {
+            int expect = i == PROBE_MISSING || i == READ_MISSING ? I2C_TXN_NAK : I2C_TXN_OK;
+            if (!i2c_txn_is_done(&t[i]) || t[i].result != expect) {
+                printf("Transaction %u on bus %u: result %d, expected %d\n", i, b, t[i].result, expect);
+                return false;
+            }
+        }
+        const uint8_t *temp_regs = sim_devices[b][0].regs;
+        const uint8_t *pres_regs = sim_devices[b][1].regs;
+        if (memcmp(rx[b][READ_REGS], temp_regs + 0x10, 6) ||
+            memcmp(pres_regs + 0x20, write_regs + 1, 4) ||
+            memcmp(rx[b][READ_BACK], write_regs + 1, 4) ||
+            memcmp(rx[b][READ_ON], pres_regs + 0x24, 2)) {
+            printf("Data on bus %u doesn't match\n", b);
+            return false;
+        }
+        if (sims[b].errors || sim_queues[b].failed != 2) {
+            printf("Bus %u: %u bus errors, %u failed\n", b, (uint) sims[b].errors, (uint) sim_queues[b].failed);
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint8_t bench_reg[] = {0x00};
+static uint8_t bench_rx[N_SIM_BUSES][6];
+static i2c_txn_t bench_txns[N_SIM_BUSES];
+
+// Each bus polls its sensor over and over, starting the next read as soon
+// as the last one is done
+static void resubmit(i2c_txn_t *txn) {
+    i2c_txn_submit(&sim_queues[(uint) (uintptr_t) txn->user], txn);
+}
+
+// Returns transactions a second, over all the buses, reading 6 bytes of
+// registers at a time
+static uint32_t sim_txns_per_sec(uint n_buses, uint32_t bus_hz) {
+    init_sim_buses(n_buses, 1000000000u / bus_hz);
+    for (uint b = 0; b < n_buses; ++b) {
+        bench_txns[b] = (i2c_txn_t) {
+                .addr = 0x76,
+                .tx = bench_reg,
+                .tx_len = 1,
+                .rx = bench_rx[b],
+                .rx_len = 6,
+                .on_done = resubmit,
+                .user = (void *) (uintptr_t) b,
+        };
+        i2c_txn_submit(&sim_queues[b], &bench_txns[b]);
+    }
+    // One simulated second, a millisecond at a time
+    uint32_t total = 0;
+    for (uint ms = 0; ms < 1000; ++ms) {
+        for (uint b = 0; b < n_buses; ++b)
+            i2c_bus_sim_advance(&sims[b], 1000000);
+    }
+    for (uint b = 0; b < n_buses; ++b)
+        total += sim_queues[b].completed;
+    return total;
+}
+
+static void scan_blocking(PIO pio, uint sm, uint8_t *found) {
+    for (uint addr = 0; addr < (1 << 7); ++addr)
+        found[addr] = !reserved_addr(addr) && pio_i2c_read_blocking(pio, sm, addr, NULL, 0) >= 0;
+}
+
+static void scan_async(pio_i2c_dma_t *d, uint8_t *found) {
+    // Far more addresses than the queue holds, so wait for room as we go
+    static i2c_txn_t probes[1 << 7];
+    for (uint addr = 0; addr < (1 << 7); ++addr) {
+        probes[addr] = (i2c_txn_t) {.addr = addr};
+        if (reserved_addr(addr))
+            continue;
+        while (!pio_i2c_dma_submit(d, &probes[addr]))
+            tight_loop_contents();
+    }
+    pio_i2c_dma_wait_idle(d);
+    for (uint addr = 0; addr < (1 << 7); ++addr)
+        found[addr] = !reserved_addr(addr) && probes[addr].result == I2C_TXN_OK;
+}
+
+static void print_scan(const uint8_t *found) {
+    printf("   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
+    for (uint addr = 0; addr < (1 << 7); ++addr) {
+        if (addr % 16 == 0)
+            printf("%02x ", addr);
+        printf(found[addr] ? "@" : ".");
+        printf(addr % 16 == 15 ? "\n" : "  ");
+    }
+}
+
+int main() {
+    stdio_init_all();
+    printf("\nPIO I2C async example\n");
+
+    printf("Transaction queue against %u simulated buses: %s\n", N_SIM_BUSES, check_queue() ? "OK" : "Nope");
+
+    // With the processor blocked for each transaction, only one bus can be
+    // busy at a time, so the 1 bus figure is the best the blocking
+    // functions can do
+    static const uint32_t bus_hz[] = {100000, 400000};
+    static const uint n_buses[] = {1, 2, 4, 8};
+    printf("\nSimulated 6 byte register reads a second, over all buses\n");
+    printf("  kHz");
+    for (uint n = 0; n < count_of(n_buses); ++n)
+        printf(" %3u bus%s", n_buses[n], n_buses[n] == 1 ? " " : "es");
+    printf("\n");
+    for (uint h = 0; h < count_of(bus_hz); ++h) {
+        printf("%5u", (uint) (bus_hz[h] / 1000));
+        for (uint n = 0; n < count_of(n_buses); ++n)
+            printf(" %9u", (uint) sim_txns_per_sec(n_buses[n], bus_hz[h]));
+        printf("\n");
+    }
+
+    PIO pio = pio0;
+    uint sm = 0;
+    uint offset = pio_add_program(pio, &i2c_program);
+    i2c_program_init(pio, sm, offset, PIN_SDA, PIN_SCL);
+    static pio_i2c_dma_t dma;
+    pio_i2c_dma_init(&dma, pio, sm, DMA_IRQ_INDEX, PIO_IRQ_INDEX);
+
+    static uint8_t found_blocking[1 << 7], found_async[1 << 7];
+    uint64_t start = time_us_64();
+    scan_blocking(pio, sm, found_blocking);
+    uint32_t blocking_us = (uint32_t) (time_us_64() - start);
+    start = time_us_64();
+    scan_async(&dma, found_async);
+    uint32_t async_us = (uint32_t) (time_us_64() - start);
+
+    printf("\nBus scan, blocking %u us, async %u us: %s\n", (uint) blocking_us, (uint) async_us,
+           memcmp(found_blocking, found_async, sizeof(found_async)) ? "results differ" : "results match");
+    print_scan(found_async);
+
+    int dev = -1;
+    for (uint addr = 0; addr < (1 << 7) && dev < 0; ++addr) {
+        if (found_async[addr])
+            dev = (int) addr;
+    }
+    if (dev < 0) {
+        printf("Nothing to read registers from\n");
+        return 0;
+    }
+
+    // Read 6 bytes from register 0, N_READS times
+    uint8_t reg = 0;
+    uint8_t blocking_rx[6], async_rx[6];
+    start = time_us_64();
+    for (uint i = 0; i < N_READS; ++i) {
+        pio_i2c_write_blocking(pio, sm, (uint8_t) dev, &reg, 1);
+        pio_i2c_read_blocking(pio, sm, (uint8_t) dev, blocking_rx, sizeof(blocking_rx));
+    }
+    blocking_us = (uint32_t) (time_us_64() - start);
+
+    static i2c_txn_t reads[I2C_TXN_QUEUE_LEN];
+    uint32_t failed_before = dma.queue.failed;
+    start = time_us_64();
+    for (uint i = 0; i < N_READS; ++i) {
+        i2c_txn_t *t = &reads[i % count_of(reads)];
+        if (i >= count_of(reads))
+            pio_i2c_dma_wait(t);
+        *t = (i2c_txn_t) {.addr = (uint8_t) dev, .tx = &reg, .tx_len = 1, .rx = async_rx, .rx_len = sizeof(async_rx)};
+        hard_assert(pio_i2c_dma_submit(&dma, t));
+    }
+    pio_i2c_dma_wait_idle(&dma);
+    async_us = (uint32_t) (time_us_64() - start);
+
+    printf("%u register reads from %02x: blocking %u us, async %u us, %u failed: %s\n", N_READS, dev,
+           (uint) blocking_us, (uint) async_us, (uint) (dma.queue.failed - failed_before),
+           memcmp(blocking_rx, async_rx, sizeof(async_rx)) ? "data differs" : "data matches");
+    return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "i2c_bus_sim.h"
+
+const i2c_txn_instrs_t i2c_bus_sim_instrs = {
+        .sc0_sd0 = 0xe080,
+        .sc0_sd1 = 0xe081,
+        .sc1_sd0 = 0xf080,
+        .sc1_sd1 = 0xf081,
+        .push = 0x8000,
+};
+
+static i2c_sim_device_t *find_device(i2c_bus_sim_t *sim, uint8_t addr) {
+    for (uint32_t i = 0; i < sim->n_devices; ++i) {
+        if (sim->devices[i].addr == addr)
+            return &sim->devices[i];
+    }
+    return NULL;
+}
+
+// Returns false for an instruction the words shouldn't hold
+static bool exec_instr(i2c_bus_sim_t *sim, uint16_t instr, uint32_t *n_rx) {
+    bool scl, sda;
+    if (instr == sim->instrs.push) {
+        sim->rx[(*n_rx)++] = 0;
+        return true;
+    } else if (instr == sim->instrs.sc0_sd0) {
+        scl = false, sda = false;
+    } else if (instr == sim->instrs.sc0_sd1) {
+        scl = false, sda = true;
+    } else if (instr == sim->instrs.sc1_sd0) {
+        scl = true, sda = false;
+    } else if (instr == sim->instrs.sc1_sd1) {
+        scl = true, sda = true;
+    } else {
+        return false;
+    }
+    if (sim->scl && scl && sim->sda != sda) {
+        if (!sda) {
+            // START, or repeated START
+            sim->in_txn = true;
+            sim->expect_addr = true;
+        } else {
+            // STOP
+            sim->in_txn = false;
+            sim->selected = NULL;
+        }
+    }
+    sim->scl = scl;
+    sim->sda = sda;
+    return true;
+}
+
+// Clocks one byte and its ACK. Returns false if the state machine would stop
+// on a NAK.
+static bool clock_byte(i2c_bus_sim_t *sim, uint16_t word, uint32_t *n_rx) {
+    uint8_t out = (uint8_t) (word >> I2C_TXN_DATA_LSB);
+    bool release_ack = word & (1u << I2C_TXN_NAK_LSB);
+    bool final = word & (1u << I2C_TXN_FINAL_LSB);
+    uint8_t byte = out;
+    bool device_ack = false;
+    if (!sim->in_txn) {
+        sim->errors++;
+    } else if (sim->expect_addr) {
+        sim->expect_addr = false;
+        sim->selected = find_device(sim, out >> 1);
+        sim->reading = out & 1u;
+        sim->set_ptr = !sim->reading;
+        device_ack = sim->selected != NULL;
+    } else if (sim->selected && sim->reading) {
+        // Open drain: the controller must leave SDA released
+        if (out != 0xff)
+            sim->errors++;
+        byte = sim->selected->regs[sim->selected->ptr++];
+        sim->selected->bytes_read++;
+    } else if (sim->selected) {
+        if (sim->set_ptr)
+            sim->selected->ptr = out;
+        else
+            sim->selected->regs[sim->selected->ptr++] = out;
+        sim->set_ptr = false;
+        sim->selected->bytes_written++;
+        device_ack = true;
+    }
+    sim->rx[(*n_rx)++] = byte;
+    // Whoever doesn't pull SDA low for the ACK releases it
+    bool nak = release_ack && !device_ack;
+    return !nak || final;
+}
+
+static void sim_start(void *ctx, i2c_txn_t *txn) {
+    i2c_bus_sim_t *sim = ctx;
+    uint32_t rx_words;
+    uint32_t n = i2c_txn_encode(txn, &sim->instrs, sim->words, &rx_words);
+    uint32_t n_rx = 0;
+    uint64_t ns = sim->overhead_ns;
+    sim->result = I2C_TXN_OK;
+    for (uint32_t i = 0; i < n;) {
+        uint16_t word = sim->words[i++];
+        uint32_t icount = word >> I2C_TXN_ICOUNT_LSB;
+        if (icount) {
+            for (uint32_t k = 0; k <= icount && i < n; ++k) {
+                if (!exec_instr(sim, sim->words[i++], &n_rx))
+                    sim->errors++;
+                ns += sim->bit_ns / 4;
+            }
+        } else {
+            ns += 9ull * sim->bit_ns;
+            if (!clock_byte(sim, word, &n_rx)) {
+                // The driver drains the rest and sends a STOP
+                sim->result = I2C_TXN_NAK;
+                sim->in_txn = false;
+                sim->selected = NULL;
+                sim->scl = sim->sda = true;
+                ns += sim->bit_ns;
+                break;
+            }
+        }
+    }
+    if (sim->result == I2C_TXN_OK && (n_rx != rx_words || sim->in_txn))
+        sim->errors++;
+    sim->active = txn;
+    uint64_t start_ns = sim->finish_ns > sim->now_ns ? sim->finish_ns : sim->now_ns;
+    sim->finish_ns = start_ns + ns;
+}
+
+// The simulation is single threaded, so there is nothing to lock out
+static uint32_t sim_lock(void *ctx) {
+    (void) ctx;
+    return 0;
+}
+
+static void sim_unlock(void *ctx, uint32_t saved) {
+    (void) ctx;
+    (void) saved;
+}
+
+void i2c_bus_sim_init(i2c_bus_sim_t *sim, i2c_txn_queue_t *q, i2c_sim_device_t *devices, uint32_t n_devices,
+                      uint32_t bit_ns, uint32_t overhead_ns) {
+    memset(sim, 0, sizeof(*sim));
+    sim->queue = q;
+    sim->devices = devices;
+    sim->n_devices = n_devices;
+    sim->instrs = i2c_bus_sim_instrs;
+    sim->bit_ns = bit_ns;
+    sim->overhead_ns = overhead_ns;
+    sim->scl = sim->sda = true;
+    i2c_txn_backend_t backend = {
+            .start = sim_start,
+            .lock = sim_lock,
+            .unlock = sim_unlock,
+            .ctx = sim,
+    };
+    i2c_txn_queue_init(q, &backend);
+}
+
+void i2c_bus_sim_advance(i2c_bus_sim_t *sim, uint64_t ns) {
+    uint64_t end_ns = sim->now_ns + ns;
+    while (sim->active && sim->finish_ns <= end_ns) {
+        i2c_txn_t *txn = sim->active;
+        sim->now_ns = sim->finish_ns;
+        sim->active = NULL;
+        if (sim->result == I2C_TXN_OK)
+            i2c_txn_copy_rx(txn, sim->rx);
+        // This may start the next transaction
+        i2c_txn_queue_complete(sim->queue, sim->result);
+    }
+    sim->now_ns = end_ns;
+}
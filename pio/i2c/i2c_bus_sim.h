@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _I2C_BUS_SIM_H
+#define _I2C_BUS_SIM_H
+
+#include "i2c_txn.h"
+
+// An I2C bus with simulated devices on it, on the far end of an
+// i2c_txn_queue_t, in place of pio_i2c_dma.
+//
+// Each transaction is encoded with i2c_txn_encode(), and the words are run
+// as the i2c program would run them: the instruction sequences move SCL and
+// SDA, so START and STOP are seen on the bus, and each data word clocks a
+// byte and its ACK. Anything the program or a device wouldn't expect (data
+// outside START and STOP, an unknown instruction, the controller driving SDA
+// whilst a device sends) is counted in errors.
+//
+// The devices are like most sensors: the first byte written sets a register
+// pointer, further bytes are written to registers from there, and reads
+// return registers from there, the pointer moving on with each byte.
+//
+// Like the loopback simulation in pio/spi, time only moves on in
+// i2c_bus_sim_advance(). A bit takes bit_ns, each instruction a quarter of
+// that (as the program spends 8 cycles on each), and each transaction
+// overhead_ns more, for the processor and DMA.
+
+typedef struct {
+    uint8_t addr;
+    uint8_t ptr;
+    uint8_t regs[256];
+    uint32_t bytes_read;
+    uint32_t bytes_written;
+} i2c_sim_device_t;
+
+typedef struct {
+    i2c_txn_queue_t *queue;
+    i2c_sim_device_t *devices;
+    uint32_t n_devices;
+    i2c_txn_instrs_t instrs;
+    uint32_t bit_ns;
+    uint32_t overhead_ns;
+    i2c_txn_t *active;
+    int result;
+    uint64_t now_ns;
+    uint64_t finish_ns;
+    bool scl;
+    bool sda;
+    bool in_txn;
+    bool expect_addr;
+    bool reading;
+    bool set_ptr;
+    i2c_sim_device_t *selected;
+    uint16_t words[I2C_TXN_MAX_WORDS];
+    uint8_t rx[I2C_TXN_MAX_RX_WORDS];
+    uint32_t errors;
+} i2c_bus_sim_t;
+
+// The instructions are arbitrary distinct values, as nothing executes them
+extern const i2c_txn_instrs_t i2c_bus_sim_instrs;
+
+void i2c_bus_sim_init(i2c_bus_sim_t *sim, i2c_txn_queue_t *q, i2c_sim_device_t *devices, uint32_t n_devices,
+                      uint32_t bit_ns, uint32_t overhead_ns);
+
+// Move time on, completing any transactions which finish in that time
+void i2c_bus_sim_advance(i2c_bus_sim_t *sim, uint64_t ns);
+
+#endif
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pio_i2c.h"
+#include "pio_i2c_multi.h"
+#include "i2c_poller.h"
+#include "i2c_bus_sim.h"
+
+// The pio_i2c_bus_scan example probes one address at a time, on one bus.
+// Where there are many identical sensors, each at the same fixed address on
+// its own bus, we can run one bus per state machine (8 on RP2040, 12 on
+// RP2350), and scan or poll them all in lockstep: a tick reads every sensor
+// once, every bus at the same time, giving a vector of samples.
+//
+// The poller is tried on simulated buses at startup, which print how many
+// reads a second it manages as buses are added. The 8 real buses are on
+// SDA/SCL pins 2/3, 4/5 and so on up to 16/17; whatever the scan finds is
+// polled, and timed against reading each sensor in turn.
+
+#define PIN_SDA_BASE 2
+#define N_BUSES 8
+
+#define N_SIM_BUSES I2C_POLLER_MAX_BUSES
+#define SIM_SENSORS_PER_BUS 4
+#define SIM_OVERHEAD_NS 2000
+#define SIM_STEP_NS 10000
+
+#define SAMPLE_LEN 6
+
+static i2c_txn_queue_t sim_queues[N_SIM_BUSES];
+static i2c_bus_sim_t sims[N_SIM_BUSES];
+static i2c_sim_device_t sim_devices[N_SIM_BUSES][SIM_SENSORS_PER_BUS];
+static uint n_sim_buses;
+
+// Identical sensors at 0x48 onwards, with something different in every
+// register of every one
+static void init_sim_buses(uint n_buses, uint32_t bit_ns) {
+    n_sim_buses = n_buses;
+    for (uint b = 0; b < n_buses; ++b) {
+        memset(sim_devices[b], 0, sizeof(sim_devices[b]));
+        for (uint s = 0; s < SIM_SENSORS_PER_BUS; ++s) {
+            sim_devices[b][s].addr = 0x48 + s;
+            for (uint r = 0; r < 256; ++r)
+                sim_devices[b][s].regs[r] = (uint8_t) (r * 7 + b * 16 + s);
+        }
+        i2c_bus_sim_init(&sims[b], &sim_queues[b], sim_devices[b], SIM_SENSORS_PER_BUS, bit_ns, SIM_OVERHEAD_NS);
+    }
+}
+
+// All the buses move on together
+static void sim_wait(__unused void *ctx) {
+    for (uint b = 0; b < n_sim_buses; ++b)
+        i2c_bus_sim_advance(&sims[b], SIM_STEP_NS);
+}
+
+static void init_sim_poller(i2c_poller_t *p, uint n_buses) {
+    i2c_txn_queue_t *queues[N_SIM_BUSES];
+    for (uint b = 0; b < n_buses; ++b)
+        queues[b] = &sim_queues[b];
+    i2c_poller_init(p, queues, n_buses, sim_wait, NULL);
+}
+
+static bool sample_matches(const i2c_poller_t *p, uint sensor, const i2c_sim_device_t *dev) {
+    const uint8_t *sample = i2c_poller_sample(p, sensor);
+    return sample && !memcmp(sample, dev->regs, SAMPLE_LEN);
+}
+
+// Every sensor on every bus must be found, and each tick must give the
+// sensors' latest registers, with missing sensors left out
+static bool check_poller(void) {
+    static i2c_poller_t p;
+    init_sim_buses(N_SIM_BUSES, 2500);
+    init_sim_poller(&p, N_SIM_BUSES);
+
+    i2c_poller_scan(&p);
+    for (uint b = 0; b < N_SIM_BUSES; ++b) {
+        for (uint addr = 0; addr < (1 << 7); ++addr) {
+            bool expect = addr >= 0x48 && addr < 0x48 + SIM_SENSORS_PER_BUS;
+            if (i2c_poller_found(&p, b, addr) != expect) {
+                printf("Bus %u address %02x: found %d\n", b, addr, !expect);
+                return false;
+            }
+        }
+    }
+
+    for (uint b = 0; b < N_SIM_BUSES; ++b) {
+        for (uint s = 0; s < SIM_SENSORS_PER_BUS; ++s)
+            i2c_poller_add_sensor(&p, b, 0x48 + s, 0, SAMPLE_LEN);
+    }
+    int missing = i2c_poller_add_sensor(&p, 3, 0x50, 0, SAMPLE_LEN);
+    uint n_read = i2c_poller_tick(&p);
+    if (missing < 0 || n_read != N_SIM_BUSES * SIM_SENSORS_PER_BUS || i2c_poller_sample(&p, missing)) {
+        printf("Read %u sensors, expected %u\n", n_read, N_SIM_BUSES * SIM_SENSORS_PER_BUS);
+        return false;
+    }
+
+    for (uint tick = 0; tick < 3; ++tick) {
+        // The sensors take new readings between ticks
+        for (uint b = 0; b < N_SIM_BUSES; ++b) {
+            for (uint s = 0; s < SIM_SENSORS_PER_BUS; ++s)
+                sim_devices[b][s].regs[0] += tick + 1;
+        }
+        i2c_poller_tick(&p);
+        for (uint i = 0; i < N_SIM_BUSES * SIM_SENSORS_PER_BUS; ++i) {
+            if (!sample_matches(&p, i, &sim_devices[i / SIM_SENSORS_PER_BUS][i % SIM_SENSORS_PER_BUS])) {
+                printf("Tick %u: sensor %u doesn't match\n", tick, i);
+                return false;
+            }
+        }
+    }
+    for (uint b = 0; b < N_SIM_BUSES; ++b) {
+        if (sims[b].errors) {
+            printf("Bus %u: %u bus errors\n", b, (uint) sims[b].errors);
+            return false;
+        }
+    }
+    return p.ticks == 4 && p.failed_reads == 4;
+}
+
+// Returns reads a second, over all the buses, and the ticks a second
+static uint32_t sim_reads_per_sec(uint n_buses, uint32_t bus_hz, uint32_t *ticks_per_sec) {
+    static i2c_poller_t p;
+    init_sim_buses(n_buses, 1000000000u / bus_hz);
+    init_sim_poller(&p, n_buses);
+    for (uint b = 0; b < n_buses; ++b) {
+        for (uint s = 0; s < SIM_SENSORS_PER_BUS; ++s)
+            i2c_poller_add_sensor(&p, b, 0x48 + s, 0, SAMPLE_LEN);
+    }
+    // One simulated second
+    while (sims[0].now_ns < 1000000000ull)
+        i2c_poller_tick(&p);
+    *ticks_per_sec = p.ticks;
+    return p.reads;
+}
+
+static void service(void *ctx) {
+    pio_i2c_multi_service(ctx);
+}
+
+int main() {
+    stdio_init_all();
+    printf("\nPIO I2C multi-bus poller example\n");
+
+    printf("Poller against %u simulated buses: %s\n", N_SIM_BUSES, check_poller() ? "OK" : "Nope");
+
+    // With 1 bus, each sensor is read in turn, as the blocking functions
+    // would
+    static const uint32_t bus_hz[] = {100000, 400000};
+    static const uint n_buses[] = {1, 2, 4, 8, 12};
+    printf("\nSimulated %u byte reads a second, over all buses, %u sensors per bus (ticks a second)\n",
+           SAMPLE_LEN, SIM_SENSORS_PER_BUS);
+    printf("  kHz");
+    for (uint n = 0; n < count_of(n_buses); ++n)
+        printf("    %2u bus%s", n_buses[n], n_buses[n] == 1 ? " " : "es");
+    printf("\n");
+    for (uint h = 0; h < count_of(bus_hz); ++h) {
+        printf("%5u", (uint) (bus_hz[h] / 1000));
+        for (uint n = 0; n < count_of(n_buses); ++n) {
+            uint32_t ticks;
+            uint32_t reads = sim_reads_per_sec(n_buses[n], bus_hz[h], &ticks);
+            printf(" %6u (%4u)", (uint) reads, (uint) ticks);
+        }
+        printf("\n");
+    }
+
+    // Four buses per PIO, all running the same program
+    static pio_i2c_multi_t multi;
+    pio_i2c_multi_init(&multi);
+    i2c_txn_queue_t *queues[N_BUSES];
+    for (uint b = 0; b < N_BUSES; ++b) {
+        PIO pio = pio_get_instance(b / NUM_PIO_STATE_MACHINES);
+        uint sm = b % NUM_PIO_STATE_MACHINES;
+        static uint offset;
+        if (sm == 0)
+            offset = pio_add_program(pio, &i2c_program);
+        i2c_program_init(pio, sm, offset, PIN_SDA_BASE + 2 * b, PIN_SDA_BASE + 2 * b + 1);
+        queues[b] = pio_i2c_multi_add_bus(&multi, pio, sm);
+    }
+    static i2c_poller_t poller;
+    i2c_poller_init(&poller, queues, N_BUSES, service, &multi);
+
+    uint64_t start = time_us_64();
+    i2c_poller_scan(&poller);
+    printf("\nScanned %u buses in %u us\n", N_BUSES, (uint) (time_us_64() - start));
+    for (uint b = 0; b < N_BUSES; ++b) {
+        printf("Bus %u (SDA %2u):", b, PIN_SDA_BASE + 2 * b);
+        for (uint addr = 0; addr < (1 << 7); ++addr) {
+            if (i2c_poller_found(&poller, b, addr)) {
+                printf(" %02x", addr);
+                i2c_poller_add_sensor(&poller, b, addr, 0, SAMPLE_LEN);
+            }
+        }
+        printf("\n");
+    }
+    if (!poller.n_sensors) {
+        printf("Nothing to poll\n");
+        return 0;
+    }
+
+    // Each sensor in turn, with the blocking functions
+    static uint8_t sample[SAMPLE_LEN];
+    start = time_us_64();
+    for (uint i = 0; i < poller.n_sensors; ++i) {
+        const i2c_poller_sensor_t *s = &poller.sensors[i];
+        uint8_t reg = s->reg;
+        PIO pio = multi.buses[s->bus].pio;
+        uint sm = multi.buses[s->bus].sm;
+        pio_i2c_write_blocking(pio, sm, s->addr, &reg, 1);
+        pio_i2c_read_blocking(pio, sm, s->addr, sample, s->len);
+    }
+    uint32_t blocking_us = (uint32_t) (time_us_64() - start);
+
+    // All of them at once, for a second
+    uint32_t reads = poller.reads;
+    uint32_t ticks = poller.ticks;
+    start = time_us_64();
+    while (time_us_64() - start < 1000000)
+        i2c_poller_tick(&poller);
+    uint32_t us = (uint32_t) (time_us_64() - start);
+    ticks = poller.ticks - ticks;
+    reads = poller.reads - reads;
+
+    printf("%u sensors: one at a time %u us, all at once %u us a tick, %u reads a second, %u failed\n",
+           (uint) poller.n_sensors, (uint) blocking_us, (uint) (us / ticks),
+           (uint) ((uint64_t) reads * 1000000 / us), (uint) poller.failed_reads);
+    printf("Last samples:\n");
+    for (uint i = 0; i < poller.n_sensors; ++i) {
+        const uint8_t *s = i2c_poller_sample(&poller, i);
+        printf("bus %u %02x:", poller.sensors[i].bus, poller.sensors[i].addr);
+        for (uint j = 0; s && j < SAMPLE_LEN; ++j)
+            printf(" %02x", s[j]);
+        printf(s ? "\n" : " no answer\n");
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "i2c_poller.h"
+
+// The first and last 8 addresses are reserved
+#define FIRST_ADDR 0x08
+#define LAST_ADDR 0x77
+
+void i2c_poller_init(i2c_poller_t *p, i2c_txn_queue_t *const *queues, uint32_t n_buses, void (*wait)(void *ctx),
+                     void *wait_ctx) {
+    memset(p, 0, sizeof(*p));
+    if (n_buses > I2C_POLLER_MAX_BUSES)
+        n_buses = I2C_POLLER_MAX_BUSES;
+    for (uint32_t b = 0; b < n_buses; ++b) {
+        p->buses[b].poller = p;
+        p->buses[b].queue = queues[b];
+    }
+    p->n_buses = n_buses;
+    p->wait = wait;
+    p->wait_ctx = wait_ctx;
+}
+
+static void read_done(i2c_txn_t *txn) {
+    i2c_poller_t *p = txn->user;
+    if (txn->result == I2C_TXN_OK)
+        p->reads++;
+    else
+        p->failed_reads++;
+    if (!--p->pending)
+        p->ticks++;
+}
+
+int i2c_poller_add_sensor(i2c_poller_t *p, uint32_t bus, uint8_t addr, uint8_t reg, uint8_t len) {
+    if (bus >= p->n_buses || p->n_sensors == I2C_POLLER_MAX_SENSORS ||
+        p->buses[bus].n_sensors == I2C_POLLER_MAX_PER_BUS || !len || len > I2C_POLLER_MAX_SAMPLE)
+        return -1;
+    uint32_t i = p->n_sensors++;
+    p->buses[bus].n_sensors++;
+    p->sensors[i] = (i2c_poller_sensor_t) {
+            .bus = (uint8_t) bus,
+            .addr = addr,
+            .reg = reg,
+            .len = len,
+    };
+    p->txns[i] = (i2c_txn_t) {
+            .addr = addr,
+            .tx = &p->sensors[i].reg,
+            .tx_len = 1,
+            .rx = p->samples[i],
+            .rx_len = len,
+            .on_done = read_done,
+            .user = p,
+            .result = I2C_TXN_NAK,
+    };
+    return (int) i;
+}
+
+void i2c_poller_start_tick(i2c_poller_t *p) {
+    p->pending = p->n_sensors;
+    // A bus starts on the first transaction queued to it, so all of them
+    // are soon busy, whatever order the sensors are in
+    for (uint32_t i = 0; i < p->n_sensors; ++i) {
+        i2c_txn_queue_t *q = p->buses[p->sensors[i].bus].queue;
+        i2c_txn_t *txn = &p->txns[i];
+        if (!i2c_txn_submit(q, txn)) {
+            // Count it as a failed read. Other transactions may be finishing
+            // in interrupts, so keep them out whilst pending changes.
+            uint32_t saved = q->backend.lock(q->backend.ctx);
+            txn->result = I2C_TXN_NAK;
+            txn->done = true;
+            read_done(txn);
+            q->backend.unlock(q->backend.ctx, saved);
+        }
+    }
+}
+
+uint32_t i2c_poller_tick(i2c_poller_t *p) {
+    uint32_t reads = p->reads;
+    i2c_poller_start_tick(p);
+    while (!i2c_poller_tick_done(p))
+        p->wait(p->wait_ctx);
+    return p->reads - reads;
+}
+
+static bool next_probe(i2c_poller_bus_t *bus) {
+    if (bus->probe.addr == LAST_ADDR)
+        return false;
+    bus->probe.addr++;
+    return i2c_txn_submit(bus->queue, &bus->probe);
+}
+
+// Each bus has one probe, which moves on to the next address as soon as
+// the last one is done
+static void probe_done(i2c_txn_t *txn) {
+    i2c_poller_bus_t *bus = txn->user;
+    if (txn->result == I2C_TXN_OK)
+        bus->found[txn->addr / 32] |= 1u << (txn->addr % 32);
+    if (!next_probe(bus))
+        bus->poller->pending--;
+}
+
+void i2c_poller_scan(i2c_poller_t *p) {
+    p->pending = p->n_buses;
+    for (uint32_t b = 0; b < p->n_buses; ++b) {
+        i2c_poller_bus_t *bus = &p->buses[b];
+        memset(bus->found, 0, sizeof(bus->found));
+        bus->probe = (i2c_txn_t) {
+                .addr = FIRST_ADDR,
+                .on_done = probe_done,
+                .user = bus,
+        };
+        if (!i2c_txn_submit(bus->queue, &bus->probe))
+            p->pending--;
+    }
+    while (p->pending)
+        p->wait(p->wait_ctx);
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _I2C_POLLER_H
+#define _I2C_POLLER_H
+
+#include "i2c_txn.h"
+
+// Polls sensors spread over several I2C buses, all buses at once.
+//
+// Each bus is an i2c_txn_queue_t, with whatever backend: pio_i2c_multi.h for
+// one state machine per bus, or i2c_bus_sim.h. Each sensor is read from a
+// fixed address and register, and a tick reads every sensor once: a
+// write-then-read transaction is queued for each, on its own bus, so every
+// bus is busy at the same time, and the tick ends when the slowest bus is
+// done. The samples then hold the latest reading of each sensor.
+//
+// Whilst waiting, the wait function is called over and over, to service the
+// buses (or move simulated time on).
+
+#define I2C_POLLER_MAX_BUSES 12
+#define I2C_POLLER_MAX_SENSORS 64
+#define I2C_POLLER_MAX_SAMPLE 8
+// One transaction running and the rest queued
+#define I2C_POLLER_MAX_PER_BUS (I2C_TXN_QUEUE_LEN + 1)
+
+typedef struct i2c_poller i2c_poller_t;
+
+typedef struct {
+    i2c_poller_t *poller;
+    i2c_txn_queue_t *queue;
+    uint32_t n_sensors;
+    // Scanning: a bit for each address which answered
+    i2c_txn_t probe;
+    uint32_t found[4];
+} i2c_poller_bus_t;
+
+typedef struct {
+    uint8_t bus;
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t len;
+} i2c_poller_sensor_t;
+
+struct i2c_poller {
+    i2c_poller_bus_t buses[I2C_POLLER_MAX_BUSES];
+    uint32_t n_buses;
+    i2c_poller_sensor_t sensors[I2C_POLLER_MAX_SENSORS];
+    i2c_txn_t txns[I2C_POLLER_MAX_SENSORS];
+    uint8_t samples[I2C_POLLER_MAX_SENSORS][I2C_POLLER_MAX_SAMPLE];
+    uint32_t n_sensors;
+    // Transactions (or buses, when scanning) not yet done
+    volatile uint32_t pending;
+    void (*wait)(void *ctx);
+    void *wait_ctx;
+    uint32_t ticks;
+    uint32_t reads;
+    uint32_t failed_reads;
+};
+
+void i2c_poller_init(i2c_poller_t *p, i2c_txn_queue_t *const *queues, uint32_t n_buses, void (*wait)(void *ctx),
+                     void *wait_ctx);
+
+// Returns the sensor's index in the samples, or -1 if there's no room
+int i2c_poller_add_sensor(i2c_poller_t *p, uint32_t bus, uint8_t addr, uint8_t reg, uint8_t len);
+
+// Reads every sensor once, returning how many were read. i2c_poller_start_tick()
+// and i2c_poller_tick_done() do the same without waiting, e.g. with interrupt
+// driven buses.
+uint32_t i2c_poller_tick(i2c_poller_t *p);
+void i2c_poller_start_tick(i2c_poller_t *p);
+
+static inline bool i2c_poller_tick_done(const i2c_poller_t *p) {
+    return !p->pending;
+}
+
+// The last reading of a sensor, or NULL if it didn't answer
+static inline const uint8_t *i2c_poller_sample(const i2c_poller_t *p, uint32_t sensor) {
+    return p->txns[sensor].result == I2C_TXN_OK ? p->samples[sensor] : NULL;
+}
+
+// Probes every address on every bus, the buses all at the same time,
+// leaving the results in each bus's found bits
+void i2c_poller_scan(i2c_poller_t *p);
+
+static inline bool i2c_poller_found(const i2c_poller_t *p, uint32_t bus, uint8_t addr) {
+    return p->buses[bus].found[addr / 32] & (1u << (addr % 32));
+}
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the multi-bus sensor poller (i2c_poller.h), run on the host against
+// several simulated buses (i2c_bus_sim.h). Build with PICO_PLATFORM=host.
+//
+// A scan must find exactly the devices on each bus. Each tick must leave
+// every sensor's latest reading in its sample, and none for a sensor which
+// didn't answer, and must take as long as the busiest bus rather than the
+// sum of them. Sensors which don't fit must be refused. A read the bus's
+// queue refuses must count as a failed read, under the queue's lock, and
+// mustn't stop the tick from finishing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "i2c_bus_sim.h"
+#include "i2c_poller.h"
+
+#define N_BUSES 4
+#define SENSORS_PER_BUS 3
+#define FIRST_SENSOR_ADDR 0x48
+#define SAMPLE_LEN 6
+#define BIT_NS 2500
+#define OVERHEAD_NS 4000
+#define STEP_NS 1000
+
+static i2c_txn_queue_t queues[N_BUSES];
+static i2c_bus_sim_t sims[N_BUSES];
+static i2c_sim_device_t devices[N_BUSES][SENSORS_PER_BUS];
+static uint n_sims;
+
+static i2c_poller_t poller;
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+// Moves every simulated bus on together
+static void advance_sims(void *ctx) {
+    (void) ctx;
+    for (uint b = 0; b < n_sims; ++b)
+        i2c_bus_sim_advance(&sims[b], STEP_NS);
+}
+
+static void init_sims(uint n_buses) {
+    static i2c_txn_queue_t *const queue_ptrs[N_BUSES] = {&queues[0], &queues[1], &queues[2], &queues[3]};
+    n_sims = n_buses;
+    for (uint b = 0; b < n_buses; ++b) {
+        for (uint s = 0; s < SENSORS_PER_BUS; ++s) {
+            i2c_sim_device_t *d = &devices[b][s];
+            memset(d, 0, sizeof(*d));
+            d->addr = (uint8_t) (FIRST_SENSOR_ADDR + s);
+            for (uint i = 0; i < count_of(d->regs); ++i)
+                d->regs[i] = (uint8_t) rand();
+        }
+        i2c_bus_sim_init(&sims[b], &queues[b], devices[b], SENSORS_PER_BUS, BIT_NS, OVERHEAD_NS);
+    }
+    i2c_poller_init(&poller, queue_ptrs, n_buses, advance_sims, NULL);
+}
+
+static bool sample_matches(uint32_t sensor, const i2c_sim_device_t *d, uint8_t reg) {
+    const uint8_t *sample = i2c_poller_sample(&poller, sensor);
+    return sample && !memcmp(sample, d->regs + reg, SAMPLE_LEN);
+}
+
+static void check_scan(void) {
+    init_sims(N_BUSES);
+    // A different number of devices on each bus
+    for (uint b = 0; b < N_BUSES; ++b)
+        sims[b].n_devices = b % SENSORS_PER_BUS + 1;
+    i2c_poller_scan(&poller);
+    for (uint b = 0; b < N_BUSES; ++b) {
+        for (uint addr = 0; addr < (1 << 7); ++addr) {
+            bool expect = addr >= FIRST_SENSOR_ADDR && addr < FIRST_SENSOR_ADDR + sims[b].n_devices;
+            check(i2c_poller_found(&poller, b, (uint8_t) addr) == expect, "Addresses found by a scan");
+        }
+        // Every address but the reserved ones was probed
+        check(queues[b].completed == 0x78 - 0x08, "Number of addresses probed");
+        check(!sims[b].errors, "Bus after a scan");
+    }
+}
+
+static void check_add(void) {
+    init_sims(2);
+    check(i2c_poller_add_sensor(&poller, 2, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN) < 0, "Refusing a bus out of range");
+    check(i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, 0, 0) < 0, "Refusing an empty sample");
+    check(i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, 0, I2C_POLLER_MAX_SAMPLE + 1) < 0,
+          "Refusing a sample too long");
+    // As many as a bus's queue holds, and no more
+    for (uint i = 0; i < I2C_POLLER_MAX_PER_BUS; ++i)
+        check(i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, (uint8_t) i, SAMPLE_LEN) == (int) i,
+              "Index of a sensor");
+    check(i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN) < 0, "Refusing a sensor on a full bus");
+    check(i2c_poller_add_sensor(&poller, 1, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN) == I2C_POLLER_MAX_PER_BUS,
+          "Adding to another bus");
+
+    // Every one is read in one tick, each from its own register
+    check(i2c_poller_tick(&poller) == I2C_POLLER_MAX_PER_BUS + 1 && !poller.failed_reads, "Reads of a full bus");
+    for (uint i = 0; i < I2C_POLLER_MAX_PER_BUS; ++i)
+        check(sample_matches(i, &devices[0][0], (uint8_t) i), "Sample of a sensor on a full bus");
+}
+
+static void check_ticks(void) {
+    init_sims(N_BUSES);
+    for (uint b = 0; b < N_BUSES; ++b) {
+        for (uint s = 0; s < SENSORS_PER_BUS; ++s)
+            i2c_poller_add_sensor(&poller, b, (uint8_t) (FIRST_SENSOR_ADDR + s), (uint8_t) (16 * s), SAMPLE_LEN);
+    }
+    int missing = i2c_poller_add_sensor(&poller, 1, 0x50, 0, SAMPLE_LEN);
+    check(missing == N_BUSES * SENSORS_PER_BUS, "Index of the last sensor");
+
+    // The sensors take new readings between ticks
+    for (uint tick = 0; tick < 5; ++tick) {
+        for (uint b = 0; b < N_BUSES; ++b) {
+            for (uint s = 0; s < SENSORS_PER_BUS; ++s)
+                devices[b][s].regs[16 * s] += (uint8_t) (tick + 1);
+        }
+        uint64_t start_ns = sims[0].now_ns;
+        check(i2c_poller_tick(&poller) == N_BUSES * SENSORS_PER_BUS, "Number of sensors read");
+        for (uint i = 0; i < N_BUSES * SENSORS_PER_BUS; ++i) {
+            uint s = i % SENSORS_PER_BUS;
+            check(sample_matches(i, &devices[i / SENSORS_PER_BUS][s], (uint8_t) (16 * s)), "Sample");
+        }
+        check(!i2c_poller_sample(&poller, (uint32_t) missing), "Sample of a sensor which isn't there");
+
+        // All the buses run at once, so a tick takes as long as bus 1, with
+        // the missing sensor, and no longer than it would on its own
+        uint64_t bus_ns = OVERHEAD_NS + 2 * (BIT_NS / 4) + 9ull * BIT_NS + BIT_NS;
+        for (uint s = 0; s < SENSORS_PER_BUS; ++s)
+            bus_ns += OVERHEAD_NS + 10 * (BIT_NS / 4) + (3ull + SAMPLE_LEN) * 9 * BIT_NS;
+        check(sims[0].now_ns - start_ns >= bus_ns && sims[0].now_ns - start_ns < bus_ns + STEP_NS, "Time of a tick");
+    }
+    check(poller.ticks == 5 && poller.reads == 5 * N_BUSES * SENSORS_PER_BUS && poller.failed_reads == 5,
+          "Counts of ticks and reads");
+
+    // Without waiting: nothing is done until the buses move on
+    i2c_poller_start_tick(&poller);
+    check(!i2c_poller_tick_done(&poller), "Tick done before the buses move");
+    for (uint steps = 0; !i2c_poller_tick_done(&poller) && steps < 100000; ++steps)
+        advance_sims(NULL);
+    check(i2c_poller_tick_done(&poller) && poller.ticks == 6, "Tick without waiting");
+    for (uint b = 0; b < N_BUSES; ++b)
+        check(!sims[b].errors, "Bus after ticks");
+}
+
+// A backend which never finishes anything, so its queue can be kept full
+static uint locks, unlocks;
+
+static void stuck_start(void *ctx, i2c_txn_t *txn) {
+    (void) ctx;
+    (void) txn;
+}
+
+static uint32_t stuck_lock(void *ctx) {
+    (void) ctx;
+    return ++locks;
+}
+
+static void stuck_unlock(void *ctx, uint32_t saved) {
+    (void) ctx;
+    check(saved == locks, "Lock passed to unlock");
+    ++unlocks;
+}
+
+static void check_refused_reads(void) {
+    // Bus 0 is simulated, and bus 1 is full
+    init_sims(1);
+    static i2c_txn_queue_t stuck;
+    static i2c_txn_t filler[I2C_TXN_QUEUE_LEN + 1];
+    i2c_txn_backend_t backend = {.start = stuck_start, .lock = stuck_lock, .unlock = stuck_unlock};
+    i2c_txn_queue_init(&stuck, &backend);
+    for (uint i = 0; i < count_of(filler); ++i)
+        check(i2c_txn_submit(&stuck, &filler[i]), "Filling the queue");
+    i2c_txn_queue_t *const queue_ptrs[2] = {&queues[0], &stuck};
+    i2c_poller_init(&poller, queue_ptrs, 2, advance_sims, NULL);
+    i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN);
+    i2c_poller_add_sensor(&poller, 1, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN);
+    i2c_poller_add_sensor(&poller, 1, FIRST_SENSOR_ADDR + 1, 0, SAMPLE_LEN);
+
+    // Only the read on bus 0 is left once the tick has started
+    locks = unlocks = 0;
+    i2c_poller_start_tick(&poller);
+    check(poller.pending == 1 && poller.failed_reads == 2, "Reads refused by a full queue");
+    check(i2c_txn_is_done(&poller.txns[1]) && poller.txns[2].result == I2C_TXN_NAK, "Result of a refused read");
+    // Once for each submit, and once more for each refused read
+    check(locks == 4 && unlocks == locks, "Locking of the refusing queue");
+    for (uint steps = 0; !i2c_poller_tick_done(&poller) && steps < 100000; ++steps)
+        advance_sims(NULL);
+    check(i2c_poller_tick_done(&poller) && poller.ticks == 1 && poller.reads == 1, "Tick with refused reads");
+    check(sample_matches(0, &devices[0][0], 0) && !i2c_poller_sample(&poller, 1) && !i2c_poller_sample(&poller, 2),
+          "Samples after refused reads");
+
+    // With every read refused, the tick is over at once
+    i2c_txn_queue_t *const stuck_only[1] = {&stuck};
+    i2c_poller_init(&poller, stuck_only, 1, advance_sims, NULL);
+    i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR, 0, SAMPLE_LEN);
+    i2c_poller_add_sensor(&poller, 0, FIRST_SENSOR_ADDR + 1, 0, SAMPLE_LEN);
+    i2c_poller_start_tick(&poller);
+    check(i2c_poller_tick_done(&poller) && !poller.reads && poller.failed_reads == 2 && poller.ticks == 1,
+          "Tick with every read refused");
+    check(stuck.count == I2C_TXN_QUEUE_LEN && stuck.current == &filler[0], "Full queue after refusing");
+}
+
+int main() {
+    printf("I2C poller host tests, on %u simulated buses\n", N_BUSES);
+    check_scan();
+    check_add();
+    check_ticks();
+    check_refused_reads();
+    printf(errors ? "FAILED\n" : "All poller checks passed\n");
+    return errors != 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "i2c_txn.h"
+
+// The same sequences as pio_i2c_start(), pio_i2c_repstart() and
+// pio_i2c_stop(). An Instr count of n executes the next n + 1 words.
+static uint32_t put_start(uint16_t *w, const i2c_txn_instrs_t *instrs) {
+    w[0] = 1u << I2C_TXN_ICOUNT_LSB;
+    w[1] = instrs->sc1_sd0;
+    w[2] = instrs->sc0_sd0;
+    return 3;
+}
+
+static uint32_t put_repstart(uint16_t *w, const i2c_txn_instrs_t *instrs) {
+    w[0] = 3u << I2C_TXN_ICOUNT_LSB;
+    w[1] = instrs->sc0_sd1;
+    w[2] = instrs->sc1_sd1;
+    w[3] = instrs->sc1_sd0;
+    w[4] = instrs->sc0_sd0;
+    return 5;
+}
+
+static uint32_t put_stop_and_push(uint16_t *w, const i2c_txn_instrs_t *instrs) {
+    w[0] = 3u << I2C_TXN_ICOUNT_LSB;
+    w[1] = instrs->sc0_sd0;
+    w[2] = instrs->sc1_sd0;
+    w[3] = instrs->sc1_sd1;
+    w[4] = instrs->push;
+    return 5;
+}
+
+uint32_t i2c_txn_encode(const i2c_txn_t *txn, const i2c_txn_instrs_t *instrs, uint16_t *words,
+                        uint32_t *rx_words) {
+    uint32_t n = put_start(words, instrs);
+    uint32_t clocked = 0;
+    if (txn->tx_len || !txn->rx_len) {
+        if (txn->tx_len) {
+            words[n++] = (uint16_t) (txn->addr << 2 | 1u);
+            for (uint32_t i = 0; i < txn->tx_len; ++i) {
+                // A NAK of the last byte is only an error if there's a read
+                // to follow
+                bool final = i == txn->tx_len - 1u && !txn->rx_len;
+                words[n++] = (uint16_t) (txn->tx[i] << I2C_TXN_DATA_LSB | (uint32_t) final << I2C_TXN_FINAL_LSB |
+                                         1u << I2C_TXN_NAK_LSB);
+            }
+            clocked += 1u + txn->tx_len;
+        } else {
+            // Just the address, with the read bit, as i2c_bus_scan does
+            words[n++] = (uint16_t) (txn->addr << 2 | 3u);
+            clocked += 1;
+        }
+        if (txn->rx_len)
+            n += put_repstart(words + n, instrs);
+    }
+    if (txn->rx_len) {
+        words[n++] = (uint16_t) (txn->addr << 2 | 3u);
+        for (uint32_t i = 0; i < txn->rx_len; ++i) {
+            // Shift in with SDA released, and NAK the last byte
+            bool last = i == txn->rx_len - 1u;
+            words[n++] = (uint16_t) (0xffu << I2C_TXN_DATA_LSB |
+                                     (last ? 1u << I2C_TXN_FINAL_LSB | 1u << I2C_TXN_NAK_LSB : 0));
+        }
+        clocked += 1u + txn->rx_len;
+    }
+    n += put_stop_and_push(words + n, instrs);
+    *rx_words = clocked + 1;
+    return n;
+}
+
+void i2c_txn_copy_rx(const i2c_txn_t *txn, const uint8_t *rx_bytes) {
+    if (!txn->rx_len)
+        return;
+    // Skip the address and anything written
+    uint32_t offset = txn->tx_len ? 1u + txn->tx_len + 1u : 1u;
+    memcpy(txn->rx, rx_bytes + offset, txn->rx_len);
+}
+
+void i2c_txn_queue_init(i2c_txn_queue_t *q, const i2c_txn_backend_t *backend) {
+    memset(q, 0, sizeof(*q));
+    q->backend = *backend;
+}
+
+bool i2c_txn_submit(i2c_txn_queue_t *q, i2c_txn_t *txn) {
+    if (txn->tx_len > I2C_TXN_MAX_LEN || txn->rx_len > I2C_TXN_MAX_LEN || (txn->tx_len && !txn->tx) ||
+        (txn->rx_len && !txn->rx) || txn->addr > 0x7f)
+        return false;
+    txn->done = false;
+    txn->result = I2C_TXN_PENDING;
+
+    uint32_t saved = q->backend.lock(q->backend.ctx);
+    bool ok = true;
+    if (!q->current) {
+        q->current = txn;
+        q->backend.start(q->backend.ctx, txn);
+    } else if (q->count < I2C_TXN_QUEUE_LEN) {
+        q->queue[(q->head + q->count++) % I2C_TXN_QUEUE_LEN] = txn;
+    } else {
+        ok = false;
+    }
+    q->backend.unlock(q->backend.ctx, saved);
+    return ok;
+}
+
+void i2c_txn_queue_complete(i2c_txn_queue_t *q, int result) {
+    i2c_txn_t *txn = q->current;
+    if (!txn)
+        return;
+    // Start the next transaction first, so the bus is idle for as little
+    // time as possible
+    if (q->count) {
+        q->current = q->queue[q->head];
+        q->head = (q->head + 1) % I2C_TXN_QUEUE_LEN;
+        q->count--;
+        q->backend.start(q->backend.ctx, q->current);
+    } else {
+        q->current = NULL;
+    }
+    q->completed++;
+    if (result != I2C_TXN_OK)
+        q->failed++;
+    txn->result = result;
+    txn->done = true;
+    if (txn->on_done)
+        txn->on_done(txn);
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _I2C_TXN_H
+#define _I2C_TXN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// I2C transactions, and a queue to run them back to back on one bus.
+//
+// A transaction writes tx_len bytes, reads rx_len bytes, or writes and then
+// reads after a repeated start, e.g. to read a sensor's registers. With
+// neither, it just addresses the device, to see if it's there.
+//
+// i2c_txn_encode() turns a transaction into the 16 bit words the i2c program
+// in i2c.pio takes, as pio_i2c_put16() does, so the whole transaction can be
+// fed to the state machine by DMA: START, the address and data bytes, any
+// repeated START, then STOP. Every byte clocked pushes a word into the RX
+// FIFO, and the STOP sequence ends with a PUSH, so one more word arrives once
+// the bus is released, and the transaction has finished.
+//
+// The queue starts each transaction as the last one finishes, and marks
+// each one done with its result, calling its on_done function. The backend
+// does the transactions: pio_i2c_dma.h drives the i2c program with DMA, and
+// i2c_bus_sim.h simulates a bus with devices on it.
+
+#define I2C_TXN_MAX_LEN 32
+#define I2C_TXN_QUEUE_LEN 16
+
+// START, address, data, repeated START, address, data, STOP with PUSH
+#define I2C_TXN_MAX_WORDS (3 + 1 + I2C_TXN_MAX_LEN + 5 + 1 + I2C_TXN_MAX_LEN + 5)
+// Bytes clocked, plus the word pushed at the end
+#define I2C_TXN_MAX_RX_WORDS (1 + I2C_TXN_MAX_LEN + 1 + I2C_TXN_MAX_LEN + 1)
+
+#define I2C_TXN_OK 0
+#define I2C_TXN_NAK (-1)
+#define I2C_TXN_PENDING 1
+
+// Field positions in the words, as in pio_i2c.c
+#define I2C_TXN_ICOUNT_LSB 10
+#define I2C_TXN_FINAL_LSB 9
+#define I2C_TXN_DATA_LSB 1
+#define I2C_TXN_NAK_LSB 0
+
+typedef struct i2c_txn i2c_txn_t;
+typedef void (*i2c_txn_done_fn)(i2c_txn_t *txn);
+
+struct i2c_txn {
+    uint8_t addr;
+    const uint8_t *tx;
+    uint8_t tx_len;
+    uint8_t *rx;
+    uint8_t rx_len;
+    i2c_txn_done_fn on_done;
+    void *user;
+    // I2C_TXN_OK, or I2C_TXN_NAK if a byte other than the last was NAKed
+    volatile int result;
+    volatile bool done;
+};
+
+// The instructions which the words execute, from the set_scl_sda program
+// (SCL low or high, SDA low or high), and a PUSH
+typedef struct {
+    uint16_t sc0_sd0;
+    uint16_t sc0_sd1;
+    uint16_t sc1_sd0;
+    uint16_t sc1_sd1;
+    uint16_t push;
+} i2c_txn_instrs_t;
+
+// Returns the number of words, and sets *rx_words to the number of words
+// the transaction will push into the RX FIFO, if it isn't NAKed
+uint32_t i2c_txn_encode(const i2c_txn_t *txn, const i2c_txn_instrs_t *instrs, uint16_t *words,
+                        uint32_t *rx_words);
+
+// Copies the bytes read out of what was received, into txn->rx
+void i2c_txn_copy_rx(const i2c_txn_t *txn, const uint8_t *rx_bytes);
+
+typedef struct {
+    void (*start)(void *ctx, i2c_txn_t *txn);
+    // Keep i2c_txn_queue_complete() out whilst the queue is changed
+    uint32_t (*lock)(void *ctx);
+    void (*unlock)(void *ctx, uint32_t saved);
+    void *ctx;
+} i2c_txn_backend_t;
+
+typedef struct {
+    i2c_txn_backend_t backend;
+    i2c_txn_t *queue[I2C_TXN_QUEUE_LEN];
+    uint32_t head;
+    uint32_t count;
+    i2c_txn_t *current;
+    uint32_t completed;
+    uint32_t failed;
+} i2c_txn_queue_t;
+
+void i2c_txn_queue_init(i2c_txn_queue_t *q, const i2c_txn_backend_t *backend);
+
+// Returns false if the transaction is too long or the queue is full
+bool i2c_txn_submit(i2c_txn_queue_t *q, i2c_txn_t *txn);
+
+// Called by the backend when the current transaction has finished
+void i2c_txn_queue_complete(i2c_txn_queue_t *q, int result);
+
+static inline bool i2c_txn_is_done(const i2c_txn_t *txn) {
+    return txn->done;
+}
+
+static inline bool i2c_txn_queue_idle(const i2c_txn_queue_t *q) {
+    return !*(i2c_txn_t *volatile *) &q->current;
+}
+
+#endif
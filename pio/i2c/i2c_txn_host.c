@@ -0,0 +1,288 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the I2C transaction encoding and queue (i2c_txn.h), run on the
+// host against the simulated bus (i2c_bus_sim.h). Build with
+// PICO_PLATFORM=host.
+//
+// The words for a write, a read, a register read with a repeated START and a
+// probe are checked by hand against the sequences in pio_i2c.c. On the bus,
+// transactions must complete in the order they were submitted, each at the
+// time the bit rate says, and devices which aren't there must NAK. Then
+// random writes, reads and probes of two devices, with a missing one, are
+// checked against a model of the devices' registers. Malformed transactions
+// and a full queue must be refused, and the bus must never see anything the
+// i2c program or a device wouldn't expect.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "i2c_bus_sim.h"
+
+#define BIT_NS 2500
+#define OVERHEAD_NS 4000
+#define MISSING_ADDR 0x50
+
+static i2c_txn_queue_t queue;
+static i2c_bus_sim_t sim;
+static i2c_sim_device_t devices[2];
+
+static i2c_txn_t txns[I2C_TXN_QUEUE_LEN + 2];
+static uint32_t done_order[I2C_TXN_QUEUE_LEN + 2];
+static uint64_t done_ns[I2C_TXN_QUEUE_LEN + 2];
+static uint n_done;
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static void on_done(i2c_txn_t *txn) {
+    check(i2c_txn_is_done(txn) && txn->result != I2C_TXN_PENDING, "Result in on_done");
+    done_order[n_done] = (uint32_t) (txn - txns);
+    done_ns[n_done++] = sim.now_ns;
+}
+
+static void reset(void) {
+    memset(devices, 0, sizeof(devices));
+    devices[0].addr = 0x48;
+    devices[1].addr = 0x76;
+    for (uint i = 0; i < 256; ++i) {
+        devices[0].regs[i] = (uint8_t) rand();
+        devices[1].regs[i] = (uint8_t) rand();
+    }
+    i2c_bus_sim_init(&sim, &queue, devices, count_of(devices), BIT_NS, OVERHEAD_NS);
+    memset(txns, 0, sizeof(txns));
+    n_done = 0;
+}
+
+static bool words_match(const i2c_txn_t *txn, const uint16_t *expect, uint32_t n_expect, uint32_t expect_rx) {
+    uint16_t words[I2C_TXN_MAX_WORDS];
+    uint32_t rx_words;
+    uint32_t n = i2c_txn_encode(txn, &i2c_bus_sim_instrs, words, &rx_words);
+    return n == n_expect && rx_words == expect_rx && !memcmp(words, expect, n * sizeof(words[0]));
+}
+
+static void check_encode(void) {
+    const i2c_txn_instrs_t *in = &i2c_bus_sim_instrs;
+    const uint16_t start[] = {1u << 10, in->sc1_sd0, in->sc0_sd0};
+    const uint16_t repstart[] = {3u << 10, in->sc0_sd1, in->sc1_sd1, in->sc1_sd0, in->sc0_sd0};
+    const uint16_t stop[] = {3u << 10, in->sc0_sd0, in->sc1_sd0, in->sc1_sd1, in->push};
+    static const uint8_t tx[] = {0x10, 0xa5};
+    uint8_t rx[2];
+
+    // Address with the write bit, then data, the last with FINAL set
+    i2c_txn_t write = {.addr = 0x48, .tx = tx, .tx_len = 2};
+    uint16_t write_words[] = {start[0], start[1], start[2], 0x48 << 2 | 1, 0x10 << 1 | 1, 1u << 9 | 0xa5 << 1 | 1,
+                              stop[0], stop[1], stop[2], stop[3], stop[4]};
+    check(words_match(&write, write_words, count_of(write_words), 4), "Words of a write");
+
+    // Address with the read bit, then SDA released for each byte, NAKing the
+    // last
+    i2c_txn_t read = {.addr = 0x48, .rx = rx, .rx_len = 2};
+    uint16_t read_words[] = {start[0], start[1], start[2], 0x48 << 2 | 3, 0xff << 1, 1u << 9 | 0xff << 1 | 1,
+                             stop[0], stop[1], stop[2], stop[3], stop[4]};
+    check(words_match(&read, read_words, count_of(read_words), 4), "Words of a read");
+
+    // The register pointer is written, without FINAL, then a repeated START
+    i2c_txn_t reg_read = {.addr = 0x76, .tx = tx, .tx_len = 1, .rx = rx, .rx_len = 1};
+    uint16_t reg_read_words[] = {start[0], start[1], start[2], 0x76 << 2 | 1, 0x10 << 1 | 1,
+                                 repstart[0], repstart[1], repstart[2], repstart[3], repstart[4],
+                                 0x76 << 2 | 3, 1u << 9 | 0xff << 1 | 1,
+                                 stop[0], stop[1], stop[2], stop[3], stop[4]};
+    check(words_match(&reg_read, reg_read_words, count_of(reg_read_words), 5), "Words of a register read");
+
+    // Just the address, with the read bit
+    i2c_txn_t probe = {.addr = 0x7f};
+    uint16_t probe_words[] = {start[0], start[1], start[2], 0x7f << 2 | 3, stop[0], stop[1], stop[2], stop[3],
+                              stop[4]};
+    check(words_match(&probe, probe_words, count_of(probe_words), 2), "Words of a probe");
+
+    // The longest transaction fits
+    static uint8_t long_buf[I2C_TXN_MAX_LEN];
+    i2c_txn_t longest = {.addr = 1, .tx = long_buf, .tx_len = I2C_TXN_MAX_LEN, .rx = long_buf,
+                         .rx_len = I2C_TXN_MAX_LEN};
+    uint16_t words[I2C_TXN_MAX_WORDS];
+    uint32_t rx_words;
+    check(i2c_txn_encode(&longest, in, words, &rx_words) == I2C_TXN_MAX_WORDS && rx_words == I2C_TXN_MAX_RX_WORDS,
+          "Length of the longest transaction");
+
+    // The bytes read come after the address and anything written
+    static const uint8_t rx_bytes[] = {0xec, 0x10, 0xed, 0x31, 0x32};
+    i2c_txn_copy_rx(&reg_read, rx_bytes);
+    check(rx[0] == 0x31, "Bytes copied after a register read");
+    i2c_txn_copy_rx(&read, rx_bytes);
+    check(rx[0] == 0x10 && rx[1] == 0xed, "Bytes copied after a read");
+}
+
+// Time on the bus: a bit period for each 4 instructions, 9 for each byte
+static uint64_t txn_ns(uint32_t instrs, uint32_t bytes) {
+    return OVERHEAD_NS + instrs * (BIT_NS / 4) + bytes * 9ull * BIT_NS;
+}
+
+static void check_queue(void) {
+    static const uint8_t write_regs[] = {0x20, 0xde, 0xad, 0xbe, 0xef};
+    static const uint8_t reg[] = {0x20};
+    static uint8_t rx[3][8];
+    reset();
+    check(i2c_txn_queue_idle(&queue), "Idle to start with");
+    txns[0] = (i2c_txn_t) {.addr = 0x76, .tx = write_regs, .tx_len = sizeof(write_regs), .on_done = on_done};
+    txns[1] = (i2c_txn_t) {.addr = 0x76, .tx = reg, .tx_len = 1, .rx = rx[0], .rx_len = 4, .on_done = on_done};
+    // Carries on from where the last read left the pointer
+    txns[2] = (i2c_txn_t) {.addr = 0x76, .rx = rx[1], .rx_len = 2, .on_done = on_done};
+    txns[3] = (i2c_txn_t) {.addr = 0x48, .on_done = on_done};
+    txns[4] = (i2c_txn_t) {.addr = MISSING_ADDR, .on_done = on_done};
+    txns[5] = (i2c_txn_t) {.addr = MISSING_ADDR, .tx = reg, .tx_len = 1, .rx = rx[2], .rx_len = 2,
+                           .on_done = on_done};
+    for (uint i = 0; i < 6; ++i)
+        check(i2c_txn_submit(&queue, &txns[i]), "Submitting");
+    check(queue.current == &txns[0] && queue.count == 5 && txns[5].result == I2C_TXN_PENDING, "Queue after submitting");
+    memset(rx[2], 0xaa, sizeof(rx[2]));
+
+    uint64_t t0 = txn_ns(6, 6);
+    i2c_bus_sim_advance(&sim, t0 - 1);
+    check(!n_done && !i2c_txn_is_done(&txns[0]), "First transaction, just before it finishes");
+    i2c_bus_sim_advance(&sim, 1);
+    check(n_done == 1 && txns[0].result == I2C_TXN_OK && done_ns[0] == t0, "First transaction");
+    i2c_bus_sim_advance(&sim, 1000000);
+    check(i2c_txn_queue_idle(&queue) && n_done == 6 && queue.completed == 6 && queue.failed == 2, "Every transaction");
+    for (uint i = 0; i < n_done; ++i)
+        check(done_order[i] == i, "Completion order");
+
+    // Each one starts as the last finishes. A NAK costs a bit period for the
+    // STOP, after the byte NAKed.
+    uint64_t t = t0;
+    t += txn_ns(6 + 4, 1 + 1 + 1 + 4);
+    check(done_ns[1] == t, "Time of a register read");
+    t += txn_ns(6, 3);
+    check(done_ns[2] == t, "Time of a read");
+    t += txn_ns(6, 1);
+    check(done_ns[3] == t, "Time of a probe");
+    t += txn_ns(2, 1) + BIT_NS;
+    check(done_ns[4] == t, "Time of a probe NAKed");
+
+    check(!memcmp(devices[1].regs + 0x20, write_regs + 1, 4), "Registers written");
+    check(!memcmp(rx[0], write_regs + 1, 4) && !memcmp(rx[1], devices[1].regs + 0x24, 2), "Registers read");
+    check(txns[3].result == I2C_TXN_OK && txns[4].result == I2C_TXN_NAK && txns[5].result == I2C_TXN_NAK,
+          "Results of probes");
+    check(rx[2][0] == 0xaa, "Buffer of a read NAKed");
+    check(devices[1].bytes_written == 5 + 1 && devices[1].bytes_read == 6, "Bytes the device saw");
+}
+
+static void check_refused(void) {
+    static uint8_t buf[I2C_TXN_MAX_LEN + 1];
+    reset();
+    static const struct {
+        const char *name;
+        i2c_txn_t txn;
+    } bad[] = {
+            {"Write too long", {.addr = 0x48, .tx = buf, .tx_len = I2C_TXN_MAX_LEN + 1}},
+            {"Read too long", {.addr = 0x48, .rx = buf, .rx_len = I2C_TXN_MAX_LEN + 1}},
+            {"Write without data", {.addr = 0x48, .tx_len = 1}},
+            {"Read without a buffer", {.addr = 0x48, .rx_len = 1}},
+            {"Address of more than 7 bits", {.addr = 0x80}},
+    };
+    for (uint i = 0; i < count_of(bad); ++i) {
+        i2c_txn_t txn = bad[i].txn;
+        if (i2c_txn_submit(&queue, &txn) && !errors++)
+            printf("%s was accepted\n", bad[i].name);
+    }
+    check(i2c_txn_queue_idle(&queue), "Idle after refusing");
+
+    // One running, I2C_TXN_QUEUE_LEN waiting, and no room for more
+    for (uint i = 0; i < I2C_TXN_QUEUE_LEN + 2; ++i) {
+        txns[i] = (i2c_txn_t) {.addr = 0x48, .on_done = on_done};
+        check(i2c_txn_submit(&queue, &txns[i]) == (i <= I2C_TXN_QUEUE_LEN), "Filling the queue");
+    }
+    i2c_bus_sim_advance(&sim, 100000000);
+    check(n_done == I2C_TXN_QUEUE_LEN + 1 && !i2c_txn_is_done(&txns[I2C_TXN_QUEUE_LEN + 1]),
+          "Transactions done after filling the queue");
+}
+
+typedef struct {
+    uint8_t ptr;
+    uint8_t regs[256];
+} model_device_t;
+
+static bool check_random(uint n_rounds) {
+    static uint8_t tx[I2C_TXN_QUEUE_LEN + 1][I2C_TXN_MAX_LEN];
+    static uint8_t rx[I2C_TXN_QUEUE_LEN + 1][I2C_TXN_MAX_LEN];
+    static uint8_t expect_rx[I2C_TXN_QUEUE_LEN + 1][I2C_TXN_MAX_LEN];
+    static model_device_t model[count_of(devices)];
+    reset();
+    for (uint d = 0; d < count_of(devices); ++d)
+        memcpy(model[d].regs, devices[d].regs, 256);
+    uint32_t failed = 0;
+    for (uint round = 0; round < n_rounds; ++round) {
+        uint n_txns = 1 + rand() % (I2C_TXN_QUEUE_LEN + 1);
+        for (uint i = 0; i < n_txns; ++i) {
+            uint which = rand() % (count_of(devices) + 1);
+            i2c_txn_t *txn = &txns[i];
+            *txn = (i2c_txn_t) {.addr = which < count_of(devices) ? devices[which].addr : MISSING_ADDR,
+                                .tx = tx[i], .tx_len = (uint8_t) (rand() % 3 ? rand() % (I2C_TXN_MAX_LEN + 1) : 0),
+                                .rx = rx[i], .rx_len = (uint8_t) (rand() % 3 ? rand() % (I2C_TXN_MAX_LEN + 1) : 0)};
+            for (uint j = 0; j < txn->tx_len; ++j)
+                tx[i][j] = (uint8_t) rand();
+            memset(rx[i], 0, sizeof(rx[i]));
+            if (which == count_of(devices)) {
+                ++failed;
+                continue;
+            }
+            // The first byte written sets the pointer, then registers are
+            // written and read from there
+            model_device_t *m = &model[which];
+            for (uint j = 0; j < txn->tx_len; ++j) {
+                if (j)
+                    m->regs[m->ptr++] = tx[i][j];
+                else
+                    m->ptr = tx[i][0];
+            }
+            for (uint j = 0; j < txn->rx_len; ++j)
+                expect_rx[i][j] = m->regs[m->ptr++];
+            check(i2c_txn_submit(&queue, txn), "Submitting a random transaction");
+        }
+        for (uint i = 0; i < n_txns; ++i) {
+            if (txns[i].addr == MISSING_ADDR)
+                check(i2c_txn_submit(&queue, &txns[i]), "Submitting a random transaction");
+        }
+        i2c_bus_sim_advance(&sim, 100000000);
+        if (!i2c_txn_queue_idle(&queue))
+            return false;
+        for (uint i = 0; i < n_txns; ++i) {
+            bool missing = txns[i].addr == MISSING_ADDR;
+            if (!i2c_txn_is_done(&txns[i]) || txns[i].result != (missing ? I2C_TXN_NAK : I2C_TXN_OK) ||
+                (!missing && memcmp(rx[i], expect_rx[i], txns[i].rx_len))) {
+                printf("Transaction %u of round %u doesn't match\n", i, round);
+                return false;
+            }
+        }
+        for (uint d = 0; d < count_of(devices); ++d) {
+            if (memcmp(devices[d].regs, model[d].regs, 256) || devices[d].ptr != model[d].ptr) {
+                printf("Registers of device %u don't match after round %u\n", d, round);
+                return false;
+            }
+        }
+    }
+    return queue.failed == failed;
+}
+
+int main() {
+    printf("I2C transaction host tests, on the simulated bus\n");
+    check_encode();
+    check_queue();
+    check(!sim.errors, "Bus after the queue checks");
+    check_refused();
+    check(!sim.errors, "Bus after filling the queue");
+    check(check_random(500), "Random transactions");
+    check(!sim.errors, "Bus after random transactions");
+    printf(errors ? "FAILED\n" : "All transaction checks passed\n");
+    return errors != 0;
+}
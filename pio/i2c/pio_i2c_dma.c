@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "pio_i2c_dma.h"
+
+static pio_i2c_dma_t *instances[PIO_I2C_DMA_MAX_INSTANCES];
+static uint64_t installed_irqs;
+
+static void set_nak_irq_enabled(pio_i2c_dma_t *d, bool enabled) {
+    pio_set_irqn_source_enabled(d->pio, d->pio_irq_index, (enum pio_interrupt_source) ((uint) pis_interrupt0 + d->sm),
+                                enabled);
+}
+
+static uint32_t i2c_dma_lock(__unused void *ctx) {
+    return save_and_disable_interrupts();
+}
+
+static void i2c_dma_unlock(__unused void *ctx, uint32_t saved) {
+    restore_interrupts(saved);
+}
+
+static void __time_critical_func(start_txn)(void *ctx, i2c_txn_t *txn) {
+    pio_i2c_dma_t *d = ctx;
+    PIO pio = d->pio;
+    uint sm = d->sm;
+    d->txn = txn;
+    uint32_t rx_words;
+    uint32_t n_words = i2c_txn_encode(txn, &d->instrs, d->words, &rx_words);
+
+    // Every byte goes into the RX FIFO, and anything left over from a NAKed
+    // transaction is thrown away
+    hw_set_bits(&pio->sm[sm].shiftctrl, PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS);
+    while (!pio_sm_is_rx_fifo_empty(pio, sm))
+        (void) pio_sm_get(pio, sm);
+    set_nak_irq_enabled(d, true);
+
+    dma_channel_config c = dma_channel_get_default_config(d->rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(d->rx_chan, &c, d->rx, &pio->rxf[sm], rx_words, true);
+
+    // Halfword writes, as the program expects
+    c = dma_channel_get_default_config(d->tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(d->tx_chan, &c, &pio->txf[sm], d->words, n_words, true);
+}
+
+static void __time_critical_func(finish_txn)(pio_i2c_dma_t *d, int result) {
+    set_nak_irq_enabled(d, false);
+    if (result == I2C_TXN_OK)
+        i2c_txn_copy_rx(d->txn, d->rx);
+    d->txn = NULL;
+    // Calls the transaction's on_done, and starts the next one
+    i2c_txn_queue_complete(&d->queue, result);
+}
+
+static void __time_critical_func(pio_i2c_dma_irq_handler)() {
+    for (uint i = 0; i < PIO_I2C_DMA_MAX_INSTANCES; ++i) {
+        pio_i2c_dma_t *d = instances[i];
+        if (d && d->txn && dma_irqn_get_channel_status(d->dma_irq_index, d->rx_chan)) {
+            dma_irqn_acknowledge_channel(d->dma_irq_index, d->rx_chan);
+            finish_txn(d, I2C_TXN_OK);
+        }
+    }
+}
+
+static void __time_critical_func(pio_i2c_nak_irq_handler)() {
+    for (uint i = 0; i < PIO_I2C_DMA_MAX_INSTANCES; ++i) {
+        pio_i2c_dma_t *d = instances[i];
+        if (!d || !d->txn || !pio_i2c_check_error(d->pio, d->sm))
+            continue;
+        // Stop the RX channel without it raising an interrupt (see RP2040
+        // erratum E13)
+        dma_channel_abort(d->tx_chan);
+        dma_irqn_set_channel_enabled(d->dma_irq_index, d->rx_chan, false);
+        dma_channel_abort(d->rx_chan);
+        dma_irqn_acknowledge_channel(d->dma_irq_index, d->rx_chan);
+        dma_irqn_set_channel_enabled(d->dma_irq_index, d->rx_chan, true);
+        pio_i2c_resume_after_error(d->pio, d->sm);
+        // The FIFO is empty, so this doesn't block
+        pio_i2c_stop(d->pio, d->sm);
+        finish_txn(d, I2C_TXN_NAK);
+    }
+}
+
+static void install_handler(uint irq_num, irq_handler_t handler) {
+    if (installed_irqs & (1ull << irq_num))
+        return;
+    installed_irqs |= 1ull << irq_num;
+    irq_add_shared_handler(irq_num, handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(irq_num, true);
+}
+
+void pio_i2c_dma_init(pio_i2c_dma_t *d, PIO pio, uint sm, uint dma_irq_index, uint pio_irq_index) {
+    memset(d, 0, sizeof(*d));
+    d->pio = pio;
+    d->sm = sm;
+    d->dma_irq_index = dma_irq_index;
+    d->pio_irq_index = pio_irq_index;
+    d->tx_chan = (uint) dma_claim_unused_channel(true);
+    d->rx_chan = (uint) dma_claim_unused_channel(true);
+    d->instrs = (i2c_txn_instrs_t) {
+            .sc0_sd0 = set_scl_sda_program_instructions[I2C_SC0_SD0],
+            .sc0_sd1 = set_scl_sda_program_instructions[I2C_SC0_SD1],
+            .sc1_sd0 = set_scl_sda_program_instructions[I2C_SC1_SD0],
+            .sc1_sd1 = set_scl_sda_program_instructions[I2C_SC1_SD1],
+            // Blocking, so the word marking the end isn't lost if the RX
+            // FIFO is full
+            .push = pio_encode_push(false, true),
+    };
+
+    i2c_txn_backend_t backend = {
+            .start = start_txn,
+            .lock = i2c_dma_lock,
+            .unlock = i2c_dma_unlock,
+            .ctx = d,
+    };
+    i2c_txn_queue_init(&d->queue, &backend);
+
+    uint slot = 0;
+    while (slot < PIO_I2C_DMA_MAX_INSTANCES && instances[slot])
+        ++slot;
+    hard_assert(slot < PIO_I2C_DMA_MAX_INSTANCES);
+    instances[slot] = d;
+
+    dma_irqn_set_channel_enabled(dma_irq_index, d->rx_chan, true);
+    install_handler(DMA_IRQ_0 + dma_irq_index, pio_i2c_dma_irq_handler);
+    install_handler(pio_get_irq_num(pio, pio_irq_index), pio_i2c_nak_irq_handler);
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _PIO_I2C_DMA_H
+#define _PIO_I2C_DMA_H
+
+#include "pio_i2c.h"
+#include "i2c_txn.h"
+
+// Asynchronous PIO I2C: transactions from the queue in i2c_txn.h are
+// encoded, and fed to the i2c program by a pair of DMA channels, so the
+// processor only gets involved at the end of each one.
+//
+// The RX channel collects a byte for everything clocked, and the word
+// pushed after STOP, so when it finishes, the transaction has. A NAK stops
+// the state machine and raises its interrupt flag, which is handled on the
+// given PIO IRQ: the DMA is stopped, the state machine restarted, and a STOP
+// sent, as pio_i2c_write_blocking() does.
+//
+// Each state machine needs its own instance, and they can all share the
+// same DMA and PIO IRQs, so several buses can be busy at once.
+
+#define PIO_I2C_DMA_MAX_INSTANCES 8
+
+typedef struct {
+    PIO pio;
+    uint sm;
+    uint tx_chan;
+    uint rx_chan;
+    uint dma_irq_index;
+    uint pio_irq_index;
+    i2c_txn_queue_t queue;
+    // The transaction in progress
+    i2c_txn_t *txn;
+    i2c_txn_instrs_t instrs;
+    uint16_t words[I2C_TXN_MAX_WORDS];
+    uint8_t rx[I2C_TXN_MAX_RX_WORDS];
+} pio_i2c_dma_t;
+
+// The state machine must already be running the i2c program, set up with
+// i2c_program_init(). dma_irq_index and pio_irq_index are 0 or 1.
+void pio_i2c_dma_init(pio_i2c_dma_t *d, PIO pio, uint sm, uint dma_irq_index, uint pio_irq_index);
+
+static inline bool pio_i2c_dma_submit(pio_i2c_dma_t *d, i2c_txn_t *txn) {
+    return i2c_txn_submit(&d->queue, txn);
+}
+
+static inline void pio_i2c_dma_wait(const i2c_txn_t *txn) {
+    while (!i2c_txn_is_done(txn))
+        tight_loop_contents();
+}
+
+static inline void pio_i2c_dma_wait_idle(const pio_i2c_dma_t *d) {
+    while (!i2c_txn_queue_idle(&d->queue))
+        tight_loop_contents();
+}
+
+#endif
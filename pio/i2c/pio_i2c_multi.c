@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pio_i2c_multi.h"
+
+static void feed(pio_i2c_multi_bus_t *bus) {
+    // The program pulls 16 bits at a time, from the top of the word
+    while (bus->words_put < bus->n_words && !pio_sm_is_tx_fifo_full(bus->pio, bus->sm))
+        pio_sm_put(bus->pio, bus->sm, (uint32_t) bus->words[bus->words_put++] << 16);
+}
+
+static void multi_start(void *ctx, i2c_txn_t *txn) {
+    pio_i2c_multi_bus_t *bus = ctx;
+    bus->txn = txn;
+    bus->n_words = i2c_txn_encode(txn, bus->instrs, bus->words, &bus->rx_words);
+    bus->words_put = 0;
+    bus->rx_got = 0;
+    // Every byte goes into the RX FIFO, and anything left over from a NAKed
+    // transaction is thrown away
+    hw_set_bits(&bus->pio->sm[bus->sm].shiftctrl, PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS);
+    while (!pio_sm_is_rx_fifo_empty(bus->pio, bus->sm))
+        (void) pio_sm_get(bus->pio, bus->sm);
+    feed(bus);
+}
+
+// Everything happens in pio_i2c_multi_service(), so there is nothing to lock
+// out
+static uint32_t multi_lock(__unused void *ctx) {
+    return 0;
+}
+
+static void multi_unlock(__unused void *ctx, __unused uint32_t saved) {
+}
+
+void pio_i2c_multi_init(pio_i2c_multi_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->instrs = (i2c_txn_instrs_t) {
+            .sc0_sd0 = set_scl_sda_program_instructions[I2C_SC0_SD0],
+            .sc0_sd1 = set_scl_sda_program_instructions[I2C_SC0_SD1],
+            .sc1_sd0 = set_scl_sda_program_instructions[I2C_SC1_SD0],
+            .sc1_sd1 = set_scl_sda_program_instructions[I2C_SC1_SD1],
+            // Blocking, so the word marking the end isn't lost if the RX
+            // FIFO is full
+            .push = pio_encode_push(false, true),
+    };
+}
+
+i2c_txn_queue_t *pio_i2c_multi_add_bus(pio_i2c_multi_t *m, PIO pio, uint sm) {
+    if (m->n_buses == PIO_I2C_MULTI_MAX_BUSES)
+        return NULL;
+    pio_i2c_multi_bus_t *bus = &m->buses[m->n_buses++];
+    bus->pio = pio;
+    bus->sm = sm;
+    bus->instrs = &m->instrs;
+    i2c_txn_backend_t backend = {
+            .start = multi_start,
+            .lock = multi_lock,
+            .unlock = multi_unlock,
+            .ctx = bus,
+    };
+    i2c_txn_queue_init(&bus->queue, &backend);
+    return &bus->queue;
+}
+
+static void finish(pio_i2c_multi_bus_t *bus, int result) {
+    if (result == I2C_TXN_OK)
+        i2c_txn_copy_rx(bus->txn, bus->rx);
+    bus->txn = NULL;
+    // Calls the transaction's on_done, and starts the next one
+    i2c_txn_queue_complete(&bus->queue, result);
+}
+
+bool pio_i2c_multi_service(pio_i2c_multi_t *m) {
+    bool busy = false;
+    for (uint i = 0; i < m->n_buses; ++i) {
+        pio_i2c_multi_bus_t *bus = &m->buses[i];
+        if (!bus->txn)
+            continue;
+        if (pio_i2c_check_error(bus->pio, bus->sm)) {
+            // As pio_i2c_write_blocking() does
+            pio_i2c_resume_after_error(bus->pio, bus->sm);
+            pio_i2c_stop(bus->pio, bus->sm);
+            finish(bus, I2C_TXN_NAK);
+        } else {
+            feed(bus);
+            while (!pio_sm_is_rx_fifo_empty(bus->pio, bus->sm)) {
+                uint8_t byte = (uint8_t) pio_sm_get(bus->pio, bus->sm);
+                if (bus->rx_got < bus->rx_words)
+                    bus->rx[bus->rx_got++] = byte;
+            }
+            // The last word is pushed after STOP
+            if (bus->rx_got == bus->rx_words)
+                finish(bus, I2C_TXN_OK);
+        }
+        busy |= bus->txn != NULL;
+    }
+    return busy;
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _PIO_I2C_MULTI_H
+#define _PIO_I2C_MULTI_H
+
+#include "pio_i2c.h"
+#include "i2c_txn.h"
+
+// Many PIO I2C buses, one per state machine, run by the processor together.
+//
+// pio_i2c_dma needs two DMA channels per bus, so the RP2040's 12 channels
+// run out before its 8 state machines do. Here each bus has a queue of
+// transactions from i2c_txn.h, encoded in the same way, and
+// pio_i2c_multi_service() goes round all the state machines, topping up
+// each TX FIFO and emptying each RX FIFO, and dealing with any NAK. A bus
+// needs a word every few microseconds at most, so one processor keeps up with
+// every state machine on the chip, running at full speed at the same time.
+//
+// Everything happens in pio_i2c_multi_service(), so it must be called often,
+// for as long as there is anything queued.
+
+#define PIO_I2C_MULTI_MAX_BUSES (NUM_PIOS * NUM_PIO_STATE_MACHINES)
+
+typedef struct {
+    PIO pio;
+    uint sm;
+    // The same for every state machine
+    const i2c_txn_instrs_t *instrs;
+    i2c_txn_queue_t queue;
+    // The transaction in progress
+    i2c_txn_t *txn;
+    uint32_t n_words;
+    uint32_t words_put;
+    uint32_t rx_words;
+    uint32_t rx_got;
+    uint16_t words[I2C_TXN_MAX_WORDS];
+    uint8_t rx[I2C_TXN_MAX_RX_WORDS];
+} pio_i2c_multi_bus_t;
+
+typedef struct {
+    pio_i2c_multi_bus_t buses[PIO_I2C_MULTI_MAX_BUSES];
+    uint n_buses;
+    i2c_txn_instrs_t instrs;
+} pio_i2c_multi_t;
+
+void pio_i2c_multi_init(pio_i2c_multi_t *m);
+
+// The state machine must already be running the i2c program, set up with
+// i2c_program_init(). Returns the bus's queue, or NULL if there are too many.
+i2c_txn_queue_t *pio_i2c_multi_add_bus(pio_i2c_multi_t *m, PIO pio, uint sm);
+
+// Moves every bus on as far as it can go without waiting. Returns true if
+// anything is still in progress.
+bool pio_i2c_multi_service(pio_i2c_multi_t *m);
+
+#endif
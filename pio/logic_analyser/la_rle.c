@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "la_rle.h"
+
+// Shorter runs than this are cheaper to leave in a literal record (a run
+// costs a header plus one word, and splits the surrounding literal in two)
+#define LA_RLE_MIN_RUN 3
+
+static size_t put_varint(uint8_t *dst, uint32_t val) {
+    size_t n = 0;
+    while (val >= 0x80) {
+        dst[n++] = (uint8_t) (val | 0x80);
+        val >>= 7;
+    }
+    dst[n++] = (uint8_t) val;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *src, size_t src_len, uint32_t *val) {
+    uint32_t result = 0;
+    for (size_t n = 0; n < src_len && n < 5; ++n) {
+        result |= (uint32_t) (src[n] & 0x7f) << (7 * n);
+        if (!(src[n] & 0x80)) {
+            *val = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline void put_word(uint8_t *dst, uint32_t word) {
+    dst[0] = (uint8_t) word;
+    dst[1] = (uint8_t) (word >> 8);
+    dst[2] = (uint8_t) (word >> 16);
+    dst[3] = (uint8_t) (word >> 24);
+}
+
+static inline uint32_t get_word(const uint8_t *src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+size_t la_rle_encode(const uint32_t *src, size_t n_words, uint8_t *dst, size_t dst_size) {
+    // Encoding is done straight into dst, so check for the worst case up
+    // front rather than on every record.
+    if (dst_size < LA_RLE_MAX_ENCODED_SIZE(n_words))
+        return 0;
+    uint8_t *out = dst;
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (i < n_words) {
+        uint32_t word = src[i];
+        size_t run = 1;
+        while (i + run < n_words && src[i + run] == word)
+            ++run;
+        if (run < LA_RLE_MIN_RUN) {
+            // Leave it in the pending literal
+            i += run;
+            continue;
+        }
+        if (literal_start < i) {
+            size_t count = i - literal_start;
+            out += put_varint(out, (uint32_t) count << 1);
+            for (size_t j = literal_start; j < i; ++j, out += 4)
+                put_word(out, src[j]);
+        }
+        out += put_varint(out, (uint32_t) run << 1 | 1);
+        put_word(out, word);
+        out += 4;
+        i += run;
+        literal_start = i;
+    }
+    if (literal_start < n_words) {
+        out += put_varint(out, (uint32_t) (n_words - literal_start) << 1);
+        for (size_t j = literal_start; j < n_words; ++j, out += 4)
+            put_word(out, src[j]);
+    }
+    return (size_t) (out - dst);
+}
+
+bool la_rle_decode(const uint8_t *src, size_t src_len, uint32_t *dst, size_t dst_words, size_t *n_decoded) {
+    size_t in = 0, out = 0;
+    bool ok = true;
+    while (in < src_len) {
+        uint32_t header;
+        size_t header_len = get_varint(src + in, src_len - in, &header);
+        if (!header_len) {
+            ok = false;
+            break;
+        }
+        in += header_len;
+        size_t count = header >> 1;
+        bool is_run = header & 1;
+        size_t payload_len = is_run ? 4 : count * 4;
+        if (count > dst_words - out || payload_len > src_len - in) {
+            ok = false;
+            break;
+        }
+        if (is_run) {
+            uint32_t word = get_word(src + in);
+            for (size_t j = 0; j < count; ++j)
+                dst[out++] = word;
+        } else {
+            for (size_t j = 0; j < count; ++j)
+                dst[out++] = get_word(src + in + 4 * j);
+        }
+        in += payload_len;
+    }
+    *n_decoded = out;
+    return ok;
+}
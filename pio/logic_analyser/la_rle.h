@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _LA_RLE_H
+#define _LA_RLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Run-length coding of logic analyser capture words.
+//
+// The capture buffer is a sequence of 32-bit FIFO records, each holding
+// several packed samples. When the bus is idle, consecutive records are
+// identical, so we only need to store the record once along with a repeat
+// count. Busy periods are stored as literal records with a single header.
+//
+// The encoded stream is a sequence of records, each starting with an
+// unsigned LEB128 varint header of (count << 1 | is_run):
+//
+//   is_run = 1: one 32-bit little-endian word follows, repeated `count` times
+//   is_run = 0: `count` 32-bit little-endian words follow, copied verbatim
+//
+// The encoder and decoder build for the host as well as the device, e.g. to
+// decode a capture streamed out over USB.
+
+// Worst case size of the encoding of n_words capture words
+#define LA_RLE_MAX_ENCODED_SIZE(n_words) ((n_words) * 5 + 5)
+
+// Encode n_words words from src into dst. Returns the number of bytes
+// written, or 0 if dst_size is too small (LA_RLE_MAX_ENCODED_SIZE() bytes is
+// always enough).
+size_t la_rle_encode(const uint32_t *src, size_t n_words, uint8_t *dst, size_t dst_size);
+
+// Decode src_len bytes from src into dst. Returns false if the stream is
+// malformed or would overflow dst_words. The number of words decoded is
+// written to *n_decoded.
+bool la_rle_decode(const uint8_t *src, size_t src_len, uint32_t *dst, size_t dst_words, size_t *n_decoded);
+
+#endif
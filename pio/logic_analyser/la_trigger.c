@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "la_trigger.h"
+
+// Both PIO input synchronisers (the data pins going into the trigger state
+// machine, and the trigger pin going into the capture state machine) add this
+// many cycles of delay
+#define INPUT_SYNC_CYCLES 2
+
+void la_trigger_init(la_trigger_t *trig) {
+    trig->n_stages = 0;
+}
+
+bool la_trigger_add_pattern(la_trigger_t *trig, uint32_t mask, uint32_t value) {
+    if (trig->n_stages >= LA_TRIGGER_MAX_STAGES)
+        return false;
+    trig->stages[trig->n_stages].mask = mask;
+    trig->stages[trig->n_stages].value = value & mask;
+    ++trig->n_stages;
+    return true;
+}
+
+bool la_trigger_add_level(la_trigger_t *trig, unsigned int pin, bool level) {
+    return la_trigger_add_pattern(trig, 1u << pin, (uint32_t) level << pin);
+}
+
+bool la_trigger_add_edge(la_trigger_t *trig, unsigned int pin, bool rising) {
+    if (trig->n_stages + 2 > LA_TRIGGER_MAX_STAGES)
+        return false;
+    la_trigger_add_level(trig, pin, !rising);
+    la_trigger_add_level(trig, pin, rising);
+    return true;
+}
+
+unsigned int la_trigger_stage_length(const la_trigger_stage_t *stage) {
+    unsigned int length = 1;
+    unsigned int gap = 0;
+    for (unsigned int pin = 0; pin < 32; ++pin) {
+        if (stage->mask & (1u << pin)) {
+            length += gap ? 3 : 2;
+            gap = 0;
+        } else {
+            ++gap;
+        }
+    }
+    return length;
+}
+
+unsigned int la_trigger_program_length(const la_trigger_t *trig) {
+    unsigned int length = 2;
+    for (unsigned int i = 0; i < trig->n_stages; ++i)
+        length += la_trigger_stage_length(&trig->stages[i]);
+    return length;
+}
+
+unsigned int la_trigger_worst_case_latency(const la_trigger_t *trig, unsigned int capture_cycles_per_sample) {
+    if (!trig->n_stages)
+        return 0;
+    unsigned int last = la_trigger_stage_length(&trig->stages[trig->n_stages - 1]);
+    // If the condition becomes true just after the `mov osr, pins`, we finish
+    // a failing pass through the stage, then a full passing one, then signal
+    // with one more instruction. The capture program checks the trigger pin
+    // once per sample.
+    return INPUT_SYNC_CYCLES + (last - 1) + last + 1 + INPUT_SYNC_CYCLES + capture_cycles_per_sample;
+}
+
+uint32_t la_trigger_get_sample(const uint32_t *buf, unsigned int pin_count, unsigned int bits_per_word, size_t index) {
+    // bits_per_word is a multiple of pin_count, so samples never straddle
+    // words. Data is left-justified in each word.
+    size_t bit_index = index * pin_count;
+    uint32_t word = buf[bit_index / bits_per_word];
+    uint32_t mask = pin_count < 32 ? (1u << pin_count) - 1 : ~0u;
+    return (word >> (bit_index % bits_per_word + 32 - bits_per_word)) & mask;
+}
+
+long la_trigger_find(const la_trigger_t *trig, const uint32_t *buf, unsigned int pin_count,
+                     unsigned int bits_per_word, size_t n_samples) {
+    unsigned int stage = 0;
+    if (!trig->n_stages)
+        return n_samples ? 0 : -1;
+    for (size_t i = 0; i < n_samples; ++i) {
+        uint32_t sample = la_trigger_get_sample(buf, pin_count, bits_per_word, i);
+        // At most one stage can advance per sample, as the PIO program
+        // re-reads the pins at the start of each stage
+        if ((sample & trig->stages[stage].mask) == trig->stages[stage].value) {
+            if (++stage == trig->n_stages)
+                return (long) i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _LA_TRIGGER_H
+#define _LA_TRIGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Trigger conditions for the logic analyser.
+//
+// A trigger is a sequence of up to LA_TRIGGER_MAX_STAGES stages. Each stage
+// is a pattern: the pins selected by `mask` must equal the corresponding bits
+// of `value` (bit 0 is the first captured pin). The trigger fires when every
+// stage has matched, in order, each at a later sample than the previous one.
+//
+// An edge is just a two-stage sequence: the pin at the old level, then the
+// pin at the new level.
+//
+// The same description is used to generate the PIO trigger program on the
+// device, and by la_trigger_find() to run the trigger over a capture in
+// software, so the two can be checked against each other.
+
+#define LA_TRIGGER_MAX_STAGES 8
+
+typedef struct {
+    uint32_t mask;
+    uint32_t value;
+} la_trigger_stage_t;
+
+typedef struct {
+    la_trigger_stage_t stages[LA_TRIGGER_MAX_STAGES];
+    unsigned int n_stages;
+} la_trigger_t;
+
+void la_trigger_init(la_trigger_t *trig);
+
+// These return false if the trigger already has too many stages
+bool la_trigger_add_pattern(la_trigger_t *trig, uint32_t mask, uint32_t value);
+bool la_trigger_add_level(la_trigger_t *trig, unsigned int pin, bool level);
+bool la_trigger_add_edge(la_trigger_t *trig, unsigned int pin, bool rising);
+
+// Number of PIO instructions (and cycles, as every instruction takes one
+// cycle) in the polling loop for one stage. Each stage is:
+//
+//     mov osr, pins
+//     out null, n      ; skip pins we don't care about (only if n > 0)
+//     out y, 1
+//     jmp !y / y--     ; back to the start of the stage on mismatch
+//     ...              ; repeat for each pin in the mask
+unsigned int la_trigger_stage_length(const la_trigger_stage_t *stage);
+
+// Total instructions in the trigger program, including the final instruction
+// which signals the trigger and the halt loop
+unsigned int la_trigger_program_length(const la_trigger_t *trig);
+
+// Worst case number of system clocks from the last stage's condition becoming
+// true on the pins to the capture state machine seeing the trigger, when the
+// trigger program runs at full speed and the capture program samples once per
+// `capture_cycles_per_sample` system clocks
+unsigned int la_trigger_worst_case_latency(const la_trigger_t *trig, unsigned int capture_cycles_per_sample);
+
+// Unpack sample `index` (one bit per pin) from a capture buffer in the format
+// produced by the logic analyser's `in pins, n` program with right-shifting
+// autopush at `bits_per_word`
+uint32_t la_trigger_get_sample(const uint32_t *buf, unsigned int pin_count, unsigned int bits_per_word, size_t index);
+
+// Run the trigger over a capture. Returns the index of the sample at which
+// the trigger fires, or -1 if it doesn't.
+long la_trigger_find(const la_trigger_t *trig, const uint32_t *buf, unsigned int pin_count,
+                     unsigned int bits_per_word, size_t n_samples);
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// PIO logic analyser example, continuous streaming version
+//
+// The basic logic analyser example captures one buffer's worth of samples and
+// then stops. Here we capture continuously instead:
+//
+// - Two DMA channels are chained in a ring around the capture buffer. Each
+//   channel fills one half of the buffer, then triggers the other. The write
+//   address of each channel wraps around its own half (the DMA's address ring
+//   option), so it is ready to go again as soon as it finishes, however late
+//   the completion interrupt is, and the PIO FIFO is always being drained.
+//   The interrupt just counts the blocks.
+//
+// - Core 1 run-length encodes each completed half (see la_rle.h). An idle bus
+//   produces long runs of identical FIFO records, which compress to a few
+//   bytes, so we can watch a slow bus for minutes rather than microseconds.
+//
+// - Core 0 streams the encoded blocks out over stdio, as lines of hex.
+//
+// Before streaming, a one-shot capture of the same signals is used to
+// benchmark the encoder on each core, in samples per second.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/bus_ctrl.h"
+
+// Some logic to analyse:
+#include "hardware/structs/pwm.h"
+
+#include "la_rle.h"
+
+const uint CAPTURE_PIN_BASE = 16;
+const uint CAPTURE_PIN_COUNT = 2;
+// One sample per 125 system clocks, i.e. 1 Msps at 125 MHz
+const float CAPTURE_CLKDIV = 125.f;
+
+// The ring is made of two blocks, one per DMA channel. Each block must be a
+// power of two bytes, and aligned to its size, for the DMA to wrap around it.
+#define CAPTURE_BLOCK_WORDS 1024
+#define CAPTURE_BLOCK_RING_BITS 12
+static_assert(CAPTURE_BLOCK_WORDS * sizeof(uint32_t) == 1u << CAPTURE_BLOCK_RING_BITS, "");
+// Number of encoded blocks which may be queued waiting for core 0 to print them
+#define N_ENCODED_BLOCKS 4
+// Size of the one-shot trace used for the encoder benchmark
+#define TRACE_WORDS 8192
+#define BENCHMARK_ITERATIONS 16
+
+static uint32_t capture_ring[2 * CAPTURE_BLOCK_WORDS] __attribute__((aligned(CAPTURE_BLOCK_WORDS * 4)));
+static uint32_t trace_buf[TRACE_WORDS];
+static uint32_t decode_buf[TRACE_WORDS];
+
+static uint8_t encoded_buf[N_ENCODED_BLOCKS][LA_RLE_MAX_ENCODED_SIZE(CAPTURE_BLOCK_WORDS)];
+static size_t encoded_len[N_ENCODED_BLOCKS];
+static uint32_t encoded_seq[N_ENCODED_BLOCKS];
+
+static PIO pio = pio0;
+static uint sm = 0;
+static uint dma_chan[2];
+
+// Each counter has exactly one writer
+static volatile uint32_t blocks_captured;   // DMA IRQ (core 0)
+static volatile uint32_t blocks_encoded;    // core 1
+static volatile uint32_t blocks_sent;       // core 0
+static volatile uint32_t blocks_dropped;    // core 1
+
+static inline uint bits_packed_per_word(uint pin_count) {
+    // If the number of pins to be sampled divides the shift register size, we
+    // can use the full SR and FIFO width, and push when the input shift count
+    // exactly reaches 32. If not, we have to push earlier, so we use the FIFO
+    // a little less efficiently.
+    const uint SHIFT_REG_WIDTH = 32;
+    return SHIFT_REG_WIDTH - (SHIFT_REG_WIDTH % pin_count);
+}
+
+void logic_analyser_init(PIO pio, uint sm, uint pin_base, uint pin_count, float div) {
+    // Load a program to capture n pins. This is just a single `in pins, n`
+    // instruction with a wrap.
+    uint16_t capture_prog_instr = pio_encode_in(pio_pins, pin_count);
+    struct pio_program capture_prog = {
+            .instructions = &capture_prog_instr,
+            .length = 1,
+            .origin = -1
+    };
+    uint offset = pio_add_program(pio, &capture_prog);
+
+    // Configure state machine to loop over this `in` instruction forever,
+    // with autopush enabled.
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_in_pins(&c, pin_base);
+    sm_config_set_wrap(&c, offset, offset);
+    sm_config_set_clkdiv(&c, div);
+    sm_config_set_in_shift(&c, true, true, bits_packed_per_word(pin_count));
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    pio_sm_init(pio, sm, offset, &c);
+}
+
+static void logic_analyser_stop(PIO pio, uint sm) {
+    pio_sm_set_enabled(pio, sm, false);
+    // Need to clear _input shift counter_, as well as FIFO, because there may be
+    // partial ISR contents left over from a previous run. sm_restart does this.
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+}
+
+// One-shot capture of a trace, for benchmarking the encoder on real signals
+void logic_analyser_capture_trace(PIO pio, uint sm, uint dma_chan, uint32_t *buf, size_t n_words) {
+    logic_analyser_stop(pio, sm);
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(dma_chan, &c, buf, &pio->rxf[sm], n_words, true);
+
+    pio_sm_set_enabled(pio, sm, true);
+    dma_channel_wait_for_finish_blocking(dma_chan);
+    pio_sm_set_enabled(pio, sm, false);
+}
+
+void dma_handler() {
+    // The two channels complete alternately, but check both in case we were
+    // held off for long enough that both have finished.
+    for (uint i = 0; i < 2; ++i) {
+        if (dma_channel_get_irq0_status(dma_chan[i])) {
+            dma_channel_acknowledge_irq0(dma_chan[i]);
+            // The write address has already wrapped back to the start of
+            // this channel's block, so there is nothing to re-arm
+            blocks_captured = blocks_captured + 1;
+        }
+    }
+}
+
+void logic_analyser_start_stream(PIO pio, uint sm, const uint dma_chan[2]) {
+    logic_analyser_stop(pio, sm);
+
+    for (uint i = 0; i < 2; ++i) {
+        dma_channel_config c = dma_channel_get_default_config(dma_chan[i]);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+        channel_config_set_chain_to(&c, dma_chan[i ^ 1]);
+        channel_config_set_ring(&c, true, CAPTURE_BLOCK_RING_BITS);
+        dma_channel_configure(dma_chan[i], &c,
+            &capture_ring[i * CAPTURE_BLOCK_WORDS], // Destination pointer
+            &pio->rxf[sm],                          // Source pointer
+            CAPTURE_BLOCK_WORDS,                    // Number of transfers
+            false                                   // Don't start yet
+        );
+        dma_channel_set_irq0_enabled(dma_chan[i], true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    dma_channel_start(dma_chan[0]);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+static uint64_t benchmark_rle(void) {
+    static uint8_t bench_out[LA_RLE_MAX_ENCODED_SIZE(TRACE_WORDS)];
+    uint64_t start = time_us_64();
+    for (uint i = 0; i < BENCHMARK_ITERATIONS; ++i)
+        la_rle_encode(trace_buf, TRACE_WORDS, bench_out, sizeof(bench_out));
+    return time_us_64() - start;
+}
+
+void core1_benchmark() {
+    multicore_fifo_push_blocking((uint32_t) benchmark_rle());
+}
+
+void core1_encode() {
+    uint32_t seq = 0;   // Next captured block to encode
+    uint32_t out = 0;   // Next output slot to fill
+    while (true) {
+        while (seq == blocks_captured)
+            tight_loop_contents();
+        // Wait for core 0 to free up an output slot
+        while (out - blocks_sent >= N_ENCODED_BLOCKS)
+            tight_loop_contents();
+
+        uint slot = out % N_ENCODED_BLOCKS;
+        encoded_len[slot] = la_rle_encode(&capture_ring[(seq & 1) * CAPTURE_BLOCK_WORDS], CAPTURE_BLOCK_WORDS,
+                                          encoded_buf[slot], sizeof(encoded_buf[slot]));
+        encoded_seq[slot] = seq;
+
+        // If the DMA has completed another block whilst we were encoding, it
+        // is now writing over the block we just read, so the output may be
+        // corrupt. Throw it away, and skip ahead to the newest whole block.
+        uint32_t captured = blocks_captured;
+        if (captured - seq > 1) {
+            blocks_dropped = blocks_dropped + (captured - 1 - seq);
+            seq = captured - 1;
+            continue;
+        }
+        __dmb();
+        blocks_encoded = ++out;
+        ++seq;
+    }
+}
+
+static void print_encoded_block(const uint8_t *buf, size_t len, uint32_t seq) {
+    printf("B %u %u %u ", seq, CAPTURE_BLOCK_WORDS, len);
+    for (size_t i = 0; i < len; ++i)
+        printf("%02x", buf[i]);
+    printf("\n");
+}
+
+int main() {
+    stdio_init_all();
+    printf("PIO logic analyser streaming example\n");
+
+    // Grant high bus priority to the DMA, so it can shove the processors out
+    // of the way. This should only be needed if you are pushing things up to
+    // >16bits/clk here, i.e. if you need to saturate the bus completely.
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
+
+    dma_chan[0] = dma_claim_unused_channel(true);
+    dma_chan[1] = dma_claim_unused_channel(true);
+
+    logic_analyser_init(pio, sm, CAPTURE_PIN_BASE, CAPTURE_PIN_COUNT, CAPTURE_CLKDIV);
+
+    printf("Starting PWM example\n");
+    // PWM example: -----------------------------------------------------------
+    gpio_set_function(CAPTURE_PIN_BASE, GPIO_FUNC_PWM);
+    gpio_set_function(CAPTURE_PIN_BASE + 1, GPIO_FUNC_PWM);
+    // Count from 0 to 999 and then wrap, with the counter divided by 250, so
+    // the period is 250000 system clocks: long idle periods for the encoder
+    pwm_hw->slice[0].top = 999;
+    pwm_hw->slice[0].div = 250 << PWM_CH0_DIV_INT_LSB;
+    // Channel A has a 1/4 duty cycle, and channel B 3/4
+    pwm_hw->slice[0].cc =
+            (250 << PWM_CH0_CC_A_LSB) |
+            (750 << PWM_CH0_CC_B_LSB);
+    pwm_hw->slice[0].csr = PWM_CH0_CSR_EN_BITS;
+    // ------------------------------------------------------------------------
+
+    // Record a trace, and benchmark the encoder on it from each core
+    logic_analyser_capture_trace(pio, sm, dma_chan[0], trace_buf, TRACE_WORDS);
+
+    static uint8_t trace_encoded[LA_RLE_MAX_ENCODED_SIZE(TRACE_WORDS)];
+    size_t trace_encoded_len = la_rle_encode(trace_buf, TRACE_WORDS, trace_encoded, sizeof(trace_encoded));
+    size_t n_decoded;
+    bool ok = la_rle_decode(trace_encoded, trace_encoded_len, decode_buf, TRACE_WORDS, &n_decoded) &&
+              n_decoded == TRACE_WORDS;
+    for (uint i = 0; ok && i < TRACE_WORDS; ++i)
+        ok = decode_buf[i] == trace_buf[i];
+    printf("Trace of %u words encoded to %u bytes, decode %s\n", TRACE_WORDS, trace_encoded_len,
+           ok ? "OK" : "FAILED");
+
+    uint64_t samples = (uint64_t) TRACE_WORDS * BENCHMARK_ITERATIONS *
+                       (bits_packed_per_word(CAPTURE_PIN_COUNT) / CAPTURE_PIN_COUNT);
+    uint64_t core0_us = benchmark_rle();
+    multicore_launch_core1(core1_benchmark);
+    uint64_t core1_us = multicore_fifo_pop_blocking();
+    multicore_reset_core1();
+    printf("Encoder throughput: core 0 %llu samples/s, core 1 %llu samples/s\n",
+           samples * 1000000 / core0_us, samples * 1000000 / core1_us);
+
+    // Now capture continuously. Core 1 encodes, we print.
+    printf("Streaming\n");
+    multicore_launch_core1(core1_encode);
+    logic_analyser_start_stream(pio, sm, dma_chan);
+
+    uint32_t seq = 0;
+    uint32_t last_dropped = 0;
+    while (true) {
+        while (seq == blocks_encoded)
+            tight_loop_contents();
+        __dmb();
+        uint slot = seq % N_ENCODED_BLOCKS;
+        print_encoded_block(encoded_buf[slot], encoded_len[slot], encoded_seq[slot]);
+        blocks_sent = blocks_sent + 1;
+        ++seq;
+        if (blocks_dropped != last_dropped) {
+            last_dropped = blocks_dropped;
+            printf("Dropped %u blocks so far (stdio is too slow for this sample rate)\n", last_dropped);
+        }
+    }
+}
@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// PIO logic analyser example, with pre-trigger capture and a trigger engine
+//
+// The basic logic analyser example waits for a level on one pin before it
+// starts capturing, so we never see what led up to the trigger. Here:
+//
+// - The capture state machine samples continuously into a DMA ring buffer,
+//   so the ring always holds the most recent history (the pre-trigger
+//   samples).
+//
+// - A second state machine runs a trigger program, generated at runtime from
+//   a sequence of pattern/mask stages (see la_trigger.h). Edges are two-stage
+//   sequences. When the last stage matches, it drives a trigger pin high.
+//
+// - The capture program polls the trigger pin with `jmp pin` between samples.
+//   Once it goes high, the capture program takes a fixed number of
+//   post-trigger samples, raises a PIO IRQ flag and stops.
+//
+// None of this involves the processors, so the trigger-to-capture latency is
+// a fixed number of system clocks, which we print. The trigger pin is also a
+// handy trigger output for a scope.
+//
+// Finally, the same trigger is run over the capture in software, to check
+// where the hardware triggered.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/structs/bus_ctrl.h"
+
+// Some logic to analyse:
+#include "hardware/structs/pwm.h"
+
+#include "la_trigger.h"
+
+const uint CAPTURE_PIN_BASE = 16;
+const uint CAPTURE_PIN_COUNT = 2;
+// Driven high by the trigger state machine. Must not be used for anything else.
+const uint TRIGGER_PIN = 18;
+// The capture program takes 2 instructions per sample
+const uint CAPTURE_CYCLES_PER_SAMPLE = 2;
+const uint POST_TRIGGER_SAMPLES = 256;
+
+// DMA ring sizes are a power of 2 bytes, and the ring must be naturally aligned
+#define CAPTURE_RING_BITS 12
+#define CAPTURE_RING_WORDS ((1u << CAPTURE_RING_BITS) / sizeof(uint32_t))
+// The channel runs until we abort it, so just give it a very large count
+#define CAPTURE_TRANSFER_COUNT 0x0fffffffu
+
+static uint32_t capture_ring[CAPTURE_RING_WORDS] __attribute__((aligned(1u << CAPTURE_RING_BITS)));
+static uint32_t capture_buf[CAPTURE_RING_WORDS];
+
+static inline uint bits_packed_per_word(uint pin_count) {
+    // If the number of pins to be sampled divides the shift register size, we
+    // can use the full SR and FIFO width, and push when the input shift count
+    // exactly reaches 32. If not, we have to push earlier, so we use the FIFO
+    // a little less efficiently.
+    const uint SHIFT_REG_WIDTH = 32;
+    return SHIFT_REG_WIDTH - (SHIFT_REG_WIDTH % pin_count);
+}
+
+// Capture program. Sample continuously until the trigger pin goes high, then
+// take another X + 1 samples, flag IRQ 0, and halt.
+//
+//     pre:  in pins, n
+//           jmp pin post    ; wrap to pre if no trigger
+//     post: in pins, n
+//           jmp x-- post
+//           irq set 0
+//     halt: jmp halt
+void logic_analyser_init(PIO pio, uint sm, uint pin_base, uint pin_count, uint trigger_pin) {
+    uint16_t capture_prog_instr[] = {
+            pio_encode_in(pio_pins, pin_count),
+            pio_encode_jmp_pin(2),
+            pio_encode_in(pio_pins, pin_count),
+            pio_encode_jmp_x_dec(2),
+            pio_encode_irq_set(false, 0),
+            pio_encode_jmp(5),
+    };
+    struct pio_program capture_prog = {
+            .instructions = capture_prog_instr,
+            .length = count_of(capture_prog_instr),
+            .origin = -1
+    };
+    uint offset = pio_add_program(pio, &capture_prog);
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_in_pins(&c, pin_base);
+    sm_config_set_jmp_pin(&c, trigger_pin);
+    sm_config_set_wrap(&c, offset, offset + 1);
+    // Note that we may push at a < 32 bit threshold if pin_count does not
+    // divide 32. We are using shift-to-right, so the sample data ends up
+    // left-justified in the FIFO in this case, with some zeroes at the LSBs.
+    sm_config_set_in_shift(&c, true, true, bits_packed_per_word(pin_count));
+    // We don't join the FIFOs, as we need the TX FIFO to load the post-trigger
+    // count. The DMA only needs to take one word per 32 clocks at most.
+    pio_sm_init(pio, sm, offset, &c);
+}
+
+// Trigger program: one polling loop per stage (see la_trigger.h), then drive
+// the trigger pin high and halt. Returns false if it doesn't fit in what's
+// left of the PIO's instruction memory.
+bool trigger_init(PIO pio, uint sm, const la_trigger_t *trig, uint pin_base, uint trigger_pin) {
+    uint16_t instr[32];
+    uint n = 0;
+    if (la_trigger_program_length(trig) > count_of(instr))
+        return false;
+
+    for (uint i = 0; i < trig->n_stages; ++i) {
+        const la_trigger_stage_t *stage = &trig->stages[i];
+        uint stage_start = n;
+        // All pins are sampled at once, then shifted out and checked one by one
+        instr[n++] = pio_encode_mov(pio_osr, pio_pins);
+        uint gap = 0;
+        for (uint pin = 0; pin < 32; ++pin) {
+            if (!(stage->mask & (1u << pin))) {
+                ++gap;
+                continue;
+            }
+            if (gap)
+                instr[n++] = pio_encode_out(pio_null, gap);
+            gap = 0;
+            instr[n++] = pio_encode_out(pio_y, 1);
+            // `jmp y--` jumps if y is nonzero, i.e. the pin is 1
+            if (stage->value & (1u << pin))
+                instr[n++] = pio_encode_jmp_not_y(stage_start);
+            else
+                instr[n++] = pio_encode_jmp_y_dec(stage_start);
+        }
+        hard_assert(n - stage_start == la_trigger_stage_length(stage));
+    }
+    instr[n++] = pio_encode_set(pio_pins, 1);
+    instr[n] = pio_encode_jmp(n);
+    ++n;
+
+    struct pio_program trigger_prog = {
+            .instructions = instr,
+            .length = n,
+            .origin = -1
+    };
+    // The capture program is already loaded, so there is less than the whole
+    // instruction memory left
+    if (!pio_can_add_program(pio, &trigger_prog))
+        return false;
+    uint offset = pio_add_program(pio, &trigger_prog);
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_in_pins(&c, pin_base);
+    sm_config_set_set_pins(&c, trigger_pin, 1);
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_wrap(&c, offset, offset + n - 1);
+    pio_sm_init(pio, sm, offset, &c);
+
+    pio_gpio_init(pio, trigger_pin);
+    pio_sm_set_pins_with_mask(pio, sm, 0, 1u << trigger_pin);
+    pio_sm_set_consecutive_pindirs(pio, sm, trigger_pin, 1, true);
+    return true;
+}
+
+void logic_analyser_arm(PIO pio, uint sm_capture, uint sm_trigger, uint dma_chan, uint post_trigger_samples) {
+    pio_sm_set_enabled(pio, sm_capture, false);
+    // Need to clear _input shift counter_, as well as FIFO, because there may be
+    // partial ISR contents left over from a previous run. sm_restart does this.
+    pio_sm_clear_fifos(pio, sm_capture);
+    pio_sm_restart(pio, sm_capture);
+    pio_interrupt_clear(pio, 0);
+
+    // The post loop runs X + 1 times after the sample where the trigger was seen
+    pio_sm_put(pio, sm_capture, post_trigger_samples - 1);
+    pio_sm_exec(pio, sm_capture, pio_encode_pull(false, false));
+    pio_sm_exec(pio, sm_capture, pio_encode_out(pio_x, 32));
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, CAPTURE_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_capture, false));
+
+    dma_channel_configure(dma_chan, &c,
+        capture_ring,           // Destination pointer
+        &pio->rxf[sm_capture],  // Source pointer
+        CAPTURE_TRANSFER_COUNT, // Number of transfers
+        true                    // Start immediately
+    );
+
+    pio_enable_sm_mask_in_sync(pio, (1u << sm_capture) | (1u << sm_trigger));
+}
+
+// Wait for the capture to finish, and copy the ring out in time order.
+// Returns the number of valid words.
+uint logic_analyser_collect(PIO pio, uint sm_capture, uint dma_chan, uint32_t *buf) {
+    while (!pio_interrupt_get(pio, 0))
+        tight_loop_contents();
+    while (!pio_sm_is_rx_fifo_empty(pio, sm_capture))
+        tight_loop_contents();
+    uint32_t n_words = CAPTURE_TRANSFER_COUNT - dma_channel_hw_addr(dma_chan)->transfer_count;
+    dma_channel_abort(dma_chan);
+
+    if (n_words <= CAPTURE_RING_WORDS) {
+        memcpy(buf, capture_ring, n_words * sizeof(uint32_t));
+        return n_words;
+    }
+    // Oldest data is where the DMA would have written next
+    uint oldest = n_words % CAPTURE_RING_WORDS;
+    memcpy(buf, &capture_ring[oldest], (CAPTURE_RING_WORDS - oldest) * sizeof(uint32_t));
+    memcpy(&buf[CAPTURE_RING_WORDS - oldest], capture_ring, oldest * sizeof(uint32_t));
+    return CAPTURE_RING_WORDS;
+}
+
+void print_capture_window(const uint32_t *buf, uint pin_base, uint pin_count, uint32_t first, uint32_t n_samples,
+                          uint32_t marker) {
+    // Display part of the capture buffer in text form, with the trigger
+    // sample marked underneath:
+    // 16: __--__--__--__--__--__--
+    // 17: ____----____----____----
+    //           ^
+    uint record_size_bits = bits_packed_per_word(pin_count);
+    for (uint pin = 0; pin < pin_count; ++pin) {
+        printf("%02d: ", pin + pin_base);
+        for (uint32_t sample = first; sample < first + n_samples; ++sample) {
+            uint32_t s = la_trigger_get_sample(buf, pin_count, record_size_bits, sample);
+            printf(s & (1u << pin) ? "-" : "_");
+        }
+        printf("\n");
+    }
+    printf("    %*s^\n", (int) (marker - first), "");
+}
+
+int main() {
+    stdio_init_all();
+    printf("PIO logic analyser trigger example\n");
+
+    // Grant high bus priority to the DMA, so it can shove the processors out
+    // of the way. This should only be needed if you are pushing things up to
+    // >16bits/clk here, i.e. if you need to saturate the bus completely.
+    bus_ctrl_hw->priority = BUSCTRL_BUS_PRIORITY_DMA_W_BITS | BUSCTRL_BUS_PRIORITY_DMA_R_BITS;
+
+    PIO pio = pio0;
+    uint sm_capture = 0;
+    uint sm_trigger = 1;
+    uint dma_chan = 0;
+
+    // Trigger on pin 0 rising (after having been low) whilst pin 1 is high
+    la_trigger_t trig;
+    la_trigger_init(&trig);
+    la_trigger_add_pattern(&trig, 0x3, 0x2);
+    la_trigger_add_pattern(&trig, 0x3, 0x3);
+
+    logic_analyser_init(pio, sm_capture, CAPTURE_PIN_BASE, CAPTURE_PIN_COUNT, TRIGGER_PIN);
+    if (!trigger_init(pio, sm_trigger, &trig, CAPTURE_PIN_BASE, TRIGGER_PIN)) {
+        printf("Trigger program doesn't fit alongside the capture program\n");
+        return 1;
+    }
+    uint latency = la_trigger_worst_case_latency(&trig, CAPTURE_CYCLES_PER_SAMPLE);
+    printf("Trigger program is %u instructions, worst case trigger-to-capture latency %u system clocks\n",
+           la_trigger_program_length(&trig), latency);
+
+    printf("Arming trigger\n");
+    logic_analyser_arm(pio, sm_capture, sm_trigger, dma_chan, POST_TRIGGER_SAMPLES);
+
+    printf("Starting PWM example\n");
+    // PWM example: -----------------------------------------------------------
+    gpio_set_function(CAPTURE_PIN_BASE, GPIO_FUNC_PWM);
+    gpio_set_function(CAPTURE_PIN_BASE + 1, GPIO_FUNC_PWM);
+    // Topmost value of 3: count from 0 to 3 and then wrap, so period is 4 cycles
+    pwm_hw->slice[0].top = 3;
+    // Divide frequency by two to slow things down a little
+    pwm_hw->slice[0].div = 4 << PWM_CH0_DIV_INT_LSB;
+    // Set channel A to be high for 1 cycle each period (duty cycle 1/4) and
+    // channel B for 3 cycles (duty cycle 3/4)
+    pwm_hw->slice[0].cc =
+            (1 << PWM_CH0_CC_A_LSB) |
+            (3 << PWM_CH0_CC_B_LSB);
+    // Enable this PWM slice
+    pwm_hw->slice[0].csr = PWM_CH0_CSR_EN_BITS;
+    // ------------------------------------------------------------------------
+
+    uint n_words = logic_analyser_collect(pio, sm_capture, dma_chan, capture_buf);
+    uint samples_per_word = bits_packed_per_word(CAPTURE_PIN_COUNT) / CAPTURE_PIN_COUNT;
+    uint32_t n_samples = n_words * samples_per_word;
+
+    long trigger_sample = la_trigger_find(&trig, capture_buf, CAPTURE_PIN_COUNT,
+                                          bits_packed_per_word(CAPTURE_PIN_COUNT), n_samples);
+    if (trigger_sample < 0) {
+        printf("Trigger condition not found in capture!\n");
+        return 1;
+    }
+    // Up to one partial word of samples at the end is never pushed
+    uint32_t post_samples = n_samples - trigger_sample - 1;
+    printf("Captured %u samples, %u before and %u after the trigger\n", n_samples, (uint32_t) trigger_sample,
+           post_samples);
+    printf("Trigger seen by capture program %d samples after the pattern (worst case %u, +/- %u for packing)\n",
+           (int) post_samples - (int) POST_TRIGGER_SAMPLES, (latency + CAPTURE_CYCLES_PER_SAMPLE - 1) /
+           CAPTURE_CYCLES_PER_SAMPLE, samples_per_word - 1);
+
+    uint32_t first = trigger_sample >= 32 ? trigger_sample - 32 : 0;
+    print_capture_window(capture_buf, CAPTURE_PIN_BASE, CAPTURE_PIN_COUNT, first, MIN(64, n_samples - first),
+                         trigger_sample);
+}
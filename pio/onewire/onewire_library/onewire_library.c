@@ -9,6 +9,7 @@
 #include "hardware/pio.h"
 
 #include "onewire_library.h"
+#include "ow_search.h"
 
 
 // Create a driver instance and populate the provided OW structure.
@@ -64,6 +65,34 @@ bool ow_reset (OW *ow) {
 }
 
 
+// Run the 64 triplets of a ROM search pass, after the search command, without
+// stopping between them (see the triplet code in onewire_library.pio).
+// ow: pointer to an OW driver struct
+// prefs: the direction to take at each bit where the slaves differ
+// a_bits, b_bits: locations at which to store the bits read and their complements
+void ow_triplets (OW *ow, uint64_t prefs, uint64_t *a_bits, uint64_t *b_bits) {
+    // let the last time slot of the search command finish first
+    while (pio_sm_get_pc (ow->pio, ow->sm) != (uint)ow->offset + onewire_offset_fetch_bit) {
+        tight_loop_contents ();
+    }
+    onewire_search_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio);
+    pio_sm_put_blocking (ow->pio, ow->sm, (uint32_t)prefs);
+    pio_sm_put_blocking (ow->pio, ow->sm, (uint32_t)(prefs >> 32));
+    *a_bits = 0ull;
+    *b_bits = 0ull;
+    for (int index = 0; index < 64; index += 1) {
+        uint32_t result = pio_sm_get_blocking (ow->pio, ow->sm);
+        *a_bits |= (uint64_t)OW_TRIPLET_A (result) << index;
+        *b_bits |= (uint64_t)OW_TRIPLET_B (result) << index;
+    }
+    // wait for the state machine to stop with the bus released
+    while ((ow->pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + ow->sm))) == 0) {
+        tight_loop_contents ();
+    }
+    onewire_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio, 8); // restore 8-bit mode
+}
+
+
 // Find ROM codes (64-bit hardware addresses) of all connected devices.
 // See https://www.analog.com/en/app-notes/1wire-search-algorithm.html
 // Returns: the number of devices found (up to maxdevs) or -1 if an error occurrred.
@@ -72,64 +101,28 @@ bool ow_reset (OW *ow) {
 // maxdevs: maximum number of devices to find (0 means no limit)
 // command: 1-Wire search command (e.g. OW_SEARCHROM or OW_ALARM_SEARCH)
 int ow_romsearch (OW *ow, uint64_t *romcodes, int maxdevs, uint command) {
-    int index;
-    uint64_t romcode = 0ull;
-    int branch_point;
-    int next_branch_point = -1;
+    ow_search_t search;
     int num_found = 0;
-    bool finished = false;
-
-    onewire_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio, 1); // set driver to 1-bit mode
 
-    while (finished == false && (maxdevs == 0 || num_found < maxdevs )) {
-        finished = true;
-        branch_point = next_branch_point;
+    ow_search_init (&search);
+    while (search.done == false && (maxdevs == 0 || num_found < maxdevs)) {
         if (ow_reset (ow) == false) {
-            num_found = 0;     // no slaves present
-            finished = true;
-            break;
+            return 0;           // no slaves present
         }
-        for (int i = 0; i < 8; i += 1) {    // send search command as single bits
-            ow_send (ow, command >> i);
+        ow_send (ow, command);
+
+        // the state machine works out each bit of the ROM code itself
+        uint64_t prefs = ow_search_prefs (&search);
+        uint64_t a_bits, b_bits;
+        ow_triplets (ow, prefs, &a_bits, &b_bits);
+        if (ow_search_next (&search, prefs, a_bits, b_bits) == false) {
+            return -1;          // (a, b) = (1, 1) e.g. device disconnected, or a bad ROM code
         }
-        for (index = 0; index < 64; index += 1) {   // determine romcode bits 0..63 (see ref)
-            uint a = ow_read (ow);
-            uint b = ow_read (ow);
-            if (a == 0 && b == 0) {         // (a, b) = (0, 0)
-                if (index == branch_point) {
-                    ow_send (ow, 1);
-                    romcode |= (1ull << index);
-                } else {
-                    if (index > branch_point || (romcode & (1ull << index)) == 0) {
-                        ow_send(ow, 0);
-                        finished = false;
-                        romcode &= ~(1ull << index);
-                        next_branch_point = index;
-                    } else {                // index < branch_point or romcode[index] = 1
-                        ow_send (ow, 1);
-                    }
-                }
-            } else if (a != 0 && b != 0) {  // (a, b) = (1, 1) error (e.g. device disconnected)
-                num_found = -2;             // function will return -1
-                finished = true;
-                break;                      // terminate for loop
-            } else {
-                if (a == 0) {               // (a, b) = (0, 1) or (1, 0)
-                    ow_send (ow, 0);
-                    romcode &= ~(1ull << index);
-                } else {
-                    ow_send (ow, 1);
-                    romcode |= (1ull << index);
-                }
-            }
-        }                                   // end of for loop
 
         if (romcodes != NULL) {
-            romcodes[num_found] = romcode;  // store the romcode
+            romcodes[num_found] = search.rom;  // store the romcode
         }
         num_found += 1;
-    }                                       // end of while loop
-
-    onewire_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio, 8); // restore 8-bit mode
+    }
     return num_found;
-}
\ No newline at end of file
+}
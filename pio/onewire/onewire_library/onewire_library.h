@@ -1,3 +1,6 @@
+#ifndef _ONEWIRE_LIBRARY_H
+#define _ONEWIRE_LIBRARY_H
+
 #include "hardware/pio.h"
 #include "hardware/clocks.h"            // for clock_get_hz() in generated header
 #include "onewire_library.pio.h"        // generated by pioasm
@@ -14,4 +17,11 @@ bool ow_init (OW *ow, PIO pio, uint offset, uint gpio);
 void ow_send (OW *ow, uint data);
 uint8_t ow_read (OW *ow);
 bool ow_reset (OW *ow);
-int ow_romsearch (OW *ow, uint64_t *romcodes, int maxdevs, uint command);
\ No newline at end of file
+void ow_triplets (OW *ow, uint64_t prefs, uint64_t *a_bits, uint64_t *b_bits);
+int ow_romsearch (OW *ow, uint64_t *romcodes, int maxdevs, uint command);
+
+// Each search triplet pushes the bit read, its complement and the bit written
+#define OW_TRIPLET_A(result) (((result) >> 2) & 1u)
+#define OW_TRIPLET_B(result) (((result) >> 1) & 1u)
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ow_search.h"
+
+void ow_search_init (ow_search_t *s) {
+    s->rom = 0ull;
+    s->last_discrepancy = -1;
+    s->done = false;
+}
+
+uint64_t ow_search_prefs (const ow_search_t *s) {
+    if (s->last_discrepancy < 0) {
+        return 0ull;            // first pass: take 0 wherever the slaves differ
+    }
+    // follow the last ROM code up to the last discrepancy, take 1 there, then 0
+    uint64_t below = (1ull << s->last_discrepancy) - 1;
+    return (s->rom & below) | (1ull << s->last_discrepancy);
+}
+
+bool ow_search_next (ow_search_t *s, uint64_t prefs, uint64_t a_bits, uint64_t b_bits) {
+    if (a_bits & b_bits) {
+        return false;           // (a, b) = (1, 1) e.g. device disconnected
+    }
+    // (0, 1) and (1, 0) give the slaves' bit; (0, 0) gives the preferred direction
+    uint64_t rom = a_bits | (prefs & ~b_bits);
+    if (!ow_rom_valid (rom)) {
+        return false;
+    }
+    uint64_t zeros_taken = ~a_bits & ~b_bits & ~prefs;
+    s->rom = rom;
+    s->last_discrepancy = -1;
+    for (int i = 63; i >= 0; i -= 1) {
+        if (zeros_taken & (1ull << i)) {
+            s->last_discrepancy = i;
+            break;
+        }
+    }
+    s->done = s->last_discrepancy < 0;
+    return true;
+}
+
+uint8_t ow_crc8 (const uint8_t *data, uint32_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        uint8_t byte = *data++;
+        for (int i = 0; i < 8; i += 1) {
+            bool mix = (crc ^ byte) & 1;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8c;
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+bool ow_rom_valid (uint64_t rom) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i += 1) {
+        bytes[i] = (uint8_t)(rom >> (8 * i));
+    }
+    // all zeros would pass the CRC, but is a bus held low
+    return rom != 0ull && ow_crc8 (bytes, 8) == 0;
+}
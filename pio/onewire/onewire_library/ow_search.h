@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _OW_SEARCH_H
+#define _OW_SEARCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bookkeeping for the 1-Wire ROM search, one pass at a time.
+// See https://www.analog.com/en/app-notes/1wire-search-algorithm.html
+//
+// Each pass is a reset, the search command, then 64 triplets: the slaves
+// still taking part send a bit of their ROM code and its complement, and the
+// master writes the direction to take. Where the slaves differ, the direction
+// comes from the preferred directions, which are known before the pass
+// starts, so the whole pass can run without stopping to work them out.
+
+typedef struct {
+    uint64_t rom;               // the ROM code found by the last pass
+    int last_discrepancy;       // the last bit where 0 was taken with the slaves differing, or -1
+    bool done;                  // no more ROM codes to find
+} ow_search_t;
+
+void ow_search_init (ow_search_t *s);
+
+// The directions to take where the slaves differ, for the next pass
+uint64_t ow_search_prefs (const ow_search_t *s);
+
+// Finishes a pass, given the bits read (a) and their complements (b).
+// Returns: false if no slave answered somewhere, or the ROM code is bad.
+bool ow_search_next (ow_search_t *s, uint64_t prefs, uint64_t a_bits, uint64_t b_bits);
+
+// Maxim/Dallas CRC8 (x^8 + x^5 + x^4 + 1), as used for ROM codes and the
+// DS18B20 scratchpad. Data with its CRC appended gives 0.
+uint8_t ow_crc8 (const uint8_t *data, uint32_t len);
+
+// Returns: true if the ROM code's last byte is the CRC of the rest.
+bool ow_rom_valid (uint64_t rom);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the 1-Wire ROM search bookkeeping and CRC8 (ow_search.h), run on
+// the host. Build with PICO_PLATFORM=host.
+//
+// Each pass is simulated as the slaves would answer it: for each triplet, the
+// bit read is the wired AND of the bits of the slaves still taking part, and
+// the complement the AND of their complements. Several sets of ROM codes are
+// searched until done, and each must be found exactly once, in search order,
+// in one pass per device. A bus held low (all zeros), an empty bus, a ROM code
+// with a bad CRC and a slave vanishing mid-pass must each fail the pass,
+// leaving the search where it was.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "ow_search.h"
+
+#define MAX_DEVICES 64
+
+static uint errors;
+
+static void check (bool ok, const char *what) {
+    if (!ok && !errors++) {
+        printf ("%s is wrong\n", what);
+    }
+}
+
+static uint64_t make_rom (uint8_t family, uint64_t serial) {
+    uint8_t bytes[7];
+    uint64_t rom = family | (serial & 0xffffffffffffull) << 8;
+    for (int i = 0; i < 7; i += 1) {
+        bytes[i] = (uint8_t)(rom >> (8 * i));
+    }
+    return rom | (uint64_t)ow_crc8 (bytes, 7) << 56;
+}
+
+// One pass: the bits read and their complements, as the slaves would send
+// them, taking the preferred direction where they differ
+static void simulate_pass (const uint64_t *roms, uint n, uint64_t prefs, uint64_t *a_bits, uint64_t *b_bits) {
+    bool active[MAX_DEVICES];
+    for (uint d = 0; d < n; d += 1) {
+        active[d] = true;
+    }
+    *a_bits = *b_bits = 0;
+    for (int i = 0; i < 64; i += 1) {
+        bool a = true, b = true;
+        for (uint d = 0; d < n; d += 1) {
+            if (active[d]) {
+                bool bit = (roms[d] >> i) & 1;
+                a = a && bit;
+                b = b && !bit;
+            }
+        }
+        bool dir = a != b ? a : (prefs >> i) & 1;
+        for (uint d = 0; d < n; d += 1) {
+            if (active[d] && ((roms[d] >> i) & 1) != dir) {
+                active[d] = false;
+            }
+        }
+        *a_bits |= (uint64_t)a << i;
+        *b_bits |= (uint64_t)b << i;
+    }
+}
+
+// The search takes 0 first, from bit 0 up, so finds the codes in order of
+// their bits reversed
+static uint64_t reverse_bits (uint64_t x) {
+    uint64_t r = 0;
+    for (int i = 0; i < 64; i += 1) {
+        r = r << 1 | ((x >> i) & 1);
+    }
+    return r;
+}
+
+static int compare_search_order (const void *p, const void *q) {
+    uint64_t x = reverse_bits (*(const uint64_t *)p), y = reverse_bits (*(const uint64_t *)q);
+    return x < y ? -1 : x > y;
+}
+
+// Searches until done, returning the number of passes, or -1 if one fails
+static int search_all (const uint64_t *roms, uint n, uint64_t *found) {
+    ow_search_t s;
+    ow_search_init (&s);
+    int passes = 0;
+    while (!s.done && passes <= MAX_DEVICES) {
+        uint64_t prefs = ow_search_prefs (&s), a_bits, b_bits;
+        simulate_pass (roms, n, prefs, &a_bits, &b_bits);
+        if (!ow_search_next (&s, prefs, a_bits, b_bits)) {
+            return -1;
+        }
+        found[passes] = s.rom;
+        passes += 1;
+    }
+    return passes;
+}
+
+static bool search_finds (const uint64_t *roms, uint n) {
+    uint64_t found[MAX_DEVICES + 1], expected[MAX_DEVICES];
+    if (search_all (roms, n, found) != (int)n) {
+        return false;
+    }
+    memcpy (expected, roms, n * sizeof(roms[0]));
+    qsort (expected, n, sizeof(expected[0]), compare_search_order);
+    return !memcmp (found, expected, n * sizeof(found[0]));
+}
+
+static void check_crc (void) {
+    // The example in Maxim's application note 27
+    static const uint8_t rom[8] = {0x02, 0x1c, 0xb8, 0x01, 0x00, 0x00, 0x00, 0xa2};
+    check (ow_crc8 (rom, 7) == 0xa2 && ow_crc8 (rom, 8) == 0, "CRC of the example ROM code");
+    check (ow_rom_valid (0xa200000001b81c02ull), "Example ROM code");
+    check (!ow_rom_valid (0xa200000001b81c03ull), "ROM code with a bit flipped");
+    // All zeros has a good CRC, but is a bus held low
+    static const uint8_t zeros[9];
+    check (ow_crc8 (zeros, 9) == 0 && !ow_rom_valid (0), "All zero ROM code");
+}
+
+static void check_sets (void) {
+    static uint64_t roms[MAX_DEVICES];
+
+    roms[0] = make_rom (0x28, 0x123456789abcull);
+    check (search_finds (roms, 1), "Search of a single device");
+
+    // Differing only in their first bit, and so in the CRC as well
+    roms[1] = make_rom (0x29, 0x123456789abcull);
+    check (search_finds (roms, 2), "Search of two devices differing in bit 0");
+
+    // Differing only in the last bit of the serial number
+    roms[1] = make_rom (0x28, 0x923456789abcull);
+    check (search_finds (roms, 2), "Search of two devices differing in bit 55");
+
+    // A batch of sensors with consecutive serial numbers
+    for (uint d = 0; d < 16; d += 1) {
+        roms[d] = make_rom (0x28, 0x0000000a3b00ull + d);
+    }
+    check (search_finds (roms, 16), "Search of consecutive serial numbers");
+
+    // Every combination of 6 bits
+    for (uint d = 0; d < 64; d += 1) {
+        roms[d] = make_rom (0x28, (uint64_t)(d & 7) | (uint64_t)(d >> 3) << 45);
+    }
+    check (search_finds (roms, 64), "Search of every combination of 6 bits");
+
+    for (uint set = 0; set < 200; set += 1) {
+        uint n = 1 + rand () % MAX_DEVICES;
+        for (uint d = 0; d < n; d += 1) {
+            uint64_t serial = (uint64_t)rand () << 32 ^ (uint64_t)rand () << 16 ^ (uint64_t)rand ();
+            roms[d] = make_rom (rand () % 4 ? 0x28 : 0x10, serial);
+            for (uint e = 0; e < d; e += 1) {
+                if (roms[e] == roms[d]) {
+                    d -= 1;         // try again, for a different one
+                    break;
+                }
+            }
+        }
+        if (!search_finds (roms, n)) {
+            printf ("Search of random set %u, of %u devices, failed\n", set, n);
+            errors += 1;
+            return;
+        }
+    }
+}
+
+// A failed pass leaves the search as it was, so it can be tried again
+static bool pass_fails (ow_search_t *s, uint64_t prefs, uint64_t a_bits, uint64_t b_bits) {
+    ow_search_t before = *s;
+    return !ow_search_next (s, prefs, a_bits, b_bits) && s->rom == before.rom &&
+           s->last_discrepancy == before.last_discrepancy && s->done == before.done;
+}
+
+static void check_failures (void) {
+    static uint64_t roms[4];
+    ow_search_t s;
+    uint64_t a_bits, b_bits;
+
+    // A bus held low reads zeros for every bit and complement, which would
+    // take the preferred direction everywhere
+    ow_search_init (&s);
+    check (pass_fails (&s, ow_search_prefs (&s), 0, 0), "First pass of a bus held low");
+
+    // Nobody there
+    simulate_pass (roms, 0, 0, &a_bits, &b_bits);
+    check (a_bits == ~0ull && b_bits == ~0ull, "Simulation of an empty bus");
+    check (pass_fails (&s, 0, a_bits, b_bits), "Pass of an empty bus");
+
+    // A bad CRC on the only device, and on the second of three
+    roms[0] = make_rom (0x28, 0x000000001234ull) ^ 1ull << 60;
+    check (search_all (roms, 1, roms + 3) < 0, "Search of a device with a bad CRC");
+    roms[0] = make_rom (0x28, 0x000000001234ull);
+    roms[1] = make_rom (0x28, 0x000000001235ull) ^ 1ull << 60;
+    roms[2] = make_rom (0x28, 0x000000001236ull);
+    qsort (roms, 3, sizeof(roms[0]), compare_search_order);
+    ow_search_init (&s);
+    uint passes = 0;
+    for (;;) {
+        uint64_t prefs = ow_search_prefs (&s);
+        simulate_pass (roms, 3, prefs, &a_bits, &b_bits);
+        bool bad = !ow_rom_valid (roms[passes]);
+        if (bad) {
+            check (pass_fails (&s, prefs, a_bits, b_bits), "Pass finding a bad CRC");
+            break;
+        }
+        check (ow_search_next (&s, prefs, a_bits, b_bits) && s.rom == roms[passes], "Pass before a bad CRC");
+        passes += 1;
+    }
+    check (passes < 3, "Passes before a bad CRC");
+
+    // The bus held low part way through a pass, and a slave dropping out
+    // so nobody answers a triplet
+    roms[0] = make_rom (0x28, 0x00000000abcdull);
+    roms[1] = make_rom (0x28, 0x00000000abceull);
+    ow_search_init (&s);
+    simulate_pass (roms, 2, 0, &a_bits, &b_bits);
+    check (pass_fails (&s, 0, a_bits & 0xffffffffull, b_bits & 0xffffffffull), "Pass with the bus held low");
+    check (pass_fails (&s, 0, a_bits | 1ull << 40, b_bits | 1ull << 40), "Pass with a slave dropping out");
+    // The same pass then succeeds
+    check (ow_search_next (&s, 0, a_bits, b_bits) && !s.done && s.last_discrepancy >= 0, "Pass after failures");
+}
+
+int main() {
+    printf ("1-Wire ROM search host tests\n");
+    check_crc ();
+    check_sets ();
+    check_failures ();
+    printf (errors ? "FAILED\n" : "All ROM search checks passed\n");
+    return errors != 0;
+}
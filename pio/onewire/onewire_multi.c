@@ -0,0 +1,333 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "onewire_library.h"    // onewire library functions
+#include "ow_rom.h"             // onewire ROM command codes
+#include "ds18b20.h"            // ds18b20 function codes
+#include "pio_onewire_multi.h"
+#include "ow_sensors.h"
+#include "ow_bus_sim.h"
+
+// The pio_onewire example reads its DS18B20s one bus, and one byte, at a
+// time. Every sensor converts at once, but then the 750ms conversion and
+// about 12ms a sensor to read it back are spent waiting on the one bus.
+// Spreading the sensors over several buses, one per state machine, lets
+// every bus search, convert and read at the same time, so with 8 buses
+// there are 8 times as many readings a second.
+//
+// At startup, simulated buses have devices unplugged, plugged in and
+// corrupted under the search and the conversions, and a table is printed of
+// sensors read a second by number of buses and sensors per bus. The real
+// buses are GPIO 8 to 15 (so the pio_onewire wiring on GPIO 15 is bus 7):
+// they are searched, then read one bus at a time and all at once.
+
+#define PIN_BASE 8
+#define N_BUSES 8
+
+#define N_SIM_BUSES OW_SENSORS_MAX_BUSES
+#define SIM_SENSORS_PER_BUS 8
+#define SIM_MAX_PER_BUS OW_SENSORS_MAX_PER_BUS
+#define SIM_CONVERT_NS 750000000u
+#define SIM_OVERHEAD_NS 20000
+
+static ow_txn_queue_t sim_queues[N_SIM_BUSES];
+static ow_bus_sim_t sims[N_SIM_BUSES];
+// one more device than will fit on a bus, to plug in later
+static ow_sim_device_t sim_devices[N_SIM_BUSES][SIM_MAX_PER_BUS + 1];
+static uint n_sim_buses;
+
+// DS18B20s with serial numbers spread out, so the searches branch all
+// over, each reading something different, some below zero
+static void init_sim_buses (uint n_buses, uint per_bus) {
+    n_sim_buses = n_buses;
+    for (uint b = 0; b < n_buses; b += 1) {
+        memset (sim_devices[b], 0, sizeof (sim_devices[b]));
+        for (uint s = 0; s <= per_bus; s += 1) {
+            ow_sim_device_t *dev = &sim_devices[b][s];
+            dev->rom = ow_bus_sim_rom (0x28, (b * 0x9e3779b1u + s * 0x7f4a7c15u) ^ (uint64_t)s << 40);
+            dev->temp = (int16_t)((b * 16 + s) * 8 - 200);
+            dev->present = s < per_bus;
+        }
+        ow_bus_sim_init (&sims[b], &sim_queues[b], sim_devices[b], per_bus + 1, SIM_CONVERT_NS, SIM_OVERHEAD_NS);
+    }
+}
+
+// All the buses move on together, to whenever the next transaction finishes
+static void sim_wait (__unused void *ctx) {
+    uint64_t next_ns = sims[0].now_ns + 1000000;
+    for (uint b = 0; b < n_sim_buses; b += 1) {
+        if (sims[b].active && sims[b].finish_ns < next_ns) {
+            next_ns = sims[b].finish_ns;
+        }
+    }
+    uint64_t ns = next_ns > sims[0].now_ns ? next_ns - sims[0].now_ns : 0;
+    for (uint b = 0; b < n_sim_buses; b += 1) {
+        ow_bus_sim_advance (&sims[b], ns);
+    }
+}
+
+static void init_sim_sensors (ow_sensors_t *s, uint n_buses) {
+    ow_txn_queue_t *queues[N_SIM_BUSES];
+    for (uint b = 0; b < n_buses; b += 1) {
+        queues[b] = &sim_queues[b];
+    }
+    ow_sensors_init (s, queues, n_buses, sim_wait, NULL);
+}
+
+static const ow_sim_device_t *find_device (uint bus, uint64_t rom) {
+    for (uint i = 0; i < sims[bus].n_devices; i += 1) {
+        if (sim_devices[bus][i].rom == rom) {
+            return &sim_devices[bus][i];
+        }
+    }
+    return NULL;
+}
+
+// Each bus must list the devices present, in order, and nothing else
+static bool roms_match (const ow_sensors_t *s) {
+    for (uint b = 0; b < n_sim_buses; b += 1) {
+        const ow_sensors_bus_t *bus = &s->buses[b];
+        uint present = 0;
+        for (uint i = 0; i < sims[b].n_devices; i += 1) {
+            present += sim_devices[b][i].present;
+        }
+        if (bus->n_roms != present) {
+            printf ("Bus %u: found %u devices, expected %u\n", b, (uint)bus->n_roms, present);
+            return false;
+        }
+        for (uint i = 0; i < bus->n_roms; i += 1) {
+            const ow_sim_device_t *dev = find_device (b, bus->roms[i]);
+            if (!dev || !dev->present || (i && bus->roms[i - 1] >= bus->roms[i])) {
+                printf ("Bus %u: ROM code %u is wrong\n", b, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Every device which is present, and isn't corrupt, must give its reading,
+// and nothing else may
+static bool temps_match (const ow_sensors_t *s) {
+    for (uint b = 0; b < n_sim_buses; b += 1) {
+        for (uint i = 0; i < s->buses[b].n_roms; i += 1) {
+            const ow_sim_device_t *dev = find_device (b, s->buses[b].roms[i]);
+            bool expect = dev->present && !dev->corrupt;
+            if (ow_sensors_valid (s, b, i) != expect || (expect && ow_sensors_temp (s, b, i) != dev->temp)) {
+                printf ("Bus %u sensor %u: reading is wrong\n", b, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool check_sensors (void) {
+    static ow_sensors_t s;
+    init_sim_buses (N_SIM_BUSES, SIM_SENSORS_PER_BUS);
+    init_sim_sensors (&s, N_SIM_BUSES);
+
+    uint64_t start_ns = sims[0].now_ns;
+    if (ow_sensors_search (&s) != N_SIM_BUSES || !roms_match (&s)) {
+        return false;
+    }
+    printf ("Searched %u buses of %u devices in %u ms\n", N_SIM_BUSES, SIM_SENSORS_PER_BUS,
+            (uint)((sims[0].now_ns - start_ns) / 1000000));
+    if (ow_sensors_convert (&s) != N_SIM_BUSES * SIM_SENSORS_PER_BUS || !temps_match (&s)) {
+        return false;
+    }
+    // nothing has changed
+    if (ow_sensors_search (&s) != 0 || s.buses[0].generation != 1) {
+        printf ("Second search found changes\n");
+        return false;
+    }
+
+    // unplug one, plug one in, and break one
+    sim_devices[3][2].present = false;
+    sim_devices[5][SIM_SENSORS_PER_BUS].present = true;
+    sim_devices[7][1].corrupt = true;
+    for (uint i = 0; i < OW_SENSORS_MAX_MISSES; i += 1) {
+        ow_sensors_convert (&s);
+        if (!temps_match (&s)) {
+            return false;
+        }
+    }
+    if (!ow_sensors_needs_search (&s) || s.crc_errors != OW_SENSORS_MAX_MISSES) {
+        printf ("Missing and corrupt sensors not seen\n");
+        return false;
+    }
+    if (ow_sensors_search (&s) != 2 || !s.buses[3].changed || !s.buses[5].changed || !roms_match (&s)) {
+        printf ("Changes not found\n");
+        return false;
+    }
+    sim_devices[7][1].corrupt = false;
+    ow_sensors_convert (&s);
+    if (!temps_match (&s) || ow_sensors_needs_search (&s)) {
+        return false;
+    }
+
+    // every bus as full as it can be, and one more device on bus 0
+    init_sim_buses (N_SIM_BUSES, SIM_MAX_PER_BUS);
+    sim_devices[0][SIM_MAX_PER_BUS].present = true;
+    ow_sensors_search (&s);
+    if (!s.buses[0].overflow || s.buses[0].n_roms != SIM_MAX_PER_BUS || s.buses[1].overflow || s.overflows != 1) {
+        printf ("Too many devices not seen\n");
+        return false;
+    }
+    for (uint b = 0; b < N_SIM_BUSES; b += 1) {
+        if (sims[b].errors) {
+            printf ("Bus %u: %u bus errors\n", b, (uint)sims[b].errors);
+            return false;
+        }
+    }
+    return s.failed_searches == 0;
+}
+
+// Returns: sensors read a second, over all the buses
+static uint32_t sim_sensors_per_sec (uint n_buses, uint per_bus) {
+    static ow_sensors_t s;
+    init_sim_buses (n_buses, per_bus);
+    init_sim_sensors (&s, n_buses);
+    ow_sensors_search (&s);
+    uint64_t start_ns = sims[0].now_ns;
+    uint32_t reads = 0;
+    for (uint i = 0; i < 4; i += 1) {
+        reads += ow_sensors_convert (&s);
+    }
+    return (uint32_t)(reads * 1000000000ull / (sims[0].now_ns - start_ns));
+}
+
+// The pio_onewire example's loop, for each bus in turn
+static uint read_one_bus_at_a_time (OW *ows, const ow_sensors_t *s) {
+    uint n_read = 0;
+    for (uint b = 0; b < s->n_buses; b += 1) {
+        OW *ow = &ows[b];
+        const ow_sensors_bus_t *bus = &s->buses[b];
+        if (!bus->n_roms || !ow_reset (ow)) {
+            continue;
+        }
+        ow_send (ow, OW_SKIP_ROM);
+        ow_send (ow, DS18B20_CONVERT_T);
+        while (ow_read (ow) == 0);
+        for (uint i = 0; i < bus->n_roms; i += 1) {
+            uint8_t scratchpad[9];
+            ow_reset (ow);
+            ow_send (ow, OW_MATCH_ROM);
+            for (int bit = 0; bit < 64; bit += 8) {
+                ow_send (ow, bus->roms[i] >> bit);
+            }
+            ow_send (ow, DS18B20_READ_SCRATCHPAD);
+            for (int j = 0; j < 9; j += 1) {
+                scratchpad[j] = ow_read (ow);
+            }
+            n_read += ow_crc8 (scratchpad, 9) == 0;
+        }
+    }
+    return n_read;
+}
+
+static void print_roms (const ow_sensors_t *s) {
+    for (uint b = 0; b < s->n_buses; b += 1) {
+        const ow_sensors_bus_t *bus = &s->buses[b];
+        if (bus->changed) {
+            printf ("Bus %u (GPIO %u), %u devices:\n", b, PIN_BASE + b, (uint)bus->n_roms);
+            for (uint i = 0; i < bus->n_roms; i += 1) {
+                printf ("\t%u: 0x%llx\n", i, bus->roms[i]);
+            }
+            if (bus->overflow) {
+                printf ("\tmore devices than the %u which fit\n", OW_SENSORS_MAX_PER_BUS);
+            }
+        }
+    }
+}
+
+static void service (void *ctx) {
+    pio_onewire_multi_service (ctx);
+}
+
+int main() {
+    stdio_init_all();
+    printf ("\nPIO 1-Wire multi-bus example\n");
+
+    printf ("Search and conversion against %u simulated buses: %s\n", N_SIM_BUSES,
+            check_sensors () ? "OK" : "Nope");
+
+    // with 1 bus, this is as fast as the pio_onewire example goes
+    static const uint n_buses[] = {1, 2, 4, 8, 12};
+    static const uint per_bus[] = {1, 4, 8, 16};
+    printf ("\nSimulated sensors read a second, over all buses\n");
+    printf ("per bus");
+    for (uint n = 0; n < count_of (n_buses); n += 1) {
+        printf ("  %2u bus%s", n_buses[n], n_buses[n] == 1 ? " " : "es");
+    }
+    printf ("\n");
+    for (uint p = 0; p < count_of (per_bus); p += 1) {
+        printf ("%7u", per_bus[p]);
+        for (uint n = 0; n < count_of (n_buses); n += 1) {
+            printf (" %8u", (uint)sim_sensors_per_sec (n_buses[n], per_bus[p]));
+        }
+        printf ("\n");
+    }
+
+    // four buses per PIO, all running the same program
+    static OW ows[N_BUSES];
+    static pio_onewire_multi_t multi;
+    pio_onewire_multi_init (&multi);
+    ow_txn_queue_t *queues[N_BUSES];
+    for (uint b = 0; b < N_BUSES; b += 1) {
+        PIO pio = pio_get_instance (b / NUM_PIO_STATE_MACHINES);
+        static uint offset;
+        if (b % NUM_PIO_STATE_MACHINES == 0) {
+            offset = pio_add_program (pio, &onewire_program);
+        }
+        if (!ow_init (&ows[b], pio, offset, PIN_BASE + b)) {
+            puts ("could not initialise the driver");
+            return 0;
+        }
+        queues[b] = pio_onewire_multi_add_bus (&multi, &ows[b]);
+    }
+    static ow_sensors_t sensors;
+    ow_sensors_init (&sensors, queues, N_BUSES, service, &multi);
+
+    uint64_t start = time_us_64 ();
+    ow_sensors_search (&sensors);
+    printf ("\nSearched %u buses in %u ms\n", N_BUSES, (uint)((time_us_64 () - start) / 1000));
+    print_roms (&sensors);
+
+    start = time_us_64 ();
+    uint n_read = read_one_bus_at_a_time (ows, &sensors);
+    uint32_t one_at_a_time_ms = (uint32_t)((time_us_64 () - start) / 1000);
+    start = time_us_64 ();
+    uint n_read_together = ow_sensors_convert (&sensors);
+    uint32_t together_ms = (uint32_t)((time_us_64 () - start) / 1000);
+    printf ("One bus at a time: %u sensors in %u ms. All buses at once: %u sensors in %u ms\n",
+            n_read, (uint)one_at_a_time_ms, n_read_together, (uint)together_ms);
+
+    // look for new devices now and then, and straight away if one goes
+    // missing
+    for (uint round = 1; ; round += 1) {
+        if (round % 10 == 0 || ow_sensors_needs_search (&sensors)) {
+            if (ow_sensors_search (&sensors)) {
+                print_roms (&sensors);
+            }
+        }
+        ow_sensors_convert (&sensors);
+        for (uint b = 0; b < N_BUSES; b += 1) {
+            for (uint i = 0; i < sensors.buses[b].n_roms; i += 1) {
+                if (ow_sensors_valid (&sensors, b, i)) {
+                    printf ("\t%u.%u: %f", b, i, ow_sensors_temp (&sensors, b, i) / 16.0);
+                } else {
+                    printf ("\t%u.%u: -", b, i);
+                }
+            }
+        }
+        printf ("\n");
+    }
+}
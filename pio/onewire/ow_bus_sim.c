@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "ow_bus_sim.h"
+#include "ow_rom.h"
+#include "ds18b20.h"
+#include "ow_search.h"
+
+// What the devices expect next
+enum {
+    SIM_IDLE,                   // a reset
+    SIM_ROM_COMMAND,
+    SIM_MATCH,                  // the rest of the ROM code
+    SIM_SEARCH,                 // triplets
+    SIM_FUNCTION,
+    SIM_CONVERTING,             // read slots, to see if the conversion is done
+    SIM_READING,                // read slots, for the scratchpad
+};
+
+uint64_t ow_bus_sim_rom (uint8_t family, uint64_t serial) {
+    uint8_t bytes[7];
+    uint64_t rom = family | (serial & 0xffffffffffffull) << 8;
+    for (int i = 0; i < 7; i += 1) {
+        bytes[i] = (uint8_t)(rom >> (8 * i));
+    }
+    return rom | (uint64_t)ow_crc8 (bytes, 7) << 56;
+}
+
+static void settle (ow_sim_device_t *dev, uint64_t t_ns) {
+    if (dev->converting && t_ns >= dev->convert_done_ns) {
+        dev->reading = dev->temp;
+        dev->converting = false;
+        dev->conversions++;
+    }
+}
+
+static void fill_scratchpad (ow_sim_device_t *dev) {
+    uint8_t *sp = dev->scratchpad;
+    sp[0] = (uint8_t)dev->reading;
+    sp[1] = (uint8_t)((uint16_t)dev->reading >> 8);
+    sp[2] = 0x4b;               // TH and TL, as they come
+    sp[3] = 0x46;
+    sp[4] = 0x7f;               // 12-bit resolution
+    sp[5] = 0xff;
+    sp[6] = 0x0c;
+    sp[7] = 0x10;
+    sp[8] = ow_crc8 (sp, 8);
+    if (dev->corrupt) {
+        sp[0] ^= 1;
+    }
+    dev->scratchpad_reads++;
+}
+
+static uint64_t present_devices (const ow_bus_sim_t *sim) {
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+        if (sim->devices[i].present) {
+            mask |= 1ull << i;
+        }
+    }
+    return mask;
+}
+
+static void write_byte (ow_bus_sim_t *sim, uint8_t byte, uint64_t t_ns) {
+    switch (sim->state) {
+    case SIM_ROM_COMMAND:
+        if (byte == OW_SKIP_ROM) {
+            sim->state = SIM_FUNCTION;
+        } else if (byte == OW_MATCH_ROM) {
+            sim->match_rom = 0;
+            sim->match_count = 0;
+            sim->state = SIM_MATCH;
+        } else if (byte == OW_SEARCH_ROM) {
+            sim->state = SIM_SEARCH;
+        } else {
+            sim->errors++;
+            sim->state = SIM_IDLE;
+        }
+        break;
+    case SIM_MATCH:
+        sim->match_rom |= (uint64_t)byte << (8 * sim->match_count++);
+        if (sim->match_count == 8) {
+            for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+                if (sim->devices[i].rom != sim->match_rom) {
+                    sim->selected &= ~(1ull << i);
+                }
+            }
+            sim->state = SIM_FUNCTION;
+        }
+        break;
+    case SIM_FUNCTION:
+        if (byte == DS18B20_CONVERT_T) {
+            for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+                if (sim->selected & (1ull << i)) {
+                    ow_sim_device_t *dev = &sim->devices[i];
+                    settle (dev, t_ns);
+                    dev->converting = true;
+                    dev->convert_done_ns = t_ns + sim->convert_ns;
+                }
+            }
+            sim->state = SIM_CONVERTING;
+        } else if (byte == DS18B20_READ_SCRATCHPAD) {
+            for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+                if (sim->selected & (1ull << i)) {
+                    settle (&sim->devices[i], t_ns);
+                    fill_scratchpad (&sim->devices[i]);
+                }
+            }
+            sim->sp_index = 0;
+            sim->state = SIM_READING;
+        } else {
+            sim->errors++;
+            sim->state = SIM_IDLE;
+        }
+        break;
+    default:
+        // nobody is listening until the next reset
+        sim->errors++;
+        break;
+    }
+}
+
+// Whoever pulls the bus low wins
+static uint8_t read_byte (ow_bus_sim_t *sim, uint64_t t_ns) {
+    uint8_t byte = 0xff;
+    for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+        if ((sim->selected & (1ull << i)) == 0) {
+            continue;
+        }
+        ow_sim_device_t *dev = &sim->devices[i];
+        if (sim->state == SIM_CONVERTING) {
+            settle (dev, t_ns);
+            if (dev->converting) {
+                byte = 0;
+            }
+        } else if (sim->state == SIM_READING && sim->sp_index < 9) {
+            byte &= dev->scratchpad[sim->sp_index];
+        }
+    }
+    if (sim->state == SIM_READING) {
+        sim->sp_index++;
+    }
+    return byte;
+}
+
+// As the triplet code in onewire_library.pio does it
+static void search (ow_bus_sim_t *sim, uint64_t prefs) {
+    if (sim->state != SIM_SEARCH) {
+        sim->errors++;
+    }
+    sim->a_bits = 0;
+    sim->b_bits = 0;
+    for (int bit = 0; bit < 64; bit += 1) {
+        bool a = true;
+        bool b = true;
+        for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+            if (sim->state == SIM_SEARCH && (sim->selected & (1ull << i))) {
+                bool rom_bit = (sim->devices[i].rom >> bit) & 1;
+                a &= rom_bit;
+                b &= !rom_bit;
+            }
+        }
+        bool dir = (!a && !b) ? (prefs >> bit) & 1 : a;
+        for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+            if (((sim->devices[i].rom >> bit) & 1) != dir) {
+                sim->selected &= ~(1ull << i);
+            }
+        }
+        sim->a_bits |= (uint64_t)a << bit;
+        sim->b_bits |= (uint64_t)b << bit;
+    }
+    sim->state = SIM_IDLE;
+}
+
+static void sim_start (void *ctx, ow_txn_t *txn) {
+    ow_bus_sim_t *sim = ctx;
+    uint64_t start_ns = sim->finish_ns > sim->now_ns ? sim->finish_ns : sim->now_ns;
+    uint64_t t_ns = start_ns + sim->overhead_ns;
+    sim->result = OW_TXN_OK;
+    if (txn->reset) {
+        t_ns += OW_SIM_RESET_NS;
+        sim->selected = present_devices (sim);
+        sim->state = SIM_ROM_COMMAND;
+        if (!sim->selected) {
+            sim->state = SIM_IDLE;
+            sim->result = OW_TXN_NO_PRESENCE;
+        }
+    }
+    if (sim->result == OW_TXN_OK) {
+        for (uint32_t i = 0; i < txn->tx_len; i += 1) {
+            t_ns += 8 * OW_SIM_SLOT_NS;
+            write_byte (sim, txn->tx[i], t_ns);
+        }
+        if (txn->search) {
+            search (sim, txn->prefs);
+            t_ns += 64ull * OW_SIM_TRIPLET_NS + 2 * OW_SIM_SLOT_NS;
+        }
+        for (uint32_t i = 0; i < txn->rx_len; i += 1) {
+            t_ns += 8 * OW_SIM_SLOT_NS;
+            sim->rx[i] = read_byte (sim, t_ns);
+        }
+    }
+    sim->active = txn;
+    sim->finish_ns = t_ns;
+}
+
+// The simulation is single threaded, so there is nothing to lock out
+static uint32_t sim_lock (void *ctx) {
+    (void)ctx;
+    return 0;
+}
+
+static void sim_unlock (void *ctx, uint32_t saved) {
+    (void)ctx;
+    (void)saved;
+}
+
+void ow_bus_sim_init (ow_bus_sim_t *sim, ow_txn_queue_t *q, ow_sim_device_t *devices, uint32_t n_devices,
+                      uint32_t convert_ns, uint32_t overhead_ns) {
+    memset (sim, 0, sizeof (*sim));
+    sim->queue = q;
+    sim->devices = devices;
+    sim->n_devices = n_devices > OW_BUS_SIM_MAX_DEVICES ? OW_BUS_SIM_MAX_DEVICES : n_devices;
+    sim->convert_ns = convert_ns;
+    sim->overhead_ns = overhead_ns;
+    sim->state = SIM_IDLE;
+    for (uint32_t i = 0; i < sim->n_devices; i += 1) {
+        devices[i].reading = 85 * 16;
+        devices[i].converting = false;
+    }
+    ow_txn_backend_t backend = {
+        .start = sim_start,
+        .lock = sim_lock,
+        .unlock = sim_unlock,
+        .ctx = sim,
+    };
+    ow_txn_queue_init (q, &backend);
+}
+
+void ow_bus_sim_advance (ow_bus_sim_t *sim, uint64_t ns) {
+    uint64_t end_ns = sim->now_ns + ns;
+    while (sim->active && sim->finish_ns <= end_ns) {
+        ow_txn_t *txn = sim->active;
+        sim->now_ns = sim->finish_ns;
+        sim->active = NULL;
+        if (sim->result == OW_TXN_OK) {
+            if (txn->rx_len) {
+                memcpy (txn->rx, sim->rx, txn->rx_len);
+            }
+            txn->a_bits = sim->a_bits;
+            txn->b_bits = sim->b_bits;
+        }
+        // this may start the next transaction
+        ow_txn_queue_complete (sim->queue, sim->result);
+    }
+    sim->now_ns = end_ns;
+}
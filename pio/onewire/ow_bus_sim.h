@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _OW_BUS_SIM_H
+#define _OW_BUS_SIM_H
+
+#include "ow_txn.h"
+
+// A 1-Wire bus with simulated DS18B20s on it, on the far end of an
+// ow_txn_queue_t, in place of pio_onewire_multi.
+//
+// The devices follow the ROM and function commands a byte at a time: Skip
+// ROM, Match ROM and Search ROM, then Convert T and Read Scratchpad. The bus
+// is wired-AND, so in a search the slaves still taking part each send their
+// bit and its complement, and drop out if the master writes the other value.
+// A conversion takes convert_ns, during which read slots give 0, and the
+// scratchpad holds the last reading with its CRC. Devices can be added and
+// removed (present), or made to send a bad CRC (corrupt). Anything a device
+// wouldn't expect (a command without a reset first, or an unknown one) is
+// counted in errors.
+//
+// Like the simulated I2C bus in pio/i2c, time only moves on in
+// ow_bus_sim_advance(). The slots take as long as the onewire program makes
+// them: 71us for each bit of a byte, 217us for each triplet, 960us for a
+// reset, and each transaction overhead_ns more, for the processor.
+
+#define OW_BUS_SIM_MAX_DEVICES 64
+
+#define OW_SIM_SLOT_NS 71000
+#define OW_SIM_TRIPLET_NS 217000
+#define OW_SIM_RESET_NS 960000
+
+typedef struct {
+    uint64_t rom;
+    int16_t temp;               // what the next conversion reads, in 1/16 degrees C
+    bool present;
+    bool corrupt;
+    // the last conversion (85 degrees C at power on)
+    int16_t reading;
+    bool converting;
+    uint64_t convert_done_ns;
+    uint8_t scratchpad[9];
+    uint32_t conversions;
+    uint32_t scratchpad_reads;
+} ow_sim_device_t;
+
+typedef struct {
+    ow_txn_queue_t *queue;
+    ow_sim_device_t *devices;
+    uint32_t n_devices;
+    uint32_t convert_ns;
+    uint32_t overhead_ns;
+    ow_txn_t *active;
+    int result;
+    uint64_t now_ns;
+    uint64_t finish_ns;
+    // what the devices expect next, and which of them are listening
+    int state;
+    uint64_t selected;
+    uint64_t match_rom;
+    uint32_t match_count;
+    uint32_t sp_index;
+    uint8_t rx[OW_TXN_MAX_LEN];
+    uint64_t a_bits;
+    uint64_t b_bits;
+    uint32_t errors;
+} ow_bus_sim_t;
+
+// A valid ROM code: the family code, a 48-bit serial number and the CRC
+uint64_t ow_bus_sim_rom (uint8_t family, uint64_t serial);
+
+void ow_bus_sim_init (ow_bus_sim_t *sim, ow_txn_queue_t *q, ow_sim_device_t *devices, uint32_t n_devices,
+                      uint32_t convert_ns, uint32_t overhead_ns);
+
+// Move time on, completing any transactions which finish in that time
+void ow_bus_sim_advance (ow_bus_sim_t *sim, uint64_t ns);
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "ow_sensors.h"
+#include "ow_rom.h"
+#include "ds18b20.h"
+
+static const uint8_t search_cmd[] = {OW_SEARCH_ROM};
+static const uint8_t convert_cmd[] = {OW_SKIP_ROM, DS18B20_CONVERT_T};
+
+void ow_sensors_init (ow_sensors_t *s, ow_txn_queue_t *const *queues, uint32_t n_buses, void (*wait) (void *ctx),
+                      void *wait_ctx) {
+    memset (s, 0, sizeof (*s));
+    if (n_buses > OW_SENSORS_MAX_BUSES) {
+        n_buses = OW_SENSORS_MAX_BUSES;
+    }
+    for (uint32_t b = 0; b < n_buses; b += 1) {
+        s->buses[b].owner = s;
+        s->buses[b].queue = queues[b];
+    }
+    s->n_buses = n_buses;
+    s->wait = wait;
+    s->wait_ctx = wait_ctx;
+}
+
+static void wait_for_buses (ow_sensors_t *s) {
+    while (s->pending) {
+        s->wait (s->wait_ctx);
+    }
+}
+
+static void finish_search (ow_sensors_bus_t *bus, bool ok) {
+    if (!ok) {
+        bus->owner->failed_searches++;
+    } else {
+        // keep the ROM codes in order, so the same devices give the same list
+        for (uint32_t i = 1; i < bus->n_found; i += 1) {
+            uint64_t rom = bus->found[i];
+            uint32_t j = i;
+            for (; j > 0 && bus->found[j - 1] > rom; j -= 1) {
+                bus->found[j] = bus->found[j - 1];
+            }
+            bus->found[j] = rom;
+        }
+        if (bus->n_found != bus->n_roms || memcmp (bus->found, bus->roms, bus->n_found * sizeof (uint64_t))) {
+            memcpy (bus->roms, bus->found, bus->n_found * sizeof (uint64_t));
+            bus->n_roms = bus->n_found;
+            bus->generation++;
+            bus->changed = true;
+            memset (bus->valid, 0, sizeof (bus->valid));
+        }
+        memset (bus->misses, 0, sizeof (bus->misses));
+        bus->needs_search = false;
+        bus->owner->searches++;
+    }
+    bus->owner->pending--;
+}
+
+static void search_done (ow_txn_t *txn);
+
+static void search_pass (ow_sensors_bus_t *bus) {
+    bus->txn = (ow_txn_t) {
+        .reset = true,
+        .tx = search_cmd,
+        .tx_len = sizeof (search_cmd),
+        .search = true,
+        .prefs = ow_search_prefs (&bus->search),
+        .on_done = search_done,
+        .user = bus,
+    };
+    if (!ow_txn_submit (bus->queue, &bus->txn)) {
+        finish_search (bus, false);
+    }
+}
+
+// Each bus has one search pass at a time, and starts the next as soon as the
+// last one is done
+static void search_done (ow_txn_t *txn) {
+    ow_sensors_bus_t *bus = txn->user;
+    if (txn->result == OW_TXN_NO_PRESENCE) {
+        // nothing on the bus, unless something has just gone
+        finish_search (bus, bus->n_found == 0);
+    } else if (!ow_search_next (&bus->search, txn->prefs, txn->a_bits, txn->b_bits)) {
+        finish_search (bus, false);
+    } else {
+        bus->found[bus->n_found++] = bus->search.rom;
+        if (!bus->search.done && bus->n_found == OW_SENSORS_MAX_PER_BUS) {
+            // more devices than we have room for: keep the first ones
+            bus->overflow = true;
+            bus->owner->overflows++;
+            finish_search (bus, true);
+        } else if (bus->search.done) {
+            finish_search (bus, true);
+        } else {
+            search_pass (bus);
+        }
+    }
+}
+
+uint32_t ow_sensors_search (ow_sensors_t *s) {
+    s->pending = s->n_buses;
+    for (uint32_t b = 0; b < s->n_buses; b += 1) {
+        ow_sensors_bus_t *bus = &s->buses[b];
+        bus->changed = false;
+        bus->overflow = false;
+        bus->n_found = 0;
+        ow_search_init (&bus->search);
+        search_pass (bus);
+    }
+    wait_for_buses (s);
+
+    uint32_t changed = 0;
+    for (uint32_t b = 0; b < s->n_buses; b += 1) {
+        changed += s->buses[b].changed;
+    }
+    return changed;
+}
+
+static void missed (ow_sensors_bus_t *bus, uint32_t i) {
+    bus->valid[i] = false;
+    bus->owner->failed_reads++;
+    if (bus->misses[i] < OW_SENSORS_MAX_MISSES) {
+        bus->misses[i]++;
+    }
+    if (bus->misses[i] == OW_SENSORS_MAX_MISSES) {
+        bus->needs_search = true;
+    }
+}
+
+static bool all_bytes (const uint8_t *data, uint32_t len, uint8_t value) {
+    while (len--) {
+        if (*data++ != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void read_done (ow_txn_t *txn) {
+    ow_sensors_bus_t *bus = txn->user;
+    uint32_t i = (uint32_t)(txn - bus->reads);
+    const uint8_t *sp = bus->scratchpads[i];
+    if (txn->result != OW_TXN_OK || all_bytes (sp, 9, 0xff)) {
+        missed (bus, i);        // nobody answered
+    } else if (all_bytes (sp, 9, 0x00) || ow_crc8 (sp, 9) != 0) {
+        // a bus held low reads all zeros, which has a good CRC
+        bus->owner->crc_errors++;
+        missed (bus, i);
+    } else {
+        bus->temps[i] = (int16_t)(sp[0] | sp[1] << 8);
+        bus->valid[i] = true;
+        bus->misses[i] = 0;
+        bus->owner->reads++;
+    }
+    if (!--bus->reads_pending) {
+        bus->owner->pending--;
+    }
+}
+
+static void start_reads (ow_sensors_bus_t *bus) {
+    bus->reads_pending = bus->n_roms;
+    for (uint32_t i = 0; i < bus->n_roms; i += 1) {
+        uint8_t *match = bus->match[i];
+        match[0] = OW_MATCH_ROM;
+        for (int b = 0; b < 8; b += 1) {
+            match[1 + b] = (uint8_t)(bus->roms[i] >> (8 * b));
+        }
+        match[9] = DS18B20_READ_SCRATCHPAD;
+        bus->reads[i] = (ow_txn_t) {
+            .reset = true,
+            .tx = match,
+            .tx_len = 10,
+            .rx = bus->scratchpads[i],
+            .rx_len = 9,
+            .on_done = read_done,
+            .user = bus,
+        };
+    }
+    // a bus starts on the first, and the queue holds the rest
+    for (uint32_t i = 0; i < bus->n_roms; i += 1) {
+        if (!ow_txn_submit (bus->queue, &bus->reads[i])) {
+            bus->reads[i].result = OW_TXN_NO_PRESENCE;
+            read_done (&bus->reads[i]);
+        }
+    }
+}
+
+static void finish_convert (ow_sensors_bus_t *bus) {
+    for (uint32_t i = 0; i < bus->n_roms; i += 1) {
+        missed (bus, i);
+    }
+    bus->owner->pending--;
+}
+
+static void poll_done (ow_txn_t *txn);
+
+static void poll (ow_sensors_bus_t *bus) {
+    bus->txn = (ow_txn_t) {
+        .rx = &bus->poll,
+        .rx_len = 1,
+        .on_done = poll_done,
+        .user = bus,
+    };
+    if (!ow_txn_submit (bus->queue, &bus->txn)) {
+        finish_convert (bus);
+    }
+}
+
+// The devices hold the bus low in read slots until they have all finished
+static void poll_done (ow_txn_t *txn) {
+    ow_sensors_bus_t *bus = txn->user;
+    if (bus->poll == 0xff) {
+        start_reads (bus);
+    } else if (++bus->polls == OW_SENSORS_MAX_POLLS) {
+        finish_convert (bus);
+    } else {
+        poll (bus);
+    }
+}
+
+static void convert_done (ow_txn_t *txn) {
+    ow_sensors_bus_t *bus = txn->user;
+    if (txn->result != OW_TXN_OK) {
+        bus->needs_search = true;
+        finish_convert (bus);
+    } else {
+        bus->polls = 0;
+        poll (bus);
+    }
+}
+
+uint32_t ow_sensors_convert (ow_sensors_t *s) {
+    uint32_t reads = s->reads;
+    s->pending = s->n_buses;
+    for (uint32_t b = 0; b < s->n_buses; b += 1) {
+        ow_sensors_bus_t *bus = &s->buses[b];
+        if (!bus->n_roms) {
+            s->pending--;
+            continue;
+        }
+        bus->txn = (ow_txn_t) {
+            .reset = true,
+            .tx = convert_cmd,
+            .tx_len = sizeof (convert_cmd),
+            .on_done = convert_done,
+            .user = bus,
+        };
+        if (!ow_txn_submit (bus->queue, &bus->txn)) {
+            finish_convert (bus);
+        }
+    }
+    wait_for_buses (s);
+    s->conversions++;
+    return s->reads - reads;
+}
+
+bool ow_sensors_needs_search (const ow_sensors_t *s) {
+    for (uint32_t b = 0; b < s->n_buses; b += 1) {
+        if (s->buses[b].needs_search) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _OW_SENSORS_H
+#define _OW_SENSORS_H
+
+#include "ow_txn.h"
+#include "ow_search.h"
+
+// Finds and reads DS18B20s spread over several 1-Wire buses, all buses at
+// once.
+//
+// Each bus is an ow_txn_queue_t, with whatever backend: pio_onewire_multi.h
+// for one state machine per bus, or ow_bus_sim.h. ow_sensors_search() runs
+// a ROM search on every bus at the same time, each pass starting as soon as
+// the last one on that bus is done, and keeps each bus's ROM codes in order.
+// If they are not the same as last time, the bus is marked changed, and its
+// generation counts up, so whoever uses the ROM codes can tell. A search
+// which goes wrong part way (e.g. a device unplugged mid-pass) leaves the
+// last good list alone. A bus with more than OW_SENSORS_MAX_PER_BUS devices
+// keeps the first ones found, and is marked overflow.
+//
+// ow_sensors_convert() then starts a conversion on every device on every
+// bus with Skip ROM and Convert T, so every sensor converts at once, and
+// polls each bus with read slots until its devices are all done. Each bus
+// then reads each of its devices' scratchpads in turn, with Match ROM,
+// checking the CRC, and that it isn't all zeros (which is what a bus held
+// low gives, and has a good CRC). The conversion takes 750ms at 12-bit
+// resolution, however many sensors and buses there are, and reading a
+// scratchpad about 12ms more, so the more buses the sensors are spread
+// over, the more of them are read a second. A sensor which doesn't answer, or sends a bad
+// CRC, is marked not valid, and if that happens OW_SENSORS_MAX_MISSES times
+// in a row ow_sensors_needs_search() says so.
+//
+// Whilst waiting, the wait function is called over and over, to service the
+// buses (or move simulated time on).
+
+#define OW_SENSORS_MAX_BUSES 12
+// every scratchpad read is queued at once
+#define OW_SENSORS_MAX_PER_BUS (OW_TXN_QUEUE_LEN + 1)
+// about a second of polling
+#define OW_SENSORS_MAX_POLLS 2000
+#define OW_SENSORS_MAX_MISSES 2
+
+typedef struct ow_sensors ow_sensors_t;
+
+typedef struct {
+    ow_sensors_t *owner;
+    ow_txn_queue_t *queue;
+    // the ROM codes found by the last good search, in order
+    uint64_t roms[OW_SENSORS_MAX_PER_BUS];
+    uint32_t n_roms;
+    uint32_t generation;
+    bool changed;
+    // the last search found more devices than there is room for
+    bool overflow;
+    // searching
+    ow_search_t search;
+    uint64_t found[OW_SENSORS_MAX_PER_BUS];
+    uint32_t n_found;
+    // converting and polling, or a search pass
+    ow_txn_t txn;
+    uint8_t poll;
+    uint32_t polls;
+    // reading the scratchpads
+    ow_txn_t reads[OW_SENSORS_MAX_PER_BUS];
+    uint8_t match[OW_SENSORS_MAX_PER_BUS][10];
+    uint8_t scratchpads[OW_SENSORS_MAX_PER_BUS][9];
+    uint32_t reads_pending;
+    // the last reading of each device, in 1/16 degrees C
+    int16_t temps[OW_SENSORS_MAX_PER_BUS];
+    bool valid[OW_SENSORS_MAX_PER_BUS];
+    uint8_t misses[OW_SENSORS_MAX_PER_BUS];
+    bool needs_search;
+} ow_sensors_bus_t;
+
+struct ow_sensors {
+    ow_sensors_bus_t buses[OW_SENSORS_MAX_BUSES];
+    uint32_t n_buses;
+    // buses not yet done
+    volatile uint32_t pending;
+    void (*wait) (void *ctx);
+    void *wait_ctx;
+    uint32_t searches;
+    uint32_t failed_searches;
+    uint32_t overflows;
+    uint32_t conversions;
+    uint32_t reads;
+    uint32_t failed_reads;
+    uint32_t crc_errors;
+};
+
+void ow_sensors_init (ow_sensors_t *s, ow_txn_queue_t *const *queues, uint32_t n_buses, void (*wait) (void *ctx),
+                      void *wait_ctx);
+
+// Searches every bus. Returns: the number of buses whose ROM codes changed.
+uint32_t ow_sensors_search (ow_sensors_t *s);
+
+// Converts and reads every sensor found. Returns: the number read.
+uint32_t ow_sensors_convert (ow_sensors_t *s);
+
+// Returns: true if a sensor has been missing for a while, or a bus has
+// stopped answering.
+bool ow_sensors_needs_search (const ow_sensors_t *s);
+
+static inline bool ow_sensors_valid (const ow_sensors_t *s, uint32_t bus, uint32_t sensor) {
+    return sensor < s->buses[bus].n_roms && s->buses[bus].valid[sensor];
+}
+
+static inline int16_t ow_sensors_temp (const ow_sensors_t *s, uint32_t bus, uint32_t sensor) {
+    return s->buses[bus].temps[sensor];
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "ow_txn.h"
+
+void ow_txn_queue_init (ow_txn_queue_t *q, const ow_txn_backend_t *backend) {
+    memset (q, 0, sizeof (*q));
+    q->backend = *backend;
+}
+
+bool ow_txn_submit (ow_txn_queue_t *q, ow_txn_t *txn) {
+    if (txn->tx_len > OW_TXN_MAX_LEN || txn->rx_len > OW_TXN_MAX_LEN ||
+        (txn->tx_len && !txn->tx) || (txn->rx_len && !txn->rx) || (txn->search && txn->rx_len)) {
+        return false;
+    }
+    txn->done = false;
+    txn->result = OW_TXN_PENDING;
+
+    uint32_t saved = q->backend.lock (q->backend.ctx);
+    bool ok = true;
+    if (!q->current) {
+        q->current = txn;
+        q->backend.start (q->backend.ctx, txn);
+    } else if (q->count < OW_TXN_QUEUE_LEN) {
+        q->queue[(q->head + q->count++) % OW_TXN_QUEUE_LEN] = txn;
+    } else {
+        ok = false;
+    }
+    q->backend.unlock (q->backend.ctx, saved);
+    return ok;
+}
+
+void ow_txn_queue_complete (ow_txn_queue_t *q, int result) {
+    ow_txn_t *txn = q->current;
+    if (!txn) {
+        return;
+    }
+    // start the next transaction first, so the bus is idle for as little
+    // time as possible
+    if (q->count) {
+        q->current = q->queue[q->head];
+        q->head = (q->head + 1) % OW_TXN_QUEUE_LEN;
+        q->count--;
+        q->backend.start (q->backend.ctx, q->current);
+    } else {
+        q->current = NULL;
+    }
+    q->completed++;
+    if (result != OW_TXN_OK) {
+        q->failed++;
+    }
+    txn->result = result;
+    txn->done = true;
+    if (txn->on_done) {
+        txn->on_done (txn);
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _OW_TXN_H
+#define _OW_TXN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 1-Wire transactions, and a queue to run them back to back on one bus.
+//
+// A transaction is, in order and each optional: a bus reset, bytes written,
+// then either a ROM search pass (64 triplets, see ow_search.h) or bytes read.
+// That covers everything a DS18B20 needs: e.g. reset, Skip ROM, Convert T;
+// or reset, Match ROM and the ROM code, Read Scratchpad, then 9 bytes read.
+// A search pass leaves the slaves part way into their next command, so the
+// next transaction must start with a reset.
+//
+// The queue starts each transaction as the last one finishes, and marks
+// each one done with its result, calling its on_done function, which may
+// submit the next one. The backend does the transactions: pio_onewire_multi.h
+// drives the onewire program, and ow_bus_sim.h simulates a bus with devices
+// on it.
+
+#define OW_TXN_MAX_LEN 16
+#define OW_TXN_QUEUE_LEN 16
+
+#define OW_TXN_OK 0
+#define OW_TXN_NO_PRESENCE (-1)
+#define OW_TXN_PENDING 1
+
+typedef struct ow_txn ow_txn_t;
+typedef void (*ow_txn_done_fn) (ow_txn_t *txn);
+
+struct ow_txn {
+    bool reset;
+    const uint8_t *tx;
+    uint8_t tx_len;
+    bool search;
+    uint64_t prefs;             // the directions to take where the slaves differ
+    uint8_t *rx;
+    uint8_t rx_len;
+    ow_txn_done_fn on_done;
+    void *user;
+    // the bits read by the search, and their complements
+    uint64_t a_bits;
+    uint64_t b_bits;
+    // OW_TXN_OK, or OW_TXN_NO_PRESENCE if nothing answered the reset
+    volatile int result;
+    volatile bool done;
+};
+
+typedef struct {
+    void (*start) (void *ctx, ow_txn_t *txn);
+    // keep ow_txn_queue_complete() out whilst the queue is changed
+    uint32_t (*lock) (void *ctx);
+    void (*unlock) (void *ctx, uint32_t saved);
+    void *ctx;
+} ow_txn_backend_t;
+
+typedef struct {
+    ow_txn_backend_t backend;
+    ow_txn_t *queue[OW_TXN_QUEUE_LEN];
+    uint32_t head;
+    uint32_t count;
+    ow_txn_t *current;
+    uint32_t completed;
+    uint32_t failed;
+} ow_txn_queue_t;
+
+void ow_txn_queue_init (ow_txn_queue_t *q, const ow_txn_backend_t *backend);
+
+// Returns: false if the transaction is too long or the queue is full.
+bool ow_txn_submit (ow_txn_queue_t *q, ow_txn_t *txn);
+
+// Called by the backend when the current transaction has finished
+void ow_txn_queue_complete (ow_txn_queue_t *q, int result);
+
+static inline bool ow_txn_queue_idle (const ow_txn_queue_t *q) {
+    return !*(ow_txn_t *volatile *) &q->current;
+}
+
+#endif
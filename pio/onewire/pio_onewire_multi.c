@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pio_onewire_multi.h"
+
+// The parts of a transaction, in order
+enum {
+    STEP_RESET,
+    STEP_TX,
+    STEP_SEARCH,
+    STEP_RX,
+    STEP_DONE,
+};
+
+// The state machine has finished its last time slot, and is waiting for the
+// next byte (see ow_triplets in onewire_library.c)
+static bool sm_idle (const pio_onewire_multi_bus_t *bus) {
+    const OW *ow = &bus->ow;
+    return pio_sm_is_tx_fifo_empty (ow->pio, ow->sm) &&
+           pio_sm_get_pc (ow->pio, ow->sm) == (uint)ow->offset + onewire_offset_fetch_bit;
+}
+
+// Skips the parts the transaction doesn't have
+static void begin (pio_onewire_multi_bus_t *bus, int step) {
+    const ow_txn_t *txn = bus->txn;
+    OW *ow = &bus->ow;
+    if (step == STEP_TX && !txn->tx_len) {
+        step = STEP_SEARCH;
+    }
+    if (step == STEP_SEARCH && !txn->search) {
+        step = STEP_RX;
+    }
+    if (step == STEP_RX && !txn->rx_len) {
+        step = STEP_DONE;
+    }
+    bus->step = step;
+    bus->n_put = 0;
+    bus->n_got = 0;
+    if (step == STEP_SEARCH) {
+        // the FIFO is empty, so both words of preferred directions fit
+        onewire_search_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio);
+        pio_sm_put (ow->pio, ow->sm, (uint32_t)txn->prefs);
+        pio_sm_put (ow->pio, ow->sm, (uint32_t)(txn->prefs >> 32));
+        bus->a_bits = 0;
+        bus->b_bits = 0;
+    }
+}
+
+static void multi_start (void *ctx, ow_txn_t *txn) {
+    pio_onewire_multi_bus_t *bus = ctx;
+    OW *ow = &bus->ow;
+    bus->txn = txn;
+    while (!pio_sm_is_rx_fifo_empty (ow->pio, ow->sm)) {
+        (void)pio_sm_get (ow->pio, ow->sm);
+    }
+    if (txn->reset) {
+        bus->step = STEP_RESET;
+        pio_sm_exec (ow->pio, ow->sm, ow->jmp_reset);
+    } else {
+        begin (bus, STEP_TX);
+    }
+}
+
+// Everything happens in pio_onewire_multi_service(), so there is nothing to
+// lock out
+static uint32_t multi_lock (__unused void *ctx) {
+    return 0;
+}
+
+static void multi_unlock (__unused void *ctx, __unused uint32_t saved) {
+}
+
+void pio_onewire_multi_init (pio_onewire_multi_t *m) {
+    memset (m, 0, sizeof (*m));
+}
+
+ow_txn_queue_t *pio_onewire_multi_add_bus (pio_onewire_multi_t *m, const OW *ow) {
+    if (m->n_buses == PIO_ONEWIRE_MULTI_MAX_BUSES) {
+        return NULL;
+    }
+    pio_onewire_multi_bus_t *bus = &m->buses[m->n_buses++];
+    bus->ow = *ow;
+    ow_txn_backend_t backend = {
+        .start = multi_start,
+        .lock = multi_lock,
+        .unlock = multi_unlock,
+        .ctx = bus,
+    };
+    ow_txn_queue_init (&bus->queue, &backend);
+    return &bus->queue;
+}
+
+static void finish (pio_onewire_multi_bus_t *bus, int result) {
+    ow_txn_t *txn = bus->txn;
+    if (result == OW_TXN_OK) {
+        if (txn->rx_len) {
+            memcpy (txn->rx, bus->rx, txn->rx_len);
+        }
+        txn->a_bits = bus->a_bits;
+        txn->b_bits = bus->b_bits;
+    }
+    bus->txn = NULL;
+    // calls the transaction's on_done, and starts the next one
+    ow_txn_queue_complete (&bus->queue, result);
+}
+
+static void service_bus (pio_onewire_multi_bus_t *bus) {
+    const ow_txn_t *txn = bus->txn;
+    OW *ow = &bus->ow;
+    switch (bus->step) {
+    case STEP_RESET:
+        if (!pio_sm_is_rx_fifo_empty (ow->pio, ow->sm)) {
+            // a slave pulled the bus low (see ow_reset)
+            if (pio_sm_get (ow->pio, ow->sm) & 1) {
+                finish (bus, OW_TXN_NO_PRESENCE);
+            } else {
+                begin (bus, STEP_TX);
+            }
+        }
+        break;
+    case STEP_TX:
+        while (bus->n_put < txn->tx_len && !pio_sm_is_tx_fifo_full (ow->pio, ow->sm)) {
+            pio_sm_put (ow->pio, ow->sm, txn->tx[bus->n_put++]);
+        }
+        while (!pio_sm_is_rx_fifo_empty (ow->pio, ow->sm)) {
+            (void)pio_sm_get (ow->pio, ow->sm);     // discard the response
+            bus->n_got++;
+        }
+        if (bus->n_got == txn->tx_len && sm_idle (bus)) {
+            begin (bus, STEP_SEARCH);
+        }
+        break;
+    case STEP_SEARCH:
+        while (bus->n_got < 64 && !pio_sm_is_rx_fifo_empty (ow->pio, ow->sm)) {
+            uint32_t result = pio_sm_get (ow->pio, ow->sm);
+            bus->a_bits |= (uint64_t)OW_TRIPLET_A (result) << bus->n_got;
+            bus->b_bits |= (uint64_t)OW_TRIPLET_B (result) << bus->n_got;
+            bus->n_got++;
+        }
+        // wait for the state machine to stop with the bus released, as
+        // ow_triplets does
+        if (bus->n_got == 64 && (ow->pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + ow->sm)))) {
+            onewire_sm_init (ow->pio, ow->sm, ow->offset, ow->gpio, 8);
+            begin (bus, STEP_DONE);
+        }
+        break;
+    case STEP_RX:
+        while (bus->n_put < txn->rx_len && !pio_sm_is_tx_fifo_full (ow->pio, ow->sm)) {
+            pio_sm_put (ow->pio, ow->sm, 0xff);     // generate read slots
+            bus->n_put++;
+        }
+        while (bus->n_got < txn->rx_len && !pio_sm_is_rx_fifo_empty (ow->pio, ow->sm)) {
+            bus->rx[bus->n_got++] = (uint8_t)(pio_sm_get (ow->pio, ow->sm) >> 24);
+        }
+        if (bus->n_got == txn->rx_len && sm_idle (bus)) {
+            begin (bus, STEP_DONE);
+        }
+        break;
+    }
+    if (bus->txn && bus->step == STEP_DONE) {
+        finish (bus, OW_TXN_OK);
+    }
+}
+
+bool pio_onewire_multi_service (pio_onewire_multi_t *m) {
+    bool busy = false;
+    for (uint i = 0; i < m->n_buses; i += 1) {
+        pio_onewire_multi_bus_t *bus = &m->buses[i];
+        if (bus->txn) {
+            service_bus (bus);
+        }
+        busy |= bus->txn != NULL;
+    }
+    return busy;
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _PIO_ONEWIRE_MULTI_H
+#define _PIO_ONEWIRE_MULTI_H
+
+#include "onewire_library.h"
+#include "ow_txn.h"
+
+// Many PIO 1-Wire buses, one per state machine, run by the processor
+// together.
+//
+// The functions in onewire_library.h wait for every byte, so only one bus
+// can be busy at a time. Here each bus has a queue of transactions from
+// ow_txn.h, and pio_onewire_multi_service() goes round all the state
+// machines, moving each transaction on a step at a time (reset, bytes
+// written, search triplets, bytes read) as far as its FIFOs allow. A 1-Wire
+// byte takes over half a millisecond, so one processor easily keeps up with
+// every state machine on the chip.
+//
+// Everything happens in pio_onewire_multi_service(), so it must be called
+// often, for as long as there is anything queued.
+
+#define PIO_ONEWIRE_MULTI_MAX_BUSES (NUM_PIOS * NUM_PIO_STATE_MACHINES)
+
+typedef struct {
+    OW ow;
+    ow_txn_queue_t queue;
+    // the transaction in progress, and how far it has got
+    ow_txn_t *txn;
+    int step;
+    uint32_t n_put;
+    uint32_t n_got;
+    uint8_t rx[OW_TXN_MAX_LEN];
+    uint64_t a_bits;
+    uint64_t b_bits;
+} pio_onewire_multi_bus_t;
+
+typedef struct {
+    pio_onewire_multi_bus_t buses[PIO_ONEWIRE_MULTI_MAX_BUSES];
+    uint n_buses;
+} pio_onewire_multi_t;
+
+void pio_onewire_multi_init (pio_onewire_multi_t *m);
+
+// The driver must already be set up with ow_init(). Returns: the bus's
+// queue, or NULL if there are too many.
+ow_txn_queue_t *pio_onewire_multi_add_bus (pio_onewire_multi_t *m, const OW *ow);
+
+// Moves every bus on as far as it can go without waiting. Returns: true if
+// anything is still in progress.
+bool pio_onewire_multi_service (pio_onewire_multi_t *m);
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "flash_blockdev.h"
+
+#define BLOCKS_PER_SECTOR (QSPI_FLASH_SECTOR_SIZE / FLASH_BD_BLOCK_SIZE)
+#define ALL_PAGES ((uint32_t) ((1ull << FLASH_BD_PAGES_PER_SECTOR) - 1))
+
+static uint8_t *slot_bytes(flash_bd_slot_t *s) {
+    return (uint8_t *) s->data;
+}
+
+static uint32_t sector_addr(const flash_bd_t *bd, uint32_t sector) {
+    return bd->base + sector * QSPI_FLASH_SECTOR_SIZE;
+}
+
+static flash_bd_slot_t *find_slot(flash_bd_t *bd, uint32_t sector) {
+    for (int i = 0; i < FLASH_BD_CACHE_SECTORS; ++i) {
+        if (bd->slots[i].sector == sector)
+            return &bd->slots[i];
+    }
+    return NULL;
+}
+
+static bool page_blank(const uint8_t *page) {
+    for (uint32_t i = 0; i < QSPI_FLASH_PAGE_SIZE; ++i) {
+        if (page[i] != 0xff)
+            return false;
+    }
+    return true;
+}
+
+static void start_flush(flash_bd_t *bd, int i) {
+    flash_bd_slot_t *s = &bd->slots[i];
+    bd->flushing = i;
+    bd->stats.flushes++;
+    if (s->needs_erase) {
+        // Everything but blank pages has to go back after the erase
+        s->dirty_pages = 0;
+        for (uint32_t p = 0; p < FLASH_BD_PAGES_PER_SECTOR; ++p) {
+            if (!page_blank(slot_bytes(s) + p * QSPI_FLASH_PAGE_SIZE))
+                s->dirty_pages |= 1u << p;
+        }
+        bd->flush_page = -1;
+    } else {
+        bd->stats.erases_avoided++;
+        bd->flush_page = 0;
+    }
+}
+
+// Starts the next erase or program of the write-back, if the flash is ready
+// for it. Returns false once the write-back is finished.
+static bool flush_step(flash_bd_t *bd) {
+    if (bd->flushing < 0)
+        return false;
+    if (qspi_flash_busy(bd->flash))
+        return true;
+    flash_bd_slot_t *s = &bd->slots[bd->flushing];
+    uint32_t addr = sector_addr(bd, s->sector);
+    if (bd->flush_page < 0) {
+        qspi_flash_start_sector_erase(bd->flash, addr);
+        s->needs_erase = false;
+        bd->stats.erases++;
+        bd->flush_page = 0;
+        return true;
+    }
+    while (bd->flush_page < FLASH_BD_PAGES_PER_SECTOR && !(s->dirty_pages & 1u << bd->flush_page))
+        bd->flush_page++;
+    if (bd->flush_page == FLASH_BD_PAGES_PER_SECTOR) {
+        // The last program has finished with the data, so the slot can change
+        s->dirty_pages = 0;
+        bd->flushing = -1;
+        return false;
+    }
+    uint32_t offset = (uint32_t) bd->flush_page * QSPI_FLASH_PAGE_SIZE;
+    qspi_flash_start_page_program(bd->flash, addr + offset, slot_bytes(s) + offset);
+    bd->stats.pages_programmed++;
+    bd->flush_page++;
+    return true;
+}
+
+static void finish_flush(flash_bd_t *bd) {
+    while (flush_step(bd))
+        qspi_flash_wait_ready(bd->flash);
+}
+
+static int lru_dirty(const flash_bd_t *bd) {
+    int best = -1;
+    for (int i = 0; i < FLASH_BD_CACHE_SECTORS; ++i) {
+        const flash_bd_slot_t *s = &bd->slots[i];
+        if (s->dirty_pages && (best < 0 || s->last_used < bd->slots[best].last_used))
+            best = i;
+    }
+    return best;
+}
+
+// An empty slot, or the least recently used clean one, writing back if there
+// are none
+static flash_bd_slot_t *get_slot(flash_bd_t *bd) {
+    for (;;) {
+        flash_bd_slot_t *best = NULL;
+        for (int i = 0; i < FLASH_BD_CACHE_SECTORS; ++i) {
+            flash_bd_slot_t *s = &bd->slots[i];
+            if (i == bd->flushing)
+                continue;
+            if (s->sector == FLASH_BD_NO_SECTOR)
+                return s;
+            if (!s->dirty_pages && (!best || s->last_used < best->last_used))
+                best = s;
+        }
+        if (best)
+            return best;
+        if (bd->flushing < 0)
+            start_flush(bd, lru_dirty(bd));
+        finish_flush(bd);
+    }
+}
+
+// Start writing back early, so there is usually a clean slot to hand
+static void write_behind(flash_bd_t *bd) {
+    if (bd->flushing >= 0)
+        return;
+    uint32_t dirty = 0;
+    for (int i = 0; i < FLASH_BD_CACHE_SECTORS; ++i)
+        dirty += bd->slots[i].dirty_pages != 0;
+    if (dirty >= FLASH_BD_CACHE_SECTORS / 2)
+        start_flush(bd, lru_dirty(bd));
+}
+
+// Only pages which change need programming, and only clearing bits can be
+// done without an erase
+static void update_slot(flash_bd_slot_t *s, uint32_t offset, const uint8_t *src, uint32_t len) {
+    uint8_t *dst = slot_bytes(s) + offset;
+    for (uint32_t i = 0; i < len; ++i) {
+        if (dst[i] != src[i]) {
+            if ((dst[i] & src[i]) != src[i])
+                s->needs_erase = true;
+            s->dirty_pages |= 1u << ((offset + i) / QSPI_FLASH_PAGE_SIZE);
+            dst[i] = src[i];
+        }
+    }
+}
+
+void flash_bd_init(flash_bd_t *bd, qspi_flash_t *flash, uint32_t base, uint32_t size) {
+    memset(bd, 0, sizeof(*bd));
+    bd->flash = flash;
+    bd->base = base;
+    bd->n_sectors = size / QSPI_FLASH_SECTOR_SIZE;
+    bd->flushing = -1;
+    for (int i = 0; i < FLASH_BD_CACHE_SECTORS; ++i)
+        bd->slots[i].sector = FLASH_BD_NO_SECTOR;
+}
+
+bool flash_bd_read(flash_bd_t *bd, uint32_t block, uint8_t *buf, uint32_t count) {
+    if (block > flash_bd_block_count(bd) || count > flash_bd_block_count(bd) - block)
+        return false;
+    bd->stats.block_reads += count;
+    while (count) {
+        uint32_t sector = block / BLOCKS_PER_SECTOR;
+        flash_bd_slot_t *s = find_slot(bd, sector);
+        uint32_t n;
+        if (s) {
+            uint32_t first = block % BLOCKS_PER_SECTOR;
+            n = BLOCKS_PER_SECTOR - first < count ? BLOCKS_PER_SECTOR - first : count;
+            memcpy(buf, slot_bytes(s) + first * FLASH_BD_BLOCK_SIZE, n * FLASH_BD_BLOCK_SIZE);
+            s->last_used = ++bd->clock;
+            bd->stats.cache_hits++;
+        } else {
+            // As many blocks as we can read in one go
+            n = 0;
+            while (n < count && !find_slot(bd, (block + n) / BLOCKS_PER_SECTOR))
+                ++n;
+            qspi_flash_read(bd->flash, bd->base + block * FLASH_BD_BLOCK_SIZE, buf, n * FLASH_BD_BLOCK_SIZE);
+        }
+        block += n;
+        buf += n * FLASH_BD_BLOCK_SIZE;
+        count -= n;
+    }
+    flush_step(bd);
+    return true;
+}
+
+bool flash_bd_write(flash_bd_t *bd, uint32_t block, const uint8_t *buf, uint32_t count) {
+    if (block > flash_bd_block_count(bd) || count > flash_bd_block_count(bd) - block)
+        return false;
+    bd->stats.block_writes += count;
+    while (count) {
+        uint32_t sector = block / BLOCKS_PER_SECTOR;
+        uint32_t first = block % BLOCKS_PER_SECTOR;
+        uint32_t n = BLOCKS_PER_SECTOR - first < count ? BLOCKS_PER_SECTOR - first : count;
+        flash_bd_slot_t *s = find_slot(bd, sector);
+        if (s) {
+            // The data mustn't change under a write-back
+            if (s - bd->slots == bd->flushing)
+                finish_flush(bd);
+            bd->stats.cache_hits++;
+        } else {
+            s = get_slot(bd);
+            s->sector = sector;
+            s->dirty_pages = 0;
+            s->needs_erase = false;
+            if (n == BLOCKS_PER_SECTOR) {
+                // All of it is about to be replaced, so there's no need to
+                // fetch it, but it may need erasing
+                memset(s->data, 0xff, sizeof(s->data));
+                s->needs_erase = true;
+                s->dirty_pages = ALL_PAGES;
+            } else {
+                qspi_flash_read(bd->flash, sector_addr(bd, sector), slot_bytes(s), QSPI_FLASH_SECTOR_SIZE);
+                bd->stats.sector_fetches++;
+            }
+        }
+        update_slot(s, first * FLASH_BD_BLOCK_SIZE, buf, n * FLASH_BD_BLOCK_SIZE);
+        s->last_used = ++bd->clock;
+        block += n;
+        buf += n * FLASH_BD_BLOCK_SIZE;
+        count -= n;
+    }
+    write_behind(bd);
+    flush_step(bd);
+    return true;
+}
+
+bool flash_bd_poll(flash_bd_t *bd) {
+    if (bd->flushing < 0) {
+        int i = lru_dirty(bd);
+        if (i < 0)
+            return false;
+        start_flush(bd, i);
+    }
+    flush_step(bd);
+    return bd->flushing >= 0 || lru_dirty(bd) >= 0;
+}
+
+void flash_bd_sync(flash_bd_t *bd) {
+    for (;;) {
+        finish_flush(bd);
+        int i = lru_dirty(bd);
+        if (i < 0)
+            break;
+        start_flush(bd, i);
+    }
+    qspi_flash_wait_ready(bd->flash);
+}
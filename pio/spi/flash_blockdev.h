@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _FLASH_BLOCKDEV_H
+#define _FLASH_BLOCKDEV_H
+
+#include "qspi_flash.h"
+
+// A block device on serial NOR flash, with 512 byte blocks, as a filesystem
+// such as FatFs or littlefs expects, and a write-back cache of whole sectors.
+//
+// Writes go into the cache, so several writes to a sector cost one erase.
+// A sector only gets erased if a write sets a bit which was clear, and only
+// the pages which changed are programmed, so appending to a sector needs no
+// erase at all. Write-back runs in the background: each call moves it on by
+// at most one program or erase, without waiting for the flash, and reads of
+// other sectors go in between. When there is nothing else to do,
+// flash_bd_poll() moves it on, and starts on any other dirty sectors.
+// flash_bd_sync() finishes it all.
+//
+// Reads of sectors which aren't cached go straight to flash, without
+// displacing anything from the cache.
+
+#define FLASH_BD_BLOCK_SIZE 512
+#define FLASH_BD_CACHE_SECTORS 4
+#define FLASH_BD_PAGES_PER_SECTOR (QSPI_FLASH_SECTOR_SIZE / QSPI_FLASH_PAGE_SIZE)
+#define FLASH_BD_NO_SECTOR 0xffffffffu
+
+typedef struct {
+    uint32_t sector;
+    bool needs_erase;
+    // Bitmap of pages to program
+    uint32_t dirty_pages;
+    uint32_t last_used;
+    uint32_t data[QSPI_FLASH_SECTOR_SIZE / 4];
+} flash_bd_slot_t;
+
+typedef struct {
+    uint32_t block_reads;
+    uint32_t block_writes;
+    uint32_t cache_hits;
+    uint32_t sector_fetches;
+    uint32_t erases;
+    uint32_t erases_avoided;
+    uint32_t pages_programmed;
+    uint32_t flushes;
+} flash_bd_stats_t;
+
+typedef struct {
+    qspi_flash_t *flash;
+    uint32_t base;
+    uint32_t n_sectors;
+    flash_bd_slot_t slots[FLASH_BD_CACHE_SECTORS];
+    uint32_t clock;
+    // Slot being written back, or -1, and its next page (-1 to erase first)
+    int flushing;
+    int flush_page;
+    flash_bd_stats_t stats;
+} flash_bd_t;
+
+// Uses size bytes of flash from base, both multiples of the sector size
+void flash_bd_init(flash_bd_t *bd, qspi_flash_t *flash, uint32_t base, uint32_t size);
+
+static inline uint32_t flash_bd_block_count(const flash_bd_t *bd) {
+    return bd->n_sectors * (QSPI_FLASH_SECTOR_SIZE / FLASH_BD_BLOCK_SIZE);
+}
+
+// These return false if the blocks are out of range
+bool flash_bd_read(flash_bd_t *bd, uint32_t block, uint8_t *buf, uint32_t count);
+bool flash_bd_write(flash_bd_t *bd, uint32_t block, const uint8_t *buf, uint32_t count);
+
+// Moves write-back on, without waiting. Returns true if there is more to do.
+bool flash_bd_poll(flash_bd_t *bd);
+
+// Writes back everything, and waits for the flash
+void flash_bd_sync(flash_bd_t *bd);
+
+#endif
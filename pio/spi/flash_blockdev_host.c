@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the flash block device and its sector cache (flash_blockdev.h) and
+// the quad SPI flash driver (qspi_flash.h) under it, run on the host against
+// the emulated flash chip (flash_chip_emu.h). Build with PICO_PLATFORM=host.
+//
+// With each quad read command: writing a whole sector needs no fetch, writes
+// which only clear bits need no erase and program only the pages which
+// changed, writes which change nothing write nothing back, and reads of
+// other sectors don't displace the cache. Write-back driven only by
+// flash_bd_poll() must finish on its own. Then a random mix of reads and
+// writes is checked against a copy of what should be there, and after each
+// sync the emulated chip's memory itself must match. The chip must never
+// see a bad command.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "flash_blockdev.h"
+#include "flash_chip_emu.h"
+
+#define FLASH_SIZE (64 * 1024)
+#define N_BLOCKS (FLASH_SIZE / FLASH_BD_BLOCK_SIZE)
+#define BLOCKS_PER_SECTOR (QSPI_FLASH_SECTOR_SIZE / FLASH_BD_BLOCK_SIZE)
+#define NIBBLE_NS 20
+
+static uint8_t emu_mem[FLASH_SIZE];
+// What the block device should hold
+static uint8_t model[FLASH_SIZE];
+static uint8_t buf[8 * FLASH_BD_BLOCK_SIZE];
+
+static flash_chip_emu_t emu;
+static spi_xfer_queue_t emu_queue;
+static qspi_flash_t flash;
+static flash_bd_t bd;
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static void fill_random(uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; ++i)
+        p[i] = (uint8_t) rand();
+}
+
+static void write_blocks(uint32_t block, const uint8_t *data, uint32_t count) {
+    check(flash_bd_write(&bd, block, data, count), "Writing");
+    memcpy(model + block * FLASH_BD_BLOCK_SIZE, data, count * FLASH_BD_BLOCK_SIZE);
+}
+
+static bool chip_matches_model(void) {
+    return !memcmp(emu_mem, model, FLASH_SIZE);
+}
+
+static void check_chip(void) {
+    check(qspi_flash_jedec_id(&flash) == 0xef4017, "JEDEC ID");
+    check(qspi_flash_enable_quad(&flash), "Quad enable");
+    check(!emu.errors, "Commands before quad enable");
+}
+
+static void check_cache(void) {
+    flash_bd_init(&bd, &flash, 0, FLASH_SIZE);
+    memcpy(model, emu_mem, FLASH_SIZE);
+    check(flash_bd_block_count(&bd) == N_BLOCKS, "Block count");
+    check(!flash_bd_read(&bd, N_BLOCKS, buf, 1) && !flash_bd_read(&bd, N_BLOCKS - 1, buf, 2) &&
+          !flash_bd_write(&bd, 0, buf, N_BLOCKS + 1), "Refusing blocks out of range");
+
+    // A whole sector is written without fetching it, but erased first
+    fill_random(buf, QSPI_FLASH_SECTOR_SIZE);
+    write_blocks(BLOCKS_PER_SECTOR, buf, BLOCKS_PER_SECTOR);
+    flash_bd_sync(&bd);
+    flash_bd_stats_t s = bd.stats;
+    check(!s.sector_fetches && s.erases == 1 && s.pages_programmed == FLASH_BD_PAGES_PER_SECTOR, "Whole sector");
+    check(chip_matches_model(), "Chip after writing a whole sector");
+
+    // Clearing bits in one block needs no erase, and programs only its pages
+    for (uint i = 0; i < FLASH_BD_BLOCK_SIZE; ++i)
+        buf[i] = model[BLOCKS_PER_SECTOR * FLASH_BD_BLOCK_SIZE + FLASH_BD_BLOCK_SIZE + i] & 0x5a;
+    write_blocks(BLOCKS_PER_SECTOR + 1, buf, 1);
+    flash_bd_sync(&bd);
+    check(bd.stats.erases == s.erases && bd.stats.erases_avoided == s.erases_avoided + 1 &&
+          bd.stats.pages_programmed == s.pages_programmed + 2, "Clearing bits");
+    check(chip_matches_model(), "Chip after clearing bits");
+
+    // Writing what's already there writes nothing back
+    s = bd.stats;
+    write_blocks(BLOCKS_PER_SECTOR + 1, buf, 1);
+    flash_bd_sync(&bd);
+    check(bd.stats.flushes == s.flushes && bd.stats.pages_programmed == s.pages_programmed, "Unchanged data");
+
+    // Setting a bit needs an erase, and every page which isn't blank goes back
+    buf[7] = 0xff;
+    write_blocks(BLOCKS_PER_SECTOR + 1, buf, 1);
+    flash_bd_sync(&bd);
+    check(bd.stats.erases == s.erases + 1, "Setting bits");
+    check(chip_matches_model(), "Chip after setting bits");
+
+    // Part sectors are fetched once, and stay cached across reads of others
+    flash_bd_init(&bd, &flash, 0, FLASH_SIZE);
+    for (uint i = 0; i < FLASH_BD_CACHE_SECTORS; ++i) {
+        fill_random(buf, FLASH_BD_BLOCK_SIZE);
+        write_blocks(i * BLOCKS_PER_SECTOR + 3, buf, 1);
+    }
+    check(bd.stats.sector_fetches == FLASH_BD_CACHE_SECTORS, "Fetches of part sectors");
+    flash_bd_read(&bd, FLASH_BD_CACHE_SECTORS * BLOCKS_PER_SECTOR, buf, 8);
+    flash_bd_read(&bd, N_BLOCKS - 8, buf, 8);
+    for (uint i = 0; i < FLASH_BD_CACHE_SECTORS; ++i) {
+        fill_random(buf, FLASH_BD_BLOCK_SIZE);
+        write_blocks(i * BLOCKS_PER_SECTOR + 4, buf, 1);
+    }
+    check(bd.stats.sector_fetches == FLASH_BD_CACHE_SECTORS, "Cache after reading other sectors");
+    flash_bd_sync(&bd);
+    check(chip_matches_model(), "Chip after writing part sectors");
+}
+
+// Write-back moved on only by polling, with time passing in between
+static void check_poll(void) {
+    flash_bd_init(&bd, &flash, 0, FLASH_SIZE);
+    for (uint i = 0; i < 3; ++i) {
+        fill_random(buf, 2 * FLASH_BD_BLOCK_SIZE);
+        write_blocks(i * 2 * BLOCKS_PER_SECTOR + 5, buf, 2);
+    }
+    uint polls = 0;
+    while (flash_bd_poll(&bd) && polls < 100000) {
+        flash_chip_emu_advance(&emu, 10000);
+        ++polls;
+    }
+    check(polls > 3 && polls < 100000, "Number of polls");
+    qspi_flash_wait_ready(&flash);
+    check(chip_matches_model(), "Chip after write-back by polling");
+}
+
+static bool check_random_ops(uint n_ops) {
+    flash_bd_init(&bd, &flash, 0, FLASH_SIZE);
+    for (uint op = 0; op < n_ops; ++op) {
+        uint32_t count = 1 + rand() % 8;
+        uint32_t block = rand() % (N_BLOCKS - count + 1);
+        uint8_t *expect = model + block * FLASH_BD_BLOCK_SIZE;
+        uint32_t len = count * FLASH_BD_BLOCK_SIZE;
+        uint r = rand() % 16;
+        if (r < 7) {
+            fill_random(buf, len);
+            // Some writes only clear bits, which needs no erase
+            if (r == 0)
+                for (uint32_t i = 0; i < len; ++i)
+                    buf[i] &= expect[i];
+            write_blocks(block, buf, count);
+        } else if (r < 15) {
+            flash_bd_read(&bd, block, buf, count);
+            if (memcmp(buf, expect, len)) {
+                printf("Read of blocks %u-%u after %u operations doesn't match\n", (uint) block,
+                       (uint) (block + count - 1), op);
+                return false;
+            }
+        } else {
+            flash_bd_sync(&bd);
+            if (!chip_matches_model()) {
+                printf("Chip doesn't match after sync, after %u operations\n", op);
+                return false;
+            }
+        }
+        flash_bd_poll(&bd);
+    }
+    flash_bd_sync(&bd);
+    // Read back through an empty cache too
+    flash_bd_init(&bd, &flash, 0, FLASH_SIZE);
+    for (uint32_t block = 0; block < N_BLOCKS; block += 8) {
+        flash_bd_read(&bd, block, buf, 8);
+        if (memcmp(buf, model + block * FLASH_BD_BLOCK_SIZE, sizeof(buf)))
+            return false;
+    }
+    return chip_matches_model();
+}
+
+int main() {
+    printf("Flash block device host tests, on the emulated chip\n");
+    flash_chip_emu_init(&emu, &emu_queue, emu_mem, FLASH_SIZE, NIBBLE_NS);
+    qspi_flash_init(&flash, &emu_queue, QSPI_FLASH_CMD_READ_QUAD_IO, flash_chip_emu_wait, &emu);
+    check_chip();
+
+    static const uint8_t read_cmds[] = {QSPI_FLASH_CMD_READ_QUAD_OUT, QSPI_FLASH_CMD_READ_QUAD_IO};
+    for (uint i = 0; i < count_of(read_cmds); ++i) {
+        flash.read_cmd = read_cmds[i];
+        check_cache();
+        check_poll();
+        check(check_random_ops(2000), "Random reads and writes");
+    }
+    check(!emu.errors, "Commands the chip would reject");
+    printf("%u reads, %u programs, %u erases, %u status reads on the emulated chip\n", (uint) emu.reads,
+           (uint) emu.programs, (uint) emu.erases, (uint) emu.status_reads);
+    printf(errors ? "FAILED\n" : "All block device checks passed\n");
+    return errors != 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "flash_chip_emu.h"
+#include "qspi_flash.h"
+
+// Time to move on when nothing is happening
+#define WAIT_STEP_NS 2000
+
+// Nibble i of what the controller sends: the prefix, then the tx bytes
+static uint32_t nibble_out(const spi_xfer_t *xfer, uint32_t i) {
+    if (i < xfer->prefix_nibbles)
+        return (xfer->prefix[i / 8] >> (28 - 4 * (i % 8))) & 0xfu;
+    i -= xfer->prefix_nibbles;
+    uint8_t byte = ((const uint8_t *) xfer->tx)[i / 2];
+    return i % 2 ? byte & 0xfu : byte >> 4;
+}
+
+static uint32_t nibbles_out(const spi_xfer_t *xfer) {
+    return xfer->prefix_nibbles + 2 * xfer->tx_len;
+}
+
+// A byte on one lane, from IO0, checking HOLD and WP are high
+static int single_lane_byte(flash_chip_emu_t *emu, const spi_xfer_t *xfer, uint32_t i) {
+    if (i + 8 > nibbles_out(xfer))
+        return -1;
+    uint8_t byte = 0;
+    for (uint32_t n = 0; n < 8; ++n) {
+        uint32_t nibble = nibble_out(xfer, i + n);
+        if ((nibble & 0xcu) != 0xcu)
+            emu->errors++;
+        byte = (uint8_t) (byte << 1 | (nibble & 1u));
+    }
+    return byte;
+}
+
+static int single_lane_addr(flash_chip_emu_t *emu, const spi_xfer_t *xfer, uint32_t i) {
+    int a = single_lane_byte(emu, xfer, i);
+    int b = single_lane_byte(emu, xfer, i + 8);
+    int c = single_lane_byte(emu, xfer, i + 16);
+    if (a < 0 || b < 0 || c < 0)
+        return -1;
+    return a << 16 | b << 8 | c;
+}
+
+// Registers are sent on IO1, a byte per 8 nibbles, repeating for as long as
+// the chip is clocked. The other lines are pulled up.
+static void reply_single_lane(const spi_xfer_t *xfer, const uint8_t *values, uint32_t n_values) {
+    uint8_t *rx = xfer->rx;
+    for (uint32_t i = 0; i < xfer->rx_len; ++i) {
+        uint32_t bits = (values[i / 4 % n_values] >> (6 - 2 * (i % 4))) & 3u;
+        rx[i] = (uint8_t) (0xdd | (bits & 2u) << 4 | (bits & 1u) << 1);
+    }
+}
+
+static void reply_data(flash_chip_emu_t *emu, const spi_xfer_t *xfer, uint32_t addr) {
+    uint8_t *rx = xfer->rx;
+    for (uint32_t i = 0; i < xfer->rx_len; ++i)
+        rx[i] = emu->mem[(addr + i) % emu->size];
+    emu->reads++;
+}
+
+static bool quad_allowed(flash_chip_emu_t *emu) {
+    if (emu->status2 & QSPI_FLASH_STATUS2_QE_MASK)
+        return true;
+    emu->errors++;
+    return false;
+}
+
+static bool write_allowed(flash_chip_emu_t *emu) {
+    if (emu->write_enabled)
+        return true;
+    emu->errors++;
+    return false;
+}
+
+static void set_busy(flash_chip_emu_t *emu, uint32_t ns) {
+    emu->busy_until_ns = emu->now_ns + ns;
+    emu->busy_ns += ns;
+    emu->write_enabled = false;
+}
+
+static void run_command(flash_chip_emu_t *emu, const spi_xfer_t *xfer) {
+    int cmd = single_lane_byte(emu, xfer, 0);
+    bool busy = emu->now_ns < emu->busy_until_ns;
+    if (cmd == QSPI_FLASH_CMD_STATUS) {
+        emu->status_reads++;
+        uint8_t status = (uint8_t) ((busy ? QSPI_FLASH_STATUS_BUSY_MASK : 0) |
+                                    (emu->write_enabled ? QSPI_FLASH_STATUS_WEL_MASK : 0));
+        reply_single_lane(xfer, &status, 1);
+        return;
+    }
+    if (busy) {
+        emu->errors++;
+        return;
+    }
+    int addr;
+    switch (cmd) {
+        case QSPI_FLASH_CMD_STATUS2:
+            reply_single_lane(xfer, &emu->status2, 1);
+            break;
+        case QSPI_FLASH_CMD_JEDEC_ID: {
+            // Winbond W25Q64
+            static const uint8_t id[] = {0xef, 0x40, 0x17};
+            reply_single_lane(xfer, id, sizeof(id));
+            break;
+        }
+        case QSPI_FLASH_CMD_WRITE_EN:
+            emu->write_enabled = true;
+            break;
+        case QSPI_FLASH_CMD_WRITE_STATUS2: {
+            int value = single_lane_byte(emu, xfer, 8);
+            if (value >= 0 && write_allowed(emu)) {
+                emu->status2 = (uint8_t) value;
+                set_busy(emu, 10000);
+            }
+            break;
+        }
+        case QSPI_FLASH_CMD_SECTOR_ERASE:
+            addr = single_lane_addr(emu, xfer, 8);
+            if (addr >= 0 && write_allowed(emu)) {
+                uint32_t sector = (uint32_t) addr % emu->size & ~(QSPI_FLASH_SECTOR_SIZE - 1);
+                memset(emu->mem + sector, 0xff, QSPI_FLASH_SECTOR_SIZE);
+                emu->erases++;
+                set_busy(emu, emu->sector_erase_ns);
+            }
+            break;
+        case QSPI_FLASH_CMD_PAGE_PROGRAM_QUAD:
+            addr = single_lane_addr(emu, xfer, 8);
+            if (addr >= 0 && write_allowed(emu) && quad_allowed(emu)) {
+                // Data past the end of the page wraps to its start
+                uint32_t page = (uint32_t) addr % emu->size & ~(QSPI_FLASH_PAGE_SIZE - 1);
+                uint32_t offset = (uint32_t) addr % QSPI_FLASH_PAGE_SIZE;
+                for (uint32_t i = 32; i + 1 < nibbles_out(xfer); i += 2) {
+                    uint8_t byte = (uint8_t) (nibble_out(xfer, i) << 4 | nibble_out(xfer, i + 1));
+                    emu->mem[page + offset] &= byte;
+                    offset = (offset + 1) % QSPI_FLASH_PAGE_SIZE;
+                }
+                emu->programs++;
+                set_busy(emu, emu->page_program_ns);
+            }
+            break;
+        case QSPI_FLASH_CMD_READ_QUAD_OUT:
+            addr = single_lane_addr(emu, xfer, 8);
+            // Then 8 dummy clocks
+            if (addr >= 0 && nibbles_out(xfer) == 40 && quad_allowed(emu))
+                reply_data(emu, xfer, (uint32_t) addr);
+            else
+                emu->errors++;
+            break;
+        case QSPI_FLASH_CMD_READ_QUAD_IO:
+            // Address and mode bits, then 4 dummy clocks
+            if (nibbles_out(xfer) == 20 && quad_allowed(emu)) {
+                addr = 0;
+                for (uint32_t i = 8; i < 14; ++i)
+                    addr = addr << 4 | (int) nibble_out(xfer, i);
+                uint32_t mode = nibble_out(xfer, 14) << 4 | nibble_out(xfer, 15);
+                // Mode bits 5:4 = 10 would ask for continuous read mode
+                if ((mode & 0x30) == 0x20)
+                    emu->errors++;
+                reply_data(emu, xfer, (uint32_t) addr);
+            } else {
+                emu->errors++;
+            }
+            break;
+        default:
+            emu->errors++;
+            break;
+    }
+}
+
+// The simulation is single threaded, so there is nothing to lock out
+static uint32_t emu_lock(void *ctx) {
+    (void) ctx;
+    return 0;
+}
+
+static void emu_unlock(void *ctx, uint32_t saved) {
+    (void) ctx;
+    (void) saved;
+}
+
+static void emu_start(void *ctx, spi_xfer_t *xfer) {
+    flash_chip_emu_t *emu = ctx;
+    emu->active = xfer;
+    uint64_t start_ns = emu->finish_ns > emu->now_ns ? emu->finish_ns : emu->now_ns;
+    emu->finish_ns = start_ns + emu->overhead_ns + (uint64_t) spi_xfer_units(xfer) * emu->nibble_ns;
+}
+
+void flash_chip_emu_init(flash_chip_emu_t *emu, spi_xfer_queue_t *q, uint8_t *mem, uint32_t size,
+                         uint32_t nibble_ns) {
+    memset(emu, 0, sizeof(*emu));
+    emu->queue = q;
+    emu->mem = mem;
+    emu->size = size;
+    emu->nibble_ns = nibble_ns;
+    emu->overhead_ns = 1000;
+    emu->page_program_ns = 400000;
+    emu->sector_erase_ns = 45000000;
+    memset(mem, 0xff, size);
+    spi_xfer_backend_t backend = {
+            .start = emu_start,
+            .lock = emu_lock,
+            .unlock = emu_unlock,
+            .ctx = emu,
+    };
+    spi_xfer_queue_init(q, &backend);
+}
+
+void flash_chip_emu_advance(flash_chip_emu_t *emu, uint64_t ns) {
+    uint64_t end_ns = emu->now_ns + ns;
+    while (emu->active && emu->finish_ns <= end_ns) {
+        spi_xfer_t *xfer = emu->active;
+        emu->now_ns = emu->finish_ns;
+        emu->active = NULL;
+        run_command(emu, xfer);
+        // This may start the next transfer
+        spi_xfer_queue_complete(emu->queue);
+    }
+    emu->now_ns = end_ns;
+}
+
+void flash_chip_emu_wait(void *ctx) {
+    flash_chip_emu_t *emu = ctx;
+    if (emu->active && emu->finish_ns > emu->now_ns) {
+        flash_chip_emu_advance(emu, emu->finish_ns - emu->now_ns);
+    } else if (emu->busy_until_ns > emu->now_ns) {
+        // Polling would show the chip busy until then, so skip the polls
+        flash_chip_emu_advance(emu, emu->busy_until_ns - emu->now_ns);
+    } else {
+        flash_chip_emu_advance(emu, WAIT_STEP_NS);
+    }
+}
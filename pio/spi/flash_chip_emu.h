@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _FLASH_CHIP_EMU_H
+#define _FLASH_CHIP_EMU_H
+
+#include "spi_xfer_queue.h"
+
+// A quad SPI NOR flash chip, emulated in RAM, on the far end of a
+// spi_xfer_queue_t, in place of pio_spi_dma.
+//
+// It decodes each quad transfer as the chip would see it, nibble by nibble,
+// and answers the commands used by qspi_flash.h. Programming can only clear
+// bits, pages wrap, and the chip is busy for page_program_ns or
+// sector_erase_ns afterwards. Anything the real chip would ignore or get
+// wrong (a command whilst busy, programming without write enable, a quad
+// command before Quad Enable is set, HOLD low on a single lane) is counted
+// in errors, so a test can check there are none.
+//
+// Like the loopback simulation, time only moves on in
+// flash_chip_emu_advance(), with each nibble taking nibble_ns.
+
+typedef struct {
+    spi_xfer_queue_t *queue;
+    uint8_t *mem;
+    uint32_t size;
+    uint32_t nibble_ns;
+    uint32_t overhead_ns;
+    uint32_t page_program_ns;
+    uint32_t sector_erase_ns;
+    bool write_enabled;
+    uint8_t status2;
+    spi_xfer_t *active;
+    uint64_t now_ns;
+    uint64_t finish_ns;
+    uint64_t busy_until_ns;
+    uint64_t busy_ns;
+    uint32_t reads;
+    uint32_t programs;
+    uint32_t erases;
+    uint32_t status_reads;
+    uint32_t errors;
+} flash_chip_emu_t;
+
+// mem must hold size bytes, and is erased. The timings are typical ones for a
+// W25Q-series chip, and can be changed afterwards.
+void flash_chip_emu_init(flash_chip_emu_t *emu, spi_xfer_queue_t *q, uint8_t *mem, uint32_t size,
+                         uint32_t nibble_ns);
+
+// Move time on, completing any transfers which finish in that time
+void flash_chip_emu_advance(flash_chip_emu_t *emu, uint64_t ns);
+
+// Suitable as a qspi_flash_t wait function, with the emulator as its context
+void flash_chip_emu_wait(void *emu);
+
+#endif
@@ -8,7 +8,8 @@
 
 // Just 8 bit functions provided here. The PIO program supports any frame size
 // 1...32, but the software to do the necessary FIFO shuffling is left as an
-// exercise for the reader :)
+// exercise for the reader :) (Or see pio_spi_dma.c, which lets DMA do 16 and
+// 32 bit frames.)
 //
 // Likewise we only provide MSB-first here. To do LSB-first, you need to
 // - Do shifts when reading from the FIFO, for general case n != 8, 16, 32
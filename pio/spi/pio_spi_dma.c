@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "pio_spi_dma.h"
+
+static pio_spi_dma_t *instances[PIO_SPI_DMA_MAX_INSTANCES];
+
+static uint32_t spi_dma_lock(__unused void *ctx) {
+    return save_and_disable_interrupts();
+}
+
+static void spi_dma_unlock(__unused void *ctx, uint32_t saved) {
+    restore_interrupts(saved);
+}
+
+static void set_cs(const pio_spi_dma_t *d, bool level) {
+    if (d->spi.cs_pin != PIO_SPI_DMA_NO_CS)
+        gpio_put(d->spi.cs_pin, level);
+}
+
+static void start_dma(uint chan, enum dma_channel_transfer_size size, bool bswap, bool read_incr, bool write_incr,
+                      uint dreq, volatile void *write_addr, const volatile void *read_addr, uint32_t count) {
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_bswap(&c, bswap);
+    channel_config_set_read_increment(&c, read_incr);
+    channel_config_set_write_increment(&c, write_incr);
+    channel_config_set_dreq(&c, dreq);
+    dma_channel_configure(chan, &c, write_addr, read_addr, count, true);
+}
+
+static void start_full_duplex(pio_spi_dma_t *d, spi_xfer_t *xfer) {
+    PIO pio = d->spi.pio;
+    uint sm = d->spi.sm;
+    enum dma_channel_transfer_size size = d->frame_bits <= 8 ? DMA_SIZE_8 :
+                                          d->frame_bits <= 16 ? DMA_SIZE_16 : DMA_SIZE_32;
+    bool bswap = d->swap_bytes && size != DMA_SIZE_8;
+    // Every frame pushes a word into the RX FIFO, so the RX channel always
+    // runs, and finishes after the last frame is on the bus
+    d->rx_busy = true;
+    d->tx_busy = false;
+    start_dma(d->rx_chan, size, bswap, false, xfer->rx != NULL, pio_get_dreq(pio, sm, false),
+              xfer->rx ? xfer->rx : &d->discard, &pio->rxf[sm], xfer->tx_len);
+    start_dma(d->tx_chan, size, bswap, xfer->tx != NULL, false, pio_get_dreq(pio, sm, true),
+              &pio->txf[sm], xfer->tx ? xfer->tx : &d->zero, xfer->tx_len);
+}
+
+// The header and prefix go first, as they are, then the data with its bytes
+// swapped so they go out in memory order
+static void start_quad(pio_spi_dma_t *d, spi_xfer_t *xfer) {
+    PIO pio = d->spi.pio;
+    uint sm = d->spi.sm;
+    uint32_t prefix_words = (xfer->prefix_nibbles + 7) / 8;
+    hard_assert(prefix_words <= PIO_SPI_DMA_MAX_PREFIX_WORDS);
+    d->cmd[0] = spi_xfer_quad_header(xfer);
+    memcpy(&d->cmd[1], xfer->prefix, prefix_words * sizeof(uint32_t));
+
+    d->rx_busy = xfer->rx_len != 0;
+    if (d->rx_busy)
+        start_dma(d->rx_chan, DMA_SIZE_32, true, false, true, pio_get_dreq(pio, sm, false), xfer->rx,
+                  &pio->rxf[sm], xfer->rx_len / 4);
+    d->tx_busy = true;
+    d->sending_prefix = true;
+    pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+    start_dma(d->tx_chan, DMA_SIZE_32, false, true, false, pio_get_dreq(pio, sm, true), &pio->txf[sm], d->cmd,
+              1 + prefix_words);
+}
+
+static void __time_critical_func(start_xfer)(void *ctx, spi_xfer_t *xfer) {
+    pio_spi_dma_t *d = ctx;
+    d->xfer = xfer;
+    set_cs(d, false);
+    if (d->quad)
+        start_quad(d, xfer);
+    else
+        start_full_duplex(d, xfer);
+}
+
+static void __time_critical_func(finish_xfer)(pio_spi_dma_t *d) {
+    set_cs(d, true);
+    d->xfer = NULL;
+    // Calls the transfer's on_done, and starts the next one
+    spi_xfer_queue_complete(&d->queue);
+}
+
+static void __time_critical_func(tx_done)(pio_spi_dma_t *d) {
+    PIO pio = d->spi.pio;
+    uint sm = d->spi.sm;
+    spi_xfer_t *xfer = d->xfer;
+    if (d->sending_prefix && xfer->tx_len) {
+        d->sending_prefix = false;
+        start_dma(d->tx_chan, DMA_SIZE_32, true, true, false, pio_get_dreq(pio, sm, true), &pio->txf[sm], xfer->tx,
+                  xfer->tx_len / 4);
+        return;
+    }
+    d->tx_busy = false;
+    if (!d->rx_busy) {
+        // Nothing to receive, so wait for the last of the FIFO to go out.
+        // This is at most a few words, and the state machine then stalls
+        // waiting for the next header.
+        uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+        pio->fdebug = stall;
+        while (!(pio->fdebug & stall) || !pio_sm_is_tx_fifo_empty(pio, sm))
+            tight_loop_contents();
+        finish_xfer(d);
+    }
+}
+
+static void __time_critical_func(pio_spi_dma_irq_handler)() {
+    for (uint i = 0; i < PIO_SPI_DMA_MAX_INSTANCES; ++i) {
+        pio_spi_dma_t *d = instances[i];
+        if (!d || !d->xfer)
+            continue;
+        uint irq = d->dma_irq_index;
+        if (d->tx_busy && dma_irqn_get_channel_status(irq, d->tx_chan)) {
+            dma_irqn_acknowledge_channel(irq, d->tx_chan);
+            tx_done(d);
+        }
+        if (d->xfer && d->rx_busy && dma_irqn_get_channel_status(irq, d->rx_chan)) {
+            dma_irqn_acknowledge_channel(irq, d->rx_chan);
+            d->rx_busy = false;
+            if (!d->tx_busy)
+                finish_xfer(d);
+        }
+    }
+}
+
+void pio_spi_dma_init(pio_spi_dma_t *d, const pio_spi_inst_t *spi, uint frame_bits, bool swap_bytes, bool quad,
+                      uint dma_irq_index) {
+    memset(d, 0, sizeof(*d));
+    d->spi = *spi;
+    d->frame_bits = frame_bits;
+    d->swap_bytes = swap_bytes;
+    d->quad = quad;
+    d->dma_irq_index = dma_irq_index;
+    d->tx_chan = (uint) dma_claim_unused_channel(true);
+    d->rx_chan = (uint) dma_claim_unused_channel(true);
+
+    spi_xfer_backend_t backend = {
+            .start = start_xfer,
+            .lock = spi_dma_lock,
+            .unlock = spi_dma_unlock,
+            .ctx = d,
+    };
+    spi_xfer_queue_init(&d->queue, &backend);
+
+    bool first = true;
+    uint slot = PIO_SPI_DMA_MAX_INSTANCES;
+    for (uint i = 0; i < PIO_SPI_DMA_MAX_INSTANCES; ++i) {
+        if (instances[i])
+            first = false;
+        else if (slot == PIO_SPI_DMA_MAX_INSTANCES)
+            slot = i;
+    }
+    hard_assert(slot < PIO_SPI_DMA_MAX_INSTANCES);
+    instances[slot] = d;
+
+    // Only quad transfers need to know when the TX channel finishes
+    dma_irqn_set_channel_enabled(dma_irq_index, d->tx_chan, quad);
+    dma_irqn_set_channel_enabled(dma_irq_index, d->rx_chan, true);
+    if (first) {
+        uint irq_num = DMA_IRQ_0 + dma_irq_index;
+        irq_add_shared_handler(irq_num, pio_spi_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(irq_num, true);
+    }
+}
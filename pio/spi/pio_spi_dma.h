@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _PIO_SPI_DMA_H
+#define _PIO_SPI_DMA_H
+
+#include "pio_spi.h"
+#include "spi_xfer_queue.h"
+
+// Asynchronous PIO SPI, with a pair of DMA channels per state machine.
+//
+// The state machine runs either one of the full duplex programs, set up with
+// pio_spi_init() for 8, 16 or 32 bit frames, or the quad program, set up with
+// pio_spi_quad_init(). Transfers go through the queue in spi_xfer_queue.h,
+// with chip select driven low for each one, unless cs_pin is PIO_SPI_DMA_NO_CS.
+// The chip select GPIO must already be set up as an output.
+//
+// For wider frames, the FIFOs and DMA do a half or a quarter of the work they
+// do for 8 bit frames. With swap_bytes set, 16 and 32 bit frames are sent
+// from and received into byte buffers in memory order, so byte streams can be
+// sent as wide frames too. Quad transfers always use byte buffers.
+
+#define PIO_SPI_DMA_MAX_INSTANCES 4
+#define PIO_SPI_DMA_MAX_PREFIX_WORDS 8
+#define PIO_SPI_DMA_NO_CS ((uint) -1)
+
+typedef struct {
+    pio_spi_inst_t spi;
+    uint frame_bits;
+    bool swap_bytes;
+    bool quad;
+    uint tx_chan;
+    uint rx_chan;
+    uint dma_irq_index;
+    spi_xfer_queue_t queue;
+    // The transfer in progress
+    spi_xfer_t *xfer;
+    bool tx_busy;
+    bool rx_busy;
+    bool sending_prefix;
+    uint32_t cmd[1 + PIO_SPI_DMA_MAX_PREFIX_WORDS];
+    uint32_t zero;
+    uint32_t discard;
+} pio_spi_dma_t;
+
+// The state machine must already be running its program. Uses the given DMA
+// IRQ (0 or 1), shared with anything else.
+void pio_spi_dma_init(pio_spi_dma_t *d, const pio_spi_inst_t *spi, uint frame_bits, bool swap_bytes, bool quad,
+                      uint dma_irq_index);
+
+static inline bool pio_spi_dma_submit(pio_spi_dma_t *d, spi_xfer_t *xfer) {
+    return spi_xfer_submit(&d->queue, xfer);
+}
+
+static inline void pio_spi_dma_wait(const spi_xfer_t *xfer) {
+    while (!spi_xfer_is_done(xfer))
+        tight_loop_contents();
+}
+
+static inline void pio_spi_dma_wait_idle(const pio_spi_dma_t *d) {
+    while (!spi_xfer_queue_idle(&d->queue))
+        tight_loop_contents();
+}
+
+#endif
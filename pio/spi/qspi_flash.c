@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "qspi_flash.h"
+
+// A byte on one lane: each bit in IO0, with WP and HOLD (IO2, IO3) high
+static uint32_t single_lane(uint8_t byte) {
+    uint32_t word = 0;
+    for (int i = 7; i >= 0; --i)
+        word = word << 4 | 0xc | ((byte >> i) & 1u);
+    return word;
+}
+
+// A byte received on one lane, in IO1, from 8 nibbles in 4 bytes
+static uint8_t single_lane_in(const uint8_t *rx) {
+    uint8_t byte = 0;
+    for (int i = 0; i < 4; ++i) {
+        byte = (uint8_t) (byte << 1 | ((rx[i] >> 5) & 1u));
+        byte = (uint8_t) (byte << 1 | ((rx[i] >> 1) & 1u));
+    }
+    return byte;
+}
+
+static void flash_wait(qspi_flash_t *f) {
+    if (f->wait)
+        f->wait(f->wait_ctx);
+}
+
+static void submit(qspi_flash_t *f, spi_xfer_t *xfer) {
+    // The queue may be shared, and full for now
+    while (!spi_xfer_submit(f->queue, xfer))
+        flash_wait(f);
+}
+
+static void wait_xfer(qspi_flash_t *f, const spi_xfer_t *xfer) {
+    while (!spi_xfer_is_done(xfer))
+        flash_wait(f);
+}
+
+// Our transfers must be finished before they are reused
+static void wait_xfers(qspi_flash_t *f) {
+    for (uint32_t i = 0; i < 2; ++i)
+        wait_xfer(f, &f->xfer[i]);
+}
+
+// A command, then a 24 bit address if with_addr, on one lane. More prefix can
+// be added after the words used.
+static spi_xfer_t *command(qspi_flash_t *f, uint32_t i, uint8_t cmd, bool with_addr, uint32_t addr) {
+    spi_xfer_t *xfer = &f->xfer[i];
+    uint32_t *prefix = f->prefix[i];
+    memset(xfer, 0, sizeof(*xfer));
+    xfer->quad = true;
+    xfer->prefix = prefix;
+    prefix[0] = single_lane(cmd);
+    xfer->prefix_nibbles = 8;
+    if (with_addr) {
+        prefix[1] = single_lane((uint8_t) (addr >> 16));
+        prefix[2] = single_lane((uint8_t) (addr >> 8));
+        prefix[3] = single_lane((uint8_t) addr);
+        xfer->prefix_nibbles = 32;
+    }
+    return xfer;
+}
+
+static uint8_t read_register(qspi_flash_t *f, uint8_t cmd) {
+    wait_xfers(f);
+    spi_xfer_t *xfer = command(f, 0, cmd, false, 0);
+    xfer->rx = &f->status_rx;
+    xfer->rx_len = sizeof(f->status_rx);
+    submit(f, xfer);
+    wait_xfer(f, xfer);
+    return single_lane_in((const uint8_t *) &f->status_rx);
+}
+
+void qspi_flash_init(qspi_flash_t *f, spi_xfer_queue_t *queue, uint8_t read_cmd, void (*wait)(void *ctx),
+                     void *wait_ctx) {
+    memset(f, 0, sizeof(*f));
+    f->queue = queue;
+    f->read_cmd = read_cmd;
+    f->wait = wait;
+    f->wait_ctx = wait_ctx;
+    f->xfer[0].done = true;
+    f->xfer[1].done = true;
+}
+
+uint32_t qspi_flash_jedec_id(qspi_flash_t *f) {
+    qspi_flash_wait_ready(f);
+    wait_xfers(f);
+    uint8_t rx[12];
+    spi_xfer_t *xfer = command(f, 0, QSPI_FLASH_CMD_JEDEC_ID, false, 0);
+    xfer->rx = rx;
+    xfer->rx_len = sizeof(rx);
+    submit(f, xfer);
+    wait_xfer(f, xfer);
+    return (uint32_t) single_lane_in(rx) << 16 | (uint32_t) single_lane_in(rx + 4) << 8 | single_lane_in(rx + 8);
+}
+
+bool qspi_flash_enable_quad(qspi_flash_t *f) {
+    qspi_flash_wait_ready(f);
+    uint8_t status2 = read_register(f, QSPI_FLASH_CMD_STATUS2);
+    if (status2 & QSPI_FLASH_STATUS2_QE_MASK)
+        return true;
+    submit(f, command(f, 0, QSPI_FLASH_CMD_WRITE_EN, false, 0));
+    spi_xfer_t *xfer = command(f, 1, QSPI_FLASH_CMD_WRITE_STATUS2, false, 0);
+    f->prefix[1][1] = single_lane(status2 | QSPI_FLASH_STATUS2_QE_MASK);
+    xfer->prefix_nibbles = 16;
+    submit(f, xfer);
+    f->maybe_busy = true;
+    qspi_flash_wait_ready(f);
+    return read_register(f, QSPI_FLASH_CMD_STATUS2) & QSPI_FLASH_STATUS2_QE_MASK;
+}
+
+void qspi_flash_read(qspi_flash_t *f, uint32_t addr, uint8_t *buf, uint32_t len) {
+    qspi_flash_wait_ready(f);
+    wait_xfers(f);
+    while (len) {
+        uint32_t n = len < QSPI_FLASH_MAX_READ ? len : QSPI_FLASH_MAX_READ;
+        spi_xfer_t *xfer;
+        if (f->read_cmd == QSPI_FLASH_CMD_READ_QUAD_IO) {
+            xfer = command(f, 0, f->read_cmd, false, 0);
+            // Address, then mode bits (not continuous read), then 4 dummy
+            // clocks, all on four lanes
+            f->prefix[0][1] = addr << 8 | 0xff;
+            f->prefix[0][2] = 0xffff0000;
+            xfer->prefix_nibbles = 20;
+        } else {
+            xfer = command(f, 0, f->read_cmd, true, addr);
+            // 8 dummy clocks
+            f->prefix[0][4] = 0xcccccccc;
+            xfer->prefix_nibbles = 40;
+        }
+        xfer->rx = buf;
+        xfer->rx_len = n;
+        submit(f, xfer);
+        wait_xfer(f, xfer);
+        addr += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+void qspi_flash_start_page_program(qspi_flash_t *f, uint32_t addr, const uint8_t *data) {
+    qspi_flash_wait_ready(f);
+    wait_xfers(f);
+    submit(f, command(f, 0, QSPI_FLASH_CMD_WRITE_EN, false, 0));
+    spi_xfer_t *xfer = command(f, 1, QSPI_FLASH_CMD_PAGE_PROGRAM_QUAD, true, addr);
+    xfer->tx = data;
+    xfer->tx_len = QSPI_FLASH_PAGE_SIZE;
+    submit(f, xfer);
+    f->maybe_busy = true;
+}
+
+void qspi_flash_start_sector_erase(qspi_flash_t *f, uint32_t addr) {
+    qspi_flash_wait_ready(f);
+    wait_xfers(f);
+    submit(f, command(f, 0, QSPI_FLASH_CMD_WRITE_EN, false, 0));
+    submit(f, command(f, 1, QSPI_FLASH_CMD_SECTOR_ERASE, true, addr));
+    f->maybe_busy = true;
+}
+
+bool qspi_flash_busy(qspi_flash_t *f) {
+    if (!f->maybe_busy)
+        return false;
+    ++f->status_polls;
+    f->maybe_busy = read_register(f, QSPI_FLASH_CMD_STATUS) & QSPI_FLASH_STATUS_BUSY_MASK;
+    return f->maybe_busy;
+}
+
+void qspi_flash_wait_ready(qspi_flash_t *f) {
+    while (qspi_flash_busy(f))
+        flash_wait(f);
+}
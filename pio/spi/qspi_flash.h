@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _QSPI_FLASH_H
+#define _QSPI_FLASH_H
+
+#include "spi_xfer_queue.h"
+
+// Serial NOR flash (e.g. Winbond W25Q) over the quad SPI program in spi.pio,
+// with transfers going through a spi_xfer_queue_t.
+//
+// Reads use one of the quad read commands. Programming (quad page program)
+// and erasing only start the operation and return, so the caller can get on
+// with something else whilst the flash is busy. The flash's status register
+// is read over the bus to find when it's done, and anything which needs the
+// flash waits for that first.
+//
+// Commands, addresses and status are sent and received a bit per nibble,
+// with WP and HOLD high, so nothing needs to switch programs and this works
+// before the Quad Enable bit is set.
+//
+// Whilst waiting, the wait function (if any) is called, e.g. to move a
+// simulation on.
+
+#define QSPI_FLASH_PAGE_SIZE   256
+#define QSPI_FLASH_SECTOR_SIZE 4096
+
+// Quad output: command and address on one lane, 8 dummy clocks, data on four
+#define QSPI_FLASH_CMD_READ_QUAD_OUT 0x6b
+// Quad I/O: command on one lane, address, mode and 4 dummy clocks on four
+#define QSPI_FLASH_CMD_READ_QUAD_IO  0xeb
+
+#define QSPI_FLASH_CMD_WRITE_STATUS2 0x31
+#define QSPI_FLASH_CMD_PAGE_PROGRAM_QUAD 0x32
+#define QSPI_FLASH_CMD_STATUS        0x05
+#define QSPI_FLASH_CMD_STATUS2       0x35
+#define QSPI_FLASH_CMD_WRITE_EN      0x06
+#define QSPI_FLASH_CMD_SECTOR_ERASE  0x20
+#define QSPI_FLASH_CMD_JEDEC_ID      0x9f
+
+#define QSPI_FLASH_STATUS_BUSY_MASK  0x01
+#define QSPI_FLASH_STATUS_WEL_MASK   0x02
+#define QSPI_FLASH_STATUS2_QE_MASK   0x02
+
+// Longest read transfer: the state machine counts up to 0xffff nibbles
+#define QSPI_FLASH_MAX_READ 0x7ff0
+
+typedef struct {
+    spi_xfer_queue_t *queue;
+    uint8_t read_cmd;
+    void (*wait)(void *ctx);
+    void *wait_ctx;
+    // Set when a program or erase may still be running
+    bool maybe_busy;
+    // A write enable and the command it enables can be queued together
+    spi_xfer_t xfer[2];
+    uint32_t prefix[2][5];
+    uint32_t status_rx;
+    uint32_t status_polls;
+} qspi_flash_t;
+
+void qspi_flash_init(qspi_flash_t *f, spi_xfer_queue_t *queue, uint8_t read_cmd, void (*wait)(void *ctx),
+                     void *wait_ctx);
+
+// Returns the manufacturer and device ID, e.g. 0xef4017, or 0 or 0xffffff if
+// nothing is there
+uint32_t qspi_flash_jedec_id(qspi_flash_t *f);
+
+// Sets the Quad Enable bit, if it isn't already set. Returns false if it
+// won't stay set.
+bool qspi_flash_enable_quad(qspi_flash_t *f);
+
+// addr and len must be multiples of 4
+void qspi_flash_read(qspi_flash_t *f, uint32_t addr, uint8_t *buf, uint32_t len);
+
+// These start the operation and return. The data must stay put until
+// qspi_flash_busy() returns false.
+void qspi_flash_start_page_program(qspi_flash_t *f, uint32_t addr, const uint8_t *data);
+void qspi_flash_start_sector_erase(qspi_flash_t *f, uint32_t addr);
+
+// Reads the status register, unless nothing has been started since it last
+// said the flash was idle
+bool qspi_flash_busy(qspi_flash_t *f);
+
+void qspi_flash_wait_ready(qspi_flash_t *f);
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "pio_spi.h"
+#include "pio_spi_dma.h"
+
+// The spi_loopback example sends 20 bytes at a time, with the processor
+// feeding the FIFOs a byte at a time until it's done. Here the same loopback
+// connection (MOSI wired to MISO) is driven by DMA, with 8, 16 and 32 bit
+// frames, and transfers are queued to run back to back whilst the processor
+// gets on with something else.
+//
+// The transfer queue runs over a simulated loopback connection before the
+// real one. The data rate at each clock divider is printed next to the line
+// rate and what the blocking functions achieve.
+//
+// The quad program can't be looped back like this, as it uses its pins in
+// both directions; see the pio_spi_flash_blockdev example for that.
+
+#define PIN_SCK 18
+#define PIN_MOSI 16
+#define PIN_MISO 16 // same as MOSI, so we get loopback
+
+#define DMA_IRQ_INDEX 0
+
+#define BUF_SIZE 4096
+#define N_XFERS 4
+
+static uint8_t txbuf[BUF_SIZE];
+static uint8_t rxbuf[BUF_SIZE];
+
+static uint32_t done_order[SPI_XFER_QUEUE_LEN + 1];
+static uint32_t n_done;
+
+static void record_done(spi_xfer_t *xfer) {
+    done_order[n_done++] = (uint32_t) (uintptr_t) xfer->user;
+}
+
+static void fill_random(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; ++i)
+        buf[i] = rand() >> 16;
+}
+
+// Transfers of different sizes, queued together, must finish in order, each
+// receiving what it sent, at the time the bit rate says
+static bool check_scheduler(void) {
+    spi_xfer_queue_t q;
+    spi_loopback_sim_t sim;
+    const uint32_t bit_ns = 32, overhead_ns = 500;
+    spi_loopback_sim_init(&sim, &q, 8, bit_ns, overhead_ns);
+
+    static spi_xfer_t xfers[SPI_XFER_QUEUE_LEN + 1];
+    fill_random(txbuf, BUF_SIZE);
+    memset(rxbuf, 0, BUF_SIZE);
+    n_done = 0;
+    uint32_t offset = 0;
+    uint64_t expect_ns = 0;
+    for (uint i = 0; i < count_of(xfers); ++i) {
+        uint32_t len = 1 + (rand() >> 16) % (BUF_SIZE / count_of(xfers));
+        xfers[i] = (spi_xfer_t) {
+                .tx = txbuf + offset,
+                .rx = rxbuf + offset,
+                .tx_len = len,
+                .rx_len = len,
+                .on_done = record_done,
+                .user = (void *) (uintptr_t) i,
+        };
+        if (!spi_xfer_submit(&q, &xfers[i])) {
+            printf("Transfer %u was refused\n", i);
+            return false;
+        }
+        offset += len;
+        expect_ns += overhead_ns + 8ull * len * bit_ns;
+    }
+    // One running and the rest queued, so one more won't fit
+    spi_xfer_t extra = {.tx = txbuf, .tx_len = 1};
+    if (spi_xfer_submit(&q, &extra)) {
+        printf("Full queue took another transfer\n");
+        return false;
+    }
+    spi_xfer_t bad = {.quad = true, .prefix_nibbles = 2, .tx = txbuf, .tx_len = 4};
+    if (spi_xfer_submit(&q, &bad)) {
+        printf("Malformed transfer was accepted\n");
+        return false;
+    }
+
+    // Step through time, checking nothing finishes early
+    while (!spi_xfer_queue_idle(&q)) {
+        spi_loopback_sim_advance(&sim, 1000);
+        for (uint i = 0; i < n_done; ++i) {
+            if (done_order[i] != i) {
+                printf("Transfer %u finished out of order\n", (uint) done_order[i]);
+                return false;
+            }
+        }
+    }
+    if (n_done != count_of(xfers) || sim.finish_ns != expect_ns) {
+        printf("%u transfers finished at %u ns, expected %u at %u ns\n", (uint) n_done, (uint) sim.finish_ns,
+               (uint) count_of(xfers), (uint) expect_ns);
+        return false;
+    }
+    if (memcmp(txbuf, rxbuf, offset)) {
+        printf("Received data doesn't match\n");
+        return false;
+    }
+    for (uint i = 0; i < count_of(xfers); ++i) {
+        if (!spi_xfer_is_done(&xfers[i]))
+            return false;
+    }
+    return true;
+}
+
+static void queue_transfers(pio_spi_dma_t *d, spi_xfer_t *xfers, uint32_t frame_bytes) {
+    uint32_t chunk = BUF_SIZE / N_XFERS;
+    for (uint i = 0; i < N_XFERS; ++i) {
+        xfers[i] = (spi_xfer_t) {
+                .tx = txbuf + i * chunk,
+                .rx = rxbuf + i * chunk,
+                .tx_len = chunk / frame_bytes,
+                .rx_len = chunk / frame_bytes,
+        };
+        hard_assert(pio_spi_dma_submit(d, &xfers[i]));
+    }
+}
+
+// Returns the time taken for BUF_SIZE bytes, as N_XFERS transfers, or 0 if
+// the data didn't come back
+static uint32_t run_dma(pio_spi_dma_t *d) {
+    static spi_xfer_t xfers[N_XFERS];
+    fill_random(txbuf, BUF_SIZE);
+    memset(rxbuf, 0, BUF_SIZE);
+    uint32_t frame_bytes = d->frame_bits / 8;
+
+    uint64_t start = time_us_64();
+    queue_transfers(d, xfers, frame_bytes);
+    // The processor is free to do something else until the last one finishes
+    pio_spi_dma_wait(&xfers[N_XFERS - 1]);
+    uint32_t us = (uint32_t) (time_us_64() - start);
+    return memcmp(txbuf, rxbuf, BUF_SIZE) ? 0 : us;
+}
+
+static uint32_t run_blocking(const pio_spi_inst_t *spi) {
+    fill_random(txbuf, BUF_SIZE);
+    memset(rxbuf, 0, BUF_SIZE);
+    uint64_t start = time_us_64();
+    pio_spi_write8_read8_blocking(spi, txbuf, rxbuf, BUF_SIZE);
+    uint32_t us = (uint32_t) (time_us_64() - start);
+    return memcmp(txbuf, rxbuf, BUF_SIZE) ? 0 : us;
+}
+
+static float mbps(uint32_t us) {
+    return us ? 8.f * BUF_SIZE / (float) us : 0.f;
+}
+
+int main() {
+    stdio_init_all();
+    printf("PIO SPI DMA loopback example\n");
+
+    printf("Transfer queue against simulated loopback: %s\n", check_scheduler() ? "OK" : "Nope");
+
+    pio_spi_inst_t spi = {
+            .pio = pio0,
+            .sm = 0,
+            .cs_pin = PIO_SPI_DMA_NO_CS
+    };
+    uint prog_offs = pio_add_program(spi.pio, &spi_cpha0_program);
+
+    // One instance per frame size, taking turns on the same state machine.
+    // Wide frames are sent from a byte buffer, so their bytes are swapped.
+    static const uint frame_bits[] = {8, 16, 32};
+    static pio_spi_dma_t dma[count_of(frame_bits)];
+    for (uint i = 0; i < count_of(frame_bits); ++i) {
+        pio_spi_init(spi.pio, spi.sm, prog_offs, frame_bits[i], 31.25f, false, false, PIN_SCK, PIN_MOSI, PIN_MISO);
+        pio_spi_dma_init(&dma[i], &spi, frame_bits[i], true, false, DMA_IRQ_INDEX);
+        printf("%2u bit frames, %u queued transfers: %s\n", frame_bits[i], N_XFERS, run_dma(&dma[i]) ? "OK" : "Nope");
+    }
+
+    // SCK is clk_sys / (4 * clkdiv)
+    float sys_mhz = (float) clock_get_hz(clk_sys) / 1e6f;
+    static const uint clkdivs[] = {1, 2, 4, 8, 16};
+    printf("\nMbit/s for %u bytes (0.0 = data didn't come back)\n", BUF_SIZE);
+    printf("clkdiv    line  blocking   DMA 8b  DMA 16b  DMA 32b\n");
+    for (uint d = 0; d < count_of(clkdivs); ++d) {
+        float clkdiv = (float) clkdivs[d];
+        pio_spi_init(spi.pio, spi.sm, prog_offs, 8, clkdiv, false, false, PIN_SCK, PIN_MOSI, PIN_MISO);
+        uint32_t blocking_us = run_blocking(&spi);
+        printf("%6u %7.2f %9.2f", clkdivs[d], sys_mhz / (4.f * clkdiv), mbps(blocking_us));
+        for (uint i = 0; i < count_of(frame_bits); ++i) {
+            pio_spi_init(spi.pio, spi.sm, prog_offs, frame_bits[i], clkdiv, false, false, PIN_SCK, PIN_MOSI,
+                         PIN_MISO);
+            printf(" %8.2f", mbps(run_dma(&dma[i])));
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/binary_info.h"
+#include "hardware/clocks.h"
+#include "pio_spi_dma.h"
+#include "flash_blockdev.h"
+#include "flash_chip_emu.h"
+
+// The spi_flash example reads, programs and erases a serial flash chip a
+// byte at a time on one data line, and waits for each program and erase to
+// finish. Here the chip is driven on four data lines, with DMA, and wrapped
+// in a block device with a write-back sector cache, ready for a filesystem.
+//
+// Everything above the PIO and DMA is first run against an emulated chip,
+// which checks every command it's sent: a random mix of reads and writes is
+// checked against a copy of what should be there, then sequential and random
+// I/O is timed (in simulated time, with the chip's real program and erase
+// times), with the cache and without it (syncing after every write), and
+// with both quad read commands.
+//
+// Then, if a chip is connected, the same is done for real. This erases the
+// first FLASH_SIZE bytes of the chip.
+//
+// Connections: IO0-IO3 (DI, DO, WP, HOLD) go on four consecutive pins from
+// PIN_IO0. WP and HOLD are pulled up here, but want pull-ups on the board
+// if the chip is to be left with its Quad Enable bit clear.
+
+#define PIN_CS 5
+#define PIN_SCK 6
+#define PIN_IO0 7
+
+// SCK is clk_sys / (2 * CLKDIV)
+#define CLKDIV 4.f
+
+#define FLASH_SIZE (64 * 1024)
+#define N_BLOCKS (FLASH_SIZE / FLASH_BD_BLOCK_SIZE)
+#define N_RANDOM_OPS 2000
+
+static uint8_t emu_mem[FLASH_SIZE];
+// What the block device should hold
+static uint8_t model[FLASH_SIZE];
+static uint8_t buf[8 * FLASH_BD_BLOCK_SIZE];
+
+static flash_chip_emu_t emu;
+static spi_xfer_queue_t emu_queue;
+
+static uint64_t emu_now_ns(void) {
+    return emu.now_ns;
+}
+
+static uint64_t real_now_ns(void) {
+    return time_us_64() * 1000;
+}
+
+static void fill_random(uint8_t *p, size_t len) {
+    for (size_t i = 0; i < len; ++i)
+        p[i] = rand() >> 16;
+}
+
+static bool check_random_ops(flash_bd_t *bd) {
+    for (uint op = 0; op < N_RANDOM_OPS; ++op) {
+        uint32_t count = 1 + (rand() >> 16) % 8;
+        uint32_t block = (rand() >> 16) % (N_BLOCKS - count + 1);
+        uint8_t *expect = model + block * FLASH_BD_BLOCK_SIZE;
+        uint32_t len = count * FLASH_BD_BLOCK_SIZE;
+        uint r = (rand() >> 16) % 16;
+        if (r < 7) {
+            fill_random(buf, len);
+            // Some writes only clear bits, which needs no erase
+            if (r == 0)
+                for (uint32_t i = 0; i < len; ++i)
+                    buf[i] &= expect[i];
+            flash_bd_write(bd, block, buf, count);
+            memcpy(expect, buf, len);
+        } else if (r < 15) {
+            flash_bd_read(bd, block, buf, count);
+            if (memcmp(buf, expect, len)) {
+                printf("Read of blocks %u-%u after %u operations doesn't match\n", (uint) block,
+                       (uint) (block + count - 1), op);
+                return false;
+            }
+        } else {
+            flash_bd_sync(bd);
+        }
+        flash_bd_poll(bd);
+    }
+    // Everything should end up in flash, whatever the cache did
+    flash_bd_sync(bd);
+    flash_bd_init(bd, bd->flash, bd->base, FLASH_SIZE);
+    for (uint32_t block = 0; block < N_BLOCKS; block += 8) {
+        flash_bd_read(bd, block, buf, 8);
+        if (memcmp(buf, model + block * FLASH_BD_BLOCK_SIZE, sizeof(buf))) {
+            printf("Flash doesn't match after sync, at block %u\n", (uint) block);
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    bool write;
+    bool random;
+    // Write back after every write, as if there were no cache
+    bool write_through;
+} workload_t;
+
+static const workload_t workloads[] = {
+        {"sequential write", true, false, false},
+        {"  write-through", true, false, true},
+        {"random write", true, true, false},
+        {"  write-through", true, true, true},
+        {"sequential read", false, false, false},
+        {"random read", false, true, false},
+};
+
+// Returns kB/s for N_BLOCKS single block reads or writes, starting with an
+// empty cache
+static float run_workload(flash_bd_t *bd, const workload_t *w, uint64_t (*now_ns)(void)) {
+    static uint8_t fill;
+    flash_bd_init(bd, bd->flash, bd->base, FLASH_SIZE);
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < N_BLOCKS; ++i) {
+        uint32_t block = w->random ? (uint32_t) (rand() >> 16) % N_BLOCKS : i;
+        if (w->write) {
+            // A different fill each time, so every write changes something
+            memset(buf, ++fill, FLASH_BD_BLOCK_SIZE);
+            flash_bd_write(bd, block, buf, 1);
+            if (w->write_through)
+                flash_bd_sync(bd);
+        } else {
+            flash_bd_read(bd, block, buf, 1);
+        }
+    }
+    flash_bd_sync(bd);
+    uint64_t ns = now_ns() - start;
+    return ns ? (float) N_BLOCKS * FLASH_BD_BLOCK_SIZE * 1e6f / (float) ns : 0.f;
+}
+
+static void benchmark(flash_bd_t *bd, uint64_t (*now_ns)(void)) {
+    printf("%-17s %9s %7s %9s %7s %7s\n", "", "kB/s", "erases", "no erase", "pages", "fetches");
+    for (uint i = 0; i < count_of(workloads); ++i) {
+        float kbps = run_workload(bd, &workloads[i], now_ns);
+        const flash_bd_stats_t *stats = &bd->stats;
+        printf("%-17s %9.1f %7u %9u %7u %7u\n", workloads[i].name, kbps, (uint) stats->erases,
+               (uint) stats->erases_avoided, (uint) stats->pages_programmed, (uint) stats->sector_fetches);
+    }
+}
+
+static void run_all(qspi_flash_t *flash, uint32_t base, uint64_t (*now_ns)(void), bool (*errors_ok)(void)) {
+    static flash_bd_t bd;
+    static const uint8_t read_cmds[] = {QSPI_FLASH_CMD_READ_QUAD_OUT, QSPI_FLASH_CMD_READ_QUAD_IO};
+    for (uint i = 0; i < count_of(read_cmds); ++i) {
+        flash->read_cmd = read_cmds[i];
+        printf("Reading with command %02x\n", read_cmds[i]);
+        flash_bd_init(&bd, flash, base, FLASH_SIZE);
+        // Start from what's there now
+        flash_bd_read(&bd, 0, model, N_BLOCKS);
+        bool ok = check_random_ops(&bd);
+        if (errors_ok)
+            ok = ok && errors_ok();
+        printf("Random reads and writes: %s\n", ok ? "OK" : "Nope");
+        benchmark(&bd, now_ns);
+    }
+}
+
+static bool emu_errors_ok(void) {
+    if (emu.errors)
+        printf("The emulated chip saw %u bad commands\n", (uint) emu.errors);
+    return !emu.errors;
+}
+
+int main() {
+    stdio_init_all();
+    printf("PIO SPI flash block device example\n");
+
+    // Emulated, at the same SCK frequency as the real one
+    uint32_t nibble_ns = (uint32_t) (2.f * CLKDIV * 1e9f / (float) clock_get_hz(clk_sys));
+    static qspi_flash_t flash;
+    flash_chip_emu_init(&emu, &emu_queue, emu_mem, FLASH_SIZE, nibble_ns);
+    qspi_flash_init(&flash, &emu_queue, QSPI_FLASH_CMD_READ_QUAD_IO, flash_chip_emu_wait, &emu);
+    printf("\nEmulated chip, ID %06x, quad enable %s\n", (uint) qspi_flash_jedec_id(&flash),
+           qspi_flash_enable_quad(&flash) ? "OK" : "failed");
+    run_all(&flash, 0, emu_now_ns, emu_errors_ok);
+
+    // The real one
+    bi_decl(bi_3pins_with_names(PIN_CS, "Flash CS", PIN_SCK, "Flash SCK", PIN_IO0, "Flash IO0"));
+    gpio_init(PIN_CS);
+    gpio_put(PIN_CS, 1);
+    gpio_set_dir(PIN_CS, GPIO_OUT);
+    gpio_pull_up(PIN_IO0 + 2);
+    gpio_pull_up(PIN_IO0 + 3);
+    pio_spi_inst_t spi = {
+            .pio = pio0,
+            .sm = 0,
+            .cs_pin = PIN_CS
+    };
+    uint prog_offs = pio_add_program(spi.pio, &spi_quad_program);
+    pio_spi_quad_init(spi.pio, spi.sm, prog_offs, CLKDIV, PIN_SCK, PIN_IO0);
+    static pio_spi_dma_t dma;
+    pio_spi_dma_init(&dma, &spi, 32, true, true, 0);
+    qspi_flash_init(&flash, &dma.queue, QSPI_FLASH_CMD_READ_QUAD_IO, NULL, NULL);
+    uint32_t id = qspi_flash_jedec_id(&flash);
+    if (id == 0 || id == 0xffffff) {
+        printf("\nNo flash chip found\n");
+        return 0;
+    }
+    printf("\nFlash chip, ID %06x\n", (uint) id);
+    if (!qspi_flash_enable_quad(&flash)) {
+        printf("Couldn't set the Quad Enable bit\n");
+        return 0;
+    }
+    run_all(&flash, 0, real_now_ns, NULL);
+    return 0;
+}
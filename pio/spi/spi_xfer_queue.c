@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "spi_xfer_queue.h"
+
+void spi_xfer_queue_init(spi_xfer_queue_t *q, const spi_xfer_backend_t *backend) {
+    memset(q, 0, sizeof(*q));
+    q->backend = *backend;
+}
+
+static bool xfer_valid(const spi_xfer_t *xfer) {
+    if (xfer->quad) {
+        if (xfer->rx_len % 4 || xfer->tx_len % 4 || (xfer->tx_len && xfer->prefix_nibbles % 8))
+            return false;
+        if (xfer->prefix_nibbles && !xfer->prefix)
+            return false;
+        if ((xfer->tx_len && !xfer->tx) || (xfer->rx_len && !xfer->rx))
+            return false;
+        // The state machine counts in 16 bits, and must send something
+        uint32_t nibbles_out = xfer->prefix_nibbles + 2 * xfer->tx_len;
+        return nibbles_out && nibbles_out <= 0x10000 && 2 * xfer->rx_len < 0x10000;
+    }
+    if (xfer->rx && xfer->tx && xfer->rx_len != xfer->tx_len)
+        return false;
+    return xfer->tx_len != 0;
+}
+
+bool spi_xfer_submit(spi_xfer_queue_t *q, spi_xfer_t *xfer) {
+    if (!xfer->quad && !xfer->tx)
+        xfer->tx_len = xfer->rx_len;
+    if (!xfer_valid(xfer))
+        return false;
+    xfer->done = false;
+
+    uint32_t saved = q->backend.lock(q->backend.ctx);
+    bool ok = true;
+    if (!q->current) {
+        q->current = xfer;
+        q->backend.start(q->backend.ctx, xfer);
+    } else if (q->count < SPI_XFER_QUEUE_LEN) {
+        q->queue[(q->head + q->count++) % SPI_XFER_QUEUE_LEN] = xfer;
+    } else {
+        ok = false;
+    }
+    q->backend.unlock(q->backend.ctx, saved);
+    return ok;
+}
+
+void spi_xfer_queue_complete(spi_xfer_queue_t *q) {
+    spi_xfer_t *xfer = q->current;
+    if (!xfer)
+        return;
+    // Start the next transfer first, so the bus is idle for as little time as
+    // possible
+    if (q->count) {
+        q->current = q->queue[q->head];
+        q->head = (q->head + 1) % SPI_XFER_QUEUE_LEN;
+        q->count--;
+        q->backend.start(q->backend.ctx, q->current);
+    } else {
+        q->current = NULL;
+    }
+    q->completed++;
+    xfer->done = true;
+    if (xfer->on_done)
+        xfer->on_done(xfer);
+}
+
+// The simulation is single threaded, so there is nothing to lock out
+static uint32_t sim_lock(void *ctx) {
+    (void) ctx;
+    return 0;
+}
+
+static void sim_unlock(void *ctx, uint32_t saved) {
+    (void) ctx;
+    (void) saved;
+}
+
+static void sim_start(void *ctx, spi_xfer_t *xfer) {
+    spi_loopback_sim_t *sim = ctx;
+    sim->active = xfer;
+    uint64_t bits = xfer->quad ? spi_xfer_units(xfer) : (uint64_t) spi_xfer_units(xfer) * sim->frame_bits;
+    // A transfer queued behind another starts when that one finishes
+    uint64_t start_ns = sim->finish_ns > sim->now_ns ? sim->finish_ns : sim->now_ns;
+    sim->finish_ns = start_ns + sim->overhead_ns + bits * sim->bit_ns;
+    sim->bits += bits;
+}
+
+static void sim_finish(spi_loopback_sim_t *sim, spi_xfer_t *xfer) {
+    if (xfer->quad) {
+        if (xfer->rx)
+            memset(xfer->rx, 0xff, xfer->rx_len);
+    } else if (xfer->rx) {
+        uint32_t bytes = xfer->rx_len * ((sim->frame_bits + 7) / 8);
+        if (xfer->tx)
+            memcpy(xfer->rx, xfer->tx, bytes);
+        else
+            memset(xfer->rx, 0, bytes);
+    }
+}
+
+void spi_loopback_sim_init(spi_loopback_sim_t *sim, spi_xfer_queue_t *q, uint32_t frame_bits, uint32_t bit_ns,
+                           uint32_t overhead_ns) {
+    memset(sim, 0, sizeof(*sim));
+    sim->queue = q;
+    sim->frame_bits = frame_bits;
+    sim->bit_ns = bit_ns;
+    sim->overhead_ns = overhead_ns;
+    spi_xfer_backend_t backend = {
+            .start = sim_start,
+            .lock = sim_lock,
+            .unlock = sim_unlock,
+            .ctx = sim,
+    };
+    spi_xfer_queue_init(q, &backend);
+}
+
+void spi_loopback_sim_advance(spi_loopback_sim_t *sim, uint64_t ns) {
+    uint64_t end_ns = sim->now_ns + ns;
+    while (sim->active && sim->finish_ns <= end_ns) {
+        spi_xfer_t *xfer = sim->active;
+        sim->now_ns = sim->finish_ns;
+        sim->active = NULL;
+        sim_finish(sim, xfer);
+        // This may start the next transfer
+        spi_xfer_queue_complete(sim->queue);
+    }
+    sim->now_ns = end_ns;
+}
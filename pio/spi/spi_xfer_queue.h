@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _SPI_XFER_QUEUE_H
+#define _SPI_XFER_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Queue of SPI transfers, run back to back.
+//
+// spi_xfer_submit() adds a transfer to the queue, starting it at once if the
+// bus is idle. When the backend has finished a transfer it calls
+// spi_xfer_queue_complete(), usually from its DMA interrupt, which marks the
+// transfer done, calls its on_done function, and starts the next one. So
+// each transfer can be waited for on its own, by polling spi_xfer_is_done()
+// (like a future), or handled in its callback.
+//
+// The backend does the transfers: pio_spi_dma.h drives PIO SPI with a pair
+// of DMA channels, and spi_loopback_sim_init() simulates a loopback
+// connection, with the same timing.
+
+#define SPI_XFER_QUEUE_LEN 16
+
+typedef struct spi_xfer spi_xfer_t;
+typedef void (*spi_xfer_done_fn)(spi_xfer_t *xfer);
+
+struct spi_xfer {
+    // Full duplex transfers send tx_len frames and receive as many, so if both
+    // tx and rx are given, rx_len must equal tx_len. Without tx, zeros are
+    // sent, and without rx, what is received is thrown away.
+    //
+    // Quad transfers send prefix_nibbles nibbles from prefix, written by the
+    // processor (e.g. a command, address and dummy cycles), then tx_len bytes
+    // from tx, then receive rx_len bytes into rx. prefix_nibbles must be a
+    // multiple of 8 if there is tx data, and tx_len and rx_len multiples of 4.
+    bool quad;
+    const uint32_t *prefix;
+    uint32_t prefix_nibbles;
+    const void *tx;
+    uint32_t tx_len;
+    void *rx;
+    uint32_t rx_len;
+    spi_xfer_done_fn on_done;
+    void *user;
+    // Set once the transfer has finished
+    volatile bool done;
+};
+
+typedef struct {
+    void (*start)(void *ctx, spi_xfer_t *xfer);
+    // Keep spi_xfer_queue_complete() out whilst the queue is changed, e.g. by
+    // disabling interrupts
+    uint32_t (*lock)(void *ctx);
+    void (*unlock)(void *ctx, uint32_t saved);
+    void *ctx;
+} spi_xfer_backend_t;
+
+typedef struct {
+    spi_xfer_backend_t backend;
+    spi_xfer_t *queue[SPI_XFER_QUEUE_LEN];
+    uint32_t head;
+    uint32_t count;
+    spi_xfer_t *current;
+    uint32_t completed;
+} spi_xfer_queue_t;
+
+void spi_xfer_queue_init(spi_xfer_queue_t *q, const spi_xfer_backend_t *backend);
+
+// Returns false if the transfer is malformed or the queue is full
+bool spi_xfer_submit(spi_xfer_queue_t *q, spi_xfer_t *xfer);
+
+// Called by the backend when the current transfer has finished
+void spi_xfer_queue_complete(spi_xfer_queue_t *q);
+
+static inline bool spi_xfer_is_done(const spi_xfer_t *xfer) {
+    return xfer->done;
+}
+
+static inline bool spi_xfer_queue_idle(const spi_xfer_queue_t *q) {
+    return !*(spi_xfer_t *volatile *) &q->current;
+}
+
+// Frames for a full duplex transfer, or nibbles for a quad one
+static inline uint32_t spi_xfer_units(const spi_xfer_t *xfer) {
+    return xfer->quad ? xfer->prefix_nibbles + 2 * (xfer->tx_len + xfer->rx_len) : xfer->tx_len;
+}
+
+// Header word for a quad transfer, which tells the state machine the number
+// of nibbles to send, minus one, and the number to receive (see spi.pio)
+static inline uint32_t spi_xfer_quad_header(const spi_xfer_t *xfer) {
+    return (xfer->prefix_nibbles + 2 * xfer->tx_len - 1) << 16 | 2 * xfer->rx_len;
+}
+
+// Loopback connection, as if MOSI were wired to MISO: each full duplex
+// transfer receives what it sends. Quad transfers receive 0xff, as from a
+// bus with pull-ups and nothing driving it.
+//
+// Transfers take frame_bits bit periods per frame, or one per nibble, plus
+// overhead_ns each, and are completed by spi_loopback_sim_advance().
+typedef struct {
+    spi_xfer_queue_t *queue;
+    uint32_t frame_bits;
+    uint32_t bit_ns;
+    uint32_t overhead_ns;
+    spi_xfer_t *active;
+    uint64_t now_ns;
+    uint64_t finish_ns;
+    uint64_t bits;
+} spi_loopback_sim_t;
+
+void spi_loopback_sim_init(spi_loopback_sim_t *sim, spi_xfer_queue_t *q, uint32_t frame_bits, uint32_t bit_ns,
+                           uint32_t overhead_ns);
+
+// Move time on, completing any transfers which finish in that time
+void spi_loopback_sim_advance(spi_loopback_sim_t *sim, uint64_t ns);
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the SPI transfer queue (spi_xfer_queue.h), run on the host against
+// the simulated loopback connection. Build with PICO_PLATFORM=host.
+//
+// Transfers must complete in the order they were submitted, each at the time
+// the bit rate and overhead say, including ones submitted from another
+// transfer's on_done, and must receive what the loopback sends back.
+// Malformed transfers and a full queue must be refused. The header word the
+// quad state machine is sent first must be (nibbles out - 1) << 16 | nibbles
+// in.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "spi_xfer_queue.h"
+
+#define BIT_NS 100
+#define OVERHEAD_NS 1000
+
+static spi_xfer_queue_t queue;
+static spi_loopback_sim_t sim;
+
+static spi_xfer_t xfers[SPI_XFER_QUEUE_LEN + 2];
+static uint32_t done_order[SPI_XFER_QUEUE_LEN + 2];
+static uint64_t done_ns[SPI_XFER_QUEUE_LEN + 2];
+static uint n_done;
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static void on_done(spi_xfer_t *xfer) {
+    check(spi_xfer_is_done(xfer), "Done flag in on_done");
+    done_order[n_done] = (uint32_t) (xfer - xfers);
+    done_ns[n_done++] = sim.now_ns;
+}
+
+// Submits the transfer in user when this one is done
+static void on_done_chain(spi_xfer_t *xfer) {
+    on_done(xfer);
+    check(spi_xfer_submit(&queue, (spi_xfer_t *) xfer->user), "Submitting from on_done");
+}
+
+static void reset(uint32_t frame_bits) {
+    spi_loopback_sim_init(&sim, &queue, frame_bits, BIT_NS, OVERHEAD_NS);
+    memset(xfers, 0, sizeof(xfers));
+    n_done = 0;
+}
+
+static void check_order(void) {
+    static uint8_t tx[SPI_XFER_QUEUE_LEN][32], rx[SPI_XFER_QUEUE_LEN][32];
+    reset(8);
+    check(spi_xfer_queue_idle(&queue), "Idle to start with");
+    // The first starts at once, the rest queue behind it
+    uint64_t finish_ns = 0;
+    for (uint i = 0; i < 8; ++i) {
+        for (uint j = 0; j < sizeof(tx[i]); ++j)
+            tx[i][j] = (uint8_t) rand();
+        memset(rx[i], 0xaa, sizeof(rx[i]));
+        uint32_t len = 1 + i * 4;
+        xfers[i] = (spi_xfer_t) {.tx = tx[i], .tx_len = len, .rx = rx[i], .rx_len = len, .on_done = on_done};
+        check(spi_xfer_submit(&queue, &xfers[i]), "Submitting");
+        finish_ns += OVERHEAD_NS + (uint64_t) len * 8 * BIT_NS;
+    }
+    check(!spi_xfer_queue_idle(&queue) && queue.current == &xfers[0] && queue.count == 7, "Queue after submitting");
+    spi_loopback_sim_advance(&sim, OVERHEAD_NS + 8 * BIT_NS - 1);
+    check(!spi_xfer_is_done(&xfers[0]) && !n_done, "First transfer, just before it finishes");
+    spi_loopback_sim_advance(&sim, 1);
+    check(spi_xfer_is_done(&xfers[0]) && !spi_xfer_is_done(&xfers[1]) && n_done == 1, "First transfer");
+    spi_loopback_sim_advance(&sim, finish_ns);
+    check(spi_xfer_queue_idle(&queue) && n_done == 8 && queue.completed == 8, "Every transfer");
+
+    uint64_t t = 0;
+    for (uint i = 0; i < n_done; ++i) {
+        t += OVERHEAD_NS + (uint64_t) (1 + i * 4) * 8 * BIT_NS;
+        check(done_order[i] == i, "Completion order");
+        check(done_ns[i] == t, "Completion time");
+        check(!memcmp(rx[i], tx[i], 1 + i * 4) && rx[i][1 + i * 4] == 0xaa, "Loopback data");
+    }
+    check(sim.bits == finish_ns / BIT_NS - 8 * OVERHEAD_NS / BIT_NS, "Bits sent");
+}
+
+// A transfer submitted from on_done goes behind the ones already queued
+static void check_submit_from_callback(void) {
+    static uint16_t tx[4] = {0x1234, 0x5678, 0x9abc, 0xdef0}, rx[4];
+    reset(16);
+    xfers[0] = (spi_xfer_t) {.tx = tx, .tx_len = 4, .on_done = on_done_chain, .user = &xfers[2]};
+    xfers[1] = (spi_xfer_t) {.rx = rx, .rx_len = 4, .on_done = on_done};
+    xfers[2] = (spi_xfer_t) {.tx = tx, .tx_len = 2, .rx = rx, .rx_len = 2, .on_done = on_done};
+    check(spi_xfer_submit(&queue, &xfers[0]) && spi_xfer_submit(&queue, &xfers[1]), "Submitting two");
+    // Without tx, the length comes from rx
+    check(xfers[1].tx_len == 4, "Length of a receive only transfer");
+    memset(rx, 0xff, sizeof(rx));
+    spi_loopback_sim_advance(&sim, 2 * OVERHEAD_NS + 8 * 16 * BIT_NS);
+    check(n_done == 2 && done_order[0] == 0 && done_order[1] == 1, "Order with a transfer added from on_done");
+    // Zeros are sent when there is no tx data, so zeros come back
+    check(!rx[0] && !rx[3], "Receiving without sending");
+    spi_loopback_sim_advance(&sim, OVERHEAD_NS + 2 * 16 * BIT_NS);
+    check(n_done == 3 && done_order[2] == 2 && rx[0] == 0x1234 && rx[1] == 0x5678 && !rx[2],
+          "Transfer added from on_done");
+    check(spi_xfer_queue_idle(&queue), "Idle at the end");
+}
+
+static void check_refused(void) {
+    static uint8_t buf[64];
+    static const uint32_t prefix[2] = {0x6b000000, 0};
+    reset(8);
+    static const struct {
+        const char *name;
+        spi_xfer_t xfer;
+    } bad[] = {
+            {"Empty transfer", {.tx = buf, .tx_len = 0}},
+            {"Different tx and rx lengths", {.tx = buf, .tx_len = 4, .rx = buf, .rx_len = 5}},
+            {"Quad, nothing to send", {.quad = true, .rx = buf, .rx_len = 4}},
+            {"Quad, rx length not a multiple of 4", {.quad = true, .prefix = prefix, .prefix_nibbles = 8,
+                                                     .rx = buf, .rx_len = 6}},
+            {"Quad, tx after a part word prefix", {.quad = true, .prefix = prefix, .prefix_nibbles = 6,
+                                                   .tx = buf, .tx_len = 4}},
+            {"Quad, prefix missing", {.quad = true, .prefix_nibbles = 8}},
+            {"Quad, rx buffer missing", {.quad = true, .prefix = prefix, .prefix_nibbles = 8, .rx_len = 4}},
+            {"Quad, too many nibbles to send", {.quad = true, .prefix = prefix, .prefix_nibbles = 8,
+                                                .tx = buf, .tx_len = 0x8000}},
+            {"Quad, too many nibbles to receive", {.quad = true, .prefix = prefix, .prefix_nibbles = 8,
+                                                   .rx = buf, .rx_len = 0x8000}},
+    };
+    for (uint i = 0; i < count_of(bad); ++i) {
+        spi_xfer_t xfer = bad[i].xfer;
+        if (spi_xfer_submit(&queue, &xfer) && !errors++)
+            printf("%s was accepted\n", bad[i].name);
+    }
+    check(spi_xfer_queue_idle(&queue), "Idle after refusing");
+
+    // One running, SPI_XFER_QUEUE_LEN waiting, and no room for more
+    for (uint i = 0; i < SPI_XFER_QUEUE_LEN + 2; ++i) {
+        xfers[i] = (spi_xfer_t) {.tx = buf, .tx_len = 1, .on_done = on_done};
+        check(spi_xfer_submit(&queue, &xfers[i]) == (i <= SPI_XFER_QUEUE_LEN), "Filling the queue");
+    }
+    spi_loopback_sim_advance(&sim, 1000000);
+    check(n_done == SPI_XFER_QUEUE_LEN + 1 && !spi_xfer_is_done(&xfers[SPI_XFER_QUEUE_LEN + 1]),
+          "Transfers done after filling the queue");
+}
+
+static void check_quad(void) {
+    static uint32_t data[64], rx[64];
+    static const uint32_t prefix[2] = {0x6b123456, 0x78000000};
+    reset(8);
+    // A fast read: 8 nibbles of command and address, 2 dummy, then 256 bytes in
+    spi_xfer_t read = {.quad = true, .prefix = prefix, .prefix_nibbles = 10, .rx = rx, .rx_len = 256};
+    check(spi_xfer_quad_header(&read) == (9u << 16 | 512u), "Header of a read");
+    // A page program: 8 nibbles of command and address, then 256 bytes out
+    spi_xfer_t program = {.quad = true, .prefix = prefix, .prefix_nibbles = 8, .tx = data, .tx_len = 256};
+    check(spi_xfer_quad_header(&program) == (519u << 16), "Header of a page program");
+    // The most the state machine can count
+    spi_xfer_t longest = {.quad = true, .prefix = prefix, .prefix_nibbles = 8, .tx = data, .tx_len = 0x7ffc,
+                          .rx = rx, .rx_len = 0x7ffc};
+    check(spi_xfer_quad_header(&longest) == (0xffffu << 16 | 0xfff8u), "Header of the longest transfer");
+
+    // The header and units agree for any valid transfer
+    for (uint i = 0; i < 1000; ++i) {
+        spi_xfer_t xfer = {.quad = true, .prefix = prefix, .prefix_nibbles = 8 * (rand() % 3),
+                           .tx = data, .tx_len = 4 * (rand() % 64), .rx = rx, .rx_len = 4 * (rand() % 64)};
+        if (!xfer.prefix_nibbles && !xfer.tx_len)
+            xfer.prefix_nibbles = 8;
+        uint32_t header = spi_xfer_quad_header(&xfer);
+        check((header >> 16) + 1 == xfer.prefix_nibbles + 2 * xfer.tx_len &&
+              (header & 0xffffu) == 2 * xfer.rx_len &&
+              (header >> 16) + 1 + (header & 0xffffu) == spi_xfer_units(&xfer), "Header against the units");
+    }
+
+    // Quad transfers take one bit period per nibble, and receive 0xff
+    memset(rx, 0, sizeof(rx));
+    read.on_done = on_done;
+    check(spi_xfer_submit(&queue, &read), "Submitting a quad read");
+    spi_loopback_sim_advance(&sim, OVERHEAD_NS + (10 + 512) * BIT_NS);
+    check(n_done == 1 && done_ns[0] == OVERHEAD_NS + (10 + 512) * BIT_NS, "Quad read time");
+    check(rx[0] == 0xffffffffu && rx[63] == 0xffffffffu, "Quad read data");
+}
+
+int main() {
+    printf("SPI transfer queue host tests, on the loopback simulation\n");
+    check_order();
+    check_submit_from_callback();
+    check_refused();
+    check_quad();
+    printf(errors ? "FAILED\n" : "All transfer queue checks passed\n");
+    return errors != 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lcd_dirty.h"
+
+void lcd_dirty_init(lcd_dirty_t *dirty, uint16_t width, uint16_t height) {
+    dirty->width = width;
+    dirty->height = height;
+    lcd_dirty_clear(dirty);
+}
+
+void lcd_dirty_clear(lcd_dirty_t *dirty) {
+    dirty->n_rects = 0;
+    dirty->band_rect = 0;
+    dirty->band_row = 0;
+}
+
+static uint32_t rect_cost(const lcd_rect_t *r) {
+    return (uint32_t) r->w * r->h * LCD_BYTES_PER_PIXEL + LCD_DIRTY_WINDOW_COST;
+}
+
+static lcd_rect_t rect_union(const lcd_rect_t *a, const lcd_rect_t *b) {
+    uint16_t x0 = a->x < b->x ? a->x : b->x;
+    uint16_t y0 = a->y < b->y ? a->y : b->y;
+    uint16_t x1 = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+    uint16_t y1 = a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+    return (lcd_rect_t) {x0, y0, (uint16_t) (x1 - x0), (uint16_t) (y1 - y0)};
+}
+
+static void remove_rect(lcd_dirty_t *dirty, unsigned int i) {
+    dirty->rects[i] = dirty->rects[--dirty->n_rects];
+}
+
+void lcd_dirty_add(lcd_dirty_t *dirty, int x, int y, int w, int h) {
+    int x1 = x + w, y1 = y + h;
+    if (x < 0)
+        x = 0;
+    if (y < 0)
+        y = 0;
+    if (x1 > dirty->width)
+        x1 = dirty->width;
+    if (y1 > dirty->height)
+        y1 = dirty->height;
+    if (x1 <= x || y1 <= y)
+        return;
+    lcd_rect_t r = {(uint16_t) x, (uint16_t) y, (uint16_t) (x1 - x), (uint16_t) (y1 - y)};
+
+    // Absorb any rectangles which are cheaper to send together with this one.
+    // The union may now be worth merging with one we've already passed, so
+    // start again after each merge.
+    bool merged;
+    do {
+        merged = false;
+        for (unsigned int i = 0; i < dirty->n_rects; ++i) {
+            lcd_rect_t u = rect_union(&r, &dirty->rects[i]);
+            if (rect_cost(&u) <= rect_cost(&r) + rect_cost(&dirty->rects[i])) {
+                r = u;
+                remove_rect(dirty, i);
+                merged = true;
+                break;
+            }
+        }
+    } while (merged);
+
+    if (dirty->n_rects == LCD_DIRTY_MAX_RECTS) {
+        // Full, so merge the cheapest pair, counting the new one
+        dirty->rects[dirty->n_rects++] = r;
+        unsigned int best_i = 0, best_j = 1;
+        int32_t best = INT32_MAX;
+        for (unsigned int i = 0; i < dirty->n_rects; ++i) {
+            for (unsigned int j = i + 1; j < dirty->n_rects; ++j) {
+                lcd_rect_t u = rect_union(&dirty->rects[i], &dirty->rects[j]);
+                int32_t extra = (int32_t) rect_cost(&u) - (int32_t) rect_cost(&dirty->rects[i]) -
+                                (int32_t) rect_cost(&dirty->rects[j]);
+                if (extra < best) {
+                    best = extra;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        dirty->rects[best_i] = rect_union(&dirty->rects[best_i], &dirty->rects[best_j]);
+        remove_rect(dirty, best_j);
+        return;
+    }
+    dirty->rects[dirty->n_rects++] = r;
+}
+
+uint32_t lcd_dirty_bytes(const lcd_dirty_t *dirty) {
+    uint32_t bytes = 0;
+    for (unsigned int i = 0; i < dirty->n_rects; ++i)
+        bytes += (uint32_t) dirty->rects[i].w * dirty->rects[i].h * LCD_BYTES_PER_PIXEL + LCD_WINDOW_COMMAND_BYTES;
+    return bytes;
+}
+
+void lcd_dirty_start_bands(lcd_dirty_t *dirty, unsigned int band_pixels) {
+    dirty->band_rect = 0;
+    dirty->band_row = 0;
+    dirty->band_pixels = band_pixels;
+}
+
+bool lcd_dirty_next_band(lcd_dirty_t *dirty, lcd_band_t *band) {
+    if (dirty->band_rect >= dirty->n_rects)
+        return false;
+    const lcd_rect_t *r = &dirty->rects[dirty->band_rect];
+    unsigned int rows = dirty->band_pixels / r->w;
+    if (rows > (unsigned int) (r->h - dirty->band_row))
+        rows = r->h - dirty->band_row;
+    band->rect = (lcd_rect_t) {r->x, (uint16_t) (r->y + dirty->band_row), r->w, (uint16_t) rows};
+    band->new_window = dirty->band_row == 0;
+    dirty->band_row += rows;
+    if (dirty->band_row == r->h) {
+        ++dirty->band_rect;
+        dirty->band_row = 0;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _LCD_DIRTY_H
+#define _LCD_DIRTY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Dirty rectangle tracking for displays like the ST7789, which can be
+// updated a window at a time (set the window with CASET and RASET, then write
+// its pixels with RAMWR).
+//
+// Rectangles are merged when sending their bounding box would cost no more
+// than sending them separately, counting LCD_DIRTY_WINDOW_COST bytes for
+// setting up each window. If there are too many rectangles, the pair which is
+// cheapest to merge is merged.
+//
+// Once a frame's changes have been added, the band scheduler splits the
+// rectangles into bands of whole rows which fit in a band buffer, so one band
+// can be sent whilst the next is rendered.
+
+#define LCD_DIRTY_MAX_RECTS 16
+
+// CASET (5 bytes), RASET (5 bytes) and RAMWR (1 byte)
+#define LCD_WINDOW_COMMAND_BYTES 11
+
+// Cost of setting a window, in equivalent pixel data bytes, for merging
+// decisions. This includes the time taken toggling DC and CS between the
+// commands, so is rather more than LCD_WINDOW_COMMAND_BYTES.
+#ifndef LCD_DIRTY_WINDOW_COST
+#define LCD_DIRTY_WINDOW_COST 64
+#endif
+
+#define LCD_BYTES_PER_PIXEL 2
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} lcd_rect_t;
+
+typedef struct {
+    lcd_rect_t rect;
+    // The first band of a rectangle needs its window setting; later bands
+    // carry on where the previous one stopped
+    bool new_window;
+} lcd_band_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    unsigned int n_rects;
+    // One spare, for choosing which pair to merge when full
+    lcd_rect_t rects[LCD_DIRTY_MAX_RECTS + 1];
+    // Band scheduler
+    unsigned int band_rect;
+    uint16_t band_row;
+    unsigned int band_pixels;
+} lcd_dirty_t;
+
+void lcd_dirty_init(lcd_dirty_t *dirty, uint16_t width, uint16_t height);
+
+void lcd_dirty_clear(lcd_dirty_t *dirty);
+
+// Mark an area as changed. It is clipped to the display.
+void lcd_dirty_add(lcd_dirty_t *dirty, int x, int y, int w, int h);
+
+// Bytes to send for the current rectangles, including commands
+uint32_t lcd_dirty_bytes(const lcd_dirty_t *dirty);
+
+// Start splitting the rectangles into bands of at most band_pixels pixels.
+// band_pixels must be at least the display width.
+void lcd_dirty_start_bands(lcd_dirty_t *dirty, unsigned int band_pixels);
+
+// Get the next band, or return false if there are no more
+bool lcd_dirty_next_band(lcd_dirty_t *dirty, lcd_band_t *band);
+
+#endif
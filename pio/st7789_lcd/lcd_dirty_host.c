@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the dirty rectangle tracker (lcd_dirty.h), run on the host. Build
+// with PICO_PLATFORM=host.
+//
+// Clipping and merging are checked with a few rectangles placed by hand.
+// Then random areas are marked, and every pixel of them must be covered by
+// the rectangles, which must stay on the display and within
+// LCD_DIRTY_MAX_RECTS, and the bands must cover each rectangle exactly once.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "lcd_dirty.h"
+
+#define WIDTH 240
+#define HEIGHT 240
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+static bool rect_is(const lcd_rect_t *r, uint x, uint y, uint w, uint h) {
+    return r->x == x && r->y == y && r->w == w && r->h == h;
+}
+
+static void check_clipping(void) {
+    lcd_dirty_t dirty;
+    lcd_dirty_init(&dirty, WIDTH, HEIGHT);
+    lcd_dirty_add(&dirty, -10, -20, 30, 40);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 0, 0, 20, 20), "Clipping at the top left");
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, WIDTH - 5, HEIGHT - 8, 100, 100);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], WIDTH - 5, HEIGHT - 8, 5, 8),
+          "Clipping at the bottom right");
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, -50, 10, 50, 10);
+    lcd_dirty_add(&dirty, WIDTH, 10, 10, 10);
+    lcd_dirty_add(&dirty, 10, HEIGHT + 1, 10, 10);
+    lcd_dirty_add(&dirty, 10, 10, 0, 10);
+    lcd_dirty_add(&dirty, 10, 10, 10, -5);
+    check(dirty.n_rects == 0, "Clipping areas off the display, or empty");
+    lcd_dirty_add(&dirty, -1000, -1000, 3000, 3000);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 0, 0, WIDTH, HEIGHT), "Clipping to the whole display");
+}
+
+static void check_merging(void) {
+    lcd_dirty_t dirty;
+    lcd_dirty_init(&dirty, WIDTH, HEIGHT);
+    // Mostly overlapping, and one inside another
+    lcd_dirty_add(&dirty, 10, 10, 20, 20);
+    lcd_dirty_add(&dirty, 15, 15, 20, 20);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 10, 10, 25, 25), "Merging overlapping rectangles");
+    lcd_dirty_add(&dirty, 15, 15, 5, 5);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 10, 10, 25, 25), "Adding a rectangle already covered");
+
+    // Overlapping corners, but the bounding box would send more than the two
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, 10, 10, 20, 20);
+    lcd_dirty_add(&dirty, 20, 20, 20, 20);
+    check(dirty.n_rects == 2, "Keeping barely overlapping rectangles apart");
+
+    // Far apart, so cheaper to send separately
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, 0, 0, 10, 10);
+    lcd_dirty_add(&dirty, 200, 200, 10, 10);
+    check(dirty.n_rects == 2, "Keeping distant rectangles apart");
+    check(lcd_dirty_bytes(&dirty) == 2 * (10 * 10 * LCD_BYTES_PER_PIXEL + LCD_WINDOW_COMMAND_BYTES),
+          "Bytes for two rectangles");
+
+    // Adjacent rows of a line of text, each cheaper merged with the last
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, 0, 100, 100, 1);
+    lcd_dirty_add(&dirty, 0, 101, 100, 1);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 0, 100, 100, 2), "Merging adjacent rows");
+
+    // Two which are kept apart, until a third bridges the gap between them
+    lcd_dirty_clear(&dirty);
+    lcd_dirty_add(&dirty, 0, 0, 40, 40);
+    lcd_dirty_add(&dirty, 0, 80, 40, 40);
+    check(dirty.n_rects == 2, "Rectangles with a gap between");
+    lcd_dirty_add(&dirty, 0, 40, 40, 40);
+    check(dirty.n_rects == 1 && rect_is(&dirty.rects[0], 0, 0, 40, 120), "Merging across a bridging rectangle");
+
+    // Too many to keep apart: one more merge, and never more than the limit
+    lcd_dirty_clear(&dirty);
+    for (uint i = 0; i < LCD_DIRTY_MAX_RECTS + 4; ++i)
+        lcd_dirty_add(&dirty, (int) (i % 5) * 48, (int) (i / 5) * 48, 4, 4);
+    check(dirty.n_rects == LCD_DIRTY_MAX_RECTS, "Number of rectangles when full");
+}
+
+static uint8_t marked[HEIGHT][WIDTH];
+static uint8_t covered[HEIGHT][WIDTH];
+
+// Random areas, some partly off the display
+static void check_random(uint n_frames) {
+    lcd_dirty_t dirty;
+    lcd_dirty_init(&dirty, WIDTH, HEIGHT);
+    for (uint frame = 0; frame < n_frames && !errors; ++frame) {
+        lcd_dirty_clear(&dirty);
+        memset(marked, 0, sizeof(marked));
+        uint n_areas = 1 + rand() % 40;
+        for (uint i = 0; i < n_areas; ++i) {
+            int x = rand() % (WIDTH + 40) - 20, y = rand() % (HEIGHT + 40) - 20;
+            int w = rand() % 4 ? 1 + rand() % 16 : 1 + rand() % 120;
+            int h = rand() % 4 ? 1 + rand() % 16 : 1 + rand() % 120;
+            lcd_dirty_add(&dirty, x, y, w, h);
+            for (int py = y < 0 ? 0 : y; py < y + h && py < HEIGHT; ++py)
+                for (int px = x < 0 ? 0 : x; px < x + w && px < WIDTH; ++px)
+                    marked[py][px] = 1;
+        }
+        check(dirty.n_rects <= LCD_DIRTY_MAX_RECTS, "Number of rectangles");
+
+        memset(covered, 0, sizeof(covered));
+        for (uint i = 0; i < dirty.n_rects; ++i) {
+            const lcd_rect_t *r = &dirty.rects[i];
+            check(r->w && r->h && r->x + r->w <= WIDTH && r->y + r->h <= HEIGHT, "Rectangle on the display");
+            for (uint py = r->y; py < (uint) (r->y + r->h); ++py)
+                for (uint px = r->x; px < (uint) (r->x + r->w); ++px)
+                    covered[py][px] = 1;
+        }
+        for (uint py = 0; py < HEIGHT; ++py)
+            for (uint px = 0; px < WIDTH; ++px)
+                check(covered[py][px] >= marked[py][px], "Coverage of a marked pixel");
+
+        // Bands go through each rectangle in order, top to bottom
+        uint band_pixels = WIDTH * (1 + rand() % 8);
+        lcd_dirty_start_bands(&dirty, band_pixels);
+        lcd_band_t band;
+        uint rect = 0, row = 0;
+        while (lcd_dirty_next_band(&dirty, &band)) {
+            if (rect >= dirty.n_rects) {
+                check(false, "Number of bands");
+                break;
+            }
+            const lcd_rect_t *r = &dirty.rects[rect];
+            check(band.rect.x == r->x && band.rect.w == r->w && band.rect.y == r->y + row && band.rect.h &&
+                  band.rect.w * band.rect.h <= band_pixels && band.new_window == (row == 0), "Band");
+            row += band.rect.h;
+            if (row >= r->h) {
+                check(row == r->h, "Height of the bands of a rectangle");
+                ++rect;
+                row = 0;
+            }
+        }
+        check(rect == dirty.n_rects && row == 0, "Bands covering every rectangle");
+    }
+}
+
+int main() {
+    printf("LCD dirty rectangle host tests\n");
+    check_clipping();
+    check_merging();
+    const uint n_frames = 2000;
+    check_random(n_frames);
+    printf(errors ? "FAILED\n" : "All dirty rectangle checks passed\n");
+    return errors != 0;
+}
@@ -0,0 +1,328 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Partial updates for the ST7789, fed by DMA.
+//
+// The st7789_lcd example renders every pixel of every frame and pushes it
+// into the PIO FIFO from the processor. Most user interfaces only change a
+// small part of the screen each frame, so here instead:
+//
+// - Each frame's changes are recorded as dirty rectangles, which are merged
+//   when that is cheaper than sending them separately (see lcd_dirty.h).
+//
+// - Only the dirty rectangles are sent, each with its own CASET/RASET window.
+//
+// - Rectangles are split into bands of whole rows. There are two band
+//   buffers: DMA sends one to the PIO FIFO whilst the processor renders the
+//   next into the other. There is no frame buffer.
+//
+// First we print the bytes sent per frame for some typical workloads,
+// compared with sending whole frames, then we run a demo with some bouncing
+// sprites and a progress bar.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+
+#include "st7789_lcd.pio.h"
+#include "lcd_dirty.h"
+
+#define SCREEN_WIDTH 240
+#define SCREEN_HEIGHT 240
+
+#define PIN_DIN 0
+#define PIN_CLK 1
+#define PIN_CS 2
+#define PIN_DC 3
+#define PIN_RESET 4
+#define PIN_BL 5
+
+#define SERIAL_CLK_DIV 1.f
+
+// Each band buffer holds 16 full-width rows
+#define BAND_PIXELS (SCREEN_WIDTH * 16)
+
+#define N_SPRITES 4
+#define SPRITE_SIZE 24
+#define BAR_X 20
+#define BAR_Y 220
+#define BAR_W 200
+#define BAR_H 8
+
+// Format: cmd length (including cmd byte), post delay in units of 5 ms, then cmd payload
+// Note the delays have been shortened a little
+static const uint8_t st7789_init_seq[] = {
+        1, 20, 0x01,                        // Software reset
+        1, 10, 0x11,                        // Exit sleep mode
+        2, 2, 0x3a, 0x55,                   // Set colour mode to 16 bit
+        2, 0, 0x36, 0x00,                   // Set MADCTL: row then column, refresh is bottom to top ????
+        5, 0, 0x2a, 0x00, 0x00, SCREEN_WIDTH >> 8, SCREEN_WIDTH & 0xff,   // CASET: column addresses
+        5, 0, 0x2b, 0x00, 0x00, SCREEN_HEIGHT >> 8, SCREEN_HEIGHT & 0xff, // RASET: row addresses
+        1, 2, 0x21,                         // Inversion on, then 10 ms delay (supposedly a hack?)
+        1, 2, 0x13,                         // Normal display on, then 10 ms delay
+        1, 2, 0x29,                         // Main screen turn on, then wait 500 ms
+        0                                   // Terminate list
+};
+
+static PIO pio = pio0;
+static uint sm = 0;
+static uint dma_chan;
+
+// Pixels are stored byte-swapped, i.e. big-endian in memory, so the DMA can
+// send them a byte at a time, most significant byte first. Byte writes to the
+// FIFO are replicated across the word, the same as st7789_lcd_put().
+static uint16_t band_buf[2][BAND_PIXELS];
+
+static inline void lcd_set_dc_cs(bool dc, bool cs) {
+    sleep_us(1);
+    gpio_put_masked((1u << PIN_DC) | (1u << PIN_CS), !!dc << PIN_DC | !!cs << PIN_CS);
+    sleep_us(1);
+}
+
+static inline void lcd_write_cmd(PIO pio, uint sm, const uint8_t *cmd, size_t count) {
+    st7789_lcd_wait_idle(pio, sm);
+    lcd_set_dc_cs(0, 0);
+    st7789_lcd_put(pio, sm, *cmd++);
+    if (count >= 2) {
+        st7789_lcd_wait_idle(pio, sm);
+        lcd_set_dc_cs(1, 0);
+        for (size_t i = 0; i < count - 1; ++i)
+            st7789_lcd_put(pio, sm, *cmd++);
+    }
+    st7789_lcd_wait_idle(pio, sm);
+    lcd_set_dc_cs(1, 1);
+}
+
+static inline void lcd_init(PIO pio, uint sm, const uint8_t *init_seq) {
+    const uint8_t *cmd = init_seq;
+    while (*cmd) {
+        lcd_write_cmd(pio, sm, cmd + 2, *cmd);
+        sleep_ms(*(cmd + 1) * 5);
+        cmd += *cmd + 2;
+    }
+}
+
+// Set the window and leave the display expecting pixel data (DC high, CS low)
+static void lcd_start_window(PIO pio, uint sm, const lcd_rect_t *r) {
+    uint x1 = r->x + r->w - 1, y1 = r->y + r->h - 1;
+    uint8_t caset[] = {0x2a, r->x >> 8, r->x & 0xff, x1 >> 8, x1 & 0xff};
+    uint8_t raset[] = {0x2b, r->y >> 8, r->y & 0xff, y1 >> 8, y1 & 0xff};
+    uint8_t ramwr = 0x2c;
+    lcd_write_cmd(pio, sm, caset, count_of(caset));
+    lcd_write_cmd(pio, sm, raset, count_of(raset));
+    lcd_write_cmd(pio, sm, &ramwr, 1);
+    lcd_set_dc_cs(1, 0);
+}
+
+// The scene: a background pattern, some bouncing sprites and a progress bar
+
+typedef struct {
+    int x, y;
+    int dx, dy;
+    uint16_t colour;
+} sprite_t;
+
+static sprite_t sprites[N_SPRITES];
+static int bar_fill;
+
+static inline uint16_t rgb565(uint r, uint g, uint b) {
+    return (uint16_t) ((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+}
+
+static inline void fill_span(uint16_t *row, int x0, int x1, int clip0, int clip1, uint16_t colour) {
+    if (x0 < clip0)
+        x0 = clip0;
+    if (x1 > clip1)
+        x1 = clip1;
+    uint16_t swapped = __builtin_bswap16(colour);
+    for (int x = x0; x < x1; ++x)
+        row[x - clip0] = swapped;
+}
+
+static void render_band(const lcd_rect_t *r, uint16_t *buf) {
+    int x0 = r->x, x1 = r->x + r->w;
+    for (int y = r->y; y < r->y + r->h; ++y) {
+        uint16_t *row = buf + (y - r->y) * r->w;
+        for (int x = x0; x < x1; ++x)
+            row[x - x0] = __builtin_bswap16(rgb565(x, y, ((x ^ y) & 16) ? 96 : 64));
+        if (y >= BAR_Y && y < BAR_Y + BAR_H) {
+            fill_span(row, BAR_X, BAR_X + bar_fill, x0, x1, rgb565(0, 255, 0));
+            fill_span(row, BAR_X + bar_fill, BAR_X + BAR_W, x0, x1, rgb565(64, 64, 64));
+        }
+        for (uint i = 0; i < N_SPRITES; ++i) {
+            const sprite_t *s = &sprites[i];
+            if (y >= s->y && y < s->y + SPRITE_SIZE)
+                fill_span(row, s->x, s->x + SPRITE_SIZE, x0, x1, s->colour);
+        }
+    }
+}
+
+// Send the dirty rectangles. DMA sends one band whilst we render the next.
+static void lcd_update(lcd_dirty_t *dirty) {
+    lcd_band_t band[2];
+    uint cur = 0;
+    lcd_dirty_start_bands(dirty, BAND_PIXELS);
+    if (!lcd_dirty_next_band(dirty, &band[cur]))
+        return;
+    render_band(&band[cur].rect, band_buf[cur]);
+    bool more;
+    do {
+        dma_channel_wait_for_finish_blocking(dma_chan);
+        if (band[cur].new_window)
+            lcd_start_window(pio, sm, &band[cur].rect);
+        dma_channel_transfer_from_buffer_now(dma_chan, band_buf[cur],
+                                             band[cur].rect.w * band[cur].rect.h * LCD_BYTES_PER_PIXEL);
+        more = lcd_dirty_next_band(dirty, &band[cur ^ 1]);
+        if (more)
+            render_band(&band[cur ^ 1].rect, band_buf[cur ^ 1]);
+        cur ^= 1;
+    } while (more);
+    dma_channel_wait_for_finish_blocking(dma_chan);
+    st7789_lcd_wait_idle(pio, sm);
+    lcd_set_dc_cs(1, 1);
+}
+
+static void move_sprites(lcd_dirty_t *dirty) {
+    for (uint i = 0; i < N_SPRITES; ++i) {
+        sprite_t *s = &sprites[i];
+        lcd_dirty_add(dirty, s->x, s->y, SPRITE_SIZE, SPRITE_SIZE);
+        if (s->x + s->dx < 0 || s->x + s->dx + SPRITE_SIZE > SCREEN_WIDTH)
+            s->dx = -s->dx;
+        if (s->y + s->dy < 0 || s->y + s->dy + SPRITE_SIZE > BAR_Y)
+            s->dy = -s->dy;
+        s->x += s->dx;
+        s->y += s->dy;
+        lcd_dirty_add(dirty, s->x, s->y, SPRITE_SIZE, SPRITE_SIZE);
+    }
+}
+
+static void init_sprites() {
+    for (uint i = 0; i < N_SPRITES; ++i) {
+        sprites[i] = (sprite_t) {
+                .x = rand() % (SCREEN_WIDTH - SPRITE_SIZE),
+                .y = rand() % (BAR_Y - SPRITE_SIZE),
+                .dx = 1 + rand() % 3,
+                .dy = 1 + rand() % 3,
+                .colour = rgb565(rand() & 0xff, rand() & 0xff, rand() & 0xff),
+        };
+    }
+}
+
+// Bytes per frame for some typical workloads, using only the tracker. The
+// clock is HH:MM:SS, updated once a second, with cells numbered left to right.
+static const uint clock_periods[] = {1, 10, 60, 600, 3600, 36000};
+static const uint clock_cells[] = {7, 6, 4, 3, 1, 0};
+
+static void benchmark_workloads() {
+    static lcd_dirty_t dirty;
+    lcd_dirty_init(&dirty, SCREEN_WIDTH, SCREEN_HEIGHT);
+    const uint n_frames = 100;
+    const uint32_t full_bytes = SCREEN_WIDTH * SCREEN_HEIGHT * LCD_BYTES_PER_PIXEL + LCD_WINDOW_COMMAND_BYTES;
+    const char *names[] = {"full redraw", "clock (HH:MM:SS)", "progress bar", "bouncing sprites", "scrolling list"};
+    init_sprites();
+    printf("%-18s %12s %8s %8s\n", "workload", "bytes/frame", "windows", "% full");
+    for (uint w = 0; w < count_of(names); ++w) {
+        uint64_t bytes = 0, windows = 0;
+        uint32_t tracker_us = 0;
+        for (uint frame = 0; frame < n_frames; ++frame) {
+            uint32_t t0 = time_us_32();
+            lcd_dirty_clear(&dirty);
+            switch (w) {
+                case 0:
+                    lcd_dirty_add(&dirty, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+                    break;
+                case 1:
+                    // Six 24x40 digit cells, changing once a second,
+                    // every ten seconds, every minute and so on
+                    for (uint digit = 0; digit < count_of(clock_periods); ++digit)
+                        if (frame % clock_periods[digit] == 0)
+                            lcd_dirty_add(&dirty, 24 + clock_cells[digit] * 24, 100, 24, 40);
+                    break;
+                case 2:
+                    lcd_dirty_add(&dirty, BAR_X + frame * BAR_W / n_frames, BAR_Y, 2, BAR_H);
+                    break;
+                case 3:
+                    move_sprites(&dirty);
+                    break;
+                case 4:
+                    // Everything below the title bar moves
+                    lcd_dirty_add(&dirty, 0, 32, SCREEN_WIDTH, SCREEN_HEIGHT - 32);
+                    break;
+            }
+            tracker_us += time_us_32() - t0;
+            bytes += lcd_dirty_bytes(&dirty);
+            windows += dirty.n_rects;
+        }
+        printf("%-18s %12u %8u.%02u %7u%%   (tracker %u us/frame)\n", names[w], (uint) (bytes / n_frames),
+               (uint) (windows / n_frames), (uint) (windows % n_frames), (uint) (bytes * 100 / n_frames / full_bytes),
+               (uint) (tracker_us / n_frames));
+    }
+}
+
+int main() {
+    stdio_init_all();
+    printf("ST7789 dirty rectangle example\n");
+
+    benchmark_workloads();
+
+    uint offset = pio_add_program(pio, &st7789_lcd_program);
+    st7789_lcd_program_init(pio, sm, offset, PIN_DIN, PIN_CLK, SERIAL_CLK_DIV);
+
+    gpio_init(PIN_CS);
+    gpio_init(PIN_DC);
+    gpio_init(PIN_RESET);
+    gpio_init(PIN_BL);
+    gpio_set_dir(PIN_CS, GPIO_OUT);
+    gpio_set_dir(PIN_DC, GPIO_OUT);
+    gpio_set_dir(PIN_RESET, GPIO_OUT);
+    gpio_set_dir(PIN_BL, GPIO_OUT);
+
+    gpio_put(PIN_CS, 1);
+    gpio_put(PIN_RESET, 1);
+    lcd_init(pio, sm, st7789_init_seq);
+    gpio_put(PIN_BL, 1);
+
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dma_chan, &c, &pio->txf[sm], NULL, 0, false);
+
+    static lcd_dirty_t dirty;
+    lcd_dirty_init(&dirty, SCREEN_WIDTH, SCREEN_HEIGHT);
+    init_sprites();
+
+    // Draw everything once, then only what changes
+    lcd_dirty_add(&dirty, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    lcd_update(&dirty);
+
+    uint frames = 0;
+    uint64_t bytes = 0;
+    absolute_time_t report_time = make_timeout_time_ms(1000);
+    while (true) {
+        lcd_dirty_clear(&dirty);
+        move_sprites(&dirty);
+        int old_fill = bar_fill;
+        bar_fill = (bar_fill + 1) % (BAR_W + 1);
+        if (bar_fill > old_fill)
+            lcd_dirty_add(&dirty, BAR_X + old_fill, BAR_Y, bar_fill - old_fill, BAR_H);
+        else
+            lcd_dirty_add(&dirty, BAR_X, BAR_Y, BAR_W, BAR_H);
+        bytes += lcd_dirty_bytes(&dirty);
+        lcd_update(&dirty);
+        ++frames;
+        if (absolute_time_diff_us(report_time, get_absolute_time()) >= 0) {
+            printf("%u frames/s, %u bytes/frame\n", frames, (uint) (bytes / frames));
+            frames = 0;
+            bytes = 0;
+            report_time = delayed_by_ms(report_time, 1000);
+        }
+    }
+}
@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Drive many WS2812 strips in parallel, with the bit planes prepared on core 1.
+//
+// In the ws2812_parallel example, core 0 draws each frame, transforms it into
+// bit planes and dithers it, then waits for the previous frame and the reset
+// delay before starting the DMA. Here the work is split into a pipeline:
+//
+// - Core 0 draws into one of three sets of strip buffers, and publishes it
+//   when it's done, so it never has to wait for the other stages.
+//
+// - Core 1 transforms and dithers the most recently published buffers into
+//   a free frame of bit planes (see ws2812_planes.h), and queues it.
+//
+// - A repeating timer sends the next queued frame, at a fixed frame rate.
+//   As each frame is contiguous, this is a single DMA transfer. The frame
+//   that was being sent is then returned to core 1.
+//
+// The library handles up to 32 strips. A frame of bit planes takes 32 bytes
+// per value whatever the number of strips, so 32 strips of 1000 RGB LEDs
+// need 96 kB per queued frame, which will only fit on RP2350 (which also has
+// enough GPIOs, in the QFN-80 package).
+//
+// Before starting, we check the transposer against its reference version,
+// and time it, both for this example's strips and for 32 x 1000 LEDs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/sync.h"
+#include "pico/util/queue.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "ws2812.pio.h"
+
+#include "ws2812_planes.h"
+
+#define WS2812_PIN_BASE 2
+#define NUM_STRIPS 8
+#define NUM_PIXELS 300
+// Values per strip, all strips are RGB
+#define NUM_VALUES (NUM_PIXELS * 3)
+
+// Frames of bit planes, between core 1 and the DMA
+#define NUM_FRAMES 3
+#define FRAME_RATE 60
+
+// WS2812 latch time, plus a margin
+#define RESET_US 300
+// Time to send one word (one bit of every strip) at 800 kHz
+#define NS_PER_BIT 1250
+
+static uint8_t strip_data[3][NUM_STRIPS][NUM_VALUES];
+static ws2812_value_planes_t frames[NUM_FRAMES][NUM_VALUES];
+static ws2812_error_planes_t dither_error[NUM_VALUES];
+
+// Strip buffers published by core 0, and those being read by core 1
+static critical_section_t strip_lock;
+static volatile uint published_buf;
+static volatile uint reading_buf;
+
+// Indices of frames waiting to be filled, and waiting to be sent
+static queue_t free_frames;
+static queue_t ready_frames;
+
+static uint dma_chan;
+static int sending_frame = -1;
+
+static volatile uint32_t frames_sent;
+static volatile uint32_t frames_repeated;
+static volatile uint32_t transform_us;
+static volatile uint global_brightness = WS2812_BRIGHTNESS_ONE / 4;
+
+static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
+    return
+            ((uint32_t) (r) << 8) |
+            ((uint32_t) (g) << 16) |
+            (uint32_t) (b);
+}
+
+static inline void put_pixel(uint8_t *out, uint i, uint32_t pixel_grb) {
+    out[i * 3] = pixel_grb & 0xffu;
+    out[i * 3 + 1] = (pixel_grb >> 8u) & 0xffu;
+    out[i * 3 + 2] = (pixel_grb >> 16u) & 0xffu;
+}
+
+// Snakes, as in ws2812_parallel, with each strip offset from the last
+static void pattern_snakes(uint8_t *out, uint strip, uint t) {
+    for (uint i = 0; i < NUM_PIXELS; ++i) {
+        uint x = (i + strip * 8 + (t >> 1)) % 64;
+        if (x < 10)
+            put_pixel(out, i, urgb_u32(0xff, 0, 0));
+        else if (x >= 15 && x < 25)
+            put_pixel(out, i, urgb_u32(0, 0xff, 0));
+        else if (x >= 30 && x < 40)
+            put_pixel(out, i, urgb_u32(0, 0, 0xff));
+        else
+            put_pixel(out, i, 0);
+    }
+}
+
+static void make_strips(ws2812_strip_t *strips, uint buf) {
+    for (uint i = 0; i < NUM_STRIPS; ++i) {
+        strips[i].data = strip_data[buf][i];
+        strips[i].data_len = NUM_VALUES;
+        // Dimmer towards the last strip, to show off the dithering
+        strips[i].brightness = WS2812_BRIGHTNESS_ONE >> (i / 2);
+    }
+}
+
+// Hand the buffer just drawn to core 1, and return the next one to draw into
+static uint publish_strips(uint drawn_buf) {
+    critical_section_enter_blocking(&strip_lock);
+    published_buf = drawn_buf;
+    uint next = 0;
+    while (next == published_buf || next == reading_buf)
+        ++next;
+    critical_section_exit(&strip_lock);
+    return next;
+}
+
+static void core1_entry() {
+    ws2812_strip_t strips[NUM_STRIPS];
+    while (true) {
+        uint8_t frame;
+        queue_remove_blocking(&free_frames, &frame);
+        critical_section_enter_blocking(&strip_lock);
+        reading_buf = published_buf;
+        critical_section_exit(&strip_lock);
+
+        uint64_t start = time_us_64();
+        make_strips(strips, reading_buf);
+        ws2812_planes_transform(strips, NUM_STRIPS, 0, NUM_VALUES, global_brightness, dither_error, frames[frame]);
+        transform_us = (uint32_t) (time_us_64() - start);
+        queue_add_blocking(&ready_frames, &frame);
+    }
+}
+
+// Called at the frame rate, in an interrupt on core 0
+static bool send_frame(__unused repeating_timer_t *rt) {
+    // The frame period allows for the reset time, so this shouldn't happen
+    if (dma_channel_is_busy(dma_chan))
+        return true;
+    uint8_t frame;
+    if (queue_try_remove(&ready_frames, &frame)) {
+        if (sending_frame >= 0) {
+            uint8_t done = (uint8_t) sending_frame;
+            queue_try_add(&free_frames, &done);
+        }
+        sending_frame = frame;
+        frames_sent = frames_sent + 1;
+    } else if (sending_frame >= 0) {
+        // Core 1 didn't keep up, so keep the frame rate by sending the last
+        // frame again
+        frames_repeated = frames_repeated + 1;
+    } else {
+        return true;
+    }
+    dma_channel_set_read_addr(dma_chan, frames[sending_frame], true);
+    return true;
+}
+
+static uint check_transform(uint n_frames) {
+    static ws2812_value_planes_t ref_out[NUM_VALUES];
+    static ws2812_error_planes_t ref_error[NUM_VALUES];
+    ws2812_strip_t strips[NUM_STRIPS];
+    make_strips(strips, 0);
+    uint errors = 0;
+    for (uint f = 0; f < n_frames; ++f) {
+        for (uint i = 0; i < NUM_STRIPS; ++i)
+            for (uint v = 0; v < NUM_VALUES; ++v)
+                strip_data[0][i][v] = (uint8_t) rand();
+        // Strips of different lengths
+        strips[f % NUM_STRIPS].data_len = NUM_VALUES - f * 7;
+        uint brightness = rand() % (2 * WS2812_BRIGHTNESS_ONE);
+        ws2812_planes_transform(strips, NUM_STRIPS, 0, NUM_VALUES, brightness, dither_error, frames[0]);
+        ws2812_planes_transform_reference(strips, NUM_STRIPS, 0, NUM_VALUES, brightness, ref_error, ref_out);
+        if (memcmp(frames[0], ref_out, sizeof(ref_out)) || memcmp(dither_error, ref_error, sizeof(ref_error)))
+            ++errors;
+    }
+    memset(dither_error, 0, sizeof(dither_error));
+    memset(strip_data, 0, sizeof(strip_data));
+    return errors;
+}
+
+static void benchmark_transform() {
+    ws2812_strip_t strips[NUM_STRIPS];
+    make_strips(strips, 0);
+    const uint n_frames = 10;
+    uint64_t start = time_us_64();
+    for (uint f = 0; f < n_frames; ++f)
+        ws2812_planes_transform(strips, NUM_STRIPS, 0, NUM_VALUES, WS2812_BRIGHTNESS_ONE, dither_error, frames[0]);
+    uint32_t us = (uint32_t) ((time_us_64() - start) / n_frames);
+    printf("%u strips x %u LEDs: %u us per frame, %u frames/s\n", NUM_STRIPS, NUM_PIXELS, (uint) us,
+           (uint) (1000000 / us));
+
+    // 32 strips of 1000 LEDs, a piece at a time, so we don't need the memory
+    // for a whole frame. The strips all share the same data.
+    const uint big_values = 1000 * 3, chunk = NUM_VALUES / 3;
+    ws2812_strip_t big_strips[WS2812_MAX_STRIPS];
+    for (uint i = 0; i < WS2812_MAX_STRIPS; ++i) {
+        big_strips[i].data = &strip_data[0][0][0];
+        big_strips[i].data_len = big_values;
+        big_strips[i].brightness = WS2812_BRIGHTNESS_ONE;
+    }
+    start = time_us_64();
+    for (uint f = 0; f < n_frames; ++f)
+        for (uint v = 0; v < big_values; v += chunk)
+            ws2812_planes_transform(big_strips, WS2812_MAX_STRIPS, v, chunk, WS2812_BRIGHTNESS_ONE, dither_error,
+                                    frames[0]);
+    us = (uint32_t) ((time_us_64() - start) / n_frames);
+    printf("%u strips x 1000 LEDs: %u us per frame, %u frames/s (sending takes %u us)\n", WS2812_MAX_STRIPS,
+           (uint) us, (uint) (1000000 / us), (uint) (big_values * 8 * NS_PER_BIT / 1000 + RESET_US));
+    memset(dither_error, 0, sizeof(dither_error));
+}
+
+int main() {
+    stdio_init_all();
+    puts("WS2812 parallel pipeline");
+
+    static_assert(NUM_STRIPS <= WS2812_MAX_STRIPS, "");
+    static_assert(NUM_STRIPS * NUM_VALUES >= 3000, "benchmark needs 3000 bytes of strip data");
+    uint errors = check_transform(10);
+    printf("Bit plane transform: %s\n", errors ? "MISMATCH" : "matches reference");
+    benchmark_transform();
+
+    PIO pio = pio0;
+    int sm = 0;
+    uint offset = pio_add_program(pio, &ws2812_parallel_program);
+    ws2812_parallel_program_init(pio, sm, offset, WS2812_PIN_BASE, NUM_STRIPS, 800000);
+
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dma_chan, &c, &pio->txf[sm], NULL, NUM_VALUES * 8, false);
+
+    critical_section_init(&strip_lock);
+    published_buf = 0;
+    reading_buf = 0;
+    queue_init(&free_frames, sizeof(uint8_t), NUM_FRAMES);
+    queue_init(&ready_frames, sizeof(uint8_t), NUM_FRAMES);
+    for (uint8_t i = 0; i < NUM_FRAMES; ++i)
+        queue_add_blocking(&free_frames, &i);
+    multicore_launch_core1(core1_entry);
+
+    // Sending must finish, and the LEDs latch, within each frame period
+    uint32_t send_us = NUM_VALUES * 8 * NS_PER_BIT / 1000 + RESET_US;
+    uint32_t period_us = 1000000 / FRAME_RATE;
+    if (period_us < send_us)
+        period_us = send_us;
+    printf("Sending each frame takes %u us, frame period %u us\n", (uint) send_us, (uint) period_us);
+    repeating_timer_t timer;
+    add_repeating_timer_us(-(int64_t) period_us, send_frame, NULL, &timer);
+
+    // Draw as fast as we like, slowly breathing the global brightness so the
+    // dithering shows
+    uint draw_buf = 1;
+    uint t = 0;
+    absolute_time_t next_report = make_timeout_time_ms(1000);
+    while (true) {
+        for (uint i = 0; i < NUM_STRIPS; ++i)
+            pattern_snakes(strip_data[draw_buf][i], i, t);
+        draw_buf = publish_strips(draw_buf);
+        uint phase = (t / 4) % (2 * WS2812_BRIGHTNESS_ONE);
+        global_brightness = phase < WS2812_BRIGHTNESS_ONE ? phase : 2 * WS2812_BRIGHTNESS_ONE - phase;
+        ++t;
+        sleep_ms(5);
+
+        if (time_reached(next_report)) {
+            next_report = delayed_by_ms(next_report, 1000);
+            printf("%u frames sent, %u repeated, transform %u us\n", (uint) frames_sent, (uint) frames_repeated,
+                   (uint) transform_us);
+        }
+    }
+}
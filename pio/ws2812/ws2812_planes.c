@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ws2812_planes.h"
+
+#define VALUE_BITS (8 + WS2812_FRAC_BITS)
+#define VALUE_MAX (0xffu << WS2812_FRAC_BITS)
+
+// Strip value in 8.WS2812_FRAC_BITS fixed point. This is clamped to 255.0 so
+// adding the dither error can never overflow.
+static inline uint32_t scaled_value(const ws2812_strip_t *strip, uint32_t v, uint32_t brightness) {
+    if (v >= strip->data_len)
+        return 0;
+    uint32_t value = (strip->data[v] * strip->brightness) >> (8 - WS2812_FRAC_BITS);
+    if (value > VALUE_MAX)
+        value = VALUE_MAX;
+    value = (value * brightness) >> 8;
+    return value > VALUE_MAX ? VALUE_MAX : value;
+}
+
+// Transpose a 32x32 bit matrix, where bit 31 - c of a[r] is column c of row
+// r (Hacker's Delight, 7-3)
+static void transpose32(uint32_t a[32]) {
+    uint32_t m = 0x0000ffffu;
+    for (uint32_t j = 16; j; j >>= 1, m ^= m << j) {
+        for (uint32_t k = 0; k < 32; k = (k + j + 1) & ~j) {
+            uint32_t t = (a[k] ^ (a[k + j] >> j)) & m;
+            a[k] ^= t;
+            a[k + j] ^= t << j;
+        }
+    }
+}
+
+void ws2812_planes_transform(const ws2812_strip_t *strips, uint32_t num_strips, uint32_t first, uint32_t count,
+                             uint32_t brightness, ws2812_error_planes_t *error, ws2812_value_planes_t *out) {
+    uint32_t a[32];
+    for (uint32_t n = 0; n < count; ++n) {
+        // Strip i is row 31 - i, and bit j of its value is column 31 - j, so
+        // after transposing, bit j of every strip is in a[31 - j]
+        uint32_t i = 0;
+        for (; i < num_strips; ++i)
+            a[31 - i] = scaled_value(&strips[i], first + n, brightness);
+        for (; i < 32; ++i)
+            a[31 - i] = 0;
+        transpose32(a);
+
+        // Add the error to the fractional planes, keeping the sum as the next
+        // error, then ripple the carry through the integer planes
+        uint32_t carry = 0;
+        for (uint32_t j = 0; j < WS2812_FRAC_BITS; ++j) {
+            uint32_t s = a[31 - j];
+            uint32_t e = error[n].planes[WS2812_FRAC_BITS - 1 - j];
+            error[n].planes[WS2812_FRAC_BITS - 1 - j] = s ^ e ^ carry;
+            carry = (s & e) | (carry & (s ^ e));
+        }
+        for (uint32_t j = 0; j < 8; ++j) {
+            uint32_t s = a[31 - WS2812_FRAC_BITS - j];
+            out[n].planes[7 - j] = s ^ carry;
+            carry &= s;
+        }
+    }
+}
+
+void ws2812_planes_transform_reference(const ws2812_strip_t *strips, uint32_t num_strips, uint32_t first,
+                                       uint32_t count, uint32_t brightness, ws2812_error_planes_t *error,
+                                       ws2812_value_planes_t *out) {
+    for (uint32_t n = 0; n < count; ++n) {
+        for (uint32_t j = 0; j < 8; ++j)
+            out[n].planes[j] = 0;
+        for (uint32_t i = 0; i < num_strips; ++i) {
+            uint32_t err = 0;
+            for (uint32_t j = 0; j < WS2812_FRAC_BITS; ++j)
+                err |= ((error[n].planes[WS2812_FRAC_BITS - 1 - j] >> i) & 1u) << j;
+            uint32_t value = scaled_value(&strips[i], first + n, brightness) + err;
+            for (uint32_t j = 0; j < VALUE_BITS; ++j) {
+                uint32_t bit = ((value >> j) & 1u) << i;
+                if (j < WS2812_FRAC_BITS) {
+                    uint32_t *plane = &error[n].planes[WS2812_FRAC_BITS - 1 - j];
+                    *plane = (*plane & ~(1u << i)) | bit;
+                } else {
+                    out[n].planes[7 - (j - WS2812_FRAC_BITS)] |= bit;
+                }
+            }
+        }
+    }
+}
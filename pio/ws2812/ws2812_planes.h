@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _WS2812_PLANES_H
+#define _WS2812_PLANES_H
+
+#include <stdint.h>
+
+// Bit plane transposer and temporal dither for driving up to 32 WS2812
+// strips in parallel with the ws2812_parallel PIO program.
+//
+// Each strip is a sequence of 8-bit values (e.g. G, R, B for each LED). The
+// nth value of every strip is scaled by that strip's brightness and the
+// global brightness to 8.WS2812_FRAC_BITS fixed point, then transposed into
+// bit planes: bit i of a plane is the bit of strip i's value, so a plane is
+// exactly one word for the PIO program. The fractional bits aren't sent, but
+// are carried over to the next frame in a per-value error, so over several
+// frames the LEDs show the fractional brightness (temporal dithering).
+//
+// A frame is one ws2812_value_planes_t per value, which is contiguous, so can
+// be sent with a single DMA transfer.
+
+#define WS2812_MAX_STRIPS 32
+#define WS2812_FRAC_BITS 4
+
+// Full brightness, for both strip and global brightness
+#define WS2812_BRIGHTNESS_ONE 256
+
+typedef struct {
+    const uint8_t *data;
+    // Number of values, shorter strips are padded with zeros
+    uint32_t data_len;
+    uint32_t brightness;
+} ws2812_strip_t;
+
+// Most significant plane first, in the order they are sent
+typedef struct {
+    uint32_t planes[8];
+} ws2812_value_planes_t;
+
+// Dither error, most significant plane first. Zero to start with.
+typedef struct {
+    uint32_t planes[WS2812_FRAC_BITS];
+} ws2812_error_planes_t;
+
+// Transform values first to first + count - 1 of every strip, for one frame.
+// error and out hold just those values, i.e. error[0] is for value first.
+void ws2812_planes_transform(const ws2812_strip_t *strips, uint32_t num_strips, uint32_t first, uint32_t count,
+                             uint32_t brightness, ws2812_error_planes_t *error, ws2812_value_planes_t *out);
+
+// The same thing a bit at a time, to check the above against
+void ws2812_planes_transform_reference(const ws2812_strip_t *strips, uint32_t num_strips, uint32_t first,
+                                       uint32_t count, uint32_t brightness, ws2812_error_planes_t *error,
+                                       ws2812_value_planes_t *out);
+
+#endif
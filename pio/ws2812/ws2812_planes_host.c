@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Tests of the bit plane transposer and dither (ws2812_planes.h), run on the
+// host. Build with PICO_PLATFORM=host.
+//
+// A few values are checked by hand: full brightness, clamping, and the zero
+// padding of short strips. Over 1 << WS2812_FRAC_BITS frames of the same
+// data, the dither must send exactly the scaled value in total. Then for
+// random strips, brightnesses and ranges of values, carrying the error over
+// several frames, ws2812_planes_transform() must give exactly what
+// ws2812_planes_transform_reference() does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "ws2812_planes.h"
+
+#define NUM_VALUES 64
+
+static uint8_t strip_data[WS2812_MAX_STRIPS][NUM_VALUES];
+static ws2812_strip_t strips[WS2812_MAX_STRIPS];
+static ws2812_value_planes_t out[NUM_VALUES], ref_out[NUM_VALUES];
+static ws2812_error_planes_t error[NUM_VALUES], ref_error[NUM_VALUES];
+
+static uint errors;
+
+static void check(bool ok, const char *what) {
+    if (!ok && !errors++)
+        printf("%s is wrong\n", what);
+}
+
+// The 8-bit value of one strip in a set of planes
+static uint plane_value(const ws2812_value_planes_t *planes, uint strip) {
+    uint value = 0;
+    for (uint j = 0; j < 8; ++j)
+        value = value << 1 | ((planes->planes[j] >> strip) & 1u);
+    return value;
+}
+
+static void check_values(void) {
+    static const uint8_t full[2] = {255, 255}, half[2] = {128, 1}, short_strip[1] = {200};
+    ws2812_strip_t three[3] = {
+            {.data = full, .data_len = 2, .brightness = WS2812_BRIGHTNESS_ONE},
+            {.data = half, .data_len = 2, .brightness = 2 * WS2812_BRIGHTNESS_ONE},
+            {.data = short_strip, .data_len = 1, .brightness = WS2812_BRIGHTNESS_ONE / 2},
+    };
+    memset(error, 0, sizeof(error));
+    ws2812_planes_transform(three, 3, 0, 2, WS2812_BRIGHTNESS_ONE, error, out);
+    check(plane_value(&out[0], 0) == 255 && plane_value(&out[1], 0) == 255, "Full brightness");
+    // 128 at double brightness is clamped to 255, but 1 isn't
+    check(plane_value(&out[0], 1) == 255 && plane_value(&out[1], 1) == 2, "Strip brightness");
+    check(plane_value(&out[0], 2) == 100 && plane_value(&out[1], 2) == 0, "Short strip");
+    for (uint i = 3; i < WS2812_MAX_STRIPS; ++i)
+        check(!plane_value(&out[0], i) && !plane_value(&out[1], i), "Unused strip");
+
+    // Starting part way along, with global brightness
+    memset(error, 0, sizeof(error));
+    ws2812_planes_transform(three, 3, 1, 1, WS2812_BRIGHTNESS_ONE / 2, error, out);
+    check(plane_value(&out[0], 0) == 127 && plane_value(&out[0], 1) == 1 && plane_value(&out[0], 2) == 0,
+          "Global brightness");
+}
+
+// With the error starting at zero, the fractions add up to whole units over
+// 1 << WS2812_FRAC_BITS frames
+static void check_dither(void) {
+    for (uint i = 0; i < WS2812_MAX_STRIPS; ++i) {
+        for (uint v = 0; v < NUM_VALUES; ++v)
+            strip_data[i][v] = (uint8_t) rand();
+        strips[i] = (ws2812_strip_t) {.data = strip_data[i], .data_len = NUM_VALUES,
+                                      .brightness = 1 + rand() % WS2812_BRIGHTNESS_ONE};
+    }
+    uint brightness = 1 + rand() % WS2812_BRIGHTNESS_ONE;
+    static uint totals[WS2812_MAX_STRIPS][NUM_VALUES];
+    memset(totals, 0, sizeof(totals));
+    memset(error, 0, sizeof(error));
+    for (uint frame = 0; frame < 1u << WS2812_FRAC_BITS; ++frame) {
+        ws2812_planes_transform(strips, WS2812_MAX_STRIPS, 0, NUM_VALUES, brightness, error, out);
+        for (uint i = 0; i < WS2812_MAX_STRIPS; ++i)
+            for (uint v = 0; v < NUM_VALUES; ++v)
+                totals[i][v] += plane_value(&out[v], i);
+    }
+    for (uint i = 0; i < WS2812_MAX_STRIPS; ++i) {
+        for (uint v = 0; v < NUM_VALUES; ++v) {
+            // The scaled value in 8.WS2812_FRAC_BITS fixed point, worked out
+            // the long way
+            uint scaled = MIN((uint) strip_data[i][v] * strips[i].brightness, 255u * 256u) >> (8 - WS2812_FRAC_BITS);
+            scaled = scaled * brightness >> 8;
+            check(totals[i][v] == scaled, "Total of the dithered values");
+        }
+    }
+    for (uint v = 0; v < NUM_VALUES; ++v)
+        for (uint j = 0; j < WS2812_FRAC_BITS; ++j)
+            check(!error[v].planes[j], "Error after a whole dither cycle");
+}
+
+static void check_against_reference(uint n_trials) {
+    for (uint trial = 0; trial < n_trials && !errors; ++trial) {
+        uint num_strips = 1 + rand() % WS2812_MAX_STRIPS;
+        for (uint i = 0; i < num_strips; ++i) {
+            for (uint v = 0; v < NUM_VALUES; ++v)
+                strip_data[i][v] = (uint8_t) rand();
+            strips[i] = (ws2812_strip_t) {.data = strip_data[i], .data_len = rand() % (NUM_VALUES + 1),
+                                          .brightness = rand() % (2 * WS2812_BRIGHTNESS_ONE)};
+        }
+        uint first = rand() % NUM_VALUES;
+        uint count = 1 + rand() % (NUM_VALUES - first);
+        uint brightness = rand() % (WS2812_BRIGHTNESS_ONE + 1);
+        for (uint v = 0; v < count; ++v)
+            for (uint j = 0; j < WS2812_FRAC_BITS; ++j)
+                error[v].planes[j] = ref_error[v].planes[j] = (uint32_t) rand() ^ (uint32_t) rand() << 16;
+        // A few frames, so the error is carried over
+        for (uint frame = 0; frame < 3; ++frame) {
+            ws2812_planes_transform(strips, num_strips, first, count, brightness, error, out);
+            ws2812_planes_transform_reference(strips, num_strips, first, count, brightness, ref_error, ref_out);
+            if (memcmp(out, ref_out, count * sizeof(out[0])) || memcmp(error, ref_error, count * sizeof(error[0]))) {
+                printf("%u strips, values %u to %u, frame %u: planes differ from the reference\n", num_strips,
+                       first, first + count - 1, frame);
+                ++errors;
+                break;
+            }
+        }
+    }
+}
+
+int main() {
+    printf("WS2812 bit plane host tests\n");
+    check_values();
+    check_dither();
+    const uint n_trials = 2000;
+    check_against_reference(n_trials);
+    printf(errors ? "FAILED\n" : "All bit plane checks passed\n");
+    return errors != 0;
+}
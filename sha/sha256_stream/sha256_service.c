@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/sha256.h"
+
+#include "sha256_service.h"
+#include "sha256_soft.h"
+
+enum {
+    STAGE_START,
+    STAGE_INNER_PAD,
+    STAGE_DATA,
+    STAGE_OUTER_START,
+    STAGE_OUTER_PAD,
+    STAGE_OUTER_DIGEST,
+};
+
+static sha256_job_t *queue[SHA256_SERVICE_QUEUE_LENGTH];
+static uint queue_head;
+static uint queue_count;
+static pico_sha256_state_t state;
+
+bool sha256_service_submit(sha256_job_t *job) {
+    if (queue_count == SHA256_SERVICE_QUEUE_LENGTH)
+        return false;
+    job->done = false;
+    job->stage = STAGE_START;
+    job->segment = 0;
+    queue[(queue_head + queue_count) % SHA256_SERVICE_QUEUE_LENGTH] = job;
+    ++queue_count;
+    return true;
+}
+
+static void make_pad(sha256_job_t *job, uint8_t pad_byte) {
+    // Long keys are hashed in software; they are rare, and short
+    hmac_sha256_key_block(job->hmac_key, job->hmac_key_len, job->pad);
+    for (uint i = 0; i < sizeof(job->pad); ++i)
+        job->pad[i] ^= pad_byte;
+}
+
+static void finish_job(sha256_job_t *job) {
+    queue_head = (queue_head + 1) % SHA256_SERVICE_QUEUE_LENGTH;
+    --queue_count;
+    job->done = true;
+}
+
+bool sha256_service_poll(void) {
+    if (!queue_count)
+        return false;
+    sha256_job_t *job = queue[queue_head];
+    // pico_sha256_update() only waits for the DMA from the previous call when
+    // it is called again, so don't call it until the hardware can take more
+    if (job->stage != STAGE_START && job->stage != STAGE_OUTER_START &&
+        state.channel >= 0 && dma_channel_is_busy(state.channel))
+        return true;
+
+    switch (job->stage) {
+        case STAGE_START:
+        case STAGE_OUTER_START:
+            // Someone else may be using the hardware, in which case try again
+            // next time
+            if (pico_sha256_try_start(&state, SHA256_BIG_ENDIAN, true) != PICO_OK)
+                return true;
+            if (job->stage == STAGE_OUTER_START) {
+                make_pad(job, 0x5c);
+                job->stage = STAGE_OUTER_PAD;
+            } else if (job->hmac_key) {
+                make_pad(job, 0x36);
+                job->stage = STAGE_INNER_PAD;
+            } else {
+                job->stage = STAGE_DATA;
+            }
+            break;
+        case STAGE_INNER_PAD:
+            pico_sha256_update(&state, job->pad, sizeof(job->pad));
+            job->stage = STAGE_DATA;
+            break;
+        case STAGE_DATA:
+            if (job->segment < job->n_segments) {
+                const sha256_segment_t *seg = &job->segments[job->segment++];
+                pico_sha256_update(&state, seg->data, seg->len);
+                break;
+            }
+            if (job->hmac_key) {
+                pico_sha256_finish(&state, &job->inner);
+                job->stage = STAGE_OUTER_START;
+            } else {
+                pico_sha256_finish(&state, &job->result);
+                finish_job(job);
+            }
+            break;
+        case STAGE_OUTER_PAD:
+            pico_sha256_update(&state, job->pad, sizeof(job->pad));
+            job->stage = STAGE_OUTER_DIGEST;
+            break;
+        case STAGE_OUTER_DIGEST:
+            pico_sha256_update(&state, job->inner.bytes, SHA256_RESULT_BYTES);
+            pico_sha256_finish(&state, &job->result);
+            finish_job(job);
+            break;
+    }
+    return queue_count != 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _SHA256_SERVICE_H
+#define _SHA256_SERVICE_H
+
+#include "pico/sha256.h"
+
+// A queue of SHA-256 and HMAC-SHA256 jobs for the SHA-256 hardware.
+//
+// Each job hashes a chain of buffers, which needn't be contiguous, or word
+// aligned. The hardware is fed by DMA (see pico/sha256.h), and
+// sha256_service_poll() starts the next buffer, or the next job, as soon as
+// the previous one is done, so the hardware is kept busy whilst the processor
+// gets on with something else between polls.
+//
+// Jobs, their buffer lists and the buffers themselves belong to the caller,
+// and must stay valid until the job is done.
+
+#ifndef SHA256_SERVICE_QUEUE_LENGTH
+#define SHA256_SERVICE_QUEUE_LENGTH 8
+#endif
+
+typedef struct {
+    const void *data;
+    size_t len;
+} sha256_segment_t;
+
+typedef struct {
+    const sha256_segment_t *segments;
+    uint n_segments;
+    // For HMAC-SHA256, or NULL for a plain hash
+    const uint8_t *hmac_key;
+    size_t hmac_key_len;
+
+    sha256_result_t result;
+    volatile bool done;
+
+    // Private to the service
+    uint stage;
+    uint segment;
+    uint8_t pad[64];
+    sha256_result_t inner;
+} sha256_job_t;
+
+// Returns false if the queue is full
+bool sha256_service_submit(sha256_job_t *job);
+
+// Move the current job on, if the hardware is ready. Returns false when there
+// is nothing left to do.
+bool sha256_service_poll(void);
+
+static inline void sha256_service_run_blocking(void) {
+    while (sha256_service_poll())
+        tight_loop_contents();
+}
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "sha256_soft.h"
+
+static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror(uint32_t x, unsigned int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void compress(uint32_t h[8], const uint8_t *block) {
+    uint32_t w[64];
+    for (unsigned int i = 0; i < 16; ++i)
+        w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16 |
+               (uint32_t) block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (unsigned int i = 16; i < 64; ++i) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (unsigned int i = 0; i < 64; ++i) {
+        uint32_t t1 = hh + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        hh = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+}
+
+void sha256_soft_init(sha256_soft_t *ctx) {
+    static const uint32_t h0[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->h, h0, sizeof(h0));
+    ctx->total_bytes = 0;
+    ctx->block_used = 0;
+}
+
+void sha256_soft_update(sha256_soft_t *ctx, const void *data, size_t len) {
+    const uint8_t *p = data;
+    ctx->total_bytes += len;
+    if (ctx->block_used) {
+        size_t n = SHA256_SOFT_BLOCK_BYTES - ctx->block_used;
+        if (n > len)
+            n = len;
+        memcpy(ctx->block + ctx->block_used, p, n);
+        ctx->block_used += n;
+        p += n;
+        len -= n;
+        if (ctx->block_used < SHA256_SOFT_BLOCK_BYTES)
+            return;
+        compress(ctx->h, ctx->block);
+        ctx->block_used = 0;
+    }
+    for (; len >= SHA256_SOFT_BLOCK_BYTES; len -= SHA256_SOFT_BLOCK_BYTES, p += SHA256_SOFT_BLOCK_BYTES)
+        compress(ctx->h, p);
+    memcpy(ctx->block, p, len);
+    ctx->block_used = len;
+}
+
+void sha256_soft_finish(sha256_soft_t *ctx, uint8_t digest[SHA256_SOFT_DIGEST_BYTES]) {
+    uint64_t bits = ctx->total_bytes * 8;
+    uint8_t pad[SHA256_SOFT_BLOCK_BYTES + 8] = {0x80};
+    size_t pad_len = (ctx->block_used < 56 ? 56 : 120) - ctx->block_used;
+    for (unsigned int i = 0; i < 8; ++i)
+        pad[pad_len + i] = (uint8_t) (bits >> (56 - 8 * i));
+    sha256_soft_update(ctx, pad, pad_len + 8);
+    for (unsigned int i = 0; i < 8; ++i) {
+        digest[4 * i] = (uint8_t) (ctx->h[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (ctx->h[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (ctx->h[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) ctx->h[i];
+    }
+}
+
+void sha256_soft(const void *data, size_t len, uint8_t digest[SHA256_SOFT_DIGEST_BYTES]) {
+    sha256_soft_t ctx;
+    sha256_soft_init(&ctx);
+    sha256_soft_update(&ctx, data, len);
+    sha256_soft_finish(&ctx, digest);
+}
+
+void hmac_sha256_key_block(const uint8_t *key, size_t key_len, uint8_t block[SHA256_SOFT_BLOCK_BYTES]) {
+    memset(block, 0, SHA256_SOFT_BLOCK_BYTES);
+    if (key_len > SHA256_SOFT_BLOCK_BYTES)
+        sha256_soft(key, key_len, block);
+    else
+        memcpy(block, key, key_len);
+}
+
+static void hash_pad(sha256_soft_t *ctx, const uint8_t *key_block, uint8_t pad_byte) {
+    uint8_t pad[SHA256_SOFT_BLOCK_BYTES];
+    for (unsigned int i = 0; i < SHA256_SOFT_BLOCK_BYTES; ++i)
+        pad[i] = key_block[i] ^ pad_byte;
+    sha256_soft_update(ctx, pad, sizeof(pad));
+}
+
+void hmac_sha256_soft_init(hmac_sha256_soft_t *ctx, const uint8_t *key, size_t key_len) {
+    hmac_sha256_key_block(key, key_len, ctx->key_block);
+    sha256_soft_init(&ctx->inner);
+    hash_pad(&ctx->inner, ctx->key_block, 0x36);
+}
+
+void hmac_sha256_soft_update(hmac_sha256_soft_t *ctx, const void *data, size_t len) {
+    sha256_soft_update(&ctx->inner, data, len);
+}
+
+void hmac_sha256_soft_finish(hmac_sha256_soft_t *ctx, uint8_t mac[SHA256_SOFT_DIGEST_BYTES]) {
+    uint8_t inner_digest[SHA256_SOFT_DIGEST_BYTES];
+    sha256_soft_finish(&ctx->inner, inner_digest);
+    sha256_soft_t outer;
+    sha256_soft_init(&outer);
+    hash_pad(&outer, ctx->key_block, 0x5c);
+    sha256_soft_update(&outer, inner_digest, sizeof(inner_digest));
+    sha256_soft_finish(&outer, mac);
+}
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _SHA256_SOFT_H
+#define _SHA256_SOFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Software SHA-256 and HMAC-SHA256, for checking the hardware against, and
+// for use where the hardware isn't available (or is busy).
+
+#define SHA256_SOFT_BLOCK_BYTES 64
+#define SHA256_SOFT_DIGEST_BYTES 32
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t total_bytes;
+    uint8_t block[SHA256_SOFT_BLOCK_BYTES];
+    size_t block_used;
+} sha256_soft_t;
+
+void sha256_soft_init(sha256_soft_t *ctx);
+
+void sha256_soft_update(sha256_soft_t *ctx, const void *data, size_t len);
+
+void sha256_soft_finish(sha256_soft_t *ctx, uint8_t digest[SHA256_SOFT_DIGEST_BYTES]);
+
+void sha256_soft(const void *data, size_t len, uint8_t digest[SHA256_SOFT_DIGEST_BYTES]);
+
+// The key is reduced to a block as HMAC requires: hashed if longer than a
+// block, then zero padded. XORing the block with 0x36 or 0x5c gives the inner
+// and outer pads.
+void hmac_sha256_key_block(const uint8_t *key, size_t key_len, uint8_t block[SHA256_SOFT_BLOCK_BYTES]);
+
+typedef struct {
+    sha256_soft_t inner;
+    uint8_t key_block[SHA256_SOFT_BLOCK_BYTES];
+} hmac_sha256_soft_t;
+
+void hmac_sha256_soft_init(hmac_sha256_soft_t *ctx, const uint8_t *key, size_t key_len);
+
+void hmac_sha256_soft_update(hmac_sha256_soft_t *ctx, const void *data, size_t len);
+
+void hmac_sha256_soft_finish(hmac_sha256_soft_t *ctx, uint8_t mac[SHA256_SOFT_DIGEST_BYTES]);
+
+#endif
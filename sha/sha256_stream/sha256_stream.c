@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Streaming SHA-256 example.
+//
+// hello_sha256 hashes one buffer at a time, blocking until it's done. Here
+// sha256_service.h queues several independent jobs, each of which hashes a
+// chain of separate buffers, optionally as HMAC-SHA256. The service feeds the
+// hardware by DMA and moves on to the next buffer or job as soon as it can,
+// leaving the processor free in between.
+//
+// We check the service against the NIST SHA-256 and RFC 4231 HMAC test
+// vectors, and against the software version (sha256_soft.h) on random buffer
+// chains. Then we compare the throughput of each way of hashing, in bytes per
+// system clock cycle.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/sha256.h"
+#include "hardware/clocks.h"
+
+#include "sha256_service.h"
+#include "sha256_soft.h"
+
+#define BUFFER_SIZE 10000
+#define N_JOBS 4
+#define MAX_SEGMENTS 16
+
+static uint8_t buffer[BUFFER_SIZE];
+static sha256_segment_t segments[N_JOBS][MAX_SEGMENTS];
+static sha256_job_t jobs[N_JOBS];
+
+typedef struct {
+    const char *name;
+    const char *msg;
+    const uint8_t *key;
+    size_t key_len;
+    uint8_t expected[32];
+} test_vector_t;
+
+static const uint8_t key_0b[20] = {
+        0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+        0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+};
+static uint8_t key_aa[131];
+
+static const test_vector_t vectors[] = {
+        {"NIST abc", "abc", NULL, 0,
+         {0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+          0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad}},
+        {"NIST empty", "", NULL, 0,
+         {0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+          0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55}},
+        {"NIST 448 bit", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", NULL, 0,
+         {0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+          0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1}},
+        {"RFC 4231 case 1", "Hi There", key_0b, sizeof(key_0b),
+         {0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53, 0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+          0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7, 0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7}},
+        {"RFC 4231 case 2", "what do ya want for nothing?", (const uint8_t *) "Jefe", 4,
+         {0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+          0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43}},
+        {"RFC 4231 case 6", "Test Using Larger Than Block-Size Key - Hash Key First", key_aa, sizeof(key_aa),
+         {0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+          0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54}},
+};
+
+// The million 'a' NIST vector
+static const uint8_t nist_3_expected[32] = {
+        0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+        0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0,
+};
+
+static bool check_vectors(void) {
+    bool ok = true;
+    memset(key_aa, 0xaa, sizeof(key_aa));
+    // Queue them all at once, each split into two segments
+    for (uint i = 0; i < count_of(vectors); i += N_JOBS) {
+        uint n = MIN(N_JOBS, count_of(vectors) - i);
+        for (uint j = 0; j < n; ++j) {
+            const test_vector_t *v = &vectors[i + j];
+            size_t len = strlen(v->msg);
+            segments[j][0] = (sha256_segment_t) {v->msg, len / 2};
+            segments[j][1] = (sha256_segment_t) {v->msg + len / 2, len - len / 2};
+            jobs[j] = (sha256_job_t) {.segments = segments[j], .n_segments = 2,
+                                      .hmac_key = v->key, .hmac_key_len = v->key_len};
+            hard_assert(sha256_service_submit(&jobs[j]));
+        }
+        sha256_service_run_blocking();
+        for (uint j = 0; j < n; ++j) {
+            bool match = jobs[j].done && !memcmp(jobs[j].result.bytes, vectors[i + j].expected, 32);
+            printf("%-16s %s\n", vectors[i + j].name, match ? "ok" : "FAILED");
+            ok &= match;
+        }
+    }
+
+    // A million 'a's, as one job with the same buffer repeated
+    memset(buffer, 'a', BUFFER_SIZE);
+    static sha256_segment_t million[1000000 / BUFFER_SIZE];
+    for (uint i = 0; i < count_of(million); ++i)
+        million[i] = (sha256_segment_t) {buffer, BUFFER_SIZE};
+    jobs[0] = (sha256_job_t) {.segments = million, .n_segments = count_of(million)};
+    sha256_service_submit(&jobs[0]);
+    sha256_service_run_blocking();
+    bool match = !memcmp(jobs[0].result.bytes, nist_3_expected, 32);
+    printf("%-16s %s\n", "NIST million a", match ? "ok" : "FAILED");
+    return ok && match;
+}
+
+// Random chains of random length pieces of the buffer, some with HMAC keys,
+// checked against the software version
+static bool check_random(void) {
+    for (uint i = 0; i < BUFFER_SIZE; ++i)
+        buffer[i] = (uint8_t) rand();
+    uint8_t expected[N_JOBS][32];
+    for (uint j = 0; j < N_JOBS; ++j) {
+        uint n = 1 + rand() % MAX_SEGMENTS;
+        bool hmac = j & 1;
+        size_t key_len = 1 + rand() % 100;
+        hmac_sha256_soft_t hctx;
+        sha256_soft_t ctx;
+        if (hmac)
+            hmac_sha256_soft_init(&hctx, buffer, key_len);
+        else
+            sha256_soft_init(&ctx);
+        for (uint s = 0; s < n; ++s) {
+            size_t offset = rand() % BUFFER_SIZE;
+            size_t len = rand() % (BUFFER_SIZE - offset);
+            segments[j][s] = (sha256_segment_t) {buffer + offset, len};
+            if (hmac)
+                hmac_sha256_soft_update(&hctx, buffer + offset, len);
+            else
+                sha256_soft_update(&ctx, buffer + offset, len);
+        }
+        if (hmac)
+            hmac_sha256_soft_finish(&hctx, expected[j]);
+        else
+            sha256_soft_finish(&ctx, expected[j]);
+        jobs[j] = (sha256_job_t) {.segments = segments[j], .n_segments = n,
+                                  .hmac_key = hmac ? buffer : NULL, .hmac_key_len = key_len};
+        sha256_service_submit(&jobs[j]);
+    }
+    sha256_service_run_blocking();
+    bool ok = true;
+    for (uint j = 0; j < N_JOBS; ++j)
+        ok &= !memcmp(jobs[j].result.bytes, expected[j], 32);
+    printf("%-16s %s\n", "Random chains", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void print_rate(const char *name, size_t bytes, uint64_t us) {
+    float cycles = (float) us * ((float) clock_get_hz(clk_sys) / 1e6f);
+    printf("%-22s %.3f bytes/cycle (%.1f cycles/byte)\n", name, (float) bytes / cycles, cycles / (float) bytes);
+}
+
+static void benchmark(void) {
+    const size_t total = N_JOBS * MAX_SEGMENTS * BUFFER_SIZE;
+    uint8_t digest[32];
+    sha256_result_t result;
+
+    uint64_t start = time_us_64();
+    sha256_soft_t ctx;
+    sha256_soft_init(&ctx);
+    for (uint i = 0; i < N_JOBS * MAX_SEGMENTS; ++i)
+        sha256_soft_update(&ctx, buffer, BUFFER_SIZE);
+    sha256_soft_finish(&ctx, digest);
+    print_rate("Software", total, time_us_64() - start);
+
+    for (int use_dma = 0; use_dma < 2; ++use_dma) {
+        start = time_us_64();
+        pico_sha256_state_t state;
+        hard_assert(pico_sha256_start_blocking(&state, SHA256_BIG_ENDIAN, use_dma) == PICO_OK);
+        for (uint i = 0; i < N_JOBS * MAX_SEGMENTS; ++i)
+            pico_sha256_update_blocking(&state, buffer, BUFFER_SIZE);
+        pico_sha256_finish(&state, &result);
+        print_rate(use_dma ? "Hardware, DMA" : "Hardware, no DMA", total, time_us_64() - start);
+    }
+
+    // The same amount of data as N_JOBS queued jobs, counting how many times
+    // we get to go round the loop whilst the hardware is busy
+    for (uint j = 0; j < N_JOBS; ++j) {
+        for (uint s = 0; s < MAX_SEGMENTS; ++s)
+            segments[j][s] = (sha256_segment_t) {buffer, BUFFER_SIZE};
+        jobs[j] = (sha256_job_t) {.segments = segments[j], .n_segments = MAX_SEGMENTS};
+    }
+    uint32_t polls = 0;
+    start = time_us_64();
+    for (uint j = 0; j < N_JOBS; ++j)
+        sha256_service_submit(&jobs[j]);
+    while (sha256_service_poll())
+        ++polls;
+    print_rate("Service, queued jobs", total, time_us_64() - start);
+    printf("Polled %u times whilst hashing\n", polls);
+}
+
+int main() {
+    stdio_init_all();
+    printf("Streaming SHA-256 example\n");
+
+    bool ok = check_vectors();
+    ok &= check_random();
+    if (!ok) {
+        printf("ERROR - SHA-256 checks FAILED!\n");
+        return 1;
+    }
+    benchmark();
+    printf("Success\n");
+}